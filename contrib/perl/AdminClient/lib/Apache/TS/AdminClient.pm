@@ -265,6 +265,7 @@ The Apache Traffic Server Administration Manual will explain what these strings
 
  proxy.config.accept_threads
  proxy.config.task_threads
+ proxy.config.task_threads.work_stealing
  proxy.config.admin.admin_user
  proxy.config.admin.autoconf.localhost_only
  proxy.config.admin.autoconf.pac_filename
@@ -313,12 +314,24 @@ The Apache Traffic Server Administration Manual will explain what these strings
  proxy.config.cluster.cluster_load_clear_duration
  proxy.config.cluster.cluster_load_exceed_duration
  proxy.config.cluster.cluster_port
+ proxy.config.cluster.coalesce.enabled
+ proxy.config.cluster.coalesce.max_delay
+ proxy.config.cluster.compress.enabled
+ proxy.config.cluster.compress.min_size
+ proxy.config.cluster.consistent_hash
  proxy.config.cluster.delta_thresh
+ proxy.config.cluster.diffuse.enabled
+ proxy.config.cluster.diffuse.read_threshold
+ proxy.config.cluster.diffuse.replica_ttl_secs
+ proxy.config.cluster.diffuse.window_secs
  proxy.config.cluster.enable_monitor
  proxy.config.cluster.ethernet_interface
+ proxy.config.cluster.hash_load_factor
+ proxy.config.cluster.hash_virtual_nodes
  proxy.config.cluster.load_compute_interval_msecs
  proxy.config.cluster.load_monitor_enabled
  proxy.config.cluster.log_bogus_mc_msgs
+ proxy.config.cluster.max_machines
  proxy.config.cluster.mc_group_addr
  proxy.config.cluster.mcport
  proxy.config.cluster.mc_ttl
@@ -371,9 +384,11 @@ The Apache Traffic Server Administration Manual will explain what these strings
  proxy.config.dns.url_expansions
  proxy.config.dump_mem_info_frequency
  proxy.config.env_prep
+ proxy.config.exec_thread.affinity
  proxy.config.exec_thread.autoconfig
  proxy.config.exec_thread.autoconfig.scale
  proxy.config.exec_thread.limit
+ proxy.config.exec_thread.load_aware
  proxy.config.header.parse.no_host_url_redirect
  proxy.config.history_info_enabled
  proxy.config.hostdb
@@ -491,6 +506,8 @@ The Apache Traffic Server Administration Manual will explain what these strings
  proxy.config.http.number_of_redirections
  proxy.config.http.origin_max_connections
  proxy.config.http.origin_min_keep_alive_connections
+ proxy.config.http.origin_pipeline_depth
+ proxy.config.http.origin_pipeline_max_object_size
  proxy.config.http.origin_server_pipeline
  proxy.config.http.parent_proxies
  proxy.config.http.parent_proxy.connect_attempts_timeout
@@ -521,6 +538,8 @@ The Apache Traffic Server Administration Manual will explain what these strings
  proxy.config.http.server_other_ports
  proxy.config.http.server_port
  proxy.config.http.server_port_attr
+ proxy.config.http.server_session_max_idle_per_origin
+ proxy.config.http.server_session_steal_enabled
  proxy.config.http.session_auth_cache_keep_alive_enabled
  proxy.config.http.share_server_sessions
  proxy.config.http.slow.log.threshold
@@ -551,12 +570,15 @@ The Apache Traffic Server Administration Manual will explain what these strings
  proxy.config.local_state_dir
  proxy.config.log.ascii_buffer_size
  proxy.config.log.auto_delete_rolled_files
+ proxy.config.log.collation_compress
  proxy.config.log.collation_host
  proxy.config.log.collation_host_tagged
+ proxy.config.log.collation_max_inflight_buffers
  proxy.config.log.collation_max_send_buffers
  proxy.config.log.collation_port
  proxy.config.log.collation_retry_sec
  proxy.config.log.collation_secret
+ proxy.config.log.columnar_binary
  proxy.config.log.common_log_enabled
  proxy.config.log.common_log_header
  proxy.config.log.common_log_is_ascii
@@ -584,6 +606,7 @@ The Apache Traffic Server Administration Manual will explain what these strings
  proxy.config.log.max_space_mb_for_orphan_logs
  proxy.config.log.max_space_mb_headroom
  proxy.config.log.overspill_report_count
+ proxy.config.log.per_thread_buffers
  proxy.config.log.rolling_enabled
  proxy.config.log.rolling_interval_sec
  proxy.config.log.rolling_offset_hr
@@ -681,17 +704,27 @@ The Apache Traffic Server Administration Manual will explain what these strings
  proxy.config.ssl.client.private_key.path
  proxy.config.ssl.client.verify.server
  proxy.config.ssl.enabled
+ proxy.config.ssl.handshake.max_offload_per_thread
+ proxy.config.ssl.handshake.offload_threads
+ proxy.config.ssl.max_record_size
  proxy.config.ssl.number.threads
  proxy.config.ssl.server.cert_chain.filename
  proxy.config.ssl.server.cert.path
  proxy.config.ssl.server.cipher_suite
+ proxy.config.ssl.server.context_cache.size
  proxy.config.ssl.server.honor_cipher_order
+ proxy.config.ssl.server.lazy_load
  proxy.config.ssl.SSLv2
  proxy.config.ssl.SSLv3
  proxy.config.ssl.TLSv1
  proxy.config.ssl.compression
  proxy.config.ssl.server.multicert.filename
  proxy.config.ssl.server_port
+ proxy.config.ssl.session_cache
+ proxy.config.ssl.session_cache.filename
+ proxy.config.ssl.session_cache.num_buckets
+ proxy.config.ssl.session_cache.size
+ proxy.config.ssl.session_cache.timeout
  proxy.config.ssl.server.private_key.path
  proxy.config.stack_dump_enabled
  proxy.config.start_script
@@ -313,6 +313,21 @@ CacheVC::do_io_pread(Continuation *c, int64_t nbytes, MIOBuffer *abuf, int64_t o
   return &vio;
 }
 
+VIO *
+CacheVC::do_io_pread_ranges(Continuation *c, int64_t nbytes, MIOBuffer *abuf, int nranges, const CacheRange *ranges)
+{
+  ink_assert(vio.op == VIO::READ);
+  ink_assert(nranges > 0 && !pread_ranges);
+  for (int i = 0; i < nranges; i++)
+    ink_assert(ranges[i].start >= 0 && ranges[i].end >= ranges[i].start);
+  pread_ranges = (CacheRange *)ats_malloc(nranges * sizeof(CacheRange));
+  memcpy(pread_ranges, ranges, nranges * sizeof(CacheRange));
+  pread_n_ranges = nranges;
+  pread_range = 0;
+  pread_pos = ranges[0].start;
+  return do_io_pread(c, nbytes, abuf, ranges[0].start);
+}
+
 VIO *
 CacheVC::do_io_write(Continuation *c, int64_t nbytes, IOBufferReader *abuf, bool owner)
 {
@@ -3557,6 +3572,9 @@ CacheProcessor::open_write(Continuation *cont, int expected_size, URL *url, bool
     ClusterMachine *m = cluster_machine_at_depth(cache_hash(url_md5));
 
     if (m) {
+      // the owner gets a new copy, stop reading the local replica
+      if (cluster_diffuse_enabled)
+        diffusePolicy.drop_replica(&url_md5);
       // Do remote open_write()
       return Cluster_write(cont, expected_size, (MIOBuffer *) 0, m,
                            &url_md5, type,
@@ -795,6 +795,7 @@ CacheVC::openReadMain(int event, Event * e)
     seek_to = 0;
   }
 
+Lnext:
   if (ntodo <= 0)
     return EVENT_CONT;
   if (vio.buffer.mbuf->max_read_avail() > vio.buffer.writer()->water_mark && vio.ndone) // initiate read of first block
@@ -803,11 +804,20 @@ CacheVC::openReadMain(int event, Event * e)
     goto Lread;
   if (bytes > vio.ntodo())
     bytes = vio.ntodo();
+  if (pread_ranges && bytes > pread_ranges[pread_range].end - pread_pos + 1)
+    bytes = pread_ranges[pread_range].end - pread_pos + 1;
   b = new_IOBufferBlock(buf, bytes, doc_pos);
   b->_buf_end = b->_end;
   vio.buffer.mbuf->append_block(b);
   vio.ndone += bytes;
   doc_pos += bytes;
+  if (pread_ranges) {
+    pread_pos += bytes;
+    if (pread_pos > pread_ranges[pread_range].end && pread_range + 1 < pread_n_ranges) {
+      pread_range++;
+      openReadSeekRange(doc, pread_ranges[pread_range].start);
+    }
+  }
   if (vio.ntodo() <= 0)
     return calluser(VC_EVENT_READ_COMPLETE);
   else {
@@ -815,8 +825,15 @@ CacheVC::openReadMain(int event, Event * e)
       return EVENT_DONE;
     // we have to keep reading until we give the user all the
     // bytes it wanted or we hit the watermark.
-    if (vio.ntodo() > 0 && !vio.buffer.writer()->high_water())
+    if (vio.ntodo() > 0 && !vio.buffer.writer()->high_water()) {
+      // the next range may start in the fragment we already have
+      if (doc_pos < doc->len) {
+        ntodo = vio.ntodo();
+        bytes = doc->len - doc_pos;
+        goto Lnext;
+      }
       goto Lread;
+    }
     return EVENT_CONT;
   }
 Lread: {
@@ -874,6 +891,39 @@ Lcallreturn:
   return handleEvent(AIO_EVENT_DONE, 0);
 }
 
+// Position the read on object offset 'pos' for do_io_pread_ranges().  If
+// 'pos' is in the fragment in 'buf' just move doc_pos, otherwise mark it
+// consumed and point 'key' at the fragment to read, seek_to is what to
+// skip in it.  Going back restarts the key chain at earliest_key.
+void
+CacheVC::openReadSeekRange(Doc *doc, int64_t pos)
+{
+  int64_t frag_start = pread_pos - (doc_pos - doc->prefix_len());
+  int64_t cur = 0, target = 0, i;
+
+  if (!f.single_fragment) {
+    ink_assert(frag_len);
+    cur = frag_start / frag_len;
+    target = pos / frag_len;
+  }
+  pread_pos = pos;
+  if (target == cur) {
+    doc_pos = doc->prefix_len() + (pos - frag_start);
+    return;
+  }
+  if (target > cur) {
+    // 'key' already names fragment cur + 1
+    i = cur + 1;
+  } else {
+    key = earliest_key;
+    i = 0;
+  }
+  for (; i < target; i++)
+    next_CacheKey(&key, &key);
+  seek_to = pos - target * frag_len;
+  doc_pos = doc->len;
+}
+
 /*
   This code follows CacheVC::openReadStartHead closely,
   if you change this you might have to change that.
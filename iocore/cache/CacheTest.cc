@@ -40,7 +40,9 @@ CacheTestSM::CacheTestSM(RegressionTest *t) :
   expect_event(EVENT_NONE),
   expect_initial_event(EVENT_NONE),
   initial_event(EVENT_NONE),
-  content_salt(0)
+  content_salt(0),
+  n_ranges(0),
+  buffer_failed(0)
 {
   SET_HANDLER(&CacheTestSM::event_handler);
 }
@@ -227,6 +229,21 @@ void CacheTestSM::fill_buffer() {
   }
 }
 
+// Object offset of byte 'pos' of the read, and how many bytes follow it
+// contiguously in the object.
+int64_t CacheTestSM::object_offset(int64_t pos, int64_t *left) {
+  for (int i = 0; i < n_ranges; i++) {
+    int64_t len = ranges[i].end - ranges[i].start + 1;
+    if (pos < len) {
+      *left = len - pos;
+      return ranges[i].start + pos;
+    }
+    pos -= len;
+  }
+  *left = INT64_MAX;
+  return pos;
+}
+
 int CacheTestSM::check_buffer() {
   int64_t avail = buffer_reader->read_avail();
   CacheKey k = key;
@@ -238,14 +255,20 @@ int CacheTestSM::check_buffer() {
     int64_t l = avail;
     if (l > sk)
       l = sk;
-    int64_t o = pos % sk;
+    int64_t left;
+    int64_t opos = object_offset(pos, &left);
+    if (l > left)
+      l = left;
+    int64_t o = opos % sk;
     if (l > sk - o)
       l = sk - o;
-    k.b[0] = pos / sk;
+    k.b[0] = opos / sk;
     char *x = ((char*)&k) + o;
     buffer_reader->read(&b[0], l);
-    if (::memcmp(b, x, l))
+    if (::memcmp(b, x, l)) {
+      buffer_failed = 1;
       return 0;
+    }
     buffer_reader->consume(l);
     pos += l;
     avail -= l;
@@ -256,7 +279,8 @@ int CacheTestSM::check_buffer() {
 int CacheTestSM::check_result(int event) {
   return
     initial_event == expect_initial_event &&
-    event == expect_event;
+    event == expect_event &&
+    !buffer_failed;
 }
 
 int CacheTestSM::complete(int event) {
@@ -392,9 +416,46 @@ EXCLUSIVE_REGRESSION_TEST(cache)(RegressionTest *t, int atype, int *pstatus) {
     });
   pread_test.expect_initial_event = CACHE_EVENT_OPEN_READ;
   pread_test.expect_event = VC_EVENT_READ_COMPLETE;
-  pread_test.nbytes = 100;
+  CacheRange pread_range = { 7000000, 7000099 };
+  pread_test.set_ranges(1, &pread_range);
   pread_test.key = large_write_test.key;
 
+  // do_io_pread_ranges() over the fragments of the large object, 'f' is
+  // the data in a fragment
+  CACHE_SM(t, pread_ranges_test, {
+      cacheProcessor.open_read(this, &key, false);
+    }
+    int open_read_callout() {
+      if (!cache_vc->is_pread_ranges_capable())
+        return -1;
+      cvio = cache_vc->do_io_pread_ranges(this, nbytes, buffer, n_ranges, ranges);
+      return 1;
+    });
+  pread_ranges_test.expect_initial_event = CACHE_EVENT_OPEN_READ;
+  pread_ranges_test.expect_event = VC_EVENT_READ_COMPLETE;
+  pread_ranges_test.key = large_write_test.key;
+  int64_t f = cache_config_target_fragment_size - sizeofDoc;
+
+  CacheRange in_fragment[] = { { 3 * f + 1000, 3 * f + 5999 } };
+  pread_ranges_test.set_ranges(SIZE(in_fragment), in_fragment);
+  RegressionSM *pread_in_fragment_test = pread_ranges_test.clone();
+
+  CacheRange across_fragments[] = { { 2 * f - 3000, 2 * f + 2999 } };
+  pread_ranges_test.set_ranges(SIZE(across_fragments), across_fragments);
+  RegressionSM *pread_across_fragments_test = pread_ranges_test.clone();
+
+  // back to an earlier fragment, back in the same one, back to the first
+  // and forward across a boundary
+  CacheRange out_of_order[] = {
+    { 5 * f + 100, 5 * f + 1099 },
+    { f + 4000, f + 4999 },
+    { f + 100, f + 199 },
+    { 0, 99 },
+    { 6 * f - 50, 6 * f + 49 }
+  };
+  pread_ranges_test.set_ranges(SIZE(out_of_order), out_of_order);
+  RegressionSM *pread_out_of_order_test = pread_ranges_test.clone();
+
   r_sequential(
     t,
     write_test.clone(),
@@ -409,6 +470,9 @@ EXCLUSIVE_REGRESSION_TEST(cache)(RegressionTest *t, int atype, int *pstatus) {
     replace_read_test.clone(),
     large_write_test.clone(),
     pread_test.clone(),
+    pread_in_fragment_test,
+    pread_across_fragments_test,
+    pread_out_of_order_test,
     NULL_PTR
     )->run(pstatus);
   return;
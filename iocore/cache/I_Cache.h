@@ -158,10 +158,31 @@ struct CacheProcessor:public Processor
   static int auto_clear_flag;
 };
 
+// A byte range of an object, both ends included.
+struct CacheRange
+{
+  int64_t start;
+  int64_t end;
+};
+
 struct CacheVConnection:public VConnection
 {
   VIO *do_io_read(Continuation *c, int64_t nbytes, MIOBuffer *buf) = 0;
   virtual VIO *do_io_pread(Continuation *c, int64_t nbytes, MIOBuffer *buf, int64_t offset) = 0;
+  // Read only the bytes of 'ranges', back to back in the order given,
+  // skipping the fragments in between.  Ranges may be out of order, a
+  // range before the current one rereads its fragment.  Only valid when
+  // is_pread_ranges_capable() says so.
+  virtual VIO *do_io_pread_ranges(Continuation *c, int64_t nbytes, MIOBuffer *buf, int nranges, const CacheRange *ranges)
+  {
+    (void) c;
+    (void) nbytes;
+    (void) buf;
+    (void) nranges;
+    (void) ranges;
+    ink_assert(!"CacheVConnection::do_io_pread_ranges unsupported");
+    return NULL;
+  }
   VIO *do_io_write(Continuation *c, int64_t nbytes, IOBufferReader *buf, bool owner = false) = 0;
   void do_io_close(int lerrno = -1) = 0;
   void reenable(VIO *avio) = 0;
@@ -189,6 +210,10 @@ struct CacheVConnection:public VConnection
   virtual time_t get_pin_in_cache() = 0;
   virtual int64_t get_object_size() = 0;
   virtual bool is_pread_capable() = 0;
+  virtual bool is_pread_ranges_capable()
+  {
+    return false;
+  }
 
   CacheVConnection();
 };
@@ -260,6 +260,7 @@ struct CacheVC: public CacheVConnection
 
   VIO *do_io_read(Continuation *c, int64_t nbytes, MIOBuffer *buf);
   VIO *do_io_pread(Continuation *c, int64_t nbytes, MIOBuffer *buf, int64_t offset);
+  VIO *do_io_pread_ranges(Continuation *c, int64_t nbytes, MIOBuffer *buf, int nranges, const CacheRange *ranges);
   VIO *do_io_write(Continuation *c, int64_t nbytes, IOBufferReader *buf, bool owner = false);
   void do_io_close(int lerrno = -1);
   void reenable(VIO *avio);
@@ -320,6 +321,7 @@ struct CacheVC: public CacheVConnection
   int openReadClose(int event, Event *e);
   int openReadReadDone(int event, Event *e);
   int openReadMain(int event, Event *e);
+  void openReadSeekRange(Doc *doc, int64_t pos);
   int openReadStartEarliest(int event, Event *e);
 #ifdef HTTP_CACHE
   int openReadVecWrite(int event, Event *e);
@@ -395,6 +397,9 @@ struct CacheVC: public CacheVConnection
   virtual bool is_pread_capable() {
     return !f.read_from_writer_called;
   }
+  virtual bool is_pread_ranges_capable() {
+    return !f.read_from_writer_called;
+  }
 
   // offsets from the base stat
 #define CACHE_STAT_ACTIVE  0
@@ -473,6 +478,10 @@ struct CacheVC: public CacheVConnection
   int recursive;
   int closed;
   int64_t seek_to;                // pread offset
+  CacheRange *pread_ranges;       // do_io_pread_ranges() ranges, freed in free_CacheVC
+  int pread_n_ranges;
+  int pread_range;                // range being read
+  int64_t pread_pos;              // object offset of the next byte to hand out
   int64_t offset;                 // offset into 'blocks' of data to write
   int64_t writer_offset;          // offset of the writer for reading from a writer
   int64_t length;                 // length of data available to write
@@ -790,6 +799,8 @@ free_CacheVC(CacheVC *cont)
   cont->alternate_index = CACHE_ALT_INDEX_DEFAULT;
   if (cont->scan_vol_map)
     ats_free(cont->scan_vol_map);
+  if (cont->pread_ranges)
+    ats_free(cont->pread_ranges);
   memset((char *) &cont->vio, 0, cont->size_to_init);
 #ifdef CACHE_STAT_PAGES
   ink_assert(!cont->stat_link.next && !cont->stat_link.prev);
@@ -1556,6 +1567,8 @@ CacheProcessor::remove(Continuation *cont, CacheKey *key, bool cluster_cache_loc
     ClusterMachine *m = cluster_machine_at_depth(cache_hash(*key));
 
     if (m) {
+      if (cluster_diffuse_enabled)
+        diffusePolicy.drop_replica(key);
       return Cluster_remove(m, cont, key, rm_user_agents, rm_link, frag_type, hostname, host_len);
     }
   }
@@ -1631,6 +1644,20 @@ CacheProcessor::open_read_internal(int opcode,
   }
   ClusterMachine *m = cluster_machine_at_depth(cache_hash(url_md5));
 
+  if (m && cluster_diffuse_enabled && !migrate &&
+      ((opcode == CACHE_OPEN_READ_LONG) || (opcode == CACHE_OPEN_READ_BUFFER_LONG))) {
+    switch (diffusePolicy.remote_read(&url_md5)) {
+    case DIFFUSE_READ_LOCAL:
+      return diffusePolicy.read_replica(cont, opcode, buf, url, request, params, &url_md5, pin_in_cache,
+                                        frag_type, hostname, host_len);
+    case DIFFUSE_READ_AND_COPY:
+      migrate = true;
+      break;
+    default:
+      break;
+    }
+  }
+
   if (m) {
     return Cluster_read(m, opcode, cont, buf, url,
                         request, params, &url_md5, pin_in_cache, frag_type, hostname, host_len, migrate);
@@ -30,6 +30,7 @@
 #define MAX_HOSTS_POSSIBLE 256
 #define PINNED_DOC_TABLE_SIZE 16
 #define PINNED_DOC_TABLES 246
+#define CACHE_TEST_MAX_RANGES 8
 
 struct PinnedDocEntry
 {
@@ -89,9 +90,13 @@ struct CacheTestSM : public RegressionSM {
   int initial_event;
   uint64_t content_salt;
   CacheTestHeader header;
+  CacheRange ranges[CACHE_TEST_MAX_RANGES]; // object bytes a read returns, back to back
+  int n_ranges;                             // 0 for a read from the start
+  int buffer_failed;
   int end_memcpy_on_clone; // place all variables to be copied between these markers
 
   void fill_buffer();
+  int64_t object_offset(int64_t pos, int64_t *left);
   int check_buffer();
   int check_result(int event);
   int complete(int event);
@@ -103,6 +108,15 @@ struct CacheTestSM : public RegressionSM {
   virtual void make_request_internal() = 0;
   virtual int open_read_callout();
   virtual int open_write_callout();
+  void set_ranges(int n, const CacheRange *r) {
+    ink_assert(n <= CACHE_TEST_MAX_RANGES);
+    n_ranges = n;
+    nbytes = 0;
+    for (int i = 0; i < n; i++) {
+      ranges[i] = r[i];
+      nbytes += r[i].end - r[i].start + 1;
+    }
+  }
 
   void cancel_timeout() {
     if (timeout) timeout->cancel();
@@ -57,6 +57,12 @@ int open_delay_events = 0;
 
 // default will be read from config
 int cache_migrate_on_demand = false;
+int cluster_diffuse_enabled = 0;
+int cluster_diffuse_read_threshold = 100;
+int cluster_diffuse_window_secs = 10;
+int cluster_diffuse_replica_ttl_secs = 300;
+int cluster_coalesce_enabled = 0;
+int cluster_coalesce_max_delay = 1000;
 
 ClassAllocator<CacheContinuation> cacheContAllocator("cacheContAllocator");
 ClassAllocator<ClusterCont> clusterContAllocator("clusterContAllocator");
@@ -214,6 +220,7 @@ ClusterVCCacheEntryAlloc("ClusterVConnectionCache::Entry");
 ClusterVConnectionCache *GlobalOpenWriteVCcache = 0;
 
 DiffuseTable diffuseTable;
+DiffusePolicy diffusePolicy;
 
 /////////////////////////////////////////////////////////////////
 // Perform periodic purges of ClusterVConnectionCache entries
@@ -1861,6 +1868,17 @@ cache_op_ClusterFunction(ClusterSession cs, void *context, void *d)
       moi_len -= res;
       p += res;
 
+      if (moi_len && (c->cfl_flags & CFL_LOPENWRITE_COALESCE)) {
+        ink_assert(!ci);
+        p = (const char *) msg + flen;
+        // Unmarshal CacheHTTPHdr
+        res = c->ic_request.unmarshal((char *) p, moi_len, NULL);
+        ink_assert(res > 0);
+        ink_assert(c->ic_request.valid());
+        moi_len -= res;
+        p += res;
+      }
+
       CacheKey key(msg->url_md5);
 
       if (moi_len) {
@@ -1868,12 +1886,29 @@ cache_op_ClusterFunction(ClusterSession cs, void *context, void *d)
         c->ic_hostname_len = moi_len;
       }
 
-      SET_CONTINUATION_HANDLER(c, (CacheContHandler)
-                                                 & CacheContinuation::setupVCdataWrite);
-
       Cache *call_cache = caches[c->frag_type];
-      Action *a = call_cache->open_write(c, &key, ci, c->pin_in_cache,
-                                         NULL, c->frag_type, c->ic_hostname, c->ic_hostname_len);
+      Action *a;
+      Ptr<CacheWriterEntry> cw;
+      if (c->ic_request.valid() && cache_config_read_while_writer &&
+          writerTable.probe_entry(&key, &cw)) {
+        // Somebody is already writing the object, read it from that
+        // writer instead of failing the write lock.  setupVCdataRead
+        // falls back to open_write if the read does not work out.
+        cw = NULL;
+        c->ic_params = new(CacheLookupHttpConfigAllocator.alloc())
+          CacheLookupHttpConfig();
+        *c->ic_params = global_cache_lookup_config;
+        c->ic_params->max_rww_delay = cluster_coalesce_max_delay;
+        SET_CONTINUATION_HANDLER(c, (CacheContHandler)
+                                                   & CacheContinuation::setupVCdataRead);
+        a = call_cache->open_read(c, &key, &c->ic_request, c->ic_params,
+                                  c->frag_type, c->ic_hostname, c->ic_hostname_len);
+      } else {
+        SET_CONTINUATION_HANDLER(c, (CacheContHandler)
+                                                   & CacheContinuation::setupVCdataWrite);
+        a = call_cache->open_write(c, &key, ci, c->pin_in_cache,
+                                   NULL, c->frag_type, c->ic_hostname, c->ic_hostname_len);
+      }
       if (a != ACTION_RESULT_DONE) {
         c->pending_action = a;
       }
@@ -2043,6 +2078,7 @@ CacheContinuation::setupVCdataRead(int event, void *data)
       cache_vc->get_http_info(&info);
       cache_vc_info.copy_shallow(info);
       doc_size = cache_vc_info.object_size_get();
+      compressible = cluster_http_info_compressible(&cache_vc_info);
       if (ic_request.valid() && (ic_request.presence(MIME_PRESENCE_IF_MODIFIED_SINCE |
           MIME_PRESENCE_IF_NONE_MATCH |
           MIME_PRESENCE_IF_UNMODIFIED_SINCE | MIME_PRESENCE_IF_MATCH | MIME_PRESENCE_RANGE)))
@@ -2061,6 +2097,18 @@ CacheContinuation::setupVCdataRead(int event, void *data)
     result_error = (int) cache_vc->flags; // if open
   } else {
     result_error = (intptr_t) data;
+    if (request_opcode == CACHE_OPEN_WRITE_LONG) {
+      // the coalesced read failed (writer gone or alternate not matched),
+      // take the write lock after all
+      SET_HANDLER((CacheContHandler) & CacheContinuation::setupVCdataWrite);
+      Cache *call_cache = caches[frag_type];
+      Action *a = call_cache->open_write(this, &this->url_md5, NULL, this->pin_in_cache,
+                                               NULL, this->frag_type, this->ic_hostname, this->ic_hostname_len);
+      if (a != ACTION_RESULT_DONE) {
+        pending_action = a;
+      }
+      return EVENT_CONT;
+    }
     if (request_opcode == CACHE_OPEN_READ_LONG && result_error == -ECACHE_NO_DOC &&
         (cache_config_read_while_writer && ic_params && ic_params->max_rww_delay > 0)) {
       SET_HANDLER((CacheContHandler) & CacheContinuation::setupVCdataWrite);
@@ -2262,8 +2310,9 @@ CacheContinuation::VCdataRead(int event, void *data)
       IOBufferBlock *ret = clone_IOBufferBlockList(reader->get_current_block(),
           reader->start_offset, read_bytes);
       reader->consume(read_bytes);
-      if (cluster_send_message(cs, CLUSTER_CACHE_DATA_READ_DONE, ret, -1,
-          PRIORITY_LOW)) {
+      if (compressible ?
+          cluster_send_compressible_message(cs, CLUSTER_CACHE_DATA_READ_DONE, ret, PRIORITY_LOW) :
+          cluster_send_message(cs, CLUSTER_CACHE_DATA_READ_DONE, ret, -1, PRIORITY_LOW)) {
         Warning("data send failed for cluster internel error");
         goto free_exit;
       }
@@ -2302,8 +2351,9 @@ CacheContinuation::VCdataRead(int event, void *data)
         IOBufferBlock *ret = clone_IOBufferBlockList(
             reader->get_current_block(), reader->start_offset, read_bytes);
         reader->consume(read_bytes);
-        if (cluster_send_message(cs, CLUSTER_CACHE_DATA_READ_DONE, ret, -1,
-            PRIORITY_LOW)) {
+        if (compressible ?
+            cluster_send_compressible_message(cs, CLUSTER_CACHE_DATA_READ_DONE, ret, PRIORITY_LOW) :
+            cluster_send_message(cs, CLUSTER_CACHE_DATA_READ_DONE, ret, -1, PRIORITY_LOW)) {
           Warning("data send failed for cluster internel error");
           goto free_exit;
         }
@@ -2627,6 +2677,8 @@ CacheContinuation::replyOpEvent()
   log_cache_op_sndmsg(msg->seq_number, 0, "replyOpEvent");
 #endif
 
+  if (compressible && b)
+    return cluster_send_compressible_message(cs, CLUSTER_CACHE_OP_RESULT_CLUSTER_FUNCTION, ret, PRIORITY_MID);
   return cluster_send_message(cs, CLUSTER_CACHE_OP_RESULT_CLUSTER_FUNCTION, ret, -1, PRIORITY_MID);
 }
 
@@ -4152,6 +4204,13 @@ CacheDiffuser::main_handler(int event, void *e)
   (this->*current_handler)(event, e);
 
   if (terminate) {
+    if (diffused) {
+      RecIncrRawStat(cluster_rsb, this_ethread(), CLUSTER_DIFFUSE_COMPLETED_STAT, 1);
+      RecIncrRawStat(cluster_rsb, this_ethread(), CLUSTER_DIFFUSE_BYTES_STAT, doc_size);
+      if (cluster_diffuse_enabled)
+        diffusePolicy.add_replica(&key);
+    } else
+      RecIncrRawStat(cluster_rsb, this_ethread(), CLUSTER_DIFFUSE_FAILED_STAT, 1);
     // unregister
     diffuseTable.unregister_diffuser(this);
     return EVENT_DONE;
@@ -4234,6 +4293,7 @@ CacheDiffuser::cacheLocalWriteHandler(int event, void *e)
     local_write_vc->do_io_close();
     local_write_vc = NULL;
     terminate = true;
+    diffused = true;
     char cache_url[2048];
     int length;
     url.string_get_buf(cache_url, sizeof(cache_url), &length);
@@ -4252,6 +4312,7 @@ CacheDiffuser::cacheLocalWriteHandler(int event, void *e)
       local_write_vc = NULL;
       ink_debug_assert(!remote_read_vc);
       terminate = true;
+      diffused = true;
       return EVENT_DONE;
     }
     write_vio->reenable();
@@ -4274,6 +4335,7 @@ CacheDiffuser::do_cache_diffuse(ClusterMachine *m, int opcode, INK_MD5 *key, URL
 {
   CacheDiffuser *cd = diffuseTable.register_diffuser(key);
   if (cd) {
+    RecIncrRawStat(cluster_rsb, this_ethread(), CLUSTER_DIFFUSE_STARTED_STAT, 1);
     cd->url.create(NULL);
     cd->url.copy(url);
     cd->frag_type = type;
@@ -4284,6 +4346,224 @@ CacheDiffuser::do_cache_diffuse(ClusterMachine *m, int opcode, INK_MD5 *key, URL
   return ACTION_RESULT_DONE;
 }
 
+// entries without a replica go first, the fewest reads first, then the
+// replicas expiring first
+static inline bool
+evict_before(DiffusePolicy::Entry *a, DiffusePolicy::Entry *b)
+{
+  if (!a->replica_expire != !b->replica_expire)
+    return !a->replica_expire;
+  if (a->replica_expire)
+    return a->replica_expire < b->replica_expire;
+  return a->reads < b->reads;
+}
+
+DiffusePolicy::Entry *
+DiffusePolicy::find(int set, INK_MD5 *key, bool insert)
+{
+  Entry *e = entries[set];
+  Entry *victim = NULL;
+
+  for (int i = 0; i < DIFFUSE_POLICY_WAYS; i++) {
+    if (e[i].key == *key)
+      return &e[i];
+    if (!victim || evict_before(&e[i], victim))
+      victim = &e[i];
+  }
+  if (!insert)
+    return NULL;
+
+  victim->key = *key;
+  victim->window = 0;
+  victim->reads = 0;
+  victim->replica_expire = 0;
+  return victim;
+}
+
+DiffuseDecision
+DiffusePolicy::remote_read(INK_MD5 *key)
+{
+  int set = (int) (key->fold() % DIFFUSE_POLICY_SETS);
+  ink_hrtime now = ink_get_hrtime();
+  int window_secs = cluster_diffuse_window_secs > 0 ? cluster_diffuse_window_secs : 1;
+  uint32_t window = (uint32_t) (now / HRTIME_SECONDS(window_secs));
+  DiffuseDecision decision = DIFFUSE_READ_REMOTE;
+
+  ink_spinlock_acquire(&locks[set]);
+  Entry *e = find(set, key, true);
+  if (e->replica_expire) {
+    if (now < e->replica_expire)
+      decision = DIFFUSE_READ_LOCAL;
+    else
+      e->replica_expire = 0;
+  }
+  if (decision != DIFFUSE_READ_LOCAL) {
+    if (e->window != window) {
+      e->window = window;
+      e->reads = 0;
+    }
+    // copy once per window, a failed copy is retried in the next one
+    if (++e->reads == cluster_diffuse_read_threshold)
+      decision = DIFFUSE_READ_AND_COPY;
+  }
+  ink_spinlock_release(&locks[set]);
+
+  return decision;
+}
+
+void
+DiffusePolicy::add_replica(INK_MD5 *key)
+{
+  int set = (int) (key->fold() % DIFFUSE_POLICY_SETS);
+
+  ink_spinlock_acquire(&locks[set]);
+  Entry *e = find(set, key, true);
+  e->replica_expire = ink_get_hrtime() + HRTIME_SECONDS(cluster_diffuse_replica_ttl_secs);
+  ink_spinlock_release(&locks[set]);
+}
+
+void
+DiffusePolicy::drop_replica(INK_MD5 *key)
+{
+  int set = (int) (key->fold() % DIFFUSE_POLICY_SETS);
+
+  ink_spinlock_acquire(&locks[set]);
+  Entry *e = find(set, key, false);
+  if (e)
+    e->replica_expire = 0;
+  ink_spinlock_release(&locks[set]);
+}
+
+//
+// Read of a local replica.  The replica may have been evicted from the
+// local cache before it expired in the policy; the read then goes to the
+// owner after all.  The replica stats count actual local hits.
+//
+struct DiffuseReadCont: public Continuation
+{
+  Action action;
+  int opcode;
+  MIOBuffer *buf;
+  CacheURL *url;
+  CacheHTTPHdr *request;
+  CacheLookupHttpConfig *params;
+  INK_MD5 key;
+  time_t pin_in_cache;
+  CacheFragType frag_type;
+  char *hostname;
+  int host_len;
+  bool remote;                  // the read was passed on to the owner
+  bool finished;                // the caller has its result
+  int busy;                     // handler or start on the stack
+
+  DiffuseReadCont(Continuation *cont)
+    : Continuation(cont->mutex), opcode(0), buf(0), url(0), request(0), params(0), pin_in_cache(0),
+      frag_type(CACHE_FRAG_TYPE_NONE), hostname(0), host_len(0), remote(false), finished(false), busy(0)
+  {
+    action = cont;
+    SET_HANDLER(&DiffuseReadCont::readEvent);
+  }
+
+  int readEvent(int event, void *data);
+};
+
+int
+DiffuseReadCont::readEvent(int event, void *data)
+{
+  busy++;
+  if (event == CACHE_EVENT_OPEN_READ_FAILED && !remote && !action.cancelled) {
+    ClusterMachine *m = cluster_machine_at_depth(cache_hash(key));
+
+    diffusePolicy.drop_replica(&key);
+    if (m) {
+      remote = true;
+      Cluster_read(m, opcode, this, buf, url, request, params, &key, pin_in_cache, frag_type, hostname, host_len);
+      goto Ldone;
+    }
+  }
+  if (action.cancelled) {
+    if (event == CACHE_EVENT_OPEN_READ && data)
+      ((VConnection *) data)->do_io_close();
+  } else {
+    if (event == CACHE_EVENT_OPEN_READ && !remote) {
+      RecIncrRawStat(cluster_rsb, this_ethread(), CLUSTER_DIFFUSE_REPLICA_HITS_STAT, 1);
+      RecIncrRawStat(cluster_rsb, this_ethread(), CLUSTER_DIFFUSE_BYTES_SAVED_STAT,
+                     ((CacheVConnection *) data)->get_object_size());
+    }
+    action.continuation->handleEvent(event, data);
+  }
+  finished = true;
+
+Ldone:
+  if (--busy == 0 && finished)
+    delete this;
+  return EVENT_DONE;
+}
+
+Action *
+DiffusePolicy::read_replica(Continuation *cont, int opcode, MIOBuffer *buf, CacheURL *url, CacheHTTPHdr *request,
+                            CacheLookupHttpConfig *params, INK_MD5 *key, time_t pin_in_cache,
+                            CacheFragType frag_type, char *hostname, int host_len)
+{
+  DiffuseReadCont *rc = NEW(new DiffuseReadCont(cont));
+
+  rc->opcode = opcode;
+  rc->buf = buf;
+  rc->url = url;
+  rc->request = request;
+  rc->params = params;
+  rc->key = *key;
+  rc->pin_in_cache = pin_in_cache;
+  rc->frag_type = frag_type;
+  rc->hostname = hostname;
+  rc->host_len = host_len;
+
+  rc->busy++;
+  caches[frag_type]->open_read(rc, &rc->key, request, params, frag_type, hostname, host_len);
+  if (--rc->busy == 0 && rc->finished) {
+    delete rc;
+    return ACTION_RESULT_DONE;
+  }
+  return &rc->action;
+}
+
+//
+// Cluster link compression
+//
+bool
+cluster_http_info_compressible(CacheHTTPInfo *info)
+{
+  static const char *types[] = {
+    "text/", "application/javascript", "application/x-javascript",
+    "application/json", "application/xml", "application/xhtml"
+  };
+
+  if (!info || !info->valid())
+    return false;
+  HTTPHdr *resp = info->response_get();
+  if (!resp || !resp->valid() || resp->presence(MIME_PRESENCE_CONTENT_ENCODING))
+    return false;
+
+  int len = 0;
+  const char *ct = resp->value_get(MIME_FIELD_CONTENT_TYPE, MIME_LEN_CONTENT_TYPE, &len);
+  if (!ct)
+    return false;
+  for (unsigned i = 0; i < SIZE(types); i++) {
+    int l = strlen(types[i]);
+    if (len >= l && !strncasecmp(ct, types[i], l))
+      return true;
+  }
+
+  // structured syntax suffixes, application/rss+xml and the like
+  const char *e = (const char *) memchr(ct, ';', len);
+  if (e)
+    len = e - ct;
+  while (len > 0 && ParseRules::is_ws(ct[len - 1]))
+    len--;
+  return (len > 4 && !strncasecmp(ct + len - 4, "+xml", 4)) ||
+    (len > 5 && !strncasecmp(ct + len - 5, "+json", 5));
+}
+
 CacheDiffuser *new_CacheDiffuser()
 {
   CacheDiffuser *cd = cacheDiffuserAllocator.alloc();
@@ -28,6 +28,7 @@
 ****************************************************************************/
 
 #include "P_Cluster.h"
+#include "global.h"
 #include "machine.h"
 #include "connection.h"
 
@@ -171,15 +172,20 @@ make_cluster_connections(MachineList * l, MachineList * old)
   ClusterMachine *m;
   if (l) {
     for (i = 0; i < l->n; i++) {
-      struct in_addr in;
-      in.s_addr = l->machine[i].ip;
-      m = add_machine(l->machine[i].ip, l->machine[i].port);
+      ip_port_text_buffer ipb;
+      m = add_machine(&l->machine[i].addr.sa);
       if (m != NULL) {
+        m->weight = l->machine[i].weight;
         machine_make_connections(m);
       }
+      if (l->machine[i].ip == this_cluster_machine()->ip &&
+          (!this_cluster_machine()->cluster_port ||
+           l->machine[i].port == this_cluster_machine()->cluster_port)) {
+        this_cluster_machine()->weight = l->machine[i].weight;
+      }
 
-      Debug(CL_NOTE, "do connect hostname: %u.%u.%u.%u:%d, %s, g_machine_count: %d\n",
-          DOT_SEPARATED(l->machine[i].ip), l->machine[i].port, inet_ntoa(in), g_machine_count);
+      Debug(CL_NOTE, "do connect hostname: %s, g_machine_count: %d\n",
+          ats_ip_nptop(&l->machine[i].addr, ipb, sizeof(ipb)), g_machine_count);
 
     /*
 #ifdef LOCAL_CLUSTER_TEST_MODE
@@ -203,11 +209,10 @@ make_cluster_connections(MachineList * l, MachineList * old)
   //found down machines
   if (l == NULL) {
     for (i = 0; i < old->n; i++) {
-      struct in_addr in;
-      in.s_addr = old->machine[i].ip;
-      Debug(CL_NOTE, "stop connect hostname: %u.%u.%u.%u:%d, %s\n",
-          DOT_SEPARATED(old->machine[i].ip), old->machine[i].port, inet_ntoa(in));
-      m = get_machine(old->machine[i].ip, old->machine[i].port);
+      ip_port_text_buffer ipb;
+      Debug(CL_NOTE, "stop connect hostname: %s\n",
+          ats_ip_nptop(&old->machine[i].addr, ipb, sizeof(ipb)));
+      m = get_machine(&old->machine[i].addr.sa);
       if (m != NULL) {
         machine_stop_reconnect(m);
       }
@@ -216,7 +221,7 @@ make_cluster_connections(MachineList * l, MachineList * old)
   else {
     for (i = 0; i < old->n; i++) {
       for (k = 0; k < l->n; k++) {
-        if (l->machine[k].ip == old->machine[i].ip &&
+        if (ats_ip_addr_eq(&l->machine[k].addr, &old->machine[i].addr) &&
             l->machine[k].port == old->machine[i].port)
         {
           break;
@@ -224,11 +229,10 @@ make_cluster_connections(MachineList * l, MachineList * old)
       }
 
       if (k == l->n) {  //not found, machine down
-        struct in_addr in;
-        in.s_addr = old->machine[i].ip;
-        Debug(CL_NOTE, "stop connect hostname: %u.%u.%u.%u:%d, %s\n",
-            DOT_SEPARATED(old->machine[i].ip), old->machine[i].port, inet_ntoa(in));
-        m = get_machine(old->machine[i].ip, old->machine[i].port);
+        ip_port_text_buffer ipb;
+        Debug(CL_NOTE, "stop connect hostname: %s\n",
+            ats_ip_nptop(&old->machine[i].addr, ipb, sizeof(ipb)));
+        m = get_machine(&old->machine[i].addr.sa);
         if (m != NULL) {
           machine_stop_reconnect(m);
         }
@@ -334,13 +338,13 @@ default_cluster_config_change(const char *name, RecDataT data_type, RecData data
           DOT_SEPARATED(this_machine->ip));
   }
 
-  cc = NEW(new ClusterConfiguration);
+  cc = NEW(new ClusterConfiguration(ml->n > g_max_machine_count ? ml->n : g_max_machine_count));
   cc->n_machines = ml->n;
-  memset(cc->hash_table, 0, CLUSTER_HASH_TABLE_SIZE);
 
   for (int i = 0; i < ml->n; i++) {
     cc->machines[i] = NEW(new ClusterMachine(ml->machine[i].ip,
                                              ml->machine[i].port));
+    cc->machines[i]->weight = ml->machine[i].weight;
   }
   build_cluster_hash_table(cc);
 
@@ -373,12 +377,32 @@ do_machine_config_change(void *d, const char *s)
 /*************************************************************************/
 // ClusterConfiguration member functions (Public Class)
 /*************************************************************************/
-ClusterConfiguration::ClusterConfiguration():n_machines(0), changed(0)
+//
+// machines[] is sized from proxy.config.cluster.max_machines unless the
+// caller needs more room, copies keep the size of the original
+//
+ClusterConfiguration::ClusterConfiguration(int amax_machines):n_machines(0), changed(0)
 {
-  memset(machines, 0, sizeof(machines));
+  max_machines = amax_machines > 0 ? amax_machines : g_max_machine_count;
+  machines = (ClusterMachine **) ats_malloc(sizeof(ClusterMachine *) * max_machines);
+  memset(machines, 0, sizeof(ClusterMachine *) * max_machines);
   memset(hash_table, 0, sizeof(hash_table));
 }
 
+ClusterConfiguration::ClusterConfiguration(const ClusterConfiguration & c)
+  : n_machines(c.n_machines), max_machines(c.max_machines), changed(c.changed)
+{
+  machines = (ClusterMachine **) ats_malloc(sizeof(ClusterMachine *) * max_machines);
+  memcpy(machines, c.machines, sizeof(ClusterMachine *) * max_machines);
+  memcpy(hash_table, c.hash_table, sizeof(hash_table));
+  link = c.link;
+}
+
+ClusterConfiguration::~ClusterConfiguration()
+{
+  ats_free(machines);
+}
+
 /*************************************************************************/
 // ConfigurationContinuation member functions (Internal Class)
 /*************************************************************************/
@@ -442,6 +466,8 @@ configuration_add_machine(ClusterConfiguration * c, ClusterMachine * m)
   */
 
   int i = 0;
+  // callers refuse machines past proxy.config.cluster.max_machines
+  ink_assert(c->n_machines < c->max_machines);
   ClusterConfiguration *cc = NEW(new ClusterConfiguration(*c));
 
   // Find the place to insert this new machine
@@ -463,7 +489,6 @@ configuration_add_machine(ClusterConfiguration * c, ClusterMachine * m)
 
   cc->link.next = c;
   cc->changed = ink_get_hrtime();
-  ink_assert(cc->n_machines < CLUSTER_MAX_MACHINES);
 
   ClusterMachine *mm;
   ClusterConfiguration *def_cc;
@@ -1117,7 +1117,13 @@ ClusterHandler::startClusterEvent(int event, Event * e)
           ClusterConfiguration *c = this_cluster()->current_configuration();
           ClusterMachine *m = c->find(ip, port);
           
-          if (!m) { // this first connection
+          if (!m && c->n_machines >= c->max_machines) {
+            Warning("cluster already has %d machines, not adding %u.%u.%u.%u:%d", c->n_machines,
+                    DOT_SEPARATED(ip), port);
+            failed = -2;
+            MUTEX_UNTAKE_LOCK(the_cluster_config_mutex, this_ethread());
+            goto failed;
+          } else if (!m) { // this first connection
             ClusterConfiguration *cconf = configuration_add_machine(c, machine);
             CLUSTER_INCREMENT_DYN_STAT(CLUSTER_NODES_STAT);
             this_cluster()->configurations.push(cconf);
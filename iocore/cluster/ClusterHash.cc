@@ -54,6 +54,21 @@ bool randClusterHash = false;
 // bool boundClusterHash = true;
 // bool randClusterHash = true;
 
+//
+// Weighted hash ring (used unless consistentClusterHash is 0)
+//
+// consistentClusterHash   - place buckets on a hash ring instead of the
+//                           tables above
+// clusterHashVirtualNodes - ring points of a machine with the default
+//                           weight, scaled by the machine weight
+// clusterHashLoadFactor   - percent of its fair share of buckets a machine
+//                           may own before the rest spill to the next
+//                           machine on the ring, 0 for unbounded
+//
+int consistentClusterHash = 1;
+int clusterHashVirtualNodes = 160;
+int clusterHashLoadFactor = 125;
+
 
 
 //
@@ -93,8 +108,8 @@ build_hash_table_machine(ClusterConfiguration * c)
   int left = CLUSTER_HASH_TABLE_SIZE;
   int m = 0;
   int i = 0;
-  unsigned int rnd[CLUSTER_MAX_MACHINES];
-  unsigned int mach[CLUSTER_MAX_MACHINES];
+  unsigned int *rnd = (unsigned int *) ats_malloc(sizeof(unsigned int) * c->n_machines);
+  unsigned int *mach = (unsigned int *) ats_malloc(sizeof(unsigned int) * c->n_machines);
   int total = CLUSTER_HASH_TABLE_SIZE;
 
   for (i = 0; i < c->n_machines; i++) {
@@ -113,7 +128,7 @@ build_hash_table_machine(ClusterConfiguration * c)
   // Initialize the table to "empty"
   //
   for (i = 0; i < CLUSTER_HASH_TABLE_SIZE; i++)
-    c->hash_table[i] = 255;
+    c->hash_table[i] = CLUSTER_HASH_NO_MACHINE;
 
   // Until we have hit every element of the table, give each
   // machine a chance to select it's favorites.
@@ -129,12 +144,14 @@ build_hash_table_machine(ClusterConfiguration * c)
         i = ink_rand_r(&rnd[m]) % CLUSTER_HASH_TABLE_SIZE;
       } else
         i = next_rand(&rnd[m]) % CLUSTER_HASH_TABLE_SIZE;
-    } while (c->hash_table[i] != 255);
+    } while (c->hash_table[i] != CLUSTER_HASH_NO_MACHINE);
     mach[m]--;
     c->hash_table[i] = m;
     left--;
     m = (m + 1) % c->n_machines;
   }
+  ats_free(rnd);
+  ats_free(mach);
 }
 
 static void
@@ -142,7 +159,7 @@ build_hash_table_bucket(ClusterConfiguration * c)
 {
   int i = 0;
   unsigned int rnd[CLUSTER_HASH_TABLE_SIZE];
-  unsigned int mach[CLUSTER_MAX_MACHINES];
+  unsigned int *mach = (unsigned int *) ats_malloc(sizeof(unsigned int) * c->n_machines);
   int total = CLUSTER_HASH_TABLE_SIZE;
 
   for (i = 0; i < c->n_machines; i++) {
@@ -155,16 +172,144 @@ build_hash_table_bucket(ClusterConfiguration * c)
     rnd[i] = i;
 
   for (i = 0; i < CLUSTER_HASH_TABLE_SIZE; i++) {
-    unsigned char x = 0;
+    int x = 0;
     do {
       if (randClusterHash) {
-        x = ink_rand_r(&rnd[i]) % CLUSTER_MAX_MACHINES;
+        x = ink_rand_r(&rnd[i]) % c->n_machines;
       } else
-        x = next_rand(&rnd[i]) % CLUSTER_MAX_MACHINES;
-    } while (x >= c->n_machines || (!mach[x] && boundClusterHash));
+        x = next_rand(&rnd[i]) % c->n_machines;
+    } while (!mach[x] && boundClusterHash);
     mach[x]--;
     c->hash_table[i] = x;
   }
+  ats_free(mach);
+}
+
+//
+// Ring point for the i'th virtual node of a machine.  Mixed from the
+// address only, so all the machines of a cluster compute the same ring
+// whatever order the machines joined in.
+//
+static inline unsigned int
+ring_point(unsigned int ip, int port, int i)
+{
+  unsigned int h = ip ^ ((unsigned int) port << 16) ^ ((unsigned int) i * 0x9e3779b9);
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+struct ring_entry
+{
+  unsigned int rval;
+  unsigned int ip;
+  int port;
+  int machine;
+};
+
+// sorts on the ring position, ties broken on the address
+static int
+cmpring(const void *aa, const void *bb)
+{
+  ring_entry *a = (ring_entry *) aa;
+  ring_entry *b = (ring_entry *) bb;
+  if (a->rval != b->rval)
+    return a->rval < b->rval ? -1 : 1;
+  if (a->ip != b->ip)
+    return a->ip < b->ip ? -1 : 1;
+  return a->port - b->port;
+}
+
+static inline int
+machine_weight(ClusterMachine * m)
+{
+  return m->weight > 0 ? m->weight : CLUSTER_DEFAULT_MACHINE_WEIGHT;
+}
+
+//
+// Build the hash table from a hash ring
+// Each machine gets clusterHashVirtualNodes * weight / 100 points on the
+// ring and each bucket goes to the first point at or after its position,
+// so adding or removing a machine only moves the buckets adjacent to its
+// points.  With a load factor, a machine which already has its share of
+// buckets passes the bucket to the next machine on the ring.
+//
+static void
+hash_table_ring(ClusterConfiguration * c, int virtual_nodes, int load_factor)
+{
+  int i, j, k;
+  int n_points = 0;
+  int64_t total_weight = 0;
+  int *points = (int *) ats_malloc(sizeof(int) * 3 * c->n_machines);
+  int *capacity = points + c->n_machines;
+  int *load = capacity + c->n_machines;
+
+  for (i = 0; i < c->n_machines; i++) {
+    int w = machine_weight(c->machines[i]);
+    total_weight += w;
+    points[i] = (int) ((int64_t) virtual_nodes * w / CLUSTER_DEFAULT_MACHINE_WEIGHT);
+    if (points[i] < 1)
+      points[i] = 1;
+    n_points += points[i];
+    load[i] = 0;
+  }
+
+  // bounded load: ceil(share * factor), the factor is at least 100% so
+  // the capacities always add up to the table size
+  int factor = load_factor;
+  if (factor > 0 && factor < 100)
+    factor = 100;
+  for (i = 0; i < c->n_machines; i++) {
+    if (factor > 0) {
+      int64_t d = total_weight * 100;
+      capacity[i] = (int) (((int64_t) CLUSTER_HASH_TABLE_SIZE * machine_weight(c->machines[i]) * factor + d - 1) / d);
+    } else
+      capacity[i] = CLUSTER_HASH_TABLE_SIZE;
+  }
+
+  ring_entry *ring = (ring_entry *) ats_malloc(sizeof(ring_entry) * n_points);
+  k = 0;
+  for (i = 0; i < c->n_machines; i++)
+    for (j = 0; j < points[i]; j++) {
+      ring[k].rval = ring_point(c->machines[i]->ip, c->machines[i]->cluster_port, j);
+      ring[k].ip = c->machines[i]->ip;
+      ring[k].port = c->machines[i]->cluster_port;
+      ring[k].machine = i;
+      k++;
+    }
+  ink_assert(k == n_points);
+  qsort(ring, n_points, sizeof(ring_entry), cmpring);
+
+  // buckets are evenly spaced on the ring, walk both in order
+  unsigned int width = (1LL << 32) / CLUSTER_HASH_TABLE_SIZE;
+  k = 0;
+  for (j = 0; j < CLUSTER_HASH_TABLE_SIZE; j++) {
+    unsigned int pos = width / 2 + j * width;
+    while (k < n_points && ring[k].rval < pos)
+      k++;
+    int p = k < n_points ? k : 0;       // wrap around
+    while (load[ring[p].machine] >= capacity[ring[p].machine])
+      p = (p + 1) % n_points;
+    c->hash_table[j] = ring[p].machine;
+    load[ring[p].machine]++;
+  }
+
+  for (i = 0; i < c->n_machines; i++) {
+    Debug("cluster_hash", "machine %u.%u.%u.%u:%d weight %d points %d got %d buckets",
+          DOT_SEPARATED(c->machines[i]->ip), c->machines[i]->cluster_port,
+          machine_weight(c->machines[i]), points[i], load[i]);
+  }
+  ats_free(ring);
+  ats_free(points);
+}
+
+void
+build_hash_table_ring(ClusterConfiguration * c)
+{
+  hash_table_ring(c, clusterHashVirtualNodes, clusterHashLoadFactor);
 }
 
 static void
@@ -182,8 +327,9 @@ adjust_cluster_hash_table(ClusterConfiguration * c)
     mm = cc->machines[cc->hash_table[i]];
 
     if (!mm->dead && !m->equal(mm)) {
-      c->hash_table[i] = c->find_idx(mm->ip, mm->cluster_port);
-      ink_release_assert(c->hash_table[i] >= 0);
+      int idx = c->find_idx(mm->ip, mm->cluster_port);
+      ink_release_assert(idx >= 0);
+      c->hash_table[i] = idx;
     }
   }
 }
@@ -191,10 +337,173 @@ adjust_cluster_hash_table(ClusterConfiguration * c)
 void
 build_cluster_hash_table(ClusterConfiguration * c)
 {
-  if (machineClusterHash)
+  if (consistentClusterHash)
+    build_hash_table_ring(c);
+  else if (machineClusterHash)
     build_hash_table_machine(c);
   else
     build_hash_table_bucket(c);
 
   adjust_cluster_hash_table(c);
 }
+
+#if TS_HAS_TESTS
+
+//
+// Hash ring simulator: for n = 1 .. 31 machines, where every third
+// machine has twice the default weight, add a machine and then remove
+// the first one.  Without a load bound only the buckets of the added or
+// removed machine may move; with one, no machine may own more than its
+// bounded share.  The buckets moved against the minimum which has to move
+// and the load skew are reported.  Last, a cluster of CLUSTER_MAX_MACHINES
+// has to hash to machines past index 255.
+//
+
+static int
+ring_buckets_moved(ClusterConfiguration * a, ClusterConfiguration * b, ClusterMachine * m, bool * only_m)
+{
+  int moved = 0;
+  *only_m = true;
+  for (int j = 0; j < CLUSTER_HASH_TABLE_SIZE; j++) {
+    ClusterMachine *am = a->machines[a->hash_table[j]];
+    ClusterMachine *bm = b->machines[b->hash_table[j]];
+    if (am != bm) {
+      moved++;
+      if (am != m && bm != m)
+        *only_m = false;
+    }
+  }
+  return moved;
+}
+
+// largest ratio of buckets owned to the weighted share; false if a
+// bucket points past the machines or a machine is over its bound
+static bool
+ring_check_load(ClusterConfiguration * c, int load_factor, float *skew)
+{
+  int *n = (int *) ats_malloc(sizeof(int) * c->n_machines);
+  int64_t total_weight = 0;
+  bool ok = true;
+  int j;
+
+  *skew = 0;
+  for (j = 0; j < c->n_machines; j++) {
+    n[j] = 0;
+    total_weight += machine_weight(c->machines[j]);
+  }
+  for (j = 0; ok && j < CLUSTER_HASH_TABLE_SIZE; j++) {
+    if (c->hash_table[j] >= c->n_machines)
+      ok = false;
+    else
+      n[c->hash_table[j]]++;
+  }
+  for (j = 0; ok && j < c->n_machines; j++) {
+    float share = (float) CLUSTER_HASH_TABLE_SIZE * machine_weight(c->machines[j]) / total_weight;
+    if ((float) n[j] / share > *skew)
+      *skew = (float) n[j] / share;
+    if (load_factor && n[j] > share * load_factor / 100 + 1)
+      ok = false;
+  }
+  ats_free(n);
+  return ok;
+}
+
+static int
+ring_weighted_share(ClusterConfiguration * c, ClusterMachine * m)
+{
+  int64_t total_weight = 0;
+  for (int j = 0; j < c->n_machines; j++)
+    total_weight += machine_weight(c->machines[j]);
+  return (int) (CLUSTER_HASH_TABLE_SIZE * machine_weight(m) / total_weight);
+}
+
+REGRESSION_TEST(ClusterHash_ring) (RegressionTest * t, int atype, int *pstatus)
+{
+  NOWARN_UNUSED(atype);
+  static const int load_factors[] = { 0, 125 };
+  static const int n_test_machines = 32;
+  ClusterMachine *machines[n_test_machines];
+  int status = REGRESSION_TEST_PASSED;
+  int i, f;
+
+  for (i = 0; i < n_test_machines; i++) {
+    machines[i] = NEW(new ClusterMachine(0x0a000001 + i * 7, 8086));
+    machines[i]->weight = (i % 3) ? CLUSTER_DEFAULT_MACHINE_WEIGHT : 2 * CLUSTER_DEFAULT_MACHINE_WEIGHT;
+  }
+
+  for (f = 0; f < (int) SIZE(load_factors); f++) {
+    int load_factor = load_factors[f];
+    ClusterConfiguration *c = NEW(new ClusterConfiguration);
+
+    c->n_machines = 1;
+    c->machines[0] = machines[0];
+    hash_table_ring(c, clusterHashVirtualNodes, load_factor);
+    rprintf(t, "hash ring - %d virtual nodes - load factor %d%%\n", clusterHashVirtualNodes, load_factor);
+
+    for (i = 1; i < n_test_machines && status == REGRESSION_TEST_PASSED; i++) {
+      ClusterMachine *m = machines[i];
+      ClusterConfiguration *cc = NEW(new ClusterConfiguration(*c));
+      ClusterConfiguration *rc = NEW(new ClusterConfiguration);
+      bool add_only_m, remove_only_m;
+      float add_skew, remove_skew;
+      int j;
+
+      // add (machines are kept in address order, the new one is last)
+      cc->machines[cc->n_machines++] = m;
+      hash_table_ring(cc, clusterHashVirtualNodes, load_factor);
+      int add_moved = ring_buckets_moved(c, cc, m, &add_only_m);
+
+      // and remove the first machine from the new configuration
+      for (j = 1; j < cc->n_machines; j++)
+        rc->machines[rc->n_machines++] = cc->machines[j];
+      hash_table_ring(rc, clusterHashVirtualNodes, load_factor);
+      int remove_moved = ring_buckets_moved(cc, rc, cc->machines[0], &remove_only_m);
+
+      rprintf(t, "n = %2d: add moved = %5d min = %5d remove moved = %5d min = %5d\n", i, add_moved,
+              ring_weighted_share(cc, m), remove_moved, ring_weighted_share(cc, cc->machines[0]));
+
+      if (!ring_check_load(cc, load_factor, &add_skew) || !ring_check_load(rc, load_factor, &remove_skew)) {
+        rprintf(t, "n = %d: bucket owner out of range or over the %d%% bound\n", i, load_factor);
+        status = REGRESSION_TEST_FAILED;
+      }
+      if (!load_factor && (!add_only_m || !remove_only_m)) {
+        rprintf(t, "n = %d: buckets moved between machines which did not change\n", i);
+        status = REGRESSION_TEST_FAILED;
+      }
+      delete rc;
+      delete c;
+      c = cc;
+    }
+    delete c;
+  }
+
+  for (i = 0; i < n_test_machines; i++)
+    delete machines[i];
+
+  // a full size cluster: every bucket has to name one of the machines,
+  // including those with indexes which do not fit in a byte
+  if (status == REGRESSION_TEST_PASSED) {
+    ClusterConfiguration *c = NEW(new ClusterConfiguration(CLUSTER_MAX_MACHINES));
+    int highest = 0;
+    float skew;
+
+    for (i = 0; i < CLUSTER_MAX_MACHINES; i++)
+      c->machines[c->n_machines++] = NEW(new ClusterMachine(0x0a000001 + i * 7, 8086));
+    hash_table_ring(c, clusterHashVirtualNodes, clusterHashLoadFactor);
+    for (i = 0; i < CLUSTER_HASH_TABLE_SIZE; i++)
+      if (c->hash_table[i] > highest)
+        highest = c->hash_table[i];
+    bool ok = ring_check_load(c, clusterHashLoadFactor, &skew);
+    rprintf(t, "n = %d: highest machine index %d skew %.2f\n", c->n_machines, highest, skew);
+    if (!ok || highest < 256) {
+      rprintf(t, "n = %d: bucket owner out of range or over the %d%% bound\n", c->n_machines, clusterHashLoadFactor);
+      status = REGRESSION_TEST_FAILED;
+    }
+    for (i = 0; i < c->n_machines; i++)
+      delete c->machines[i];
+    delete c;
+  }
+  *pstatus = status;
+}
+
+#endif /* TS_HAS_TESTS */
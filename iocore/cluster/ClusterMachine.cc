@@ -70,14 +70,22 @@ dead(true),
 hostname(NULL),
 ip(aip),
 cluster_port(aport),
+machine_id(-1),
 num_connections(0),
 now_connections(0),
 free_connections(0),
 rr_count(0),
+weight(CLUSTER_DEFAULT_MACHINE_WEIGHT),
 msg_proto_major(0),
 msg_proto_minor(0),
+compress_in_bytes(0),
+compress_out_bytes(0),
+decompress_in_bytes(0),
+decompress_out_bytes(0),
+link_stats_registered(false),
 clusterHandlers(0)
 {
+  ats_ip4_set(&addr, aip, htons(aport));
 }
 
 ClusterMachine::ClusterMachine(char *ahostname, unsigned int aip, int aport):
@@ -85,12 +93,19 @@ dead(false),
 hostname(ahostname),
 ip(aip),
 cluster_port(aport),
+machine_id(-1),
 num_connections(0),
 now_connections(0),
 free_connections(0),
 rr_count(0),
+weight(CLUSTER_DEFAULT_MACHINE_WEIGHT),
 msg_proto_major(0),
 msg_proto_minor(0),
+compress_in_bytes(0),
+compress_out_bytes(0),
+decompress_in_bytes(0),
+decompress_out_bytes(0),
+link_stats_registered(false),
 clusterHandlers(0)
 {
   /*
@@ -165,6 +180,7 @@ clusterHandlers(0)
     hostname_len = strlen(hostname);
   else
     hostname_len = 0;
+  ats_ip4_set(&addr, ip, htons(cluster_port));
 
   num_connections = num_of_cluster_threads;
   //clusterHandlers = (ClusterHandler **)ats_calloc(num_connections, sizeof(ClusterHandler *));
@@ -237,6 +253,7 @@ read_MachineList(char *filename, int afd)
 {
   char line[256];
   int n = -1, i = 0, ln = 0;
+  char *weight;
   MachineList *l = NULL;
   ink_assert(filename || (afd != -1));
   char p[PATH_NAME_MAX];
@@ -261,13 +278,14 @@ read_MachineList(char *filename, int afd)
         }
         continue;
       }
-      if (l && ParseRules::is_digit(*line) && i < n) {
-        char *port = strchr(line, ':');
-        if (!port)
+      if (l && (ParseRules::is_digit(*line) || *line == '[') && i < n) {
+        // "ip:port [weight]", an IPv6 ip in brackets: "[ip]:port"
+        weight = strpbrk(line, " \t\r\n");
+        if (weight)
+          *weight++ = 0;
+        if (!strchr(line, ':'))
           goto Lfail;
-        *port++ = 0;
-        l->machine[i].ip = inet_addr(line);
-        if (-1 == (int) l->machine[i].ip) {
+        if (0 != ats_ip_pton(line, &l->machine[i].addr)) {
           if (afd == -1) {
             Warning("read machine list failure, bad ip, line %d", ln);
             return NULL;
@@ -277,9 +295,17 @@ read_MachineList(char *filename, int afd)
             return (MachineList *) ats_strdup(s);
           }
         }
-        l->machine[i].port = atoi(port);
+        l->machine[i].ip = cluster_machine_key(&l->machine[i].addr.sa);
+        l->machine[i].port = ats_ip_port_host_order(&l->machine[i].addr);
         if (!l->machine[i].port)
           goto Lfail;
+        // optional weight after the port
+        l->machine[i].weight = CLUSTER_DEFAULT_MACHINE_WEIGHT;
+        if (weight) {
+          int w = atoi(weight);
+          if (w > 0)
+            l->machine[i].weight = w < CLUSTER_MAX_MACHINE_WEIGHT ? w : CLUSTER_MAX_MACHINE_WEIGHT;
+        }
         i++;
         l->n++;
         continue;
@@ -27,6 +27,7 @@
   ClusterProcessor.cc
 ****************************************************************************/
 
+#include <ifaddrs.h>
 #include "P_Cluster.h"
 #include "global.h"
 #include "connection.h"
@@ -442,6 +443,11 @@ static int machine_change_notify(ClusterMachine * m)
         DOT_SEPARATED(m->ip), m->cluster_port);
       result = EEXIST;
     }
+    else if (c->n_machines >= c->max_machines) {
+      Warning("machine %hhu.%hhu.%hhu.%hhu:%d not added, the cluster already has %d machines",
+        DOT_SEPARATED(m->ip), m->cluster_port, c->n_machines);
+      result = ENOSPC;
+    }
     else {
         ClusterConfiguration *cconf = configuration_add_machine(c, m);
         //CLUSTER_INCREMENT_DYN_STAT(CLUSTER_NODES_STAT);
@@ -494,6 +500,25 @@ cluster_ping_config_cb(const char *name, RecDataT data_type, RecData data, void
   return 0;
 }
 
+// mgmt_getAddrForIntr() only finds IPv4 addresses, look for a routable
+// IPv6 one on an interface without.
+static bool
+cluster_getIp6AddrForIntr(const char *intrName, IpEndpoint *addr)
+{
+  struct ifaddrs *ifap, *ifa;
+  bool found = false;
+
+  if (getifaddrs(&ifap) != 0)
+    return false;
+  for (ifa = ifap; ifa && !found; ifa = ifa->ifa_next) {
+    if (ifa->ifa_addr && ats_is_ip6(ifa->ifa_addr) && 0 == strcmp(ifa->ifa_name, intrName) &&
+        !IN6_IS_ADDR_LINKLOCAL(&ats_ip6_addr_cast(ifa->ifa_addr)))
+      found = ats_ip_copy(addr, ifa->ifa_addr);
+  }
+  freeifaddrs(ifap);
+  return found;
+}
+
 static int
 cluster_enabled_config_cb(const char *name, RecDataT data_type, RecData data, void *cookie)
 {
@@ -782,6 +807,30 @@ ClusterProcessor::init()
                      "proxy.process.cluster.write_lock_misses",
                      RECD_INT, RECP_NON_PERSISTENT, (int) CLUSTER_WRITE_LOCK_MISSES_STAT, RecRawStatSyncCount);
   CLUSTER_CLEAR_DYN_STAT(CLUSTER_WRITE_LOCK_MISSES_STAT);
+  RecRegisterRawStat(cluster_rsb, RECT_PROCESS,
+                     "proxy.process.cluster.diffuse.started",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) CLUSTER_DIFFUSE_STARTED_STAT, RecRawStatSyncSum);
+  CLUSTER_CLEAR_DYN_STAT(CLUSTER_DIFFUSE_STARTED_STAT);
+  RecRegisterRawStat(cluster_rsb, RECT_PROCESS,
+                     "proxy.process.cluster.diffuse.completed",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) CLUSTER_DIFFUSE_COMPLETED_STAT, RecRawStatSyncSum);
+  CLUSTER_CLEAR_DYN_STAT(CLUSTER_DIFFUSE_COMPLETED_STAT);
+  RecRegisterRawStat(cluster_rsb, RECT_PROCESS,
+                     "proxy.process.cluster.diffuse.failed",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) CLUSTER_DIFFUSE_FAILED_STAT, RecRawStatSyncSum);
+  CLUSTER_CLEAR_DYN_STAT(CLUSTER_DIFFUSE_FAILED_STAT);
+  RecRegisterRawStat(cluster_rsb, RECT_PROCESS,
+                     "proxy.process.cluster.diffuse.bytes_copied",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) CLUSTER_DIFFUSE_BYTES_STAT, RecRawStatSyncSum);
+  CLUSTER_CLEAR_DYN_STAT(CLUSTER_DIFFUSE_BYTES_STAT);
+  RecRegisterRawStat(cluster_rsb, RECT_PROCESS,
+                     "proxy.process.cluster.diffuse.replica_hits",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) CLUSTER_DIFFUSE_REPLICA_HITS_STAT, RecRawStatSyncSum);
+  CLUSTER_CLEAR_DYN_STAT(CLUSTER_DIFFUSE_REPLICA_HITS_STAT);
+  RecRegisterRawStat(cluster_rsb, RECT_PROCESS,
+                     "proxy.process.cluster.diffuse.bytes_saved",
+                     RECD_INT, RECP_NON_PERSISTENT, (int) CLUSTER_DIFFUSE_BYTES_SAVED_STAT, RecRawStatSyncSum);
+  CLUSTER_CLEAR_DYN_STAT(CLUSTER_DIFFUSE_BYTES_SAVED_STAT);
   CLUSTER_CLEAR_DYN_STAT(CLUSTER_NODES_STAT);   // clear sum and count
   // INKqa08033: win2k: ui: cluster warning light on
   // Used to call CLUSTER_INCREMENT_DYN_STAT here; switch to SUM_GLOBAL_DYN_STAT
@@ -830,8 +879,35 @@ ClusterProcessor::init()
   IOCORE_EstablishStaticConfigInteger(cluster_flow_ctrl_max_bps, "proxy.config.cluster.flow_ctrl.max_bps");
   IOCORE_EstablishStaticConfigInt32(cluster_send_min_wait_time, "proxy.config.cluster.flow_ctrl.min_send_wait_time");
   IOCORE_EstablishStaticConfigInt32(cluster_send_max_wait_time, "proxy.config.cluster.flow_ctrl.max_send_wait_time");
-  IOCORE_EstablishStaticConfigInt32(cluster_min_loop_interval, "proxy.config.cluster.flow_ctrl.min_loop_interval");
-  IOCORE_EstablishStaticConfigInt32(cluster_max_loop_interval, "proxy.config.cluster.flow_ctrl.max_loop_interval");
+
+  // The io threads sleep in epoll_wait until there is work, so the loop
+  // interval configs have no effect any more.
+  int min_loop_interval = 0, max_loop_interval = 1000;
+  IOCORE_ReadConfigInt32(min_loop_interval, "proxy.config.cluster.flow_ctrl.min_loop_interval");
+  IOCORE_ReadConfigInt32(max_loop_interval, "proxy.config.cluster.flow_ctrl.max_loop_interval");
+  if (min_loop_interval != 0 || max_loop_interval != 1000) {
+    Warning("proxy.config.cluster.flow_ctrl.min_loop_interval and max_loop_interval are deprecated and ignored");
+  }
+
+  IOCORE_EstablishStaticConfigInt32(cluster_compress_enabled, "proxy.config.cluster.compress.enabled");
+  IOCORE_EstablishStaticConfigInt32(cluster_compress_min_size, "proxy.config.cluster.compress.min_size");
+
+  IOCORE_ReadConfigInt32(consistentClusterHash, "proxy.config.cluster.consistent_hash");
+  IOCORE_ReadConfigInt32(clusterHashVirtualNodes, "proxy.config.cluster.hash_virtual_nodes");
+  IOCORE_ReadConfigInt32(clusterHashLoadFactor, "proxy.config.cluster.hash_load_factor");
+  if (clusterHashLoadFactor < 0 || (clusterHashLoadFactor > 0 && clusterHashLoadFactor < 100)) {
+    Warning("proxy.config.cluster.hash_load_factor %d is out of range, using %d", clusterHashLoadFactor,
+            clusterHashLoadFactor < 0 ? 0 : 100);
+    clusterHashLoadFactor = clusterHashLoadFactor < 0 ? 0 : 100;
+  }
+
+  IOCORE_EstablishStaticConfigInt32(cluster_diffuse_enabled, "proxy.config.cluster.diffuse.enabled");
+  IOCORE_EstablishStaticConfigInt32(cluster_diffuse_read_threshold, "proxy.config.cluster.diffuse.read_threshold");
+  IOCORE_EstablishStaticConfigInt32(cluster_diffuse_window_secs, "proxy.config.cluster.diffuse.window_secs");
+  IOCORE_EstablishStaticConfigInt32(cluster_diffuse_replica_ttl_secs, "proxy.config.cluster.diffuse.replica_ttl_secs");
+
+  IOCORE_EstablishStaticConfigInt32(cluster_coalesce_enabled, "proxy.config.cluster.coalesce.enabled");
+  IOCORE_EstablishStaticConfigInt32(cluster_coalesce_max_delay, "proxy.config.cluster.coalesce.max_delay");
 
   int cluster_type = 0;
   IOCORE_ReadConfigInteger(cluster_type, "proxy.local.cluster.type");
@@ -849,6 +925,16 @@ ClusterProcessor::init()
   PeriodicClusterEvent->init();
   */
 
+  // the configurations below size their machine tables from this
+  if (cluster_type == 1) {
+    IOCORE_ReadConfigInteger(g_max_machine_count, "proxy.config.cluster.max_machines");
+    if (g_max_machine_count < 2 || g_max_machine_count > CLUSTER_MAX_MACHINES) {
+      Warning("proxy.config.cluster.max_machines %d is out of range, using %d", g_max_machine_count,
+              CLUSTER_MAX_MACHINES);
+      g_max_machine_count = CLUSTER_MAX_MACHINES;
+    }
+  }
+
   this_cluster = NEW(new Cluster);
   if (cluster_type == 1) {
     this_cluster->init_default_configuration();
@@ -857,7 +943,6 @@ ClusterProcessor::init()
   this_cluster->configurations.push(cc);
   cc->n_machines = 1;
   cc->machines[0] = this_cluster_machine();
-  memset(cc->hash_table, 0, CLUSTER_HASH_TABLE_SIZE);
 
   /*
   // 0 dummy output data
@@ -886,10 +971,18 @@ ClusterProcessor::init()
     ink_assert(found && intrName != NULL);
 
     found = mgmt_getAddrForIntr(intrName, &cluster_ip.sa);
+    if (!found)
+      found = cluster_getIp6AddrForIntr(intrName, &cluster_ip);
     if (!found) {
       ink_fatal(1, "[ClusterProcessor::init] Unable to find network interface %s.  Exiting...\n", intrName);
-    } else if (!ats_is_ip4(&cluster_ip)) {
-      ink_fatal(1, "[ClusterProcessor::init] Unable to find IPv4 network interface %s.  Exiting...\n", intrName);
+    }
+
+    // an IPv6 cluster interface: the address from the environment
+    // (see ClusterMachine) can only be IPv4, take the interface's
+    if (ats_is_ip6(&cluster_ip)) {
+      ats_ip_copy(&this_cluster_machine()->addr, &cluster_ip);
+      ats_ip_port_cast(&this_cluster_machine()->addr) = htons(cluster_port);
+      this_cluster_machine()->ip = cluster_machine_key(&cluster_ip.sa);
     }
 
     g_work_threads = num_of_cluster_threads;
@@ -900,7 +993,7 @@ ClusterProcessor::init()
     g_server_port = cluster_port;
     cluster_global_init(cluster_main_handler, machine_change_notify);
 
-    result = connection_manager_init(cluster_ip.sin.sin_addr.s_addr, cluster_port);
+    result = connection_manager_init(&cluster_ip.sa, cluster_port);
     if (result == 0) {
       int enabled;
       IOCORE_ReadConfigInteger(enabled, "proxy.local.cluster.enabled");
@@ -879,6 +879,14 @@ ClusterCacheVC::openWriteStart(int event, void *data)
     return EVENT_DONE;
   }
   // process the data
+  if (event == CACHE_EVENT_OPEN_READ) {
+    // the remote side coalesced us into a write in progress,
+    // we read that write instead of doing our own
+    vio.op = VIO::READ;
+    SET_HANDLER(&ClusterCacheVC::openReadMain);
+    callcont(CACHE_EVENT_OPEN_READ);
+    return EVENT_CONT;
+  }
   if (event != CACHE_EVENT_OPEN_WRITE) {
     // prevent further trigger
     remote_closed = true;
@@ -950,8 +958,7 @@ Lagain:
     IOBufferBlock *r = clone_IOBufferBlockList(blocks, offset, flen);
     blocks = iobufferblock_skip(blocks, &offset, &length, flen);
 
-    remote_closed = cluster_send_message(cs, CLUSTER_CACHE_DATA_WRITE_DONE, r, -1,
-        priority);
+    remote_closed = send_write_data(r);
     if (remote_closed)
       goto Lagain;
 
@@ -965,8 +972,7 @@ Lagain:
     data_sent += length;
     IOBufferBlock *r = clone_IOBufferBlockList(blocks, offset, length);
     blocks = iobufferblock_skip(blocks, &offset, &length, length);
-    remote_closed = cluster_send_message(cs, CLUSTER_CACHE_DATA_WRITE_DONE, r,
-              -1, priority);
+    remote_closed = send_write_data(r);
     if (remote_closed)
       goto Lagain;
     Debug("data_sent", "sent bytes %d, reminds %"PRId64"", flen, length);
@@ -1045,6 +1051,7 @@ ClusterCacheVC::do_io_write(Continuation *c, int64_t nbytes, IOBufferReader *abu
     priority = PRIORITY_MID;
   else
     priority = PRIORITY_LOW;
+  compressible = frag_type == CACHE_FRAG_TYPE_HTTP && cluster_http_info_compressible(&alternate);
 
   CacheHTTPInfo *r = &alternate;
   SetIOWriteMessage msg;
@@ -1153,8 +1160,7 @@ ClusterCacheVC::do_io_close(int alerrno)
           IOBufferBlock *ret = clone_IOBufferBlockList(blocks, offset, flen);
           blocks = iobufferblock_skip(blocks, &offset, &length, flen);
 
-          remote_closed = cluster_send_message(cs, CLUSTER_CACHE_DATA_WRITE_DONE, ret,
-              -1, priority);
+          remote_closed = send_write_data(ret);
           if (remote_closed)
             goto Lfree;
 
@@ -1166,8 +1172,7 @@ ClusterCacheVC::do_io_close(int alerrno)
           data_sent += length;
           IOBufferBlock *ret = clone_IOBufferBlockList(blocks, offset, length);
           blocks = iobufferblock_skip(blocks, &offset, &length, length);
-          remote_closed = cluster_send_message(cs, CLUSTER_CACHE_DATA_WRITE_DONE, ret, -1,
-              priority);
+          remote_closed = send_write_data(ret);
           if (remote_closed)
             goto Lfree;
           Debug("data_sent", "sent bytes done: %"PRId64", reminds %"PRId64"", data_sent, length);
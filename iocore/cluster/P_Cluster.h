@@ -122,6 +122,12 @@ enum
   CLUSTER_REMOTE_CONNECTION_TIME_STAT,
   CLUSTER_SETDATA_NO_CLUSTERVC_STAT,
   CLUSTER_SETDATA_NO_CLUSTER_STAT,
+  CLUSTER_DIFFUSE_STARTED_STAT,
+  CLUSTER_DIFFUSE_COMPLETED_STAT,
+  CLUSTER_DIFFUSE_FAILED_STAT,
+  CLUSTER_DIFFUSE_BYTES_STAT,
+  CLUSTER_DIFFUSE_REPLICA_HITS_STAT,
+  CLUSTER_DIFFUSE_BYTES_SAVED_STAT,
   cluster_stat_count
 };
 
@@ -63,7 +63,14 @@
 //   changes
 //
 #define CLUSTER_MAJOR_VERSION               6
-#define CLUSTER_MINOR_VERSION               0
+#define CLUSTER_MINOR_VERSION               2
+
+// Lowest minor version that understands compressed cluster messages
+#define CLUSTER_COMPRESS_MINOR_VERSION      1
+
+// Lowest minor version that can coalesce a remote open_write into a
+// write already in progress (CFL_LOPENWRITE_COALESCE)
+#define CLUSTER_COALESCE_MINOR_VERSION      2
 
 // Lowest supported major/minor cluster version
 #define MIN_CLUSTER_MAJOR_VERSION	    CLUSTER_MAJOR_VERSION
@@ -76,9 +83,12 @@
 
 #define MAX_CLUSTER_SEND_LENGTH             INT_MAX
 
-#define CLUSTER_MAX_MACHINES                256
+// upper bound of proxy.config.cluster.max_machines, hash table entries
+// are 16 bits wide and CLUSTER_HASH_NO_MACHINE marks an empty one
+#define CLUSTER_MAX_MACHINES                4096
 // less than 1% disparity at 255 machines, 32707 is prime less than 2^15
 #define CLUSTER_HASH_TABLE_SIZE             32707
+#define CLUSTER_HASH_NO_MACHINE             0xFFFF
 
 // after timeout the configuration is "dead"
 #define CLUSTER_CONFIGURATION_TIMEOUT       HRTIME_DAY
@@ -158,7 +168,8 @@ ats_swap64(uint64_t d)
 struct ClusterConfiguration
 {
   int n_machines;
-  ClusterMachine *machines[CLUSTER_MAX_MACHINES];
+  int max_machines;             // size of machines[]
+  ClusterMachine **machines;
 
   ClusterMachine *machine_hash(unsigned int hash_value)
   {
@@ -182,8 +193,10 @@ struct ClusterConfiguration
   //
   // Private
   //
-  ClusterConfiguration();
-  unsigned char hash_table[CLUSTER_HASH_TABLE_SIZE];
+  ClusterConfiguration(int amax_machines = 0);
+  ClusterConfiguration(const ClusterConfiguration & c);
+  ~ClusterConfiguration();
+  uint16_t hash_table[CLUSTER_HASH_TABLE_SIZE];
   ink_hrtime changed;
   SLINK(ClusterConfiguration, link);
 };
@@ -1191,6 +1204,9 @@ ClusterConfiguration *configuration_remove_machine(ClusterConfiguration * c, Clu
 extern bool machineClusterHash;
 extern bool boundClusterHash;
 extern bool randClusterHash;
+extern int consistentClusterHash;
+extern int clusterHashVirtualNodes;
+extern int clusterHashLoadFactor;
 
 void build_cluster_hash_table(ClusterConfiguration *);
 
@@ -1270,6 +1286,7 @@ struct ClusterCacheVC: public CacheVConnection
   bool in_progress; //
   bool remote_closed;
   bool session_closed;
+  bool compressible;              // see cluster_http_info_compressible()
 
   union
   {
@@ -1318,6 +1335,14 @@ struct ClusterCacheVC: public CacheVConnection
 
   void do_remote_close(); // invoke remote, for cancel or error
 
+  // send a chunk of the object being written to the owner
+  int send_write_data(IOBufferBlock *b)
+  {
+    if (compressible)
+      return cluster_send_compressible_message(cs, CLUSTER_CACHE_DATA_WRITE_DONE, b, priority);
+    return cluster_send_message(cs, CLUSTER_CACHE_DATA_WRITE_DONE, b, -1, priority);
+  }
+
   virtual int get_header(void **ptr, int *len)
   {
     NOWARN_UNUSED(ptr);
@@ -1460,13 +1485,14 @@ struct CacheDiffuser : public Continuation
   int len;
   CacheFragType frag_type;
   bool terminate;
+  bool diffused;                // the local copy is complete
   ContinuationHandler current_handler;
   ContinuationHandler read_handler;
   ContinuationHandler write_handler;
 
   CacheDiffuser():remote_read_vc(0), local_write_vc(0), read_vio(0), write_vio(0),
       hostname(0), doc_size(-1), len(0), frag_type(CACHE_FRAG_TYPE_NONE),
-      terminate(false), current_handler(0)
+      terminate(false), diffused(false), current_handler(0)
   {
     SET_HANDLER(&CacheDiffuser::main_handler);
     read_handler = (ContinuationHandler)&CacheDiffuser::cacheRemoteReadHandler;
@@ -1538,6 +1564,76 @@ struct DiffuseTable {
   }
 };
 
+//
+// Hot object replication
+//
+// With cluster_diffuse_enabled, the remote reads of each key are counted
+// over windows of cluster_diffuse_window_secs.  The read which brings a
+// key to cluster_diffuse_read_threshold in a window also copies the
+// object into the local cache (CacheDiffuser), and once the copy is done
+// reads of the key are served from it for cluster_diffuse_replica_ttl_secs.
+// After that they go back to the owner, which bounds how stale a replica
+// can be.  Writes and removes sent to the owner from this node drop the
+// replica at once.
+//
+enum DiffuseDecision
+{
+  DIFFUSE_READ_REMOTE,          // read from the owner
+  DIFFUSE_READ_AND_COPY,        // read from the owner, copy into the local cache
+  DIFFUSE_READ_LOCAL            // read the local replica
+};
+
+extern int cluster_diffuse_enabled;
+extern int cluster_diffuse_read_threshold;
+extern int cluster_diffuse_window_secs;
+extern int cluster_diffuse_replica_ttl_secs;
+
+#define DIFFUSE_POLICY_SETS 4093
+#define DIFFUSE_POLICY_WAYS 4
+
+struct DiffusePolicy
+{
+  struct Entry
+  {
+    INK_MD5 key;
+    uint32_t window;            // window the reads were counted in
+    int32_t reads;
+    ink_hrtime replica_expire;  // 0 when there is no local replica
+  };
+
+  Entry entries[DIFFUSE_POLICY_SETS][DIFFUSE_POLICY_WAYS];
+  ink_spinlock locks[DIFFUSE_POLICY_SETS];
+
+  DiffusePolicy() {
+    memset(entries, 0, sizeof(entries));
+    for (int i = 0; i < DIFFUSE_POLICY_SETS; ++i)
+      ink_spinlock_init(&locks[i]);
+  }
+
+  ~DiffusePolicy() {
+    for (int i = 0; i < DIFFUSE_POLICY_SETS; ++i)
+      ink_spinlock_destroy(&locks[i]);
+  }
+
+  // count a read of key which would go to its owner
+  DiffuseDecision remote_read(INK_MD5 *key);
+  void add_replica(INK_MD5 *key);
+  void drop_replica(INK_MD5 *key);
+  // open_read of the local replica, falling back to the owner on a miss
+  Action *read_replica(Continuation *cont, int opcode, MIOBuffer *buf, CacheURL *url, CacheHTTPHdr *request,
+                       CacheLookupHttpConfig *params, INK_MD5 *key, time_t pin_in_cache,
+                       CacheFragType frag_type, char *hostname, int host_len);
+
+private:
+  Entry *find(int set, INK_MD5 *key, bool insert);
+};
+
+extern DiffusePolicy diffusePolicy;
+
+// true if the object bodies described by info are worth compressing on
+// the cluster link: text like content, not already content encoded
+bool cluster_http_info_compressible(CacheHTTPInfo *info);
+
 inline IOBufferBlock *
 clone_IOBufferBlockList(IOBufferBlock *ab, int64_t offset, int64_t len)
 {
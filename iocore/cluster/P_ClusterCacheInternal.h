@@ -71,6 +71,8 @@ extern int64_t num_of_cachecontinuation;
 #define TIMEOUT_TEST(_x)
 
 extern int cache_migrate_on_demand;
+extern int cluster_coalesce_enabled;
+extern int cluster_coalesce_max_delay;
 extern int ET_CLUSTER;
 //
 // Compile time options.
@@ -246,6 +248,7 @@ struct CacheContinuation:public Continuation
   bool have_all_data;           // all object data in response
   bool expect_next;
   bool writer_aborted;
+  bool compressible;            // data sent is worth compressing
   int result;                   // return event code
   int result_error;             // error code associated with event
   uint16_t cfl_flags;             // Request flags; see CFL_XXX defines
@@ -472,6 +475,9 @@ free_CacheCont(CacheContinuation *c) {
 #define CFL_REMOVE_LINK 		(1 << 3)
 #define CFL_LOPENWRITE_HAVE_OLDINFO	(1 << 4)
 #define CFL_ALLOW_MULTIPLE_WRITES       (1 << 5)
+// open_write_long carries the request header; if the object is being
+// written on the owner, reply with a read of that write instead
+#define CFL_LOPENWRITE_COALESCE         (1 << 6)
 #define CFL_MAX 			(1 << 15)
 
 struct CacheOpArgs_General
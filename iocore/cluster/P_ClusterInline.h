@@ -187,7 +187,6 @@ Cluster_write(Continuation * cont, int expected_size,
               CacheHTTPHdr * request, CacheHTTPInfo * old_info, char *hostname, int host_len)
 {
   (void) key;
-  (void) request;
   ClusterSession session;
   ink_assert(cont);
   if (cluster_create_session(&session, m, NULL, 0)) {
@@ -197,6 +196,7 @@ Cluster_write(Continuation * cont, int expected_size,
   char *msg = 0;
   char *data = 0;
   int allow_multiple_writes = 0;
+  int coalesce = 0;
   int len = 0;
   int flen = 0;
   int vers = CacheOpMsg_long::protoToVersion(m->msg_proto_major);
@@ -233,6 +233,11 @@ Cluster_write(Continuation * cont, int expected_size,
       }
       if (old_info) {
         len += old_info->marshal_length();
+      } else if (!allow_multiple_writes && cluster_coalesce_enabled && request && request->valid()
+                 && m->msg_proto_minor >= CLUSTER_COALESCE_MINOR_VERSION) {
+        // let the owner attach us to a write of this object already in progress
+        coalesce = 1;
+        len += request->m_heap->marshal_length();
       }
       len += url_hlen;
 
@@ -255,6 +260,14 @@ Cluster_write(Continuation * cont, int expected_size,
         data += res;
         cur_len -= res;
       }
+      if (coalesce) {
+        res = request->m_heap->marshal(data, cur_len);
+        if (res < 0) {
+          goto err_exit;
+        }
+        data += res;
+        cur_len -= res;
+      }
       memcpy(data, url_hostname, url_hlen);
       break;
     }
@@ -273,6 +286,7 @@ Cluster_write(Continuation * cont, int expected_size,
     writeArgs.cfl_flags |= (options & CACHE_WRITE_OPT_OVERWRITE ? CFL_OVERWRITE_ON_WRITE : 0);
     writeArgs.cfl_flags |= (old_info ? CFL_LOPENWRITE_HAVE_OLDINFO : 0);
     writeArgs.cfl_flags |= (allow_multiple_writes ? CFL_ALLOW_MULTIPLE_WRITES : 0);
+    writeArgs.cfl_flags |= (coalesce ? CFL_LOPENWRITE_COALESCE : 0);
 
     Action *action = CacheContinuation::do_op(cont, session, (void *) &writeArgs, opcode, d, flen + len, expected_size, buf);
     if (action)
@@ -53,6 +53,24 @@
 //
 #define NO_RACE_DELAY                  HRTIME_HOUR      // a long long time
 
+//
+// Relative share of the cluster hash buckets a machine gets when it has
+// no weight in cluster.config (see build_cluster_hash_table).
+//
+#define CLUSTER_DEFAULT_MACHINE_WEIGHT 100
+#define CLUSTER_MAX_MACHINE_WEIGHT     1000
+
+//
+// The 32 bit key of a cluster address, which stands for the machine in
+// session ids and the hash: the IPv4 address itself, or a hash of an
+// IPv6 address.
+//
+inline unsigned int
+cluster_machine_key(sockaddr const *addr)
+{
+  return ats_ip_hash(addr);
+}
+
 struct ClusterHandler;           // Leave this a class - VC++ gets very anal  ~SR -- which version of VC++? ~igalic
 
 struct ClusterMachine: public Server
@@ -61,15 +79,19 @@ struct ClusterMachine: public Server
   char *hostname;
   int hostname_len;
   //
-  // The network address of the current machine,
-  // stored in network byte order
+  // The machine key: the network address of an IPv4 machine,
+  // stored in network byte order, or a hash of the address of an
+  // IPv6 one (see cluster_machine_key()).  Session ids carry it.
   //
   unsigned int ip;
   int cluster_port;
+  IpEndpoint addr;              // address and cluster port
+  int machine_id;               // slot in the machine table, -1 if none
   int num_connections;
   int now_connections;
   int free_connections;
   int64_t rr_count;
+  int weight;                   // hash share, 0 for CLUSTER_DEFAULT_MACHINE_WEIGHT
 
   Link<ClusterMachine> link;
 
@@ -94,6 +116,13 @@ struct ClusterMachine: public Server
   uint16_t msg_proto_major;
   uint16_t msg_proto_minor;
 
+  // Link compression, message body bytes before and after (see message.cc)
+  volatile int64_t compress_in_bytes;
+  volatile int64_t compress_out_bytes;
+  volatile int64_t decompress_in_bytes;
+  volatile int64_t decompress_out_bytes;
+  bool link_stats_registered;   // see log_link_stats() in nio.cc
+
   // Private data for ClusterProcessor
   //
   ClusterHandler **clusterHandlers;
@@ -101,8 +130,10 @@ struct ClusterMachine: public Server
 
 struct MachineListElement
 {
-  unsigned int ip;
+  unsigned int ip;              // cluster_machine_key(&addr.sa)
   int port;
+  int weight;
+  IpEndpoint addr;
 };
 struct MachineList
 {
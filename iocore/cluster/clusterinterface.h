@@ -78,5 +78,12 @@ void *cluster_close_session(ClusterSession session);
 int cluster_send_message(ClusterSession session, const int func_id,
 	void *data, const int data_len, const MessagePriority priority);
 
+/*
+ * as cluster_send_message with IOBufferBlock * data, for bodies that are
+ * worth compressing (text like content) when the link supports it
+ **/
+int cluster_send_compressible_message(ClusterSession session,
+    const int func_id, IOBufferBlock *blocks, const MessagePriority priority);
+
 #endif
 
@@ -65,7 +65,7 @@ struct connection_thread_context
 static struct connection_thread_context connect_thread_context;
 static SocketContext *socket_contexts_pool = NULL;  //first element for accept
 
-SocketContextsByMachine *g_machine_sockets = NULL;  //[dest ip % MAX_MACHINE_COUNT]
+SocketContextsByMachine *g_machine_sockets = NULL;  //[machine_id]
 
 void *connect_worker_entrance(void *arg);
 
@@ -145,56 +145,6 @@ static void release_connection(SocketContext *pSockContext,
   }
 }
 
-inline static int get_machine_index(const unsigned int ip)
-{
-  int id;
-  int count;
-  int index;
-
-  id = ip % MAX_MACHINE_COUNT;
-  if (g_machine_sockets[id].ip == ip) {
-    return id;
-  }
-
-  count = 1;
-  while (count <= MAX_MACHINE_COUNT) {
-    index = (id + count) % MAX_MACHINE_COUNT;
-    if (g_machine_sockets[index].ip == ip) {
-      return index;
-    }
-    count++;
-  }
-
-  return -1;
-}
-
-static int alloc_machine_index(const unsigned int ip)
-{
-  int id;
-  int count;
-  int index;
-
-  id = ip % MAX_MACHINE_COUNT;
-  if (g_machine_sockets[id].ip == 0) {
-    return id;
-  }
-
-  count = 1;
-  while (count <= MAX_MACHINE_COUNT) {
-    index = (id + count) % MAX_MACHINE_COUNT;
-    if (g_machine_sockets[index].ip == 0) {
-      return index;
-    }
-    count++;
-  }
-
-  Warning("file: "__FILE__", line: %d, " \
-      "can't malloc slot for ip: %u.%u.%u.%u",
-      __LINE__, DOT_SEPARATED(ip));
-
-  return -1;
-}
-
 static void fill_send_buffer(ConnectContext *pConnectContext,
     const int func_id)
 {
@@ -282,9 +232,9 @@ static int deal_hello_message(SocketContext *pSockContext, char *data)
       if (proto_minor != CLUSTER_MINOR_VERSION) {
         Warning("file: "__FILE__", line: %d, " \
             "Different clustering minor versions (%d,%d) for " \
-            "node %u.%u.%u.%u, continuing", __LINE__,
+            "node %s, continuing", __LINE__,
             proto_minor, CLUSTER_MINOR_VERSION,
-            DOT_SEPARATED(pSockContext->machine->ip));
+            pSockContext->machine->hostname);
       }
     } else {
       proto_minor = 0;
@@ -293,9 +243,9 @@ static int deal_hello_message(SocketContext *pSockContext, char *data)
   else {
     Error("file: "__FILE__", line: %d, " \
         "Bad cluster major version range (%d-%d) for " \
-        "node %u.%u.%u.%u, close connection", __LINE__,
+        "node %s, close connection", __LINE__,
         pHelloMessage->min_major, pHelloMessage->major,
-        DOT_SEPARATED(pSockContext->machine->ip));
+        pSockContext->machine->hostname);
     return EINVAL;
   }
 
@@ -565,21 +515,13 @@ static void check_init_allocator(SocketContext *pSockContext)
 }
 #endif
 
-static SocketContext *alloc_connect_sock_context(const unsigned int machine_ip)
+static SocketContext *alloc_connect_sock_context(const ClusterMachine *machine)
 {
   SocketContext *pSockContext;
   int machine_id;
 
+  machine_id = machine->machine_id;
 	pthread_mutex_lock(&connect_thread_context.lock);
-  if ((machine_id=get_machine_index(machine_ip)) < 0) {
-    if ((machine_id=alloc_machine_index(machine_ip)) < 0) {
-      pthread_mutex_unlock(&connect_thread_context.lock);
-      return NULL;
-    }
-
-    g_machine_sockets[machine_id].ip = machine_ip;
-  }
-
   pSockContext = g_machine_sockets[machine_id].connect_free_list;
   if (pSockContext != NULL) {
     g_machine_sockets[machine_id].connect_free_list =
@@ -598,12 +540,8 @@ static void free_connect_sock_context(SocketContext *pSockContext,
     const bool needLock)
 {
   int machine_id;
-  if ((machine_id=get_machine_index(pSockContext->machine->ip)) < 0) {
-    Warning("file: "__FILE__", line: %d, " \
-        "can't get slot for ip: %u.%u.%u.%u",
-        __LINE__, DOT_SEPARATED(pSockContext->machine->ip));
-    return;
-  }
+
+  machine_id = pSockContext->machine->machine_id;
 
   if (needLock) {
     pthread_mutex_lock(&connect_thread_context.lock);
@@ -617,28 +555,13 @@ static void free_connect_sock_context(SocketContext *pSockContext,
   }
 }
 
-static SocketContext *alloc_accept_sock_context(const unsigned int machine_ip)
+static SocketContext *alloc_accept_sock_context(const ClusterMachine *machine)
 {
   SocketContext *pSockContext;
   int machine_id;
 
+  machine_id = machine->machine_id;
 	pthread_mutex_lock(&connect_thread_context.lock);
-  if ((machine_id=get_machine_index(machine_ip)) < 0) {
-    if ((machine_id=alloc_machine_index(machine_ip)) < 0) {
-      pthread_mutex_unlock(&connect_thread_context.lock);
-      return NULL;
-    }
-
-    g_machine_sockets[machine_id].ip = machine_ip;
-  }
-
-  /*
-  Debug(CLUSTER_DEBUG_TAG, "file: "__FILE__", line: %d, " \
-      "alloc slot for ip: %u.%u.%u.%u (%u)",
-      __LINE__, DOT_SEPARATED(machine_ip),
-      g_machine_sockets[machine_id].ip);
-  */
-
   pSockContext = g_machine_sockets[machine_id].accept_free_list;
   if (pSockContext != NULL) {
     g_machine_sockets[machine_id].accept_free_list =
@@ -656,19 +579,8 @@ static SocketContext *alloc_accept_sock_context(const unsigned int machine_ip)
 void free_accept_sock_context(SocketContext *pSockContext)
 {
   int machine_id;
-  if ((machine_id=get_machine_index(pSockContext->machine->ip)) < 0) {
-    Warning("file: "__FILE__", line: %d, " \
-        "can't get slot for ip: %u.%u.%u.%u",
-        __LINE__, DOT_SEPARATED(pSockContext->machine->ip));
-    return;
-  }
 
-  /*
-  Debug(CLUSTER_DEBUG_TAG, "file: "__FILE__", line: %d, " \
-      "free slot for ip: %u.%u.%u.%u (%u)",
-      __LINE__, DOT_SEPARATED(pSockContext->machine->ip),
-      g_machine_sockets[machine_id].ip);
-  */
+  machine_id = pSockContext->machine->machine_id;
 
 	pthread_mutex_lock(&connect_thread_context.lock);
   pSockContext->next = g_machine_sockets[machine_id].accept_free_list;
@@ -687,7 +599,7 @@ static int alloc_socket_contexts(const int connections_per_machine,
   SocketContext *pSockContext;
   SocketContext *pSockContextEnd;
 
-  total_connections = connections_per_machine * MAX_MACHINE_COUNT + 1;
+  total_connections = connections_per_machine * g_max_machine_count + 1;
   bytes = sizeof(SocketContext) * total_connections;
   *pool =	(SocketContext *)malloc(bytes);
   if (*pool == NULL) {
@@ -730,7 +642,7 @@ static int init_socket_contexts()
   half_connections_per_machine = g_connections_per_machine / 2;
   pSockContext = socket_contexts_pool + 1;   //0 for server accept
   thread_index = 0;
-  for (machine_index=0; machine_index<MAX_MACHINE_COUNT; machine_index++) {
+  for (machine_index=0; machine_index<g_max_machine_count; machine_index++) {
     for (k=0; k<half_connections_per_machine; k++) {
       pSockContext->connect_type = CONNECT_TYPE_SERVER;
       pSockContext->next = g_machine_sockets[machine_index].accept_free_list;
@@ -759,7 +671,7 @@ int connection_init()
   int bytes;
   SocketContextsByMachine *machine_sockets;
 
-	bytes = sizeof(SocketContextsByMachine) * MAX_MACHINE_COUNT;
+	bytes = sizeof(SocketContextsByMachine) * g_max_machine_count;
 	machine_sockets = (SocketContextsByMachine *)malloc(bytes);
 	if (machine_sockets == NULL) {
 		Error("file: "__FILE__", line: %d, " \
@@ -770,7 +682,7 @@ int connection_init()
 	memset(machine_sockets, 0, bytes);
   g_machine_sockets = machine_sockets;
 
-  connect_thread_context.alloc_size = MAX_MACHINE_COUNT *
+  connect_thread_context.alloc_size = g_max_machine_count *
     g_connections_per_machine + 1;
   bytes = sizeof(struct epoll_event) * connect_thread_context.alloc_size;
   connect_thread_context.events = (struct epoll_event *)malloc(bytes);
@@ -851,11 +763,12 @@ static int do_connect(ConnectContext *pConnectContext, const bool needLock)
 {
   int result;
 	struct epoll_event event;
-  struct sockaddr_in addr;
+  ClusterMachine *machine;
   SocketContext *pSockContext;
 
   pSockContext = pConnectContext->pSockContext;
-  pSockContext->sock = socket(AF_INET, SOCK_STREAM, 0);
+  machine = pSockContext->machine;
+  pSockContext->sock = socket(machine->addr.sa.sa_family, SOCK_STREAM, 0);
   pConnectContext->connect_count++;
   pConnectContext->state = STATE_CONNECTING;
   if (pSockContext->sock < 0) {
@@ -871,18 +784,15 @@ static int do_connect(ConnectContext *pConnectContext, const bool needLock)
   }
   tcpsetnodelay(pSockContext->sock);
 
-  addr.sin_family = PF_INET;
-  addr.sin_port = htons(pSockContext->machine->cluster_port);
-  result = inet_aton(pSockContext->machine->hostname, &addr.sin_addr);
-  if (result == 0) {
+  if (!ats_is_ip(&machine->addr)) {
     close_connection(pSockContext);
     remove_connection(pSockContext, needLock);
     return EINVAL;
   }
 
   pConnectContext->connect_start_time = CURRENT_MS();   //connect start time
-  if (connect(pSockContext->sock, (const struct sockaddr*)&addr, \
-        sizeof(addr)) == 0)  //success
+  if (connect(pSockContext->sock, &machine->addr.sa, \
+        ats_ip_size(&machine->addr)) == 0)  //success
   {
     pConnectContext->state = STATE_CONNECTED;
     pConnectContext->need_check_timeout = true;
@@ -1001,7 +911,7 @@ int machine_make_connections(ClusterMachine *m)
 
   half_connections_per_machine = g_connections_per_machine / 2;
   for (i=0; i<half_connections_per_machine; i++) {
-    pSockContext = alloc_connect_sock_context(m->ip);
+    pSockContext = alloc_connect_sock_context(m);
     if (pSockContext == NULL) {
       return ENOSPC;
     }
@@ -1040,17 +950,23 @@ int make_connection(SocketContext *pSockContext)
   return do_connect(pConnectContext, true);
 }
 
-int connection_manager_init(const unsigned int my_ip, const int port)
+int connection_manager_init(const struct sockaddr *my_addr, const int port)
 {
   ConnectContext *pConnectContext;
 	char bind_addr[IP_ADDRESS_SIZE];
 	struct epoll_event event;
+  IpEndpoint my_endpoint;
   int result;
 	int server_sock;
 
   assert(MSG_HEADER_LENGTH % 16 == 0);
 	*bind_addr = '\0';
-	server_sock = socketServer(bind_addr, g_server_port, &result);
+  if (ats_is_ip6(my_addr)) {  //dual stack, accepts IPv4 peers too
+    server_sock = socketServer6(bind_addr, g_server_port, &result);
+  }
+  else {
+    server_sock = socketServer(bind_addr, g_server_port, &result);
+  }
 	if (server_sock < 0)
 	{
 		return errno != 0 ? errno : EIO;
@@ -1069,9 +985,10 @@ int connection_manager_init(const unsigned int my_ip, const int port)
 		return result;
   }
 
-  if (my_ip > 0) {
-    g_my_machine_ip = my_ip;
-    add_machine(my_ip, port);
+  if (ats_ip_copy(&my_endpoint, my_addr)) {
+    ats_ip_port_cast(&my_endpoint) = htons(port);
+    g_my_machine_ip = cluster_machine_key(&my_endpoint.sa);
+    add_machine(&my_endpoint.sa);
   }
 
 	if ((result=nio_init()) != 0 || (result=connection_init()) != 0
@@ -1303,11 +1220,11 @@ static int do_reconnect()
   return 0;
 }
 
-static int deal_income_connection(const int incomesock)
+static int deal_income_connection(const int incomesock, IpEndpoint *addr)
 {
 	int result;
-  char client_ip[IP_ADDRESS_SIZE];
-  in_addr_t ip;
+  ip_text_buffer client_ip;
+  in_addr_t ip4;
   ConnectContext *pConnectContext;
 	SocketContext *pSockContext;
   ClusterMachine *machine;
@@ -1317,8 +1234,15 @@ static int deal_income_connection(const int incomesock)
   }
   tcpsetnodelay(incomesock);
 
-  ip = getPeerIpaddr(incomesock, client_ip, sizeof(client_ip));
-  machine = get_machine(ip, g_server_port);
+  //an IPv4 peer on the dual stack server socket
+  if (ats_is_ip6(addr) && IN6_IS_ADDR_V4MAPPED(&addr->sin6.sin6_addr)) {
+    memcpy(&ip4, addr->sin6.sin6_addr.s6_addr + 12, sizeof(ip4));
+    ats_ip4_set(addr, ip4);
+  }
+  ats_ip_port_cast(addr) = htons(g_server_port);
+
+  ats_ip_ntop(addr, client_ip, sizeof(client_ip));
+  machine = get_machine(&addr->sa);
   if (machine == NULL) {
 		Debug(CLUSTER_DEBUG_TAG, "file: " __FILE__ ", line: %d, "
 			"client: %s not in my machine list", \
@@ -1328,11 +1252,11 @@ static int deal_income_connection(const int incomesock)
 
   /*
   Debug(CLUSTER_DEBUG_TAG, "file: " __FILE__ ", line: %d, "
-      "income client_ip: %s, ip: %u == %u, sock: #%d", __LINE__,
-      client_ip, ip, machine->ip, incomesock);
+      "income client_ip: %s, machine: %d, sock: #%d", __LINE__,
+      client_ip, machine->machine_id, incomesock);
   */
 
-  pSockContext = alloc_accept_sock_context(machine->ip);
+  pSockContext = alloc_accept_sock_context(machine);
 	if (pSockContext == NULL) {
 		Debug(CLUSTER_DEBUG_TAG, "file: " __FILE__ ", line: %d, "
 			"client: %s, too many income connections, exceeds %d",
@@ -1360,12 +1284,11 @@ static int deal_accept_event(SocketContext *pSockContext)
 {
   int incomesock;
   int result;
-  struct sockaddr_in inaddr;
+  IpEndpoint inaddr;
   socklen_t sockaddr_len;
 
   sockaddr_len = sizeof(inaddr);
-  incomesock = accept(pSockContext->sock, (struct sockaddr*)&inaddr,
-      &sockaddr_len);
+  incomesock = accept(pSockContext->sock, &inaddr.sa, &sockaddr_len);
   if (incomesock < 0) {  //error
     result = errno != 0 ? errno : EAGAIN;
     if (result == EINTR) {
@@ -1385,7 +1308,7 @@ static int deal_accept_event(SocketContext *pSockContext)
     return result;
   }
 
-  result = deal_income_connection(incomesock);
+  result = deal_income_connection(incomesock, &inaddr);
   if (result != 0)
   {
     close(incomesock);
@@ -1527,10 +1450,8 @@ int add_machine_sock_context(SocketContext *pSockContext)
   SocketContext **newContexts;
   int bytes;
   int machine_id;
-  if ((machine_id=get_machine_index(pSockContext->machine->ip)) < 0) {
-    return ENOENT;
-  }
 
+  machine_id = pSockContext->machine->machine_id;
 	pthread_mutex_lock(&connect_thread_context.lock);
   contextArray = &g_machine_sockets[machine_id].connected_list;
   if (contextArray->count >= contextArray->alloc_size) {
@@ -1577,9 +1498,7 @@ int remove_machine_sock_context(SocketContext *pSockContext)
   unsigned int i;
   int machine_id;
 
-  if ((machine_id=get_machine_index(pSockContext->machine->ip)) < 0) {
-    return ENOENT;
-  }
+  machine_id = pSockContext->machine->machine_id;
 
   pthread_mutex_lock(&connect_thread_context.lock);
   contextArray = &g_machine_sockets[machine_id].connected_list;
@@ -1615,7 +1534,7 @@ SocketContext *get_socket_context(const ClusterMachine *machine)
   int context_count;
 	unsigned int context_index;
 
-  if ((machine_id=get_machine_index(machine->ip)) < 0) {
+  if ((machine_id=machine->machine_id) < 0) {
     Debug(CLUSTER_DEBUG_TAG, "file: "__FILE__", line: %d, " \
         "the index of ip addr: %s not exist", __LINE__, machine->hostname);
     return NULL;
@@ -1648,7 +1567,6 @@ int get_connected_socket_contexts(struct worker_thread_context *
   SocketContext *pSocketContext;
   int machine_id;
   int count;
-  int i;
   unsigned int k;
 
   if (g_machine_sockets == NULL) {  //not init yet!
@@ -1657,11 +1575,7 @@ int get_connected_socket_contexts(struct worker_thread_context *
 
   count = 0;
   pthread_mutex_lock(&connect_thread_context.lock);
-  for (i=0; i<g_machine_count; i++) {
-    if ((machine_id=get_machine_index(g_machines[i].ip)) < 0) {
-      continue;
-    }
-
+  for (machine_id=0; machine_id<g_machine_count; machine_id++) {
     pSocketContextArray = &g_machine_sockets[machine_id].connected_list;
     for (k=0; k<pSocketContextArray->count; k++) {
       pSocketContext = pSocketContextArray->contexts[k];
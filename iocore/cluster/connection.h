@@ -17,7 +17,6 @@ typedef struct socket_context_array {
 } SocketContextArray;
 
 typedef struct socket_context_by_machine {
-  unsigned int ip;
   socket_context_array connected_list;  //connected sockets
   SocketContext *accept_free_list;  //for accept socket malloc
   SocketContext *connect_free_list; //for connect socket malloc
@@ -32,7 +31,7 @@ extern SocketContextsByMachine *g_machine_sockets; //sockets by peer machine
 int connection_init();
 void connection_destroy();
 
-int connection_manager_init(const unsigned int my_ip, const int port);
+int connection_manager_init(const struct sockaddr *my_addr, const int port);
 void connection_manager_destroy();
 int connection_manager_start(pthread_t *tid);
 
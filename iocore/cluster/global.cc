@@ -15,17 +15,19 @@ int g_server_port = 8086;
 int g_thread_stack_size = 1 * 1024 * 1024;
 int g_socket_recv_bufsize = 1 * 1024 * 1024;
 int g_socket_send_bufsize = 1 * 1024 * 1024;
+int g_max_machine_count = 255;
 
 //cluster flow control
 int64_t cluster_flow_ctrl_min_bps = 0; //bit
 int64_t cluster_flow_ctrl_max_bps = 0; //bit
 int cluster_send_min_wait_time = 1000; //us
 int cluster_send_max_wait_time = 5000; //us
-int cluster_min_loop_interval = 0;     //us
-int cluster_max_loop_interval = 1000;  //us
 int64_t cluster_ping_send_interval= 0;
 int64_t cluster_ping_latency_threshold = 0;
 int cluster_ping_retries = 3;
 int max_session_count_per_machine = 1000000;
 int session_lock_count_per_machine =  10949;
 
+//cluster link compression
+int cluster_compress_enabled = 0;
+int cluster_compress_min_size = 1024;
@@ -20,20 +20,23 @@ extern int g_server_port;
 extern int g_thread_stack_size;
 extern int g_socket_recv_bufsize;
 extern int g_socket_send_bufsize;
+extern int g_max_machine_count;   //machine table size
 
 //cluster flow control
 extern int64_t cluster_flow_ctrl_min_bps; //bit
 extern int64_t cluster_flow_ctrl_max_bps; //bit
 extern int cluster_send_min_wait_time; //us
 extern int cluster_send_max_wait_time; //us
-extern int cluster_min_loop_interval;  //us
-extern int cluster_max_loop_interval;  //us
 extern int64_t cluster_ping_send_interval;
 extern int64_t cluster_ping_latency_threshold;
 extern int cluster_ping_retries;
 extern int max_session_count_per_machine;
 extern int session_lock_count_per_machine;
 
+//cluster link compression
+extern int cluster_compress_enabled;
+extern int cluster_compress_min_size;
+
 #ifdef __cplusplus
 }
 #endif
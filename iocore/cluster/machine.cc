@@ -23,41 +23,45 @@ unsigned int g_my_machine_ip = 0;
 int g_my_machine_id = 0;
 int g_machine_count = 0;
 
-ClusterMachine *g_machines = NULL;  //sort by ip and port
-static ClusterMachine **sorted_machines = NULL;
+ClusterMachine *g_machines = NULL;  //[machine_id], in the order added
+
+//open addressing indexes over g_machines, at least twice as many slots
+//as g_max_machine_count, so a probe always ends at an empty slot.
+//machines are never removed and a slot is set once, after the machine
+//it points to is filled, so lookups do not take machine_lock
+static ClusterMachine * volatile *addr_index = NULL;  //by address and port
+static ClusterMachine * volatile *key_index = NULL;   //by machine key
+static unsigned int index_mask = 0;
 static pthread_mutex_t machine_lock;
 
-static ClusterMachine *do_add_machine(ClusterMachine *m, int *result);
+static ClusterMachine *do_add_machine(const struct sockaddr *addr,
+    int *result);
 
-ClusterMachine *add_machine(const unsigned int ip, const int port)
+inline static unsigned int hash_code(const unsigned int key, const int port)
 {
-  ClusterMachine machine;
-  struct in_addr in;
-  int result;
-  char *ip_addr;
-
-  memset(&machine, 0, sizeof(machine));
-  in.s_addr = ip;
-  ip_addr = inet_ntoa(in);
-  machine.hostname_len = strlen(ip_addr);
-  machine.hostname = strdup(ip_addr);
-  machine.cluster_port = port;
-  machine.ip = ip;
+  unsigned int h;
+  h = (key ^ ((unsigned int)port << 16)) * 2654435761U;
+  return h ^ (h >> 16);
+}
 
-  return do_add_machine(&machine, &result);
+ClusterMachine *add_machine(const struct sockaddr *addr)
+{
+  int result;
+  return do_add_machine(addr, &result);
 }
 
 int init_machines()
 {
   int result;
   int bytes;
+  unsigned int index_size;
 
   if ((result=init_pthread_lock(&machine_lock)) != 0) {
     return result;
   }
 
   g_machine_count = 0;
-  bytes = sizeof(ClusterMachine) * MAX_MACHINE_COUNT;
+  bytes = sizeof(ClusterMachine) * g_max_machine_count;
   g_machines = (ClusterMachine *)malloc(bytes);
   if (g_machines == NULL) {
     Error("file: "__FILE__", line: %d, "
@@ -66,88 +70,97 @@ int init_machines()
   }
   memset(g_machines, 0, bytes);
 
-  bytes = sizeof(ClusterMachine *) * MAX_MACHINE_COUNT;
-  sorted_machines = (ClusterMachine **)malloc(bytes);
-  if (sorted_machines == NULL) {
+  index_size = 16;
+  while (index_size < 2 * (unsigned int)g_max_machine_count) {
+    index_size *= 2;
+  }
+  index_mask = index_size - 1;
+
+  bytes = sizeof(ClusterMachine *) * index_size;
+  addr_index = (ClusterMachine **)malloc(bytes);
+  key_index = (ClusterMachine **)malloc(bytes);
+  if (addr_index == NULL || key_index == NULL) {
     Error("file: "__FILE__", line: %d, "
         "malloc %d bytes fail!", __LINE__, bytes);
     return ENOMEM;
   }
-  memset(sorted_machines, 0, bytes);
+  memset((void *)addr_index, 0, bytes);
+  memset((void *)key_index, 0, bytes);
 
   return 0;
 }
 
-static int compare_machine(const void *p1, const void *p2)
-{
-  const ClusterMachine **m1 = (const ClusterMachine **)p1;
-  const ClusterMachine **m2 = (const ClusterMachine **)p2;
-
-  if ((*m1)->ip == (*m2)->ip) {
-    return (*m1)->cluster_port - (*m2)->cluster_port;
-  }
-  else {
-    return (*m1)->ip < (*m2)->ip ? -1 : 1;
-  }
-}
-
-static ClusterMachine *do_add_machine(ClusterMachine *m, int *result)
+static ClusterMachine *do_add_machine(const struct sockaddr *addr,
+    int *result)
 {
-  ClusterMachine **ppMachine;
-  ClusterMachine **ppMachineEnd;
-  ClusterMachine **pp;
   ClusterMachine *pMachine;
-  int cr;
+  ClusterMachine *pSameKey;
+  unsigned int key;
+  unsigned int index;
+  int port;
+  ip_text_buffer ip_addr;
 
-  cr = -1;
-	pthread_mutex_lock(&machine_lock);
-  ppMachineEnd = sorted_machines + g_machine_count;
-  for (ppMachine=sorted_machines; ppMachine<ppMachineEnd; ppMachine++) {
-    cr = compare_machine(&m, ppMachine);
-    if (cr <= 0) {
-      break;
-    }
-  }
+  key = cluster_machine_key(addr);
+  port = ats_ip_port_host_order(addr);
+  ats_ip_ntop(addr, ip_addr, sizeof(ip_addr));
 
+	pthread_mutex_lock(&machine_lock);
   do {
-    if (cr == 0) {  //found
-      pMachine = *ppMachine;
+    if ((pMachine=get_machine(addr)) != NULL) {  //found
       *result = EEXIST;
       break;
     }
 
-    if (g_machine_count >= MAX_MACHINE_COUNT) {
+    if (g_machine_count >= g_max_machine_count) {
       Error("file: "__FILE__", line: %d, "
-          "host: %s:%u, exceeds max machine: %d!", __LINE__, m->hostname,
-          m->cluster_port, MAX_MACHINE_COUNT);
+          "host: %s:%u, exceeds max machine: %d!", __LINE__, ip_addr,
+          port, g_max_machine_count);
       *result = ENOSPC;
-      pMachine = NULL;
       break;
     }
 
-    for (pp=ppMachineEnd; pp>ppMachine; pp--) {
-      *pp = *(pp - 1);
+    //machines sharing a key share their sessions, which is only right
+    //for the same address on different ports
+    pSameKey = get_machine_by_key(key);
+    if (pSameKey != NULL && !ats_ip_addr_eq(&pSameKey->addr.sa, addr)) {
+      Error("file: "__FILE__", line: %d, "
+          "host: %s:%u, machine key: %08x already used by host: %s!",
+          __LINE__, ip_addr, port, key, pSameKey->hostname);
+      *result = EEXIST;
+      break;
     }
 
     pMachine = g_machines + g_machine_count;  //the last emlement
-    *ppMachine = pMachine;
+    pMachine->hostname_len = strlen(ip_addr);
+    pMachine->hostname = (char *)malloc(pMachine->hostname_len + 1);
+    if (pMachine->hostname == NULL) {
+      Error("file: "__FILE__", line: %d, "
+          "malloc %d bytes fail!", __LINE__, pMachine->hostname_len + 1);
+      *result = ENOMEM;
+      pMachine = NULL;
+      break;
+    }
+    memcpy(pMachine->hostname, ip_addr, pMachine->hostname_len + 1);
 
     pMachine->dead = true;
-    pMachine->ip = m->ip;
-    pMachine->cluster_port = m->cluster_port;
-    pMachine->hostname_len = m->hostname_len;
-    if (m->hostname_len == 0) {
-      pMachine->hostname = NULL;
+    pMachine->ip = key;
+    pMachine->cluster_port = port;
+    ats_ip_copy(&pMachine->addr, addr);
+    pMachine->machine_id = g_machine_count;
+    __sync_synchronize();
+
+    index = hash_code(key, port) & index_mask;
+    while (addr_index[index] != NULL) {
+      index = (index + 1) & index_mask;
     }
-    else {
-      pMachine->hostname = (char *)malloc(m->hostname_len + 1);
-      if (pMachine->hostname == NULL) {
-        Error("file: "__FILE__", line: %d, "
-            "malloc %d bytes fail!", __LINE__, m->hostname_len + 1);
-        *result = ENOMEM;
-        break;
+    addr_index[index] = pMachine;
+
+    if (pSameKey == NULL) {
+      index = hash_code(key, 0) & index_mask;
+      while (key_index[index] != NULL) {
+        index = (index + 1) & index_mask;
       }
-      memcpy(pMachine->hostname, m->hostname, m->hostname_len + 1);
+      key_index[index] = pMachine;
     }
 
     g_machine_count++;
@@ -158,24 +171,48 @@ static ClusterMachine *do_add_machine(ClusterMachine *m, int *result)
   return pMachine;
 }
 
-ClusterMachine *get_machine(const unsigned int ip, const int port)
+ClusterMachine *get_machine(const struct sockaddr *addr)
 {
-  ClusterMachine machine;
-  ClusterMachine *target;
-  ClusterMachine **found;
-
-  memset(&machine, 0, sizeof(machine));
-  machine.ip = ip;
-  machine.cluster_port = port;
-  target = &machine;
-  found = (ClusterMachine **)bsearch(&target, sorted_machines, g_machine_count,
-      sizeof(ClusterMachine *), compare_machine);
-  if (found != NULL) {
-    return *found;
+  ClusterMachine *pMachine;
+  unsigned int index;
+  int port;
+
+  if (addr_index == NULL) {  //not init yet!
+    return NULL;
+  }
+
+  port = ats_ip_port_host_order(addr);
+  index = hash_code(cluster_machine_key(addr), port) & index_mask;
+  while ((pMachine=addr_index[index]) != NULL) {
+    if (pMachine->cluster_port == port &&
+        ats_ip_addr_eq(&pMachine->addr.sa, addr))
+    {
+      return pMachine;
+    }
+    index = (index + 1) & index_mask;
   }
-  else {
+
+  return NULL;
+}
+
+ClusterMachine *get_machine_by_key(const unsigned int ip)
+{
+  ClusterMachine *pMachine;
+  unsigned int index;
+
+  if (key_index == NULL) {  //not init yet!
     return NULL;
   }
+
+  index = hash_code(ip, 0) & index_mask;
+  while ((pMachine=key_index[index]) != NULL) {
+    if (pMachine->ip == ip) {
+      return pMachine;
+    }
+    index = (index + 1) & index_mask;
+  }
+
+  return NULL;
 }
 
 int machine_up_notify(ClusterMachine *machine)
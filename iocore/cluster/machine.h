@@ -14,12 +14,16 @@ extern unsigned int g_my_machine_index;
 extern unsigned int g_my_machine_ip;
 extern int g_my_machine_id;
 extern int g_machine_count;
-extern struct ClusterMachine *g_machines;
+extern struct ClusterMachine *g_machines;  //[machine_id]
 
 int init_machines();
-ClusterMachine *add_machine(const unsigned int ip, const int port);
 
-ClusterMachine *get_machine(const unsigned int ip, const int port);
+//addr: the machine address with its cluster port
+ClusterMachine *add_machine(const struct sockaddr *addr);
+ClusterMachine *get_machine(const struct sockaddr *addr);
+
+//the first machine added with this machine key (session id ip)
+ClusterMachine *get_machine_by_key(const unsigned int ip);
 
 int machine_up_notify(ClusterMachine *machine);
 int machine_add_connection(SocketContext *pSockContext);
@@ -37,8 +37,72 @@ inline int64_t get_total_size(IOBufferBlock *blocks) {
   return total_avail;
 }
 
-int cluster_send_message(ClusterSession session, const int func_id,
-	void *data, const int data_len, const MessagePriority priority)
+//copy the data of the blocks to buff, which must hold data_len bytes
+inline void copy_blocks(IOBufferBlock *blocks, char *buff) {
+  IOBufferBlock *b = blocks;
+  while (b != NULL) {
+    int64_t a = b->read_avail();
+    memcpy(buff, b->start(), a);
+    buff += a;
+    b = b->next;
+  }
+}
+
+static void compress_message(SocketContext *pSockContext, OutMessage *pMessage)
+{
+  int data_len;
+  int buff_size;
+  int compressed_len;
+  char *in;
+  char *tmp;
+  Ptr<IOBufferData> d;
+  IOBufferBlock *b;
+
+  data_len = pMessage->header.data_len;
+  buff_size = COMPRESS_HEADER_LENGTH + data_len + data_len / 20 + 66;
+  if (data_len < cluster_compress_min_size || buff_size > DEFAULT_MAX_BUFFER_SIZE) {
+    return;
+  }
+
+  //fastlz wants the input in one piece
+  if (pMessage->blocks->next == NULL) {
+    in = pMessage->blocks->start();
+    tmp = NULL;
+  }
+  else {
+    tmp = (char *)ats_malloc(data_len);
+    copy_blocks(pMessage->blocks, tmp);
+    in = tmp;
+  }
+
+  d = new_IOBufferData(iobuffer_size_to_index(buff_size, MAX_BUFFER_SIZE_INDEX));
+  compressed_len = fastlz_compress(in, data_len, d->data() + COMPRESS_HEADER_LENGTH);
+  if (tmp != NULL) {
+    ats_free(tmp);
+  }
+
+  __sync_fetch_and_add(&pSockContext->machine->compress_in_bytes, data_len);
+  //keep the original unless it saves at least 1/8
+  if (compressed_len <= 0 || COMPRESS_HEADER_LENGTH + compressed_len >
+      data_len - data_len / 8)
+  {
+    __sync_fetch_and_add(&pSockContext->machine->compress_out_bytes, data_len);
+    return;
+  }
+
+  *((int *)d->data()) = data_len;
+  b = new_IOBufferBlock(d, COMPRESS_HEADER_LENGTH + compressed_len, 0);
+  b->_buf_end = b->_end;
+  pMessage->blocks = b;
+  pMessage->header.func_id |= FUNC_ID_COMPRESSED_FLAG;
+  pMessage->header.data_len = COMPRESS_HEADER_LENGTH + compressed_len;
+  __sync_fetch_and_add(&pSockContext->machine->compress_out_bytes,
+      pMessage->header.data_len);
+}
+
+static int send_message(ClusterSession session, const int func_id,
+	void *data, const int data_len, const MessagePriority priority,
+  const bool compressible)
 {
   MachineSessions *pMachineSessions;
   SessionEntry *pSessionEntry;
@@ -105,6 +169,12 @@ int cluster_send_message(ClusterSession session, const int func_id,
       pMessage->data_type = DATA_TYPE_OBJECT;
       pMessage->blocks = (IOBufferBlock *)data;
       pMessage->header.data_len = get_total_size(pMessage->blocks);
+      if (compressible && cluster_compress_enabled && func_id > 0 &&
+          pSockContext->machine->msg_proto_minor >=
+          CLUSTER_COMPRESS_MINOR_VERSION)
+      {
+        compress_message(pSockContext, pMessage);
+      }
     }
     else {
       if (data_len > MINI_MESSAGE_SIZE) {
@@ -134,6 +204,18 @@ int cluster_send_message(ClusterSession session, const int func_id,
   return result;
 }
 
+int cluster_send_message(ClusterSession session, const int func_id,
+	void *data, const int data_len, const MessagePriority priority)
+{
+  return send_message(session, func_id, data, data_len, priority, false);
+}
+
+int cluster_send_compressible_message(ClusterSession session,
+    const int func_id, IOBufferBlock *blocks, const MessagePriority priority)
+{
+  return send_message(session, func_id, blocks, -1, priority, true);
+}
+
 int cluster_send_msg_internal_ex(const ClusterSession *session,
     SocketContext *pSockContext, const int func_id,
 	void *data, const int data_len, const MessagePriority priority,
@@ -11,6 +11,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/prctl.h>
 #include "Diags.h"
 #include "global.h"
@@ -50,33 +51,28 @@ struct NIORecords {
   RecRecord * send_wait_time;
   RecRecord * epoll_wait_count;
   RecRecord * epoll_wait_time_used;
-  RecRecord * loop_usleep_count;
-  RecRecord * loop_usleep_time;
-  RecRecord * io_loop_interval;
 
 #ifdef DEBUG
   RecRecord * max_write_loop_time_used;
   RecRecord * max_read_loop_time_used;
   RecRecord * max_epoll_time_used;
-  RecRecord * max_usleep_time_used;
   RecRecord * max_callback_time_used;
 #endif
 };
 
-static NIORecords nio_records = {NULL, NULL, NULL, NULL, NULL, NULL, NULL
+static NIORecords nio_records = {NULL, NULL, NULL, NULL
 #ifdef DEBUG
-  , NULL, NULL, NULL, NULL, NULL
+  , NULL, NULL, NULL, NULL
 #endif
 };
 
-static int send_wait_time = 1 * HRTIME_MSECOND;   //write wait time calc by cluster IO
-static int io_loop_interval = 0;  //us
+//write wait time calc by cluster IO, 0 means send as soon as queued
+static int send_wait_time = 0;
 
 #ifdef DEBUG
 static volatile int64_t max_write_loop_time_used = 0;
 static volatile int64_t max_read_loop_time_used = 0;
 static volatile int64_t max_epoll_time_used = 0;
-static volatile int64_t max_usleep_time_used = 0;
 static volatile int64_t max_callback_time_used = 0;
 #endif
 
@@ -112,6 +108,18 @@ inline void consume(OutMessage *pMessage, int64_t l) {
   }
 }
 
+#define LINK_STAT_COUNT 4
+
+static const char *link_stat_names[LINK_STAT_COUNT] = {
+  "compress_in_bytes",
+  "compress_out_bytes",
+  "decompress_in_bytes",
+  "decompress_out_bytes"
+};
+
+//per link stats, LINK_STAT_COUNT for each slot of g_machines
+static RecRawStatBlock *link_rsb = NULL;
+
 static void init_nio_stats()
 {
   RecData data_default;
@@ -137,14 +145,22 @@ static void init_nio_stats()
       "proxy.process.cluster.io.epoll_wait_count", RECD_INT, data_default, RECP_NON_PERSISTENT);
   nio_records.epoll_wait_time_used = RecRegisterStat(RECT_PROCESS,
       "proxy.process.cluster.io.epoll_wait_time_used", RECD_INT, data_default, RECP_NON_PERSISTENT);
-  nio_records.loop_usleep_count = RecRegisterStat(RECT_PROCESS,
-      "proxy.process.cluster.io.loop_usleep_count", RECD_INT, data_default, RECP_NON_PERSISTENT);
-  nio_records.loop_usleep_time = RecRegisterStat(RECT_PROCESS,
-      "proxy.process.cluster.io.loop_usleep_time", RECD_INT, data_default, RECP_NON_PERSISTENT);
   nio_records.send_wait_time = RecRegisterStat(RECT_PROCESS,
       "proxy.process.cluster.io.send_wait_time", RECD_INT, data_default, RECP_NON_PERSISTENT);
-  nio_records.io_loop_interval = RecRegisterStat(RECT_PROCESS,
-      "proxy.process.cluster.io.loop_interval", RECD_INT, data_default, RECP_NON_PERSISTENT);
+
+  RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.io.loop_busy_time", 0, RECP_NON_PERSISTENT);
+  RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.io.notify_count", 0, RECP_NON_PERSISTENT);
+  RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.io.writable_count", 0, RECP_NON_PERSISTENT);
+  RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.io.cpu_time_used", 0, RECP_NON_PERSISTENT);
+  RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.io.cpu_usage", 0, RECP_NON_PERSISTENT);
+  RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.io.busy_usage", 0, RECP_NON_PERSISTENT);
+  RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.io.avg_send_latency", 0, RECP_NON_PERSISTENT);
+  RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.io.recv_large_msg_count", 0, RECP_NON_PERSISTENT);
+  RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.io.compress_in_bytes", 0, RECP_NON_PERSISTENT);
+  RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.io.compress_out_bytes", 0, RECP_NON_PERSISTENT);
+  RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.io.decompress_in_bytes", 0, RECP_NON_PERSISTENT);
+  RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.io.decompress_out_bytes", 0, RECP_NON_PERSISTENT);
+  link_rsb = RecAllocateRawStatBlock(g_max_machine_count * LINK_STAT_COUNT);
 
   RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.ping_total_count", 0, RECP_NON_PERSISTENT);
   RecRegisterStatInt(RECT_PROCESS, "proxy.process.cluster.ping_success_count", 0, RECP_NON_PERSISTENT);
@@ -162,21 +178,75 @@ static void init_nio_stats()
       "proxy.process.cluster.io.max_read_loop_time_used", RECD_INT, data_default, RECP_NON_PERSISTENT);
   nio_records.max_epoll_time_used = RecRegisterStat(RECT_PROCESS,
       "proxy.process.cluster.io.max_epoll_time_used", RECD_INT, data_default, RECP_NON_PERSISTENT);
-  nio_records.max_usleep_time_used = RecRegisterStat(RECT_PROCESS,
-      "proxy.process.cluster.io.max_usleep_time_used", RECD_INT, data_default, RECP_NON_PERSISTENT);
   nio_records.max_callback_time_used = RecRegisterStat(RECT_PROCESS,
       "proxy.process.cluster.io.max_callback_time_used", RECD_INT, data_default, RECP_NON_PERSISTENT);
 #endif
 }
 
+//compression bytes of each link, as
+//proxy.process.cluster.io.link.<host>:<port>.<name>, and their sums.
+//The link stats are registered the first time a link has traffic.
+static void log_link_stats()
+{
+  RecData data;
+  ClusterMachine *pMachine;
+  ClusterMachine *pMachineEnd;
+  int64_t values[LINK_STAT_COUNT];
+  int64_t sums[LINK_STAT_COUNT];
+  char name[256];
+  int i;
+
+  memset(sums, 0, sizeof(sums));
+
+  pMachineEnd = g_machines + g_machine_count;
+  for (pMachine=g_machines; pMachine<pMachineEnd; pMachine++) {
+    int base = (pMachine - g_machines) * LINK_STAT_COUNT;
+
+    values[0] = pMachine->compress_in_bytes;
+    values[1] = pMachine->compress_out_bytes;
+    values[2] = pMachine->decompress_in_bytes;
+    values[3] = pMachine->decompress_out_bytes;
+    if (values[0] == 0 && values[2] == 0) {
+      continue;
+    }
+
+    if (link_rsb != NULL && !pMachine->link_stats_registered) {
+      for (i=0; i<LINK_STAT_COUNT; i++) {
+        snprintf(name, sizeof(name), "proxy.process.cluster.io.link.%s:%d.%s",
+            pMachine->hostname, pMachine->cluster_port, link_stat_names[i]);
+        RecRegisterRawStat(link_rsb, RECT_PROCESS, name, RECD_INT, RECP_NON_PERSISTENT,
+            base + i, RecRawStatSyncSum);
+      }
+      pMachine->link_stats_registered = true;
+    }
+
+    for (i=0; i<LINK_STAT_COUNT; i++) {
+      sums[i] += values[i];
+      if (pMachine->link_stats_registered) {
+        RecSetGlobalRawStatSum(link_rsb, base + i, values[i]);
+      }
+    }
+  }
+
+  for (i=0; i<LINK_STAT_COUNT; i++) {
+    snprintf(name, sizeof(name), "proxy.process.cluster.io.%s", link_stat_names[i]);
+    data.rec_int = sums[i];
+    RecSetRecord(RECT_PROCESS, name, RECD_INT, &data, NULL);
+  }
+}
+
 void log_nio_stats()
 {
   RecData data;
 	struct worker_thread_context *pThreadContext;
 	struct worker_thread_context *pContextEnd;
-  SocketStats sum = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  SocketStats sum;
   static time_t last_calc_bps_time = CURRENT_TIME();
   static int64_t last_send_bytes = 0;
+  static int64_t last_calc_usage_time = CURRENT_NS();
+  static SocketStats last_sum;
+
+  memset(&sum, 0, sizeof(sum));
 
 	pContextEnd = g_worker_thread_contexts + g_work_threads;
 	for (pThreadContext=g_worker_thread_contexts; pThreadContext<pContextEnd;
@@ -197,8 +267,11 @@ void log_nio_stats()
     sum.call_read_count += pThreadContext->stats.call_read_count;
     sum.epoll_wait_count += pThreadContext->stats.epoll_wait_count;
     sum.epoll_wait_time_used += pThreadContext->stats.epoll_wait_time_used;
-    sum.loop_usleep_count += pThreadContext->stats.loop_usleep_count;
-    sum.loop_usleep_time += pThreadContext->stats.loop_usleep_time;
+    sum.loop_busy_time += pThreadContext->stats.loop_busy_time;
+    sum.notify_count += pThreadContext->stats.notify_count;
+    sum.writable_count += pThreadContext->stats.writable_count;
+    sum.cpu_time_used += pThreadContext->stats.cpu_time_used;
+    sum.recv_large_msg_count += pThreadContext->stats.recv_large_msg_count;
     sum.ping_total_count += pThreadContext->stats.ping_total_count;
     sum.ping_success_count += pThreadContext->stats.ping_success_count;
     sum.ping_time_used += pThreadContext->stats.ping_time_used;
@@ -249,6 +322,40 @@ void log_nio_stats()
   RecSetRecord(RECT_PROCESS, "proxy.process.cluster.io.call_writev_count", RECD_INT, &data, NULL);
   data.rec_int = sum.call_read_count;
   RecSetRecord(RECT_PROCESS, "proxy.process.cluster.io.call_read_count", RECD_INT, &data, NULL);
+  data.rec_int = sum.loop_busy_time;
+  RecSetRecord(RECT_PROCESS, "proxy.process.cluster.io.loop_busy_time", RECD_INT, &data, NULL);
+  data.rec_int = sum.notify_count;
+  RecSetRecord(RECT_PROCESS, "proxy.process.cluster.io.notify_count", RECD_INT, &data, NULL);
+  data.rec_int = sum.writable_count;
+  RecSetRecord(RECT_PROCESS, "proxy.process.cluster.io.writable_count", RECD_INT, &data, NULL);
+  data.rec_int = sum.cpu_time_used;
+  RecSetRecord(RECT_PROCESS, "proxy.process.cluster.io.cpu_time_used", RECD_INT, &data, NULL);
+  data.rec_int = sum.recv_large_msg_count;
+  RecSetRecord(RECT_PROCESS, "proxy.process.cluster.io.recv_large_msg_count", RECD_INT, &data, NULL);
+
+  log_link_stats();
+
+  //usage since the last call: cpu time of the io threads (percent of
+  //one core per thread), time out of epoll_wait (percent) and the mean
+  //queued to sent latency of the messages sent (us)
+  int64_t usage_time_pass = CURRENT_NS() - last_calc_usage_time;
+  if (usage_time_pass > 0 && g_worker_thread_count > 0) {
+    int64_t busy_time = sum.loop_busy_time - last_sum.loop_busy_time;
+    int64_t wait_time = sum.epoll_wait_time_used - last_sum.epoll_wait_time_used;
+    int64_t msg_count = sum.send_msg_count - last_sum.send_msg_count;
+
+    data.rec_int = 100 * (sum.cpu_time_used - last_sum.cpu_time_used) /
+      (usage_time_pass * g_worker_thread_count);
+    RecSetRecord(RECT_PROCESS, "proxy.process.cluster.io.cpu_usage", RECD_INT, &data, NULL);
+    data.rec_int = (busy_time + wait_time > 0) ? 100 * busy_time / (busy_time + wait_time) : 0;
+    RecSetRecord(RECT_PROCESS, "proxy.process.cluster.io.busy_usage", RECD_INT, &data, NULL);
+    data.rec_int = (msg_count > 0) ? (sum.send_delayed_time - last_sum.send_delayed_time) /
+      msg_count / HRTIME_USECOND : 0;
+    RecSetRecord(RECT_PROCESS, "proxy.process.cluster.io.avg_send_latency", RECD_INT, &data, NULL);
+
+    last_calc_usage_time += usage_time_pass;
+    last_sum = sum;
+  }
 
   RecDataSetFromInk64(RECD_INT, &nio_records.send_retry_count->data,
         sum.send_retry_count);
@@ -256,10 +363,6 @@ void log_nio_stats()
         sum.epoll_wait_count);
   RecDataSetFromInk64(RECD_INT, &nio_records.epoll_wait_time_used->data,
         sum.epoll_wait_time_used);
-  RecDataSetFromInk64(RECD_INT, &nio_records.loop_usleep_count->data,
-        sum.loop_usleep_count);
-  RecDataSetFromInk64(RECD_INT, &nio_records.loop_usleep_time->data,
-        sum.loop_usleep_time);
 
 #ifdef DEBUG
   RecDataSetFromInk64(RECD_INT, &nio_records.max_write_loop_time_used->data,
@@ -268,8 +371,6 @@ void log_nio_stats()
         max_read_loop_time_used);
   RecDataSetFromInk64(RECD_INT, &nio_records.max_epoll_time_used->data,
         max_epoll_time_used);
-  RecDataSetFromInk64(RECD_INT, &nio_records.max_usleep_time_used->data,
-        max_usleep_time_used);
   RecDataSetFromInk64(RECD_INT, &nio_records.max_callback_time_used->data,
         max_callback_time_used);
 #endif
@@ -281,31 +382,24 @@ void log_nio_stats()
     last_calc_bps_time = CURRENT_TIME();
     last_send_bytes = sum.send_bytes;
 
-    if (cluster_flow_ctrl_max_bps <= 0) {
-      send_wait_time = cluster_send_min_wait_time * HRTIME_USECOND;
-      io_loop_interval = cluster_min_loop_interval;
+    //below min_bps messages go out as soon as they are queued; above it
+    //writes are held back to combine more messages per writev
+    if (cluster_flow_ctrl_max_bps <= 0 ||
+        cluster_current_out_bps < cluster_flow_ctrl_min_bps)
+    {
+      send_wait_time = 0;
     }
     else {
-      if (cluster_current_out_bps < cluster_flow_ctrl_min_bps) {
-        send_wait_time = cluster_send_min_wait_time * HRTIME_USECOND;
-        io_loop_interval = cluster_min_loop_interval;
+      io_busy_ratio = (double)cluster_current_out_bps / (double)cluster_flow_ctrl_max_bps;
+      if (io_busy_ratio > 1.0) {
+        io_busy_ratio = 1.0;
       }
-      else {
-        io_busy_ratio = (double)cluster_current_out_bps / (double)cluster_flow_ctrl_max_bps;
-        if (io_busy_ratio > 1.0) {
-          io_busy_ratio = 1.0;
-        }
-        send_wait_time = (int)((cluster_send_min_wait_time +
-              (cluster_send_max_wait_time - cluster_send_min_wait_time) *
-              io_busy_ratio)) * HRTIME_USECOND;
-        io_loop_interval = cluster_min_loop_interval + (int)((
-              cluster_max_loop_interval - cluster_min_loop_interval) * io_busy_ratio);
-      }
-      RecDataSetFromInk64(RECD_INT, &nio_records.send_wait_time->data,
-          send_wait_time / HRTIME_USECOND);
-      RecDataSetFromInk64(RECD_INT, &nio_records.io_loop_interval->data,
-          io_loop_interval);
+      send_wait_time = (int)((cluster_send_min_wait_time +
+            (cluster_send_max_wait_time - cluster_send_min_wait_time) *
+            io_busy_ratio)) * HRTIME_USECOND;
     }
+    RecDataSetFromInk64(RECD_INT, &nio_records.send_wait_time->data,
+        send_wait_time / HRTIME_USECOND);
   }
 }
 
@@ -337,7 +431,7 @@ int nio_init()
 	}
   memset(g_worker_thread_contexts, 0, bytes);
 
-  total_connections = g_connections_per_machine * (MAX_MACHINE_COUNT - 1);
+  total_connections = g_connections_per_machine * (g_max_machine_count - 1);
 	max_connections_per_thread = total_connections / g_work_threads;
 	if (total_connections % g_work_threads != 0) {
 		max_connections_per_thread++;
@@ -378,6 +472,27 @@ int nio_init()
 			return errno != 0 ? errno : ENOMEM;
 		}
 
+		pThreadContext->notify_fd = eventfd(0, EFD_NONBLOCK);
+		if (pThreadContext->notify_fd < 0)
+		{
+			Error("file: " __FILE__ ", line: %d, "
+				"eventfd fail, errno: %d, error info: %s", \
+				__LINE__, errno, strerror(errno));
+			return errno != 0 ? errno : ENOMEM;
+		}
+
+		struct epoll_event event;
+		event.data.ptr = NULL;  //NULL for the notify_fd
+		event.events = EPOLLIN | EPOLLET;
+		if (epoll_ctl(pThreadContext->epoll_fd, EPOLL_CTL_ADD,
+			pThreadContext->notify_fd, &event) != 0)
+		{
+			Error("file: " __FILE__ ", line: %d, "
+				"epoll_ctl fail, errno: %d, error info: %s", \
+				__LINE__, errno, strerror(errno));
+			return errno != 0 ? errno : ENOMEM;
+		}
+
 		if ((result=init_pthread_lock(&pThreadContext->lock)) != 0)
 		{
 			return result;
@@ -445,18 +560,21 @@ int cluster_global_init(message_deal_func deal_func,
     reader.buff_end = reader.msg_header + len; \
   } while (0)
 
-#define MOVE_TO_NEW_BUFFER(pSockContext, msg_bytes) \
+#define MOVE_TO_BUFFER(pSockContext, msg_bytes, len) \
   do { \
     Ptr<IOBufferData> oldBuffer; \
     char *old_msg_header; \
     oldBuffer = pSockContext->reader.buffer; \
     old_msg_header = pSockContext->reader.msg_header; \
-    INIT_READER(pSockContext->reader, read_buffer_size); \
+    INIT_READER(pSockContext->reader, len); \
     memcpy(pSockContext->reader.current, old_msg_header, msg_bytes); \
     pSockContext->reader.current += msg_bytes; \
     oldBuffer = NULL; \
   } while (0)
 
+#define MOVE_TO_NEW_BUFFER(pSockContext, msg_bytes) \
+  MOVE_TO_BUFFER(pSockContext, msg_bytes, read_buffer_size)
+
 
 static int set_socket_rw_buff_size(int sock)
 {
@@ -549,6 +667,7 @@ int nio_add_to_epoll(SocketContext *pSockContext)
   clear_send_queue(pSockContext, true);
 
   pSockContext->queue_index = 0;
+  pSockContext->writable = 1;
   pSockContext->ping_start_time = 0;
   pSockContext->ping_fail_count = 0;
   pSockContext->next_write_time = CURRENT_NS() + send_wait_time;
@@ -562,7 +681,7 @@ int nio_add_to_epoll(SocketContext *pSockContext)
   add_machine_sock_context(pSockContext);
 
 	event.data.ptr = pSockContext;
-	event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+	event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
 	if (epoll_ctl(pSockContext->thread_context->epoll_fd, EPOLL_CTL_ADD,
 		pSockContext->sock, &event) != 0)
 	{
@@ -877,6 +996,7 @@ static int deal_write_event(SocketContext * pSockContext)
 	}
 	else if (write_bytes < 0) {
 		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      pSockContext->writable = 0;  //until the next EPOLLOUT
 			return EAGAIN;
 		}
     else if (errno == EINTR) {  //should try again
@@ -901,6 +1021,9 @@ static int deal_write_event(SocketContext * pSockContext)
     result = 0;
   }
   else {
+    if (write_bytes < total_bytes) {  //socket buffer full
+      pSockContext->writable = 0;
+    }
     result = EAGAIN;
   }
 
@@ -1036,6 +1159,72 @@ static int deal_write_event(SocketContext * pSockContext)
   return result;
 }
 
+static IOBufferBlock *decompress_message(MsgHeader *pHeader,
+    SocketContext *pSockContext, IOBufferBlock *blocks)
+{
+  int data_len;
+  char *in;
+  char *tmp;
+  Ptr<IOBufferData> d;
+  IOBufferBlock *b;
+
+  if (pHeader->data_len <= COMPRESS_HEADER_LENGTH) {
+    Error("file: "__FILE__", line: %d, "
+        "%s compressed message length: %d is too small", __LINE__,
+        pSockContext->machine->hostname, pHeader->data_len);
+    return NULL;
+  }
+
+  if (blocks->next == NULL) {
+    in = blocks->start();
+    tmp = NULL;
+  }
+  else {
+    tmp = (char *)ats_malloc(pHeader->data_len);
+    b = blocks;
+    for (in=tmp; b != NULL; b=b->next) {
+      memcpy(in, b->start(), b->read_avail());
+      in += b->read_avail();
+    }
+    in = tmp;
+  }
+
+  b = NULL;
+  data_len = *((int *)in);
+  if (data_len <= 0 || data_len > DEFAULT_MAX_BUFFER_SIZE) {
+    Error("file: "__FILE__", line: %d, "
+        "%s compressed message, invalid length: %d", __LINE__,
+        pSockContext->machine->hostname, data_len);
+  }
+  else {
+    d = new_RecvBuffer(data_len);
+    if (fastlz_decompress(in + COMPRESS_HEADER_LENGTH,
+          pHeader->data_len - COMPRESS_HEADER_LENGTH,
+          d->data(), data_len) != data_len)
+    {
+      Error("file: "__FILE__", line: %d, "
+          "%s decompress message fail, func_id: %d, length: %d", __LINE__,
+          pSockContext->machine->hostname,
+          pHeader->func_id & ~FUNC_ID_COMPRESSED_FLAG, data_len);
+    }
+    else {
+      b = new_IOBufferBlock(d, data_len, 0);
+      b->_buf_end = b->_end;
+      __sync_fetch_and_add(&pSockContext->machine->decompress_in_bytes,
+          pHeader->data_len);
+      __sync_fetch_and_add(&pSockContext->machine->decompress_out_bytes,
+          data_len);
+      pHeader->func_id &= ~FUNC_ID_COMPRESSED_FLAG;
+      pHeader->data_len = data_len;
+    }
+  }
+
+  if (tmp != NULL) {
+    ats_free(tmp);
+  }
+  return b;
+}
+
 static int deal_message(MsgHeader *pHeader, SocketContext *
     pSockContext, IOBufferBlock *blocks)
 {
@@ -1045,6 +1234,7 @@ static int deal_message(MsgHeader *pHeader, SocketContext *
   SessionEntry *pSessionEntry;
   void *user_data;
   int64_t time_used;
+  Ptr<IOBufferBlock> data;
 
  /*
   Debug(CLUSTER_DEBUG_TAG, "file: "__FILE__", line: %d, " \
@@ -1090,6 +1280,14 @@ static int deal_message(MsgHeader *pHeader, SocketContext *
     return 0;
   }
 
+  if (pHeader->func_id > 0 && (pHeader->func_id & FUNC_ID_COMPRESSED_FLAG)) {
+    data = decompress_message(pHeader, pSockContext, blocks);
+    if (data == NULL) {
+      return EINVAL;
+    }
+    blocks = data;
+  }
+
   result = get_response_session(pHeader, &pMachineSessions,
       &pSessionEntry, pSockContext, &call_func, &user_data);
   if (result != 0) {
@@ -1314,6 +1512,21 @@ static int deal_read_event(SocketContext *pSockContext)
         current_true_body_bytes = padding_body_bytes;
       }
 
+      //a large body gets a buffer of its own (the rest of it, with the
+      //messages after it, is read there) instead of a chain of blocks
+      //pinning the shared read buffers
+      if (bFirstBlock && pHeader->aligned_data_len >= LARGE_MSG_MIN_LENGTH &&
+          msg_bytes <= LARGE_MSG_MAX_MOVE_BYTES &&
+          MSG_HEADER_LENGTH + pHeader->aligned_data_len <= DEFAULT_MAX_BUFFER_SIZE)
+      {
+        int buff_size = index_to_buffer_size(iobuffer_size_to_index(
+              MSG_HEADER_LENGTH + pHeader->aligned_data_len,
+              MAX_BUFFER_SIZE_INDEX));
+        MOVE_TO_BUFFER(pSockContext, msg_bytes, buff_size);
+        pSockContext->thread_context->stats.recv_large_msg_count++;
+        return result;
+      }
+
       //must be only one block
       if (pHeader->func_id < 0) {
         if (!bFirstBlock) {
@@ -1417,6 +1630,13 @@ inline static void deal_epoll_events(struct worker_thread_context *
 	pEventEnd = pThreadContext->events + count;
 	for (pEvent=pThreadContext->events; pEvent<pEventEnd; pEvent++) {
 	  pSockContext = (SocketContext *)pEvent->data.ptr;
+    if (pSockContext == NULL) {  //notify_fd, new messages queued
+      eventfd_t value;
+      eventfd_read(pThreadContext->notify_fd, &value);
+      pThreadContext->stats.notify_count++;
+      __sync_bool_compare_and_swap(&pThreadContext->notify_pending, 1, 0);
+      continue;
+    }
 
     /*
     Debug(CLUSTER_DEBUG_TAG, "======file: "__FILE__", line: %d, " \
@@ -1436,6 +1656,15 @@ inline static void deal_epoll_events(struct worker_thread_context *
       continue;
     }
 
+    if (pEvent->events & EPOLLOUT) {  //written by schedule_sock_write
+      pSockContext->writable = 1;
+      pThreadContext->stats.writable_count++;
+    }
+
+    if ((pEvent->events & EPOLLIN) == 0) {
+      continue;
+    }
+
     while ((result=deal_read_event(pSockContext)) == 0) {
     }
 
@@ -1447,27 +1676,47 @@ inline static void deal_epoll_events(struct worker_thread_context *
 	return;
 }
 
-inline static void schedule_sock_write(struct worker_thread_context * pThreadContext)
+inline static bool has_message_to_send(SocketContext *pSockContext)
+{
+  for (int i=0; i<PRIORITY_COUNT; i++) {
+    if (pSockContext->send_queues[i].head != NULL) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#define TIMER_TIME_BEFORE(t) \
+  do { \
+    if ((t) < next_time) { \
+      next_time = (t); \
+    } \
+  } while (0)
+
+/**
+ * write the queued messages of the writable sockets, returns the time
+ * of the next timer (ping, ping timeout or a deferred write) so the
+ * caller can sleep in epoll_wait until then
+ */
+inline static int64_t schedule_sock_write(struct worker_thread_context * pThreadContext)
 {
 #define MAX_SOCK_CONTEXT_COUNT 32
   int result;
   int fail_count;
   int64_t current_time;
+  int64_t next_time;
   SocketContext **ppSockContext;
   SocketContext **ppContextEnd;
   SocketContext *failSockContexts[MAX_SOCK_CONTEXT_COUNT];
 
   fail_count = 0;
   current_time = CURRENT_NS();
+  next_time = current_time + HRTIME_SECOND;
   ppContextEnd = pThreadContext->active_sockets +
     pThreadContext->active_sock_count;
   for (ppSockContext = pThreadContext->active_sockets;
       ppSockContext < ppContextEnd; ppSockContext++)
   {
-    if (current_time < (*ppSockContext)->next_write_time) {
-      continue;
-    }
-
     if ((*ppSockContext)->ping_start_time > 0) { //ping message already sent
       if (current_time - (*ppSockContext)->ping_start_time > cluster_ping_latency_threshold) {
         (*ppSockContext)->ping_start_time = 0;  //reset start time when done
@@ -1487,16 +1736,32 @@ inline static void schedule_sock_write(struct worker_thread_context * pThreadCon
               (*ppSockContext)->ping_fail_count);
         }
       }
+      else {
+        TIMER_TIME_BEFORE((*ppSockContext)->ping_start_time +
+            cluster_ping_latency_threshold + 1);
+      }
     }
-    else {
-      if (cluster_ping_send_interval > 0 && current_time >=
-          (*ppSockContext)->next_ping_time)
-      {
+    else if (cluster_ping_send_interval > 0) {
+      if (current_time >= (*ppSockContext)->next_ping_time) {
         (*ppSockContext)->thread_context->stats.ping_total_count++;
         (*ppSockContext)->ping_start_time = current_time;
         (*ppSockContext)->next_ping_time = current_time + cluster_ping_send_interval;
         send_ping_message(*ppSockContext);
+        TIMER_TIME_BEFORE(current_time + cluster_ping_latency_threshold + 1);
       }
+      else {
+        TIMER_TIME_BEFORE((*ppSockContext)->next_ping_time);
+      }
+    }
+
+    //not writable sockets are woken up by EPOLLOUT
+    if (!(*ppSockContext)->writable || !has_message_to_send(*ppSockContext)) {
+      continue;
+    }
+
+    if (current_time < (*ppSockContext)->next_write_time) {
+      TIMER_TIME_BEFORE((*ppSockContext)->next_write_time);
+      continue;
     }
 
     while ((result=deal_write_event(*ppSockContext)) == 0) {
@@ -1504,6 +1769,11 @@ inline static void schedule_sock_write(struct worker_thread_context * pThreadCon
 
     if (result == EAGAIN) {
       (*ppSockContext)->next_write_time = current_time + send_wait_time;
+      if (send_wait_time > 0 && (*ppSockContext)->writable &&
+          has_message_to_send(*ppSockContext))
+      {
+        TIMER_TIME_BEFORE((*ppSockContext)->next_write_time);
+      }
     }
     else {  //error
       if (fail_count < MAX_SOCK_CONTEXT_COUNT) {
@@ -1513,7 +1783,7 @@ inline static void schedule_sock_write(struct worker_thread_context * pThreadCon
   }
 
   if (fail_count == 0) {
-    return;
+    return next_time;
   }
 
   ppContextEnd = failSockContexts + fail_count;
@@ -1522,6 +1792,7 @@ inline static void schedule_sock_write(struct worker_thread_context * pThreadCon
   {
     close_socket(*ppSockContext);
   }
+  return current_time;  //check the remaining sockets again
 }
 
 inline static int64_t get_current_time()
@@ -1573,13 +1844,15 @@ static int close_active_connections(struct worker_thread_context *
 
 static void *work_thread_entrance(void* arg)
 {
-#define MIN_USLEEP_TIME 100
-
 	int result;
 	int count;
-  int remain_time;
+  int timeout;
+  int64_t next_time;
+  int64_t wait_time;
   int64_t loop_start_time;
   int64_t deal_start_time;
+  int64_t next_cpu_time_check;
+  struct timespec cpu_time;
 #ifdef DEBUG
   int64_t deal_end_time;
   int64_t time_used;
@@ -1595,6 +1868,7 @@ static void *work_thread_entrance(void* arg)
   prctl(PR_SET_NAME, name, 0, 0, 0);
 #endif
 
+  next_cpu_time_check = 0;
 	while (g_continue_flag) {
     if (cache_clustering_enabled <= 0) {
       close_active_connections(pThreadContext);
@@ -1611,7 +1885,7 @@ static void *work_thread_entrance(void* arg)
     deal_start_time = loop_start_time;
 #endif
 
-    schedule_sock_write(pThreadContext);
+    next_time = schedule_sock_write(pThreadContext);
 
 #ifdef DEBUG
     GET_MAX_TIME_USED(max_write_loop_time_used);
@@ -1620,11 +1894,21 @@ static void *work_thread_entrance(void* arg)
 #ifndef DEBUG
     deal_start_time = CURRENT_NS();
 #endif
+    //sleep until a socket event, a new message (notify_fd) or the next timer
+    if (next_time > deal_start_time) {
+      timeout = (int)((next_time - deal_start_time + HRTIME_MSECOND - 1) /
+          HRTIME_MSECOND);
+    }
+    else {
+      timeout = 0;
+    }
+
     pThreadContext->stats.epoll_wait_count++;
 		count = epoll_wait(pThreadContext->epoll_fd,
-			pThreadContext->events, pThreadContext->alloc_size, 1);
+			pThreadContext->events, pThreadContext->alloc_size, timeout);
 
-    pThreadContext->stats.epoll_wait_time_used += CURRENT_NS() - deal_start_time;
+    wait_time = CURRENT_NS() - deal_start_time;
+    pThreadContext->stats.epoll_wait_time_used += wait_time;
 #ifdef DEBUG
     GET_MAX_TIME_USED(max_epoll_time_used);
 #endif
@@ -1647,18 +1931,15 @@ static void *work_thread_entrance(void* arg)
 #endif
     }
 
-    if (io_loop_interval > MIN_USLEEP_TIME) {
-      remain_time = io_loop_interval - (int)((CURRENT_NS() -
-          loop_start_time) / HRTIME_USECOND);
-      if (remain_time >= MIN_USLEEP_TIME && remain_time <= io_loop_interval) {
-        pThreadContext->stats.loop_usleep_count++;
-        pThreadContext->stats.loop_usleep_time += remain_time;
-        usleep(remain_time);
-
-#ifdef DEBUG
-        GET_MAX_TIME_USED(max_usleep_time_used);
-#endif
+    deal_start_time = CURRENT_NS();
+    pThreadContext->stats.loop_busy_time += deal_start_time -
+      loop_start_time - wait_time;
+    if (deal_start_time >= next_cpu_time_check) {
+      if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_time) == 0) {
+        pThreadContext->stats.cpu_time_used = (int64_t)cpu_time.tv_sec *
+          HRTIME_SECOND + cpu_time.tv_nsec * HRTIME_NSECOND;
       }
+      next_cpu_time_check = deal_start_time + HRTIME_SECOND;
     }
 	}
 
@@ -1721,12 +2002,18 @@ int push_to_send_queue(SocketContext *pSockContext, OutMessage *pMessage,
 	pSockContext->send_queues[priority].tail = pMessage;
 	pthread_mutex_unlock(&pSockContext->send_queues[priority].lock);
 
+  //wake up the io thread, once until it reads the notify_fd
+  if (__sync_bool_compare_and_swap(&pSockContext->thread_context->notify_pending, 0, 1)) {
+    eventfd_write(pSockContext->thread_context->notify_fd, 1);
+  }
+
   __sync_fetch_and_add(&pSockContext->thread_context->stats.push_msg_count, 1);
   __sync_fetch_and_add(&pSockContext->thread_context->stats.push_msg_bytes,
       MSG_HEADER_LENGTH + pMessage->header.aligned_data_len);
   return 0;
 }
 
+//called by the io thread only (ping messages), so no notify_fd wakeup
 int insert_into_send_queue_head(SocketContext *pSockContext, OutMessage *pMessage,
     const MessagePriority priority)
 {
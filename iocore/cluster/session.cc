@@ -31,55 +31,20 @@ static Allocator g_in_message_allocator("InMessage", sizeof(InMessage), 1024);
 
 static Allocator g_session_allocator("SessionEntry", sizeof(SessionEntry), 1024);
 
-static MachineSessions *all_sessions;  //[src ip % MAX_MACHINE_COUNT]
+static MachineSessions *all_sessions;  //[machine_id]
 static pthread_mutex_t session_lock;
 
 static void init_session_stat(const char *prefix);
 
+//sessions are kept by the machine key in the session id, machines
+//sharing a key (only the same address on other ports) share a slot
 inline static int get_session_machine_index(const unsigned int ip)
 {
-  int id;
-  int count;
-  int index;
-
-  id = ip % MAX_MACHINE_COUNT;
-  if (all_sessions[id].ip == ip) {
-    return id;
-  }
-
-  count = 1;
-  while (count <= MAX_MACHINE_COUNT) {
-    index = (id + count) % MAX_MACHINE_COUNT;
-    if (all_sessions[index].ip == ip) {
-      return index;
-    }
-    count++;
-  }
-
-  return -1;
-}
-
-static int alloc_session_machine_index(const unsigned int ip)
-{
-  int id;
-  int count;
-  int index;
-
-  id = ip % MAX_MACHINE_COUNT;
-  if (all_sessions[id].ip == 0) {
-    return id;
-  }
-
-  count = 1;
-  while (count <= MAX_MACHINE_COUNT) {
-    index = (id + count) % MAX_MACHINE_COUNT;
-    if (all_sessions[index].ip == 0) {
-      return index;
-    }
-    count++;
+  ClusterMachine *machine;
+  if ((machine=get_machine_by_key(ip)) == NULL) {
+    return -1;
   }
-
-  return -1;
+  return machine->machine_id;
 }
 
 inline static void release_in_message(SocketContext *pSockContext,
@@ -108,14 +73,12 @@ int init_machine_sessions(ClusterMachine *machine, const bool bMyself)
   pthread_mutex_t *pLock;
   pthread_mutex_t *pLockEnd;
 
-  pthread_mutex_lock(&session_lock);
   if ((machine_id=get_session_machine_index(machine->ip)) < 0) {
-    if ((machine_id=alloc_session_machine_index(machine->ip)) < 0) {
-      pthread_mutex_unlock(&session_lock);
-      return ENOSPC;
-    }
+    return ENOENT;
   }
 
+  pthread_mutex_lock(&session_lock);
+
   pMachineSessions = all_sessions + machine_id;
   if (pMachineSessions->init_done) {  //already init
     pthread_mutex_unlock(&session_lock);
@@ -165,7 +128,7 @@ int session_init()
   int result;
   ClusterMachine *myMachine;
 
-	bytes = sizeof(MachineSessions) * MAX_MACHINE_COUNT;
+	bytes = sizeof(MachineSessions) * g_max_machine_count;
 	all_sessions = (MachineSessions *)malloc(bytes);
 	if (all_sessions == NULL) {
 		Error("file: "__FILE__", line: %d, " \
@@ -745,12 +745,47 @@ int socketBind(int sock, const char *bind_ipaddr, const int port)
 	return 0;
 }
 
-int socketServer(const char *bind_ipaddr, const int port, int *err_no)
+int socketBind6(int sock, const char *bind_ipaddr, const int port)
+{
+	struct sockaddr_in6 bindaddr;
+
+	memset(&bindaddr, 0, sizeof(bindaddr));
+	bindaddr.sin6_family = AF_INET6;
+	bindaddr.sin6_port = htons(port);
+	if (bind_ipaddr == NULL || *bind_ipaddr == '\0')
+	{
+		bindaddr.sin6_addr = in6addr_any;
+	}
+	else
+	{
+		if (inet_pton(AF_INET6, bind_ipaddr, &bindaddr.sin6_addr) != 1)
+		{
+			Error("file: "__FILE__", line: %d, " \
+				"invalid ip addr %s", \
+				__LINE__, bind_ipaddr);
+			return EINVAL;
+		}
+	}
+
+	if (bind(sock, (struct sockaddr*)&bindaddr, sizeof(bindaddr)) < 0)
+	{
+		Error("file: "__FILE__", line: %d, " \
+			"bind port %d failed, " \
+			"errno: %d, error info: %s.", \
+			__LINE__, port, errno, STRERROR(errno));
+		return errno != 0 ? errno : ENOMEM;
+	}
+
+	return 0;
+}
+
+static int do_socket_server(const int family, const char *bind_ipaddr, \
+		const int port, int *err_no)
 {
 	int sock;
 	int result;
 	
-	sock = socket(AF_INET, SOCK_STREAM, 0);
+	sock = socket(family, SOCK_STREAM, 0);
 	if (sock < 0)
 	{
 		*err_no = errno != 0 ? errno : EMFILE;
@@ -771,7 +806,27 @@ int socketServer(const char *bind_ipaddr, const int port, int *err_no)
 		return -2;
 	}
 
-	if ((*err_no=socketBind(sock, bind_ipaddr, port)) != 0)
+	if (family == AF_INET6)
+	{
+		result = 0;  //dual stack
+		if (setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &result, \
+			sizeof(int)) < 0)
+		{
+			*err_no = errno != 0 ? errno : ENOMEM;
+			Error("file: "__FILE__", line: %d, " \
+				"setsockopt failed, errno: %d, error info: %s", \
+				__LINE__, errno, STRERROR(errno));
+			close(sock);
+			return -2;
+		}
+
+		*err_no = socketBind6(sock, bind_ipaddr, port);
+	}
+	else
+	{
+		*err_no = socketBind(sock, bind_ipaddr, port);
+	}
+	if (*err_no != 0)
 	{
 		close(sock);
 		return -3;
@@ -792,6 +847,16 @@ int socketServer(const char *bind_ipaddr, const int port, int *err_no)
 	return sock;
 }
 
+int socketServer(const char *bind_ipaddr, const int port, int *err_no)
+{
+	return do_socket_server(AF_INET, bind_ipaddr, port, err_no);
+}
+
+int socketServer6(const char *bind_ipaddr, const int port, int *err_no)
+{
+	return do_socket_server(AF_INET6, bind_ipaddr, port, err_no);
+}
+
 int tcprecvfile(int sock, const char *filename, const int64_t file_bytes, \
 		const int fsync_after_written_bytes, const int timeout, \
 		int64_t *true_file_bytes)
@@ -217,6 +217,12 @@ in_addr_t getIpaddrByName(const char *name, char *buff, const int bufferSize);
 */
 int socketBind(int sock, const char *bind_ipaddr, const int port);
 
+/** bind wrapper for an IPv6 socket, bind_ipaddr empty for any address
+ *  parameters: the same as socketBind
+ *  return: error no, 0 success, != 0 fail
+*/
+int socketBind6(int sock, const char *bind_ipaddr, const int port);
+
 /** start a socket server (socket, bind and listen)
  *  parameters:
  *          sock: the socket
@@ -227,6 +233,13 @@ int socketBind(int sock, const char *bind_ipaddr, const int port);
 */
 int socketServer(const char *bind_ipaddr, const int port, int *err_no);
 
+/** start an IPv6 socket server which accepts IPv4 peers too
+ *  (as v4 mapped addresses)
+ *  parameters: the same as socketServer
+ *  return: >= 0 server socket, < 0 fail
+*/
+int socketServer6(const char *bind_ipaddr, const int port, int *err_no);
+
 #define tcprecvdata(sock, data, size, timeout) \
 	tcprecvdata_ex(sock, data, size, timeout, NULL)
 
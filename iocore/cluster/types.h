@@ -23,13 +23,26 @@
 #define MAGIC_NUMBER        0x3308
 #define MAX_MSG_LENGTH      (4 * 1024 * 1024)
 
-#define MAX_MACHINE_COUNT        255   //IMPORTANT: can't be 256!!
+//the machine table size is g_max_machine_count (global.h)
 
 //combine multi msg to call writev
 #define WRITEV_ARRAY_SIZE   128
 #define WRITEV_ITEM_ONCE    (WRITEV_ARRAY_SIZE / 2)
 #define WRITE_MAX_COMBINE_BYTES  (64 * 1024)
 
+//a message body larger than this that does not fit in the rest of the
+//read buffer is read into a buffer of its own, so it reaches the dealer
+//as one block, as long as no more than LARGE_MSG_MAX_MOVE_BYTES of it
+//were already read (and must be moved)
+#define LARGE_MSG_MIN_LENGTH      (32 * 1024)
+#define LARGE_MSG_MAX_MOVE_BYTES  (16 * 1024)
+
+//compressed message: func_id | FUNC_ID_COMPRESSED_FLAG, the body is the
+//uncompressed length (int) followed by the fastlz compressed data. only
+//sent to machines whose msg_proto_minor >= CLUSTER_COMPRESS_MINOR_VERSION
+#define FUNC_ID_COMPRESSED_FLAG   0x40000000
+#define COMPRESS_HEADER_LENGTH    ((int)sizeof(int))
+
 #define CONNECT_TYPE_CLIENT  'C'  //connect by me, client
 #define CONNECT_TYPE_SERVER  'S'  //connect by peer, server
 
@@ -143,12 +156,13 @@ typedef struct socket_context {
 
   int queue_index;  //current deal queue index
   int connect_type;       //client or server
+  int writable;           //false after a short write, until EPOLLOUT
   time_t connected_time;  //connection established timestamp
   uint32_t version;    //avoid CAS ABA
 
   int ping_fail_count;    //ping fail counter
   int64_t next_ping_time; //next time to send ping message
-  int64_t next_write_time; //next time to send data
+  int64_t next_write_time; //next time to send data, for flow control
   int64_t ping_start_time;
 
 #ifdef USE_MULTI_ALLOCATOR
@@ -180,11 +194,15 @@ struct SocketStats {
   int64_t enqueue_in_msg_bytes; //push into in msg queue
   int64_t dequeue_in_msg_bytes; //pop from in msg queue
 
+  int64_t recv_large_msg_count;  //read into a buffer of their own
+
   int64_t call_read_count;
   int64_t epoll_wait_count;
   int64_t epoll_wait_time_used;
-  int64_t loop_usleep_count;
-  int64_t loop_usleep_time;
+  int64_t loop_busy_time;    //time used out of epoll_wait
+  int64_t notify_count;      //wakeups by push_to_send_queue
+  int64_t writable_count;    //EPOLLOUT edges
+  int64_t cpu_time_used;     //thread cpu time
 
   int64_t ping_total_count;
   int64_t ping_success_count;
@@ -194,6 +212,8 @@ struct SocketStats {
 struct worker_thread_context
 {
 	int epoll_fd;
+  int notify_fd;          //eventfd, wakes up epoll_wait for new messages
+  volatile int notify_pending;  //notify_fd written and not yet consumed
 	int alloc_size;         //for epoll events
 	int thread_index;       //my thread index
   int active_sock_count;
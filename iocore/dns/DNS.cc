@@ -1190,7 +1190,9 @@ dns_result(DNSHandler *h, DNSEntry *e, HostEnt *ent, bool retry) {
     if (!ent) {
       DNS_SUM_DYN_STAT(dns_fail_time_stat, ink_get_hrtime() - e->submit_time);
     } else {
-      DNS_SUM_DYN_STAT(dns_success_time_stat, ink_get_hrtime() - e->submit_time);
+      ink_hrtime lookup_time = ink_get_hrtime() - e->submit_time;
+      DNS_SUM_DYN_STAT(dns_success_time_stat, lookup_time);
+      DNS_RECORD_HIST(dns_lookup_hist, lookup_time);
     }
   }
   h->entries.remove(e);
@@ -1621,6 +1623,7 @@ Lerror:;
 
 
 RecRawStatBlock *dns_rsb;
+RecHistogramBlock *dns_rhb;
 
 void
 ink_dns_init(ModuleVersion v)
@@ -1637,6 +1640,7 @@ ink_dns_init(ModuleVersion v)
   // do one time stuff
   // create a stat block for HostDBStats
   dns_rsb = RecAllocateRawStatBlock((int) DNS_Stat_Count);
+  dns_rhb = RecAllocateHistogramBlock((int) DNS_Hist_Count);
 
   //
   // Register statistics callbacks
@@ -1653,6 +1657,8 @@ ink_dns_init(ModuleVersion v)
                      "proxy.process.dns.success_avg_time",
                      RECD_INT, RECP_NON_PERSISTENT, (int) dns_success_time_stat, RecRawStatSyncHrTimeAvg);
 
+  RecRegisterHistogram(dns_rhb, RECT_PROCESS, "proxy.process.dns.lookup_usecs", (int) dns_lookup_hist);
+
   RecRegisterRawStat(dns_rsb, RECT_PROCESS,
                      "proxy.process.dns.lookup_successes",
                      RECD_INT, RECP_NULL, (int) dns_lookup_success_stat, RecRawStatSyncSum);
@@ -109,8 +109,17 @@ enum DNS_Stats
 struct HostEnt;
 struct DNSHandler;
 
+// Latency histograms, in microseconds
+enum DNS_Histograms
+{
+  dns_lookup_hist,              // successful lookups, submit to answer
+  DNS_Hist_Count
+};
+
 struct RecRawStatBlock;
 extern RecRawStatBlock *dns_rsb;
+struct RecHistogramBlock;
+extern RecHistogramBlock *dns_rhb;
 
 // Stat Macros
 
@@ -126,6 +135,9 @@ extern RecRawStatBlock *dns_rsb;
 #define DNS_SUM_DYN_STAT(_x, _r)                                  \
   RecIncrRawStatSum(dns_rsb, mutex->thread_holding, (int)_x, _r)
 
+#define DNS_RECORD_HIST(_x, _t)                                  \
+  RecRecordHistogram(dns_rhb, mutex->thread_holding, (int)_x, ink_hrtime_to_usec(_t))
+
 #define DNS_READ_DYN_STAT(_x, _count, _sum) do {    \
     RecGetRawStatSum(dns_rsb, (int)_x, &_sum);      \
     RecGetRawStatCount(dns_rsb, (int)_x, &_count);  \
@@ -44,4 +44,14 @@ ink_event_system_init(ModuleVersion v)
   if (default_large_iobuffer_size > max_iobuffer_size)
     default_large_iobuffer_size = max_iobuffer_size;
   init_buffer_allocators();
+
+  IOCORE_ReadConfigInteger(eventProcessor.thread_affinity, "proxy.config.exec_thread.affinity");
+  IOCORE_ReadConfigInteger(eventProcessor.load_aware, "proxy.config.exec_thread.load_aware");
+#if !defined(linux)
+  if (eventProcessor.thread_affinity) {
+    Warning("proxy.config.exec_thread.affinity is not supported on this platform");
+    eventProcessor.thread_affinity = 0;
+  }
+#endif
+  eventProcessor.sample_load = true;
 }
@@ -342,6 +342,15 @@ public:
   ink_sem *eventsem;            // For dedicated event thread
 
   SessionBucket* l1_hash;
+
+  // Load accounting, EventProcessor samples it once a second
+  volatile ink_hrtime idle_time;        // waiting for work, since the start
+  volatile int utilization;             // busy per mille over the last sample
+  volatile int64_t stolen_events;       // taken from the other threads of the group
+  int steal_type;                       // thread agnostic group, -1 if none
+
+  bool steal_work();
+  bool is_less_loaded(EThread *t);
 };
 
 /**
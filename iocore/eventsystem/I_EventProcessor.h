@@ -314,9 +314,30 @@ public:
   Event * schedule(Event * e, EventType etype, bool fast_signal = false);
   EThread *assign_thread(EventType etype);
 
+  /**
+    Declares the continuations scheduled on the event type as thread
+    agnostic: they have their own mutex and don't keep anything in the
+    thread, so an idle thread of the group may steal their immediate
+    events from a busy one. Call it before scheduling on the type.
+
+  */
+  void set_thread_agnostic(EventType etype);
+  void wake_idle_thread(EventType etype, EThread *busy);
+
+  // Pin the calling event thread to its cpu, or give a thread spawned
+  // by a pinned one the process cpu mask back.
+  void bind_thread(EThread *t);
+  void unbind_thread();
+
   EThread *all_dthreads[MAX_EVENT_THREADS];
   int n_dthreads;               // No. of dedicated threads
   volatile int thread_data_used;
+
+  // Thread placement, read by ink_event_system_init()
+  int thread_affinity;          // pin the event threads to the cpus
+  int load_aware;               // assign_thread() looks at the thread load
+  bool sample_load;             // sample the utilization, with stats
+  bool thread_agnostic_for_type[MAX_EVENT_TYPES];
 };
 
 extern inkcoreapi class EventProcessor eventProcessor;
@@ -29,6 +29,9 @@
   (2). In case the queue is empty, dequeue() sleeps for a specified
        amount of time, or until a new element is inserted, whichever
        is earlier
+  (3). Events of thread agnostic continuations go to a shared queue
+       under the mutex, the other threads of the group can steal()
+       them while the owner is busy.
 
 
  ****************************************************************************/
@@ -46,11 +49,18 @@ struct ProtectedQueue
   void remove(Event * e);
   Event *dequeue_local();
   void dequeue_timed(ink_hrtime cur_time, ink_hrtime timeout, bool sleep);
+  void enqueue_shared(Event * e);
+  Event *steal();               // Non blocking, from the other threads of the group
+  int depth();                  // Events waiting to be dequeued
 
   InkAtomicList al;
   ink_mutex lock;
   ink_cond might_have_data;
   Que(Event, link) localQueue;
+  Que(Event, link) sharedQueue; // Protected by the lock
+  volatile int n_pending;       // In al, not dequeued yet
+  volatile int n_shared;
+  volatile int waiting;         // The owner sleeps on might_have_data
 
   ProtectedQueue();
 };
@@ -35,6 +35,7 @@
 
 TS_INLINE
 ProtectedQueue::ProtectedQueue()
+  : n_pending(0), n_shared(0), waiting(0)
 {
   Event e;
   ink_mutex_init(&lock, "ProtectedQueue");
@@ -73,11 +74,19 @@ ProtectedQueue::enqueue_local(Event * e)
   localQueue.enqueue(e);
 }
 
+TS_INLINE int
+ProtectedQueue::depth()
+{
+  return n_pending + n_shared;
+}
+
 TS_INLINE void
 ProtectedQueue::remove(Event * e)
 {
   ink_assert(e->in_the_prot_queue);
-  if (!ink_atomiclist_remove(&al, e))
+  if (ink_atomiclist_remove(&al, e))
+    ink_atomic_increment(&n_pending, -1);
+  else
     localQueue.remove(e);
   e->in_the_prot_queue = 0;
 }
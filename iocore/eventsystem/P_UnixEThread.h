@@ -170,6 +170,19 @@ EThread::free_event(Event * e)
   EVENT_FREE(e, eventAllocator, this);
 }
 
+// The backlog first, it is what delays the next event, then how busy
+// the thread was lately.
+TS_INLINE bool
+EThread::is_less_loaded(EThread *t)
+{
+  int depth = EventQueueExternal.depth();
+  int t_depth = t->EventQueueExternal.depth();
+
+  if (depth != t_depth)
+    return depth < t_depth;
+  return utilization < t->utilization;
+}
+
 #if defined(USE_OLD_EVENTFD)
 TS_INLINE int
 EThread::getEventFd()
@@ -33,12 +33,16 @@ EventProcessor::EventProcessor():
 n_ethreads(0),
 n_thread_groups(0),
 n_dthreads(0),
-thread_data_used(0)
+thread_data_used(0),
+thread_affinity(0),
+load_aware(0),
+sample_load(false)
 {
   memset(all_ethreads, 0, sizeof(all_ethreads));
   memset(all_dthreads, 0, sizeof(all_dthreads));
   memset(n_threads_for_type, 0, sizeof(n_threads_for_type));
   memset(next_thread_for_type, 0, sizeof(next_thread_for_type));
+  memset(thread_agnostic_for_type, 0, sizeof(thread_agnostic_for_type));
 }
 
 TS_INLINE off_t
@@ -64,9 +68,18 @@ EventProcessor::assign_thread(EventType etype)
   int next;
 
   ink_assert(etype < MAX_EVENT_TYPES);
-  if (n_threads_for_type[etype] > 1)
-    next = next_thread_for_type[etype]++ % n_threads_for_type[etype];
-  else
+  int n = n_threads_for_type[etype];
+  if (n > 1) {
+    unsigned int r = next_thread_for_type[etype]++;
+    next = r % n;
+    if (load_aware) {
+      // Two choices: the round robin pick or a pseudo random other
+      // thread of the group, whichever is less loaded.
+      int other = (next + 1 + ((r * 2654435761U) >> 16) % (n - 1)) % n;
+      if (eventthread[etype][other]->is_less_loaded(eventthread[etype][next]))
+        next = other;
+    }
+  } else
     next = 0;
   return (eventthread[etype][next]);
 }
@@ -76,9 +89,16 @@ EventProcessor::schedule(Event * e, EventType etype, bool fast_signal)
 {
   ink_assert(etype < MAX_EVENT_TYPES);
   e->ethread = assign_thread(etype);
-  if (e->continuation->mutex)
+  if (e->continuation->mutex) {
     e->mutex = e->continuation->mutex;
-  else
+    // the continuation doesn't need this thread, anybody in the group may run it
+    if (thread_agnostic_for_type[etype] && e->immediate) {
+      e->ethread->EventQueueExternal.enqueue_shared(e);
+      if (!e->ethread->EventQueueExternal.waiting)
+        wake_idle_thread(etype, e->ethread);
+      return e;
+    }
+  } else
     e->mutex = e->continuation->mutex = e->ethread->mutex;
   e->ethread->EventQueueExternal.enqueue(e, fast_signal);
   return e;
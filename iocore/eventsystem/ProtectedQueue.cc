@@ -50,6 +50,7 @@ ProtectedQueue::enqueue(Event *e , bool fast_signal)
   ink_assert(!e->in_the_prot_queue && !e->in_the_priority_queue);
   EThread *e_ethread = e->ethread;
   e->in_the_prot_queue = 1;
+  ink_atomic_increment(&n_pending, 1);
   bool was_empty = (ink_atomiclist_push(&al, e) == NULL);
 
   if (was_empty) {
@@ -144,19 +145,35 @@ ProtectedQueue::dequeue_timed(ink_hrtime cur_time, ink_hrtime timeout, bool slee
   Event *e;
   if (sleep) {
     ink_mutex_acquire(&lock);
-    if (INK_ATOMICLIST_EMPTY(al)) {
+    if (INK_ATOMICLIST_EMPTY(al) && !n_shared) {
       timespec ts = ink_based_hrtime_to_timespec(timeout);
+      waiting = 1;
       ink_cond_timedwait(&might_have_data, &lock, &ts);
+      waiting = 0;
     }
     ink_mutex_release(&lock);
   }
 
+  // whatever is left in the shared queue is ours again
+  if (n_shared) {
+    ink_mutex_acquire(&lock);
+    while ((e = sharedQueue.dequeue()))
+      localQueue.enqueue(e);
+    n_shared = 0;
+    ink_mutex_release(&lock);
+  }
+
   e = (Event *) ink_atomiclist_popall(&al);
   // invert the list, to preserve order
+  int n = 0;
   SLL<Event, Event::Link_link> l, t;
   t.head = e;
-  while ((e = t.pop()))
+  while ((e = t.pop())) {
     l.push(e);
+    n++;
+  }
+  if (n)
+    ink_atomic_increment(&n_pending, -n);
   // insert into localQueue
   while ((e = l.pop())) {
     if (!e->cancelled)
@@ -167,3 +184,211 @@ ProtectedQueue::dequeue_timed(ink_hrtime cur_time, ink_hrtime timeout, bool slee
     }
   }
 }
+
+void
+ProtectedQueue::enqueue_shared(Event *e)
+{
+  ink_assert(!e->in_the_prot_queue && !e->in_the_priority_queue);
+  e->in_the_prot_queue = 1;
+  ink_mutex_acquire(&lock);
+  sharedQueue.enqueue(e);
+  n_shared++;
+  if (waiting)
+    ink_cond_signal(&might_have_data);
+  ink_mutex_release(&lock);
+}
+
+Event *
+ProtectedQueue::steal()
+{
+  Event *e = NULL;
+
+  // don't hold up the owner, somebody else has work for it
+  if (n_shared && ink_mutex_try_acquire(&lock)) {
+    if ((e = sharedQueue.dequeue()))
+      n_shared--;
+    ink_mutex_release(&lock);
+  }
+  return e;
+}
+
+#if TS_HAS_TESTS
+#include "ts/TestBox.h"
+
+#define STEAL_TEST_EVENTS               32
+
+static Event *
+protected_queue_test_event(Continuation *c, int index)
+{
+  Event *e = eventAllocator.alloc();
+
+  e->init(c, 0, 0);
+  e->mutex = c->mutex;
+  e->ethread = this_ethread(); // so enqueue() has nobody to signal
+  e->cookie = (void *) (intptr_t) index;
+  return e;
+}
+
+REGRESSION_TEST(ProtectedQueue_depth)(RegressionTest * t, int atype, int * pstatus)
+{
+  NOWARN_UNUSED(atype);
+  TestBox box(t, pstatus);
+  ProtectedQueue q;
+  Continuation c(new_ProxyMutex());
+  Event *events[8];
+  int seen[8] = { 0 };
+  Event *e;
+
+  box = REGRESSION_TEST_PASSED;
+
+  for (int i = 0; i < 4; i++)
+    q.enqueue(events[i] = protected_queue_test_event(&c, i));
+  for (int i = 4; i < 8; i++)
+    q.enqueue_shared(events[i] = protected_queue_test_event(&c, i));
+  box.check(q.depth() == 8, "depth %d after queueing 8 events", q.depth());
+
+  q.remove(events[1]);
+  box.check(q.depth() == 7, "depth %d after removing one", q.depth());
+
+  e = q.steal();
+  box.check(e == events[4], "stole event %p, expected the first shared one %p", e, events[4]);
+  box.check(q.depth() == 6, "depth %d after stealing one", q.depth());
+
+  q.dequeue_timed(ink_get_hrtime(), 0, false);
+  box.check(q.depth() == 0, "depth %d after dequeue", q.depth());
+  box.check(q.steal() == NULL, "stole an event the owner already has");
+
+  while ((e = q.dequeue_local()))
+    seen[(intptr_t) e->cookie]++;
+  for (int i = 0; i < 8; i++)
+    box.check(seen[i] == (i == 1 || i == 4 ? 0 : 1), "event %d dequeued %d times", i, seen[i]);
+
+  for (int i = 0; i < 8; i++) {
+    events[i]->in_the_prot_queue = 0;
+    events[i]->free();
+  }
+}
+
+// Stealing between two running ET_NET threads: the owner queues shared
+// events and stays busy while the test thread steals some of them, then
+// runs the rest itself.  Every event must run once, on the thread that
+// ended up with it.
+struct StealRegressionState
+{
+  RegressionTest *test;
+  int *status;
+  EThread *owner;
+  EThread *thief;
+  Continuation *counter;
+  int stolen;
+  int checks;
+  volatile int queued;
+  volatile int released;
+  volatile int total;
+  volatile int runs_on_thief;
+  volatile int runs[STEAL_TEST_EVENTS];
+};
+
+// One per role, each with a mutex of its own so they don't hold each
+// other up.
+struct StealRegressionContinuation: public Continuation
+{
+  StealRegressionState *s;
+
+  // on the owner, which it keeps busy until the thief is done
+  int queueEvent(int event, Event *e)
+  {
+    NOWARN_UNUSED(event);
+    NOWARN_UNUSED(e);
+    for (int i = 0; i < STEAL_TEST_EVENTS; i++)
+      s->owner->EventQueueExternal.enqueue_shared(protected_queue_test_event(s->counter, i));
+    s->queued = 1;
+    for (int i = 0; i < 1000 && !s->released; i++)
+      usleep(1000);
+    return EVENT_DONE;
+  }
+
+  // on whichever thread ended up with the shared event
+  int countEvent(int event, Event *e)
+  {
+    NOWARN_UNUSED(event);
+    ink_atomic_increment(&s->runs[(intptr_t) e->cookie], 1);
+    if (this_ethread() == s->thief)
+      ink_atomic_increment(&s->runs_on_thief, 1);
+    ink_atomic_increment(&s->total, 1);
+    return EVENT_DONE;
+  }
+
+  // on the thief, every 10ms until the events have run and settled
+  int checkEvent(int event, Event *e)
+  {
+    NOWARN_UNUSED(event);
+    if (s->total < STEAL_TEST_EVENTS && ++s->checks < 500)
+      return EVENT_CONT;
+    if (s->total >= STEAL_TEST_EVENTS && ++s->checks < 10)
+      return EVENT_CONT; // a second run would show up by now
+    e->cancel();
+
+    TestBox box(s->test, s->status);
+    box = REGRESSION_TEST_PASSED;
+    box.check(s->stolen > 0, "nothing was stolen from the owner");
+    box.check(s->runs_on_thief == s->stolen, "%d events ran on the thief, %d were stolen", s->runs_on_thief, s->stolen);
+    for (int i = 0; i < STEAL_TEST_EVENTS; i++)
+      box.check(s->runs[i] == 1, "event %d ran %d times", i, s->runs[i]);
+    box.check(s->owner->EventQueueExternal.depth() == 0, "%d events left in the owner queue",
+              s->owner->EventQueueExternal.depth());
+    return EVENT_DONE;
+  }
+
+  StealRegressionContinuation(StealRegressionState *as, ContinuationHandler h)
+    : Continuation(new_ProxyMutex()), s(as)
+  {
+    handler = h;
+  }
+};
+
+REGRESSION_TEST(ProtectedQueue_steal)(RegressionTest * t, int atype, int * pstatus)
+{
+  NOWARN_UNUSED(atype);
+  StealRegressionState *s;
+  EThread *thief = this_ethread();
+  EThread *owner = NULL;
+
+  for (int i = 0; i < eventProcessor.n_threads_for_type[ET_CALL]; i++) {
+    if (eventProcessor.eventthread[ET_CALL][i] != thief) {
+      owner = eventProcessor.eventthread[ET_CALL][i];
+      break;
+    }
+  }
+  if (!owner || thief->steal_type >= 0) {
+    rprintf(t, "needs two event threads that don't steal work already\n");
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  s = (StealRegressionState *)ats_malloc(sizeof(StealRegressionState));
+  memset((void *) s, 0, sizeof(StealRegressionState));
+  s->test = t;
+  s->status = pstatus;
+  s->owner = owner;
+  s->thief = thief;
+  s->counter = NEW(new StealRegressionContinuation(s, (ContinuationHandler) &StealRegressionContinuation::countEvent));
+
+  owner->schedule_imm(NEW(new StealRegressionContinuation(s, (ContinuationHandler) &StealRegressionContinuation::queueEvent)));
+  for (int i = 0; i < 1000 && !s->queued; i++)
+    usleep(1000);
+
+  // steal_work() hands the events to the loop of this thread, which runs
+  // them once the test returns
+  thief->steal_type = ET_CALL;
+  for (int i = 0; i < STEAL_TEST_EVENTS / 2; i++) {
+    if (thief->steal_work())
+      s->stolen++;
+  }
+  thief->steal_type = -1;
+  s->released = 1;
+
+  thief->schedule_every(NEW(new StealRegressionContinuation(s, (ContinuationHandler) &StealRegressionContinuation::checkEvent)),
+                        HRTIME_MSECONDS(10));
+}
+#endif
@@ -30,7 +30,13 @@ TasksProcessor tasksProcessor;
 int
 TasksProcessor::start(int task_threads)
 {
-  if (task_threads > 0)
+  int work_stealing = 0;
+
+  if (task_threads > 0) {
     ET_TASK = eventProcessor.spawn_event_threads(task_threads, "ET_TASK");
+    REC_ReadConfigInteger(work_stealing, "proxy.config.task_threads.work_stealing");
+    if (work_stealing && task_threads > 1)
+      eventProcessor.set_thread_agnostic(ET_TASK);
+  }
   return 0;
 }
@@ -82,6 +82,7 @@ spawn_thread_internal(void *a)
 
   p->me->set_specific();
   ink_set_thread_name(p->name);
+  eventProcessor.unbind_thread();
   if (p->f)
     p->f(p->a);
   else
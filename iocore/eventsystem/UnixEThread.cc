@@ -47,7 +47,8 @@ EThread::EThread()
    main_accept_index(-1),
    id(NO_ETHREAD_ID), event_types(0),
    signal_hook(0),
-   tt(REGULAR), eventsem(NULL)
+   tt(REGULAR), eventsem(NULL),
+   idle_time(0), utilization(0), stolen_events(0), steal_type(-1)
 {
   memset(thread_private, 0, PER_THREAD_DATA);
 }
@@ -62,7 +63,11 @@ EThread::EThread(ThreadType att, int anid)
     signal_hook(0),
     tt(att),
     eventsem(NULL),
-    l1_hash(NULL)
+    l1_hash(NULL),
+    idle_time(0),
+    utilization(0),
+    stolen_events(0),
+    steal_type(-1)
 {
   ethreads_to_be_signalled = (EThread **)ats_malloc(MAX_EVENT_THREADS * sizeof(EThread *));
   memset((char *) ethreads_to_be_signalled, 0, MAX_EVENT_THREADS * sizeof(EThread *));
@@ -95,7 +100,8 @@ EThread::EThread(ThreadType att, Event * e, ink_sem * sem)
    main_accept_index(-1),
    id(NO_ETHREAD_ID), event_types(0),
    signal_hook(0),
-   tt(att), oneevent(e), eventsem(sem)
+   tt(att), oneevent(e), eventsem(sem),
+   idle_time(0), utilization(0), stolen_events(0), steal_type(-1)
 {
   ink_assert(att == DEDICATED);
   memset(thread_private, 0, PER_THREAD_DATA);
@@ -125,6 +131,29 @@ EThread::set_event_type(EventType et)
   event_types |= (1 << (int) et);
 }
 
+// Take one immediate event from a busy thread of our group, it is run
+// by the next round of the loop.
+bool
+EThread::steal_work()
+{
+  int n = eventProcessor.n_threads_for_type[steal_type];
+  int start = generator.random() % n;
+  Event *e;
+
+  for (int i = 0; i < n; i++) {
+    EThread *t = eventProcessor.eventthread[steal_type][(start + i) % n];
+    if (t == this || !t->EventQueueExternal.n_shared)
+      continue;
+    if ((e = t->EventQueueExternal.steal())) {
+      e->ethread = this;
+      EventQueueExternal.localQueue.enqueue(e);
+      stolen_events++;
+      return true;
+    }
+  }
+  return false;
+}
+
 void
 EThread::process_event(Event * e, int calling_code)
 {
@@ -180,6 +209,8 @@ EThread::execute() {
       Que(Event, link) NegativeQueue;
       ink_hrtime next_time = 0;
 
+      eventProcessor.bind_thread(this);
+
       // give priority to immediate events
       for (;;) {
         // execute all the available external events that have
@@ -229,7 +260,7 @@ EThread::execute() {
           // dequeue all the external events and put them in a local
           // queue. If there are no external events available, don't
           // do a cond_timedwait.
-          if (!INK_ATOMICLIST_EMPTY(EventQueueExternal.al))
+          if (!INK_ATOMICLIST_EMPTY(EventQueueExternal.al) || EventQueueExternal.n_shared)
             EventQueueExternal.dequeue_timed(cur_time, next_time, false);
           while ((e = EventQueueExternal.dequeue_local())) {
             if (!e->timeout_at)
@@ -278,7 +309,11 @@ EThread::execute() {
           // cond_timedwait.
           if (n_ethreads_to_be_signalled)
             flush_signals(this);
+          if (steal_type >= 0 && INK_ATOMICLIST_EMPTY(EventQueueExternal.al) && steal_work())
+            continue;
+          ink_hrtime idle_start = ink_get_hrtime_internal();
           EventQueueExternal.dequeue_timed(cur_time, next_time, true);
+          idle_time += ink_get_hrtime_internal() - idle_start;
         }
       }
     }
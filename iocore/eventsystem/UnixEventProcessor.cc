@@ -22,6 +22,98 @@
  */
 
 #include "P_EventSystem.h"      /* MAGIC_EDITING_TAG */
+#if defined(linux)
+#include <sched.h>
+#endif
+
+#define LOAD_SAMPLE_PERIOD              HRTIME_SECONDS(1)
+
+// for the stat names: ET_SSL_CRYPTO -> ssl_crypto
+static char *thread_group_names[MAX_EVENT_TYPES];
+
+#if defined(linux)
+static cpu_set_t process_cpus;
+#endif
+
+static void
+set_thread_group_name(EventType etype, const char *et_name)
+{
+  char *name;
+
+  if (strncmp(et_name, "ET_", 3) == 0)
+    et_name += 3;
+  name = ats_strdup(et_name);
+  for (char *p = name; *p; p++)
+    *p = ParseRules::ink_tolower(*p);
+  thread_group_names[etype] = name;
+}
+
+// Turns the idle time the threads account for into their utilization,
+// assign_thread() uses it and it is exported as
+// proxy.process.exec_thread.<group>.<n>.utilization (percent) and
+// proxy.process.exec_thread.<group>.<n>.stolen_events
+struct EThreadLoadSampler: public Continuation
+{
+  ink_hrtime last_time;
+  ink_hrtime last_idle[MAX_EVENT_THREADS];
+  char *utilization_names[MAX_EVENT_THREADS];
+  char *stolen_names[MAX_EVENT_THREADS];
+
+  void register_thread(EThread *t, EventType etype, int index)
+  {
+    char name[256];
+
+    snprintf(name, sizeof(name), "proxy.process.exec_thread.%s.%d.utilization", thread_group_names[etype], index);
+    RecRegisterStatInt(RECT_PROCESS, name, 0, RECP_NON_PERSISTENT);
+    utilization_names[t->id] = ats_strdup(name);
+    snprintf(name, sizeof(name), "proxy.process.exec_thread.%s.%d.stolen_events", thread_group_names[etype], index);
+    RecRegisterStatInt(RECT_PROCESS, name, 0, RECP_NON_PERSISTENT);
+    stolen_names[t->id] = ats_strdup(name);
+    last_idle[t->id] = t->idle_time;
+  }
+
+  int sample(int event, Event *e)
+  {
+    NOWARN_UNUSED(event);
+    NOWARN_UNUSED(e);
+    ink_hrtime now = ink_get_hrtime_internal();
+    ink_hrtime elapsed = now - last_time;
+
+    if (elapsed <= 0)
+      return EVENT_CONT;
+    last_time = now;
+
+    for (int g = 0; g < eventProcessor.n_thread_groups; g++) {
+      for (int i = 0; i < eventProcessor.n_threads_for_type[g]; i++) {
+        EThread *t = eventProcessor.eventthread[g][i];
+        if (!utilization_names[t->id]) {
+          register_thread(t, (EventType) g, i);
+          continue;
+        }
+        ink_hrtime idle = t->idle_time;
+        int64_t busy = (elapsed - (idle - last_idle[t->id])) * 1000 / elapsed;
+        last_idle[t->id] = idle;
+        if (busy < 0)
+          busy = 0;
+        else if (busy > 1000)
+          busy = 1000;
+        t->utilization = (int) busy;
+        RecSetRecordInt(utilization_names[t->id], busy / 10);
+        RecSetRecordInt(stolen_names[t->id], t->stolen_events);
+      }
+    }
+    return EVENT_CONT;
+  }
+
+  EThreadLoadSampler()
+    : Continuation(new_ProxyMutex()), last_time(ink_get_hrtime_internal())
+  {
+    memset(last_idle, 0, sizeof(last_idle));
+    memset(utilization_names, 0, sizeof(utilization_names));
+    memset(stolen_names, 0, sizeof(stolen_names));
+    SET_HANDLER(&EThreadLoadSampler::sample);
+  }
+};
 
 
 
@@ -46,6 +138,7 @@ EventProcessor::spawn_event_threads(int n_threads, const char* et_name)
   }
 
   n_threads_for_type[new_thread_group_id] = n_threads;
+  set_thread_group_name(new_thread_group_id, et_name);
   for (i = 0; i < n_threads; i++) {
     snprintf(thr_name, MAX_THREAD_NAME_LENGTH, "[%s %d]", et_name, i);
     eventthread[new_thread_group_id][i]->start(thr_name);
@@ -94,15 +187,91 @@ EventProcessor::start(int n_event_threads)
     t->set_event_type((EventType) ET_CALL);
   }
   n_threads_for_type[ET_CALL] = n_event_threads;
+  set_thread_group_name(ET_CALL, "ET_NET");
+
+#if defined(linux)
+  // the threads we spawn get it back from bind/unbind_thread()
+  if (thread_affinity && sched_getaffinity(0, sizeof(process_cpus), &process_cpus) != 0) {
+    Warning("unable to get the cpu affinity, event threads won't be pinned: %s", strerror(errno));
+    thread_affinity = 0;
+  }
+#endif
+
   for (i = first_thread; i < n_ethreads; i++) {
     snprintf(thr_name, MAX_THREAD_NAME_LENGTH, "[ET_NET %d]", i);
     all_ethreads[i]->start(thr_name);
   }
 
+  if (sample_load)
+    schedule_every(NEW(new EThreadLoadSampler), LOAD_SAMPLE_PERIOD, ET_CALL);
+
   Debug("iocore_thread", "Created event thread group id %d with %d threads", ET_CALL, n_event_threads);
   return 0;
 }
 
+void
+EventProcessor::set_thread_agnostic(EventType etype)
+{
+  ink_release_assert(etype < n_thread_groups);
+  for (int i = 0; i < n_threads_for_type[etype]; i++)
+    eventthread[etype][i]->steal_type = etype;
+  thread_agnostic_for_type[etype] = true;
+  Debug("iocore_thread", "Thread group %s is thread agnostic, idle threads steal work", thread_group_names[etype]);
+}
+
+// The thread the event went to is busy, get a sleeping one of the group
+// to steal it.
+void
+EventProcessor::wake_idle_thread(EventType etype, EThread *busy)
+{
+  int n = n_threads_for_type[etype];
+
+  for (int i = 1; i <= n; i++) {
+    EThread *t = eventthread[etype][(busy->id + i) % n];
+    if (t != busy && t->EventQueueExternal.waiting) {
+      t->EventQueueExternal.signal();
+      return;
+    }
+  }
+}
+
+void
+EventProcessor::bind_thread(EThread *t)
+{
+  if (!thread_affinity)
+    return;
+#if defined(linux)
+  int n = CPU_COUNT(&process_cpus);
+  int k, cpu;
+  cpu_set_t set;
+
+  if (n <= 0)
+    return;
+  // the k-th cpu we are allowed on, so a taskset keeps working
+  k = t->id % n;
+  for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &process_cpus) && k-- == 0)
+      break;
+  }
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    Warning("unable to bind event thread %d to cpu %d", t->id, cpu);
+  else
+    Debug("iocore_thread", "Bound event thread %d to cpu %d", t->id, cpu);
+#endif
+}
+
+void
+EventProcessor::unbind_thread()
+{
+  if (!thread_affinity)
+    return;
+#if defined(linux)
+  pthread_setaffinity_np(pthread_self(), sizeof(process_cpus), &process_cpus);
+#endif
+}
+
 void
 EventProcessor::shutdown()
 {
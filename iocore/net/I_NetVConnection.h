@@ -49,7 +49,12 @@ enum NetProtoType
 
 enum NetDataType
 {
-  NET_DATA_ATTRIBUTES = VCONNECTION_NET_DATA_BASE
+  NET_DATA_ATTRIBUTES = VCONNECTION_NET_DATA_BASE,
+  // A connection that carries one request of a framed protocol (a SPDY
+  // stream) has it as an HTTPHdr: get_data() hands it out, set_data()
+  // takes the response header, the body follows with do_io_write().
+  NET_DATA_REQUEST_HDR,
+  NET_DATA_RESPONSE_HDR
 };
 
 /** Holds client options for NetVConnection.
@@ -29,6 +29,48 @@
 
 struct SSLConfigParams;
 struct SSLContextStorage;
+struct SSLCertContext;
+
+typedef SSL_CTX * (*SSLCertContextLoader) (SSLCertContext * cc);
+
+// One ssl_multicert.config line and the SSL_CTX made from it.  With lazy
+// loading the context is only made when a handshake first asks for it,
+// and released again when it falls off the end of the context LRU.  A
+// line that did not change is carried over to the next configuration
+// as is, with its names and its context.
+struct SSLCertContext : public RefCountObj
+{
+  xptr<char> addr;
+  xptr<char> cert;
+  xptr<char> ca;
+  xptr<char> key;
+  xptr<char> ticket_key_filename;
+  int session_ticket_enabled;
+
+  xptr<char> signature;         // the line, to find it in the next configuration
+  time_t mtime;                 // of the certificate and key files
+  Vec<char *> names;            // subject CN and subjectAltNames
+
+  SSL_CTX * volatile ctx;
+  bool lazy;                    // ctx comes and goes through the LRU
+  ink_mutex mutex;              // held while loading ctx
+  LINK(SSLCertContext, lru_link);
+
+  // Switch ssl over to this context, loading it first when needed.
+  // At most max_loaded lazy contexts stay loaded, 0 for no limit.
+  // The load reads the certificate files on the calling net thread
+  // under mutex, so other handshakes for this line block until it is
+  // done.
+  SSL_CTX * select(SSL * ssl, SSLCertContextLoader load, int max_loaded);
+
+  SSLCertContext();
+  explicit SSLCertContext(SSL_CTX * c);
+  virtual ~SSLCertContext();
+
+private:
+  SSLCertContext(const SSLCertContext &);
+  SSLCertContext & operator =(const SSLCertContext &);
+};
 
 struct SSLCertLookup : public ConfigInfo
 {
@@ -37,9 +79,20 @@ struct SSLCertLookup : public ConfigInfo
 
   bool insert(SSL_CTX * ctx, const char * name);
   bool insert(SSL_CTX * ctx, const IpEndpoint& address);
+  bool insert(SSLCertContext * cc, const char * name);
+  bool insert(SSLCertContext * cc, const IpEndpoint& address);
+
+  SSLCertContext * find(const char * name) const;
+  SSLCertContext * find(const IpEndpoint& address) const;
+
+  // The context of a name or address match, NULL if there is none or if
+  // it is not loaded.
   SSL_CTX * findInfoInHash(const char * address) const;
   SSL_CTX * findInfoInHash(const IpEndpoint& address) const;
 
+  // The certificate line with this signature, to reuse it on a reload.
+  SSLCertContext * findSignature(const char * signature) const;
+
   // Return the last-resort default TLS context if there is no name or address match.
   SSL_CTX * defaultContext() const { return ssl_default; }
 
@@ -49,7 +49,8 @@ struct SSLConfigParams : public ConfigInfo
   enum SSL_SESSION_CACHE_MODE
   {
     SSL_SESSION_CACHE_MODE_OFF = 0,
-    SSL_SESSION_CACHE_MODE_SERVER = 1
+    SSL_SESSION_CACHE_MODE_SERVER = 1,
+    SSL_SESSION_CACHE_MODE_SERVER_SHARED = 2
   };
 
   SSLConfigParams();
@@ -69,6 +70,10 @@ struct SSLConfigParams : public ConfigInfo
   int verify_depth;
   int ssl_session_cache;
   int ssl_session_cache_size;
+  int ssl_session_cache_num_buckets;
+  int ssl_session_cache_timeout;
+  char *ssl_session_cache_filename;
+  int ssl_lazy_load;
 
   char *clientCertPath;
   char *clientKeyPath;
@@ -80,6 +85,8 @@ struct SSLConfigParams : public ConfigInfo
   long ssl_ctx_options;
   
   static int ssl_maxrecord;
+  static int ssl_handshake_max_offload;
+  static int ssl_context_cache_size;
 };
 
 /////////////////////////////////////////////////////////////
@@ -62,6 +62,11 @@ public:
 
   static EventType ET_SSL;
 
+  // Threads doing the server handshakes, when handshake_queue_offset
+  // is set; the offset is that of the SSLHandShakeQueue of each thread.
+  static EventType ET_SSL_CRYPTO;
+  static off_t handshake_queue_offset;
+
   //
   // Private
   //
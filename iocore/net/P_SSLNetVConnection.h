@@ -52,6 +52,22 @@
 #endif
 
 class SSLNextProtocolSet;
+class SSLNetVConnection;
+
+// Runs one SSL_accept() of a server handshake on an ET_SSL_CRYPTO
+// thread and brings the result back to the thread of the connection.
+struct SSLHandShakeJob:public Continuation
+{
+  SSLNetVConnection *vc;
+  int ret;
+  int ssl_error;
+  int err;
+
+  int cryptoEvent(int event, Event * e);
+  int completeEvent(int event, Event * e);
+
+  SSLHandShakeJob():Continuation(NULL), vc(NULL), ret(0), ssl_error(SSL_ERROR_NONE), err(0) { }
+};
 
 //////////////////////////////////////////////////////////////////
 //
@@ -74,6 +90,10 @@ public:
   {
     return sslHandShakeComplete;
   };
+  virtual bool getSSLHandShakeOffloaded()
+  {
+    return sslHandShakeOffloaded;
+  };
   void setSSLHandShakeComplete(bool state)
   {
     sslHandShakeComplete = state;
@@ -111,18 +131,52 @@ public:
     return npnEndpoint;
   }
 
+  LINK(SSLNetVConnection, offload_link);
+
+  // What the write side did on this connection: TLS records, plaintext
+  // bytes they carried and SSL_write() calls, retries included.
+  int64_t sslRecordsWritten;
+  int64_t sslRecordBytesWritten;
+  int64_t sslWriteCalls;
+
 private:
   SSLNetVConnection(const SSLNetVConnection &);
   SSLNetVConnection & operator =(const SSLNetVConnection &);
 
+  bool sslOffloadHandShake();
+  void sslHandShakeRetrigger(NetHandler * nh);
+  void sslHandShakeCompleted(SSLHandShakeJob * job);
+  int64_t sslRecordSize();
+
+  friend struct SSLHandShakeJob;
+  friend struct SSLHandShakeOffloadTest;
+
   bool sslHandShakeComplete;
   bool sslClientConnection;
+  bool sslHandShakeOffloaded;   // SSL_accept() is running on a crypto thread
+  bool sslHandShakeQueued;      // waiting for the crypto threads
+  bool sslHandShakeTriggered;   // I/O came in while the handshake was away
+  bool sslHandShakeResult;      // offloadJob holds an SSL_accept() result
+  SSLHandShakeJob offloadJob;
+  char *sslWriteBuf;                    // records assembled from several blocks
+  const char *sslWritePendingData;      // SSL_write() to repeat, as is, after a WANT_WRITE
+  int sslWritePending;
+  int64_t sslDynamicBytes;              // written since the connection was last idle
+  ink_hrtime sslLastWriteTime;
   const SSLNextProtocolSet * npnSet;
   Continuation * npnEndpoint;
 };
 
 typedef int (SSLNetVConnection::*SSLNetVConnHandler) (int, void *);
 
+// Per net thread, the handshakes it has on the crypto threads and the
+// connections waiting for one of them to come back.
+struct SSLHandShakeQueue
+{
+  int inflight;
+  Que(SSLNetVConnection, offload_link) waiting;
+};
+
 extern ClassAllocator<SSLNetVConnection> sslNetVCAllocator;
 
 #endif /* _SSLNetVConnection_h_ */
@@ -0,0 +1,78 @@
+/** @file
+
+  Server side SSL session cache shared by all the SSL contexts
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef __P_SSLSESSIONCACHE_H__
+#define __P_SSLSESSIONCACHE_H__
+
+#include "P_SSLUtils.h"
+
+struct SSLConfigParams;
+
+// The sessions are kept DER encoded in fixed size slots, so the whole
+// cache is one flat segment that can live in a file mapping and survive
+// a restart.  A session id hashes to a bucket, every bucket has its own
+// lock and a small array of slots it scans linearly.  When a bucket is
+// full the session closest to expiring makes room.  Every slot is
+// tagged with the certificate line it was negotiated on and is only
+// handed back to contexts of that line.
+
+#define SSL_SESSION_CACHE_MAGIC         0x53534c43      // "SSLC"
+#define SSL_SESSION_CACHE_VERSION       2
+#define SSL_SESSION_CACHE_DATA_LEN      1024            // sessions with big client certs won't fit
+
+struct SSLSessionSlot
+{
+  int64_t expire;               // absolute time, 0 when the slot is free
+  uint64_t key;                 // of the contexts it may be resumed on
+  uint32_t hash;
+  uint16_t id_len;
+  uint16_t data_len;
+  unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+  unsigned char data[SSL_SESSION_CACHE_DATA_LEN];
+};
+
+struct SSLSessionBucket
+{
+  ink_mutex mutex;
+  char pad[64 - (sizeof(ink_mutex) % 64)];
+};
+
+struct SSLSessionCacheHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  int32_t num_buckets;
+  int32_t slots_per_bucket;
+  int32_t slot_size;
+  int32_t reserved[11];
+};
+
+// Map the shared cache, when it is configured.
+void SSLSessionCacheInit(const SSLConfigParams * params);
+
+// Plug the shared cache into a server context, name is used for the
+// per context stats.  Contexts with the same session id context share
+// their sessions.  Returns false if there is no shared cache.
+bool SSLSessionCacheAttach(SSL_CTX * ctx, const char * name, const unsigned char * sid_ctx, unsigned sid_ctx_len);
+
+#endif /* __P_SSLSESSIONCACHE_H__ */
@@ -32,9 +32,44 @@
 #error Traffic Server requires a OpenSSL library that support threads
 #endif
 
+#include "I_RecProcess.h"
+
 struct SSLConfigParams;
 struct SSLCertLookup;
 
+enum SSL_Stats
+{
+  ssl_session_cache_hit_stat,
+  ssl_session_cache_miss_stat,
+  ssl_session_cache_store_stat,
+  ssl_session_cache_eviction_stat,
+  ssl_session_cache_too_large_stat,
+  ssl_session_cache_lock_contention_stat,
+  ssl_handshake_offloaded_stat,
+  ssl_handshake_offload_queued_stat,
+  ssl_records_written_stat,
+  ssl_records_coalesced_stat,
+  ssl_write_calls_stat,
+  SSL_Stat_Count
+};
+
+enum SSL_Histograms
+{
+  ssl_record_size_hist,                 // bytes, every record written
+  ssl_connection_records_hist,          // records written, per connection
+  ssl_connection_write_calls_hist,      // SSL_write() calls, per connection
+  SSL_Hist_Count
+};
+
+// Per context session cache hit and miss stats follow the global ones.
+#define SSL_SESSION_CACHE_MAX_CTX_STATS 256
+
+extern RecRawStatBlock *ssl_rsb;
+extern RecHistogramBlock *ssl_rhb;
+
+#define SSL_INCREMENT_DYN_STAT(_x) RecIncrRawStat(ssl_rsb, NULL, (int) _x, 1)
+#define SSL_RECORD_HIST(_x, _v) RecRecordHistogram(ssl_rhb, NULL, (int) _x, _v)
+
 // Create a default SSL server context.
 SSL_CTX * SSLDefaultServerContext();
 
@@ -52,6 +87,9 @@ SSL_CTX * SSLInitClientContext(const SSLConfigParams * param);
 // Initialize the SSL library.
 void SSLInitializeLibrary();
 
+// Register the SSL statistics.
+void SSLInitializeStatistics();
+
 // Release SSL_CTX and the associated data
 void SSLReleaseContext(SSL_CTX* ctx);
 
@@ -61,8 +99,10 @@ void SSLError(const char *errStr, bool critical = true);
 // Log a SSL network buffer.
 void SSLDebugBufferPrint(const char * tag, const char * buffer, unsigned buflen, const char * message);
 
-// Load the SSL certificate configuration.
-bool SSLParseCertificateConfiguration(const SSLConfigParams * params, SSLCertLookup * lookup);
+// Load the SSL certificate configuration. Certificate lines that did not change since
+// the previous configuration are taken over from it.
+bool SSLParseCertificateConfiguration(const SSLConfigParams * params, SSLCertLookup * lookup,
+                                      const SSLCertLookup * previous = NULL);
 
 // Return a static string name for a SSL_ERROR constant.
 const char * SSLErrorName(int ssl_error);
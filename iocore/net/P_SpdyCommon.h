@@ -12,10 +12,9 @@
 #include <vector>
 #include <map>
 
-#include "ts/ts.h"
-#include "ts/libts.h"
-#include "ts/ink_port.h"
-#include "ts/experimental.h"
+#include "libts.h"
+#include "P_Net.h"
+#include "HTTP.h"
 #include <spdylay/spdylay.h>
 using namespace std;
 
@@ -55,7 +54,7 @@ struct Config {
 class SpdyNV {
 public:
 
-  SpdyNV(TSFetchSM fetch_sm);
+  SpdyNV(HTTPHdr *hdr);
   ~SpdyNV();
 
 public:
@@ -68,7 +67,7 @@ private:
   char version[64];
 };
 
-string http_date(time_t t);
+char *http_date(time_t t, char *buf, size_t len);
 int spdy_config_load();
 
 extern Config SPDY_CFG;
@@ -0,0 +1,107 @@
+#ifndef __P_SPDY_STREAM_H__
+#define __P_SPDY_STREAM_H__
+
+#include "P_SpdyCommon.h"
+
+class SpdySM;
+
+//
+// One SPDY stream seen as a connection of its own, so that a regular
+// HttpClientSession and HttpSM can run it. The request is handed out
+// already parsed with get_data(NET_DATA_REQUEST_HDR), the response
+// header comes in with set_data(NET_DATA_RESPONSE_HDR) and goes out as
+// the SYN_REPLY, the bodies move through the read and write VIOs.
+//
+// A stream shares the mutex of its session. It is freed once both the
+// user has closed it and spdylay is done with it.
+//
+class SpdyStream : public NetVConnection
+{
+public:
+  SpdyStream();
+
+  void init(SpdySM *spdy_sm, int32_t id);
+  bool request_init(char **nv, bool fin);
+  void destroy();
+
+  // Called by the session
+  void recv_data(const uint8_t *data, size_t len);
+  void recv_end();
+  void stream_closed(bool reset);
+  ssize_t send_body(uint8_t *buf, size_t length, int *eof);
+
+  int main_handler(int event, void *data);
+
+  virtual VIO *do_io_read(Continuation * c, int64_t nbytes, MIOBuffer * buf);
+  virtual VIO *do_io_write(Continuation * c, int64_t nbytes, IOBufferReader * buf, bool owner = false);
+  virtual void do_io_close(int lerrno = -1);
+  virtual void do_io_shutdown(ShutdownHowTo_t howto);
+  virtual void reenable(VIO * vio);
+  virtual void reenable_re(VIO * vio);
+
+  virtual void set_active_timeout(ink_hrtime timeout_in);
+  virtual void set_inactivity_timeout(ink_hrtime timeout_in);
+  virtual void cancel_active_timeout();
+  virtual void cancel_inactivity_timeout();
+  virtual ink_hrtime get_active_timeout();
+  virtual ink_hrtime get_inactivity_timeout();
+
+  virtual void set_flow_ctl(int op, uint64_t flowctr = 0);
+  virtual void cancel_flow_ctl(int op);
+  virtual void apply_options();
+  virtual SOCKET get_socket();
+  virtual int set_tcp_init_cwnd(int init_cwnd);
+  virtual void set_local_addr();
+  virtual void set_remote_addr();
+
+  virtual bool get_data(int id, void *data);
+  virtual bool set_data(int id, void *data);
+
+public:
+  SpdySM *sm;
+  int32_t stream_id;
+  HTTPHdr request;
+
+private:
+  void process_read();
+  void process_write();
+  void process_timeout(Event ** our_eptr, int event_to_send);
+  void update_inactive_time();
+  void setup_event_cb();
+  void resume_send();
+  void credit_window(int64_t len);
+
+  VIO read_vio;
+  VIO write_vio;
+
+  // DATA frames wait here until the read VIO has room for them, the
+  // window is only credited back once they have moved on.
+  MIOBuffer *recv_buffer;
+  IOBufferReader *recv_reader;
+  int64_t recv_window_consumed;
+
+  ink_hrtime active_timeout;
+  ink_hrtime inactive_timeout;
+  Event *event;
+  Event *active_event;
+  Event *inactive_event;
+  int recursion;
+
+  bool recv_chunked;
+  bool recv_fin;
+  bool recv_trailer_sent;
+  bool read_shutdown;
+  bool write_shutdown;
+  bool reply_submitted;
+  bool send_deferred;
+  bool send_fin;
+  bool need_read;
+  bool need_write;
+  bool closed;
+  bool spdy_closed;
+  bool spdy_reset;
+};
+
+extern ClassAllocator<SpdyStream> spdyStreamAllocator;
+
+#endif
@@ -201,6 +201,9 @@ public:
   virtual bool getSSLHandShakeComplete() {
     return (true);
   }
+  virtual bool getSSLHandShakeOffloaded() {
+    return (false);
+  }
   virtual bool getSSLClientConnection()
   {
     return (false);
@@ -29,7 +29,7 @@
 #include "I_EventSystem.h"
 #include "I_Layout.h"
 #include "Regex.h"
-#include "Trie.h"
+#include "ParseRules.h"
 #include "ts/TestBox.h"
 
 struct SSLAddressLookupKey
@@ -73,25 +73,150 @@ struct SSLContextStorage
   SSLContextStorage();
   ~SSLContextStorage();
 
-  bool insert(SSL_CTX * ctx, const char * name);
-  SSL_CTX * lookup(const char * name) const;
+  bool insert(SSLCertContext * cc, const char * name);
+  SSLCertContext * lookup(const char * name) const;
+  SSLCertContext * wrap(SSL_CTX * ctx);
+  SSLCertContext * signature(const char * sig) const;
 
 private:
-  struct SSLEntry
+  // Names are indexed by their reversed labels.  There is a node for
+  // every label boundary of every name: "www.example.com" makes "com",
+  // "com.example" and "com.example.www".  A lookup goes down one label at
+  // a time and stops at the first prefix that has no node, remembering
+  // the deepest wildcard it went through.
+  struct SSLNameNode
   {
-    explicit SSLEntry(SSL_CTX * c) : ctx(c) {}
+    SSLCertContext * exact;
+    SSLCertContext * wildcard;  // "*." this name
+  };
 
-    void Print() const { Debug("ssl", "SSLEntry=%p SSL_CTX=%p", this, ctx); }
+  void own(SSLCertContext * cc);
 
-    SSL_CTX * ctx;
-    LINK(SSLEntry, link);
-  };
+  InkHashTable *  nodes;
+  InkHashTable *  owned;        // SSLCertContext pointers we hold a reference on
+  InkHashTable *  contexts;     // SSL_CTX pointers inserted as such
+  InkHashTable *  signatures;
+  Vec<SSLCertContext *> references;
+};
 
-  Trie<SSLEntry>  wildcards;
-  InkHashTable *  hostnames;
-  Vec<SSL_CTX *>  references;
+// Lazily loaded contexts, the most recently used first.  The lock also
+// covers SSLCertContext::ctx of the contexts that are on the list.
+struct SSLContextLRU
+{
+  SSLContextLRU() : count(0) {
+    ink_mutex_init(&mutex, "SSLContextLRU");
+  }
+
+  ink_mutex mutex;
+  Que(SSLCertContext, lru_link) list;
+  int count;
 };
 
+static SSLContextLRU ssl_context_lru;
+
+SSLCertContext::SSLCertContext()
+  : session_ticket_enabled(-1), mtime(0), ctx(NULL), lazy(false)
+{
+  ink_mutex_init(&mutex, "SSLCertContext");
+}
+
+SSLCertContext::SSLCertContext(SSL_CTX * c)
+  : session_ticket_enabled(-1), mtime(0), ctx(c), lazy(false)
+{
+  ink_mutex_init(&mutex, "SSLCertContext");
+}
+
+SSLCertContext::~SSLCertContext()
+{
+  if (this->lazy) {
+    ink_mutex_acquire(&ssl_context_lru.mutex);
+    if (this->ctx) {
+      ssl_context_lru.list.remove(this);
+      ssl_context_lru.count--;
+    }
+    ink_mutex_release(&ssl_context_lru.mutex);
+  }
+
+  if (this->ctx) {
+    SSLReleaseContext(this->ctx);
+  }
+
+  for (int i = 0; i < this->names.count(); ++i) {
+    ats_free(this->names[i]);
+  }
+
+  ink_mutex_destroy(&this->mutex);
+}
+
+SSL_CTX *
+SSLCertContext::select(SSL * ssl, SSLCertContextLoader load, int max_loaded)
+{
+  SSL_CTX * c;
+  SSL_CTX * loaded = NULL;
+  Vec<SSL_CTX *> evicted;
+
+  if (!this->lazy) {
+    if ((c = this->ctx) != NULL) {
+      SSL_set_SSL_CTX(ssl, c);
+    }
+    return c;
+  }
+
+  // SSL_set_SSL_CTX() takes its own reference on the context, doing it
+  // under the LRU lock keeps an eviction from releasing it under us.
+  ink_mutex_acquire(&ssl_context_lru.mutex);
+  if ((c = this->ctx) != NULL) {
+    ssl_context_lru.list.remove(this);
+    ssl_context_lru.list.push(this);
+    SSL_set_SSL_CTX(ssl, c);
+  }
+  ink_mutex_release(&ssl_context_lru.mutex);
+  if (c) {
+    return c;
+  }
+
+  // Only one thread loads a context, the others wait for it.
+  ink_mutex_acquire(&this->mutex);
+  for (;;) {
+    ink_mutex_acquire(&ssl_context_lru.mutex);
+    if ((c = this->ctx) != NULL) {
+      ssl_context_lru.list.remove(this);
+      ssl_context_lru.list.push(this);
+    } else if (loaded) {
+      c = this->ctx = loaded;
+      loaded = NULL;
+      ssl_context_lru.list.push(this);
+      ssl_context_lru.count++;
+      while (max_loaded > 0 && ssl_context_lru.count > max_loaded && ssl_context_lru.list.tail != this) {
+        SSLCertContext * victim = ssl_context_lru.list.tail;
+        ssl_context_lru.list.remove(victim);
+        ssl_context_lru.count--;
+        evicted.push_back(victim->ctx);
+        victim->ctx = NULL;
+      }
+    }
+    if (c) {
+      SSL_set_SSL_CTX(ssl, c);
+    }
+    ink_mutex_release(&ssl_context_lru.mutex);
+
+    if (c || (loaded = load(this)) == NULL) {
+      break;
+    }
+  }
+  ink_mutex_release(&this->mutex);
+
+  if (loaded) {
+    SSLReleaseContext(loaded);
+  }
+  for (int i = 0; i < evicted.count(); ++i) {
+    Debug("ssl", "evicting SSL_CTX %p from the context LRU", evicted[i]);
+    SSLReleaseContext(evicted[i]);
+  }
+
+  return c;
+}
+
 SSLCertLookup::SSLCertLookup() : ssl_storage(NEW(new SSLContextStorage())), ssl_default(NULL)
 {
 }
@@ -101,20 +226,20 @@ SSLCertLookup::~SSLCertLookup()
   delete this->ssl_storage;
 }
 
-SSL_CTX *
-SSLCertLookup::findInfoInHash(const char * address) const
+SSLCertContext *
+SSLCertLookup::find(const char * address) const
 {
   return this->ssl_storage->lookup(address);
 }
 
-SSL_CTX *
-SSLCertLookup::findInfoInHash(const IpEndpoint& address) const
+SSLCertContext *
+SSLCertLookup::find(const IpEndpoint& address) const
 {
-  SSL_CTX * ctx;
+  SSLCertContext * cc;
   SSLAddressLookupKey key(address);
   // First try the full address.
-  if ((ctx = this->ssl_storage->lookup(key.get()))) {
-    return ctx;
+  if ((cc = this->ssl_storage->lookup(key.get()))) {
+    return cc;
   }
 
   // If that failed, try the address without the port.
@@ -126,17 +251,50 @@ SSLCertLookup::findInfoInHash(const IpEndpoint& address) const
   return NULL;
 }
 
+SSL_CTX *
+SSLCertLookup::findInfoInHash(const char * address) const
+{
+  SSLCertContext * cc = this->find(address);
+  return cc ? cc->ctx : NULL;
+}
+
+SSL_CTX *
+SSLCertLookup::findInfoInHash(const IpEndpoint& address) const
+{
+  SSLCertContext * cc = this->find(address);
+  return cc ? cc->ctx : NULL;
+}
+
+SSLCertContext *
+SSLCertLookup::findSignature(const char * signature) const
+{
+  return this->ssl_storage->signature(signature);
+}
+
 bool
 SSLCertLookup::insert(SSL_CTX * ctx, const char * name)
 {
-  return this->ssl_storage->insert(ctx, name);
+  return this->ssl_storage->insert(this->ssl_storage->wrap(ctx), name);
 }
 
 bool
 SSLCertLookup::insert(SSL_CTX * ctx, const IpEndpoint& address)
 {
   SSLAddressLookupKey key(address);
-  return this->ssl_storage->insert(ctx, key.get());
+  return this->ssl_storage->insert(this->ssl_storage->wrap(ctx), key.get());
+}
+
+bool
+SSLCertLookup::insert(SSLCertContext * cc, const char * name)
+{
+  return this->ssl_storage->insert(cc, name);
+}
+
+bool
+SSLCertLookup::insert(SSLCertContext * cc, const IpEndpoint& address)
+{
+  SSLAddressLookupKey key(address);
+  return this->ssl_storage->insert(cc, key.get());
 }
 
 struct ats_wildcard_matcher
@@ -182,8 +340,11 @@ reverse_dns_name(const char * hostname, char (&reversed)[TS_MAX_HOST_NAME_LEN+1]
       *(--ptr) = '.';
     }
 
+    // Host names are case insensitive, index them in lower case.
     ptr -= len;
-    memcpy(ptr, part, len);
+    for (ssize_t i = 0; i < len; ++i) {
+      ptr[i] = ParseRules::ink_tolower(part[i]);
+    }
 
     // Skip to the next domain component. This will take us to either a '.' or a NUL.
     // If it's a '.' we need to skip over it.
@@ -197,90 +358,170 @@ reverse_dns_name(const char * hostname, char (&reversed)[TS_MAX_HOST_NAME_LEN+1]
 }
 
 SSLContextStorage::SSLContextStorage()
-  :wildcards(), hostnames(ink_hash_table_create(InkHashTableKeyType_String))
+  : nodes(ink_hash_table_create(InkHashTableKeyType_String)),
+    owned(ink_hash_table_create(InkHashTableKeyType_Word)),
+    contexts(ink_hash_table_create(InkHashTableKeyType_Word)),
+    signatures(ink_hash_table_create(InkHashTableKeyType_String))
 {
 }
 
 SSLContextStorage::~SSLContextStorage()
 {
+  // The contexts can outlive us, in the next configuration.
   for (int i = 0; i < this->references.count(); ++i) {
-    SSLReleaseContext(this->references[i]);
+    if (this->references[i]->refcount_dec() == 0) {
+      this->references[i]->free();
+    }
+  }
+
+  ink_hash_table_destroy_and_free_values(this->nodes);
+  ink_hash_table_destroy(this->owned);
+  ink_hash_table_destroy(this->contexts);
+  ink_hash_table_destroy(this->signatures);
+}
+
+void
+SSLContextStorage::own(SSLCertContext * cc)
+{
+  if (ink_hash_table_isbound(this->owned, (const char *)cc)) {
+    return;
   }
 
-  ink_hash_table_destroy(this->hostnames);
+  cc->refcount_inc();
+  this->references.push_back(cc);
+  ink_hash_table_insert(this->owned, (const char *)cc, (void *)cc);
+  if (cc->signature) {
+    ink_hash_table_insert(this->signatures, cc->signature, (void *)cc);
+  }
 }
 
+SSLCertContext *
+SSLContextStorage::wrap(SSL_CTX * ctx)
+{
+  InkHashTableValue value;
+
+  if (ink_hash_table_lookup(this->contexts, (const char *)ctx, &value)) {
+    return (SSLCertContext *)value;
+  }
+
+  SSLCertContext * cc = NEW(new SSLCertContext(ctx));
+  ink_hash_table_insert(this->contexts, (const char *)ctx, (void *)cc);
+  this->own(cc);
+  return cc;
+}
+
+SSLCertContext *
+SSLContextStorage::signature(const char * sig) const
+{
+  InkHashTableValue value;
+
+  if (ink_hash_table_lookup(this->signatures, sig, &value)) {
+    return (SSLCertContext *)value;
+  }
+  return NULL;
+}
 
 bool
-SSLContextStorage::insert(SSL_CTX * ctx, const char * name)
+SSLContextStorage::insert(SSLCertContext * cc, const char * name)
 {
   ats_wildcard_matcher wildcard;
-  bool inserted = true;
-
-  if (wildcard.match(name)) {
-    // We turn wildcards into the reverse DNS form, then insert them into the trie
-    // so that we can do a longest match lookup.
-    char namebuf[TS_MAX_HOST_NAME_LEN + 1];
-    char * reversed;
-    xptr<SSLEntry> entry;
-
-    reversed = reverse_dns_name(name + 2, namebuf);
-    if (!reversed) {
-      Error("wildcard name '%s' is too long", name);
-      return false;
-    }
+  char namebuf[TS_MAX_HOST_NAME_LEN + 1];
+  char * reversed;
+  SSLNameNode * node = NULL;
+  bool is_wildcard = wildcard.match(name);
+
+  // Wildcards are indexed at the node of the name they are a wildcard for.
+  reversed = reverse_dns_name(is_wildcard ? name + 2 : name, namebuf);
+  if (!reversed) {
+    Error("certificate name '%s' is too long", name);
+    return false;
+  }
 
-    Debug("ssl", "indexed wildcard certificate for '%s' as '%s' with SSL_CTX %p", name, reversed, ctx);
-    entry = new SSLEntry(ctx);
-    inserted = this->wildcards.Insert(reversed, entry, 0 /* rank */, -1 /* keylen */);
-    if (inserted) {
-      entry.release();
+  // Make the node, and the nodes of all its prefixes.
+  for (char * end = reversed; ; ++end) {
+    if (*end == '.' || *end == '\0') {
+      InkHashTableEntry * entry;
+      int created;
+      char sep = *end;
+
+      *end = '\0';
+      entry = ink_hash_table_get_entry(this->nodes, reversed, &created);
+      if (created) {
+        node = (SSLNameNode *)ats_malloc(sizeof(SSLNameNode));
+        node->exact = node->wildcard = NULL;
+        ink_hash_table_set_entry(this->nodes, entry, (void *)node);
+      } else {
+        node = (SSLNameNode *)ink_hash_table_entry_value(this->nodes, entry);
+      }
+      *end = sep;
+
+      if (sep == '\0') {
+        break;
+      }
     }
-  } else {
-    Debug("ssl", "indexed '%s' with SSL_CTX %p", name, ctx);
-    ink_hash_table_insert(this->hostnames, name, (void *)ctx);
   }
 
-  // Keep a unique reference to the SSL_CTX, so that we can free it later. Since we index by name, multiple
-  // certificates can be indexed for the same name. If this happens, we will overwrite the previous pointer
-  // and leak a context. So if we insert a certificate, keep an ownership reference to it.
-  if (inserted) {
-    if (this->references.in(ctx) == NULL) {
-      this->references.push_back(ctx);
+  if (is_wildcard) {
+    // The first certificate for a wildcard wins ...
+    if (node->wildcard) {
+      return false;
     }
+    Debug("ssl", "indexed wildcard certificate for '%s' as '%s' with SSL_CTX %p", name, reversed, cc->ctx);
+    node->wildcard = cc;
+  } else {
+    // ... the last one for a host name.
+    Debug("ssl", "indexed '%s' with SSL_CTX %p", name, cc->ctx);
+    node->exact = cc;
   }
 
-  return inserted;
+  this->own(cc);
+  return true;
 }
 
-SSL_CTX *
+SSLCertContext *
 SSLContextStorage::lookup(const char * name) const
 {
-  InkHashTableValue value;
-
-  if (ink_hash_table_lookup(const_cast<InkHashTable *>(this->hostnames), name, &value)) {
-    return (SSL_CTX *)value;
+  char namebuf[TS_MAX_HOST_NAME_LEN + 1];
+  char * reversed;
+  SSLCertContext * match = NULL;
+
+  reversed = reverse_dns_name(name, namebuf);
+  if (!reversed) {
+    Error("failed to reverse hostname name '%s' is too long", name);
+    return NULL;
   }
 
-  if (!this->wildcards.Empty()) {
-    char namebuf[TS_MAX_HOST_NAME_LEN + 1];
-    char * reversed;
-    SSLEntry * entry;
-
-    reversed = reverse_dns_name(name, namebuf);
-    if (!reversed) {
-      Error("failed to reverse hostname name '%s' is too long", name);
-      return NULL;
-    }
+  for (char * end = reversed; ; ++end) {
+    if (*end == '.' || *end == '\0') {
+      InkHashTableValue value;
+      SSLNameNode * node;
+      char sep = *end;
+      int found;
+
+      *end = '\0';
+      found = ink_hash_table_lookup(this->nodes, reversed, &value);
+      *end = sep;
+      if (!found) {
+        break;
+      }
 
-    Debug("ssl", "attempting wildcard match for %s", reversed);
-    entry = this->wildcards.Search(reversed);
-    if (entry) {
-      return entry->ctx;
+      node = (SSLNameNode *)value;
+      if (sep == '\0' && node->exact) {
+        return node->exact;
+      }
+      if (node->wildcard) {
+        match = node->wildcard;
+      }
+      if (sep == '\0') {
+        break;
+      }
     }
   }
 
-  return NULL;
+  if (match) {
+    Debug("ssl", "wildcard match for %s", name);
+  }
+  return match;
 }
 
 #if TS_HAS_TESTS
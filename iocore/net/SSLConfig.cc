@@ -42,6 +42,8 @@
 int SSLConfig::configid = 0;
 int SSLCertificateConfig::configid = 0;
 int SSLConfigParams::ssl_maxrecord = 0;
+int SSLConfigParams::ssl_handshake_max_offload = 0;
+int SSLConfigParams::ssl_context_cache_size = 0;
 
 static Ptr<ProxyMutex> ssl_certificate_mutex = NULL;
 
@@ -54,6 +56,7 @@ SSLConfigParams::SSLConfigParams()
     clientCertPath = clientKeyPath =
     clientCACertFilename = clientCACertPath =
     cipherSuite =
+    ssl_session_cache_filename =
     serverKeyPathOnly = NULL;
 
   clientCertLevel = client_verify_depth = verify_depth = clientVerify = 0;
@@ -61,6 +64,9 @@ SSLConfigParams::SSLConfigParams()
   ssl_ctx_options = 0;
   ssl_session_cache = SSL_SESSION_CACHE_MODE_SERVER;
   ssl_session_cache_size = 1024*20;
+  ssl_session_cache_num_buckets = 256;
+  ssl_session_cache_timeout = 0;
+  ssl_lazy_load = 0;
 }
 
 SSLConfigParams::~SSLConfigParams()
@@ -82,6 +88,7 @@ SSLConfigParams::cleanup()
   ats_free_null(serverCertPathOnly);
   ats_free_null(serverKeyPathOnly);
   ats_free_null(cipherSuite);
+  ats_free_null(ssl_session_cache_filename);
 
   clientCertLevel = client_verify_depth = verify_depth = clientVerify = 0;
 }
@@ -199,10 +206,20 @@ SSLConfigParams::initialize()
   // SSL session cache configurations
   IOCORE_ReadConfigInteger(ssl_session_cache, "proxy.config.ssl.session_cache");
   IOCORE_ReadConfigInteger(ssl_session_cache_size, "proxy.config.ssl.session_cache.size");
+  IOCORE_ReadConfigInt32(ssl_session_cache_num_buckets, "proxy.config.ssl.session_cache.num_buckets");
+  IOCORE_ReadConfigInt32(ssl_session_cache_timeout, "proxy.config.ssl.session_cache.timeout");
+  IOCORE_ReadConfigStringAlloc(ssl_session_cache_filename, "proxy.config.ssl.session_cache.filename");
 
   // SSL record size
   REC_EstablishStaticConfigInt32(ssl_maxrecord, "proxy.config.ssl.max_record_size");
 
+  // Server handshakes in flight on the crypto threads, per net thread
+  REC_EstablishStaticConfigInt32(ssl_handshake_max_offload, "proxy.config.ssl.handshake.max_offload_per_thread");
+
+  // Server contexts made on first use, and how many of them stay loaded
+  IOCORE_ReadConfigInt32(ssl_lazy_load, "proxy.config.ssl.server.lazy_load");
+  REC_EstablishStaticConfigInt32(ssl_context_cache_size, "proxy.config.ssl.server.context_cache.size");
+
   // ++++++++++++++++++++++++ Client part ++++++++++++++++++++
   client_verify_depth = 7;
   IOCORE_ReadConfigInt32(clientVerify, "proxy.config.ssl.client.verify.server");
@@ -302,11 +319,16 @@ SSLCertificateConfig::reconfigure()
 {
   SSLConfig::scoped_config params;
   SSLCertLookup * lookup = NEW(new SSLCertLookup());
+  SSLCertLookup * previous = configid ? acquire() : NULL;
 
-  if (SSLParseCertificateConfiguration(params, lookup)) {
+  if (SSLParseCertificateConfiguration(params, lookup, previous)) {
     configid = configProcessor.set(configid, lookup);
   } else
     delete lookup;
+
+  if (previous) {
+    release(previous);
+  }
 }
 
 SSLCertLookup *
@@ -25,6 +25,7 @@
 #include "I_Layout.h"
 #include "I_RecHttp.h"
 #include "P_SSLUtils.h"
+#include "P_SSLSessionCache.h"
 
 //
 // Global Data
@@ -33,6 +34,8 @@
 SSLNetProcessor   ssl_NetProcessor;
 NetProcessor&     sslNetProcessor = ssl_NetProcessor;
 EventType         SSLNetProcessor::ET_SSL;
+EventType         SSLNetProcessor::ET_SSL_CRYPTO;
+off_t             SSLNetProcessor::handshake_queue_offset = 0;
 
 void
 SSLNetProcessor::cleanup(void)
@@ -46,10 +49,19 @@ SSLNetProcessor::cleanup(void)
 int
 SSLNetProcessor::start(int number_of_ssl_threads)
 {
+  int number_of_crypto_threads = 0;
+
   // This initialization order matters ...
   SSLInitializeLibrary();
+  SSLInitializeStatistics();
   SSLConfig::startup();
 
+  // The shared session cache must be there before the first server context.
+  {
+    SSLConfig::scoped_config params;
+    SSLSessionCacheInit(params);
+  }
+
   if (HttpProxyPort::hasSSL()) {
     SSLCertificateConfig::startup();
   }
@@ -68,6 +80,12 @@ SSLNetProcessor::start(int number_of_ssl_threads)
     return -1;
 
   SSLNetProcessor::ET_SSL = eventProcessor.spawn_event_threads(number_of_ssl_threads, "ET_SSL");
+
+  IOCORE_ReadConfigInteger(number_of_crypto_threads, "proxy.config.ssl.handshake.offload_threads");
+  if (number_of_crypto_threads > 0) {
+    SSLNetProcessor::ET_SSL_CRYPTO = eventProcessor.spawn_event_threads(number_of_crypto_threads, "ET_SSL_CRYPTO");
+    SSLNetProcessor::handshake_queue_offset = eventProcessor.allocate(sizeof(SSLHandShakeQueue));
+  }
   return UnixNetProcessor::start();
 }
 
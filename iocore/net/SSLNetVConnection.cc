@@ -23,6 +23,7 @@
 #include "ink_config.h"
 #include "P_Net.h"
 #include "P_SSLNextProtocolSet.h"
+#include "P_SSLUtils.h"
 
 #define SSL_READ_ERROR_NONE	  0
 #define SSL_READ_ERROR		  1
@@ -322,6 +323,38 @@ SSLNetVConnection::net_read_io(NetHandler *nh, EThread *lthread)
 }
 
 
+// TLS records carry at most 16KB of plaintext.  With the dynamic record
+// size (proxy.config.ssl.max_record_size -1) a connection starts with
+// records that fit in one TCP segment, so the client can decrypt the
+// first bytes without waiting for the rest of a big record, and goes to
+// full size records once it moved enough data for the congestion window
+// to have opened.  After being idle for a while it starts over.
+#define SSL_MAX_TLS_RECORD_SIZE           16384
+#define SSL_DEF_TLS_RECORD_SIZE           1300
+#define SSL_DEF_TLS_RECORD_BYTE_THRESHOLD 1000000
+#define SSL_DEF_TLS_RECORD_MSEC_THRESHOLD 1000
+
+int64_t
+SSLNetVConnection::sslRecordSize()
+{
+  int maxrecord = SSLConfigParams::ssl_maxrecord;
+
+  // TS-2365: a fixed record size
+  if (maxrecord > 0) {
+    return maxrecord < SSL_MAX_TLS_RECORD_SIZE ? maxrecord : SSL_MAX_TLS_RECORD_SIZE;
+  }
+  if (maxrecord == 0) {
+    return SSL_MAX_TLS_RECORD_SIZE;
+  }
+
+  ink_hrtime now = ink_get_hrtime();
+  if (sslLastWriteTime && (now - sslLastWriteTime) > HRTIME_MSECONDS(SSL_DEF_TLS_RECORD_MSEC_THRESHOLD)) {
+    sslDynamicBytes = 0;
+  }
+  sslLastWriteTime = now;
+  return sslDynamicBytes < SSL_DEF_TLS_RECORD_BYTE_THRESHOLD ? SSL_DEF_TLS_RECORD_SIZE : SSL_MAX_TLS_RECORD_SIZE;
+}
+
 int64_t
 SSLNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted, int64_t &total_wrote, MIOBufferAccessor & buf)
 {
@@ -330,28 +363,54 @@ SSLNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted, i
   int64_t l = 0;
   int64_t offset = buf.entry->start_offset;
   IOBufferBlock *b = buf.entry->block;
+  int64_t record_size = sslRecordSize();
 
+  // One SSL_write() per record.  A record that fits in the current block
+  // is encrypted straight from it, one that spans blocks is gathered in
+  // sslWriteBuf first.  After a WANT_WRITE OpenSSL has to get the very
+  // same buffer and length again, whatever the record size is by then.
   do {
-    // check if we have done this block
-    l = b->read_avail();
-    l -= offset;
-    if (l <= 0) {
-      offset = -l;
-      b = b->next;
-      continue;
-    }
-    // check if to amount to write exceeds that in this buffer
-    int64_t wavail = towrite - total_wrote;
-
-    if (l > wavail)
-      l = wavail;
-
-    // TS-2365: If the SSL max record size is set and we have
-    // more data than that, break this into smaller write
-    // operations.
-    int64_t orig_l = l;
-    if (SSLConfigParams::ssl_maxrecord > 0 && l > SSLConfigParams::ssl_maxrecord) {
-        l = SSLConfigParams::ssl_maxrecord;
+    const char *data;
+
+    if (sslWritePending) {
+      data = sslWritePendingData;
+      l = sslWritePending;
+    } else {
+      // skip the blocks we are done with
+      while (b && (l = b->read_avail() - offset) <= 0) {
+        offset = -l;
+        b = b->next;
+      }
+      if (!b)
+        break;
+      // check if to amount to write exceeds that in this buffer
+      int64_t want = towrite - total_wrote;
+      if (want > record_size)
+        want = record_size;
+
+      if (l >= want) {
+        l = want;
+        data = b->start() + offset;
+      } else {
+        if (sslWriteBuf == NULL)
+          sslWriteBuf = (char *) ioBufAllocator[BUFFER_SIZE_INDEX_16K].alloc_void();
+        int64_t o = offset;
+        l = 0;
+        for (IOBufferBlock *c = b; c && l < want; c = c->next) {
+          int64_t n = c->read_avail() - o;
+          if (n <= 0) {
+            o = -n;
+            continue;
+          }
+          if (n > want - l)
+            n = want - l;
+          memcpy(sslWriteBuf + l, c->start() + o, n);
+          l += n;
+          o = 0;
+        }
+        data = sslWriteBuf;
+        SSL_INCREMENT_DYN_STAT(ssl_records_coalesced_stat);
+      }
     }
     if (!l)
       break;
@@ -359,18 +418,34 @@ SSLNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted, i
     total_wrote += l;
     Debug("ssl", "SSLNetVConnection::loadBufferAndCallWrite, before do_SSL_write, l=%"PRId64", towrite=%"PRId64", b=%p",
           l, towrite, b);
-    r = do_SSL_write(ssl, b->start() + offset, (int)l);
+    r = do_SSL_write(ssl, (void *) data, (int)l);
+    sslWriteCalls++;
+    SSL_INCREMENT_DYN_STAT(ssl_write_calls_stat);
     if (r == l) {
       wattempted = total_wrote;
+      sslWritePending = 0;
+      sslRecordsWritten++;
+      sslRecordBytesWritten += l;
+      sslDynamicBytes += l;
+      SSL_INCREMENT_DYN_STAT(ssl_records_written_stat);
+      SSL_RECORD_HIST(ssl_record_size_hist, l);
+
+      // step over the blocks that went out
+      for (int64_t n = l; b && n > 0; ) {
+        int64_t avail = b->read_avail() - offset;
+        if (n < avail) {
+          offset += n;
+          break;
+        }
+        n -= avail;
+        offset = 0;
+        b = b->next;
+      }
+    } else if (r <= 0) {
+      sslWritePendingData = data;
+      sslWritePending = (int)l;
     }
 
-    if (l == orig_l) {
-      // on to the next block
-      offset = 0;
-      b = b->next;
-    } else
-      offset += l;
-
     Debug("ssl", "SSLNetVConnection::loadBufferAndCallWrite,Number of bytes written=%"PRId64" , total=%"PRId64"", r, total_wrote);
     NET_DEBUG_COUNT_DYN_STAT(net_calls_to_write_stat, 1);
   } while (r == l && total_wrote < towrite && b);
@@ -417,10 +492,22 @@ SSLNetVConnection::load_buffer_and_write(int64_t towrite, int64_t &wattempted, i
 SSLNetVConnection::SSLNetVConnection():
   sslHandShakeComplete(false),
   sslClientConnection(false),
+  sslHandShakeOffloaded(false),
+  sslHandShakeQueued(false),
+  sslHandShakeTriggered(false),
+  sslHandShakeResult(false),
+  sslWriteBuf(NULL),
+  sslWritePendingData(NULL),
+  sslWritePending(0),
+  sslDynamicBytes(0),
+  sslLastWriteTime(0),
   npnSet(NULL),
   npnEndpoint(NULL)
 {
   ssl = NULL;
+  sslRecordsWritten = 0;
+  sslRecordBytesWritten = 0;
+  sslWriteCalls = 0;
 }
 
 void
@@ -447,6 +534,33 @@ SSLNetVConnection::free(EThread * t) {
   }
   sslHandShakeComplete = false;
   sslClientConnection = false;
+  if (sslHandShakeQueued) {
+    SSLHandShakeQueue *q = (SSLHandShakeQueue *)ETHREAD_GET_PTR(thread, SSLNetProcessor::handshake_queue_offset);
+    q->waiting.remove(this);
+  }
+  sslHandShakeOffloaded = false;
+  sslHandShakeQueued = false;
+  sslHandShakeTriggered = false;
+  sslHandShakeResult = false;
+  offloadJob.vc = NULL;
+  offloadJob.mutex.clear();
+  if (sslWriteCalls) {
+    Debug("ssl", "[SSLNetVConnection::free] %"PRId64" records, %"PRId64" bytes, %"PRId64" SSL_write() calls",
+          sslRecordsWritten, sslRecordBytesWritten, sslWriteCalls);
+    SSL_RECORD_HIST(ssl_connection_records_hist, sslRecordsWritten);
+    SSL_RECORD_HIST(ssl_connection_write_calls_hist, sslWriteCalls);
+  }
+  if (sslWriteBuf) {
+    ioBufAllocator[BUFFER_SIZE_INDEX_16K].free_void(sslWriteBuf);
+    sslWriteBuf = NULL;
+  }
+  sslWritePendingData = NULL;
+  sslWritePending = 0;
+  sslDynamicBytes = 0;
+  sslLastWriteTime = 0;
+  sslRecordsWritten = 0;
+  sslRecordBytesWritten = 0;
+  sslWriteCalls = 0;
   npnSet = NULL;
   npnEndpoint = NULL;
 
@@ -485,17 +599,143 @@ SSLNetVConnection::sslStartHandShake(int event, int &err)
 
 }
 
+//
+// Hand the next SSL_accept() to a crypto thread, the RSA and ECDHE
+// private key operations would otherwise stall every connection of this
+// thread.  Returns false when it has to run inline.
+//
+bool
+SSLNetVConnection::sslOffloadHandShake()
+{
+  SSLHandShakeQueue *q;
+  SSLHandShakeJob *job = &offloadJob;
+  EThread *t;
+
+  if (!SSLNetProcessor::handshake_queue_offset || thread == NULL) {
+    return false;
+  }
+
+  q = (SSLHandShakeQueue *)ETHREAD_GET_PTR(thread, SSLNetProcessor::handshake_queue_offset);
+  if (SSLConfigParams::ssl_handshake_max_offload > 0 && q->inflight >= SSLConfigParams::ssl_handshake_max_offload) {
+    q->waiting.enqueue(this);
+    sslHandShakeQueued = true;
+    SSL_INCREMENT_DYN_STAT(ssl_handshake_offload_queued_stat);
+    return true;
+  }
+
+  q->inflight++;
+  sslHandShakeOffloaded = true;
+  sslHandShakeTriggered = false;
+
+  t = eventProcessor.assign_thread(SSLNetProcessor::ET_SSL_CRYPTO);
+  job->vc = this;
+  job->mutex = t->mutex;
+  SET_CONTINUATION_HANDLER(job, &SSLHandShakeJob::cryptoEvent);
+  t->schedule_imm(job);
+  SSL_INCREMENT_DYN_STAT(ssl_handshake_offloaded_stat);
+
+  return true;
+}
+
+// Get net_read_io() or write_to_net_io() to have another go at the handshake.
+void
+SSLNetVConnection::sslHandShakeRetrigger(NetHandler * nh)
+{
+  if (read.enabled) {
+    read.triggered = 1;
+    nh->read_ready_list.in_or_enqueue(this);
+  } else if (write.enabled) {
+    write.triggered = 1;
+    nh->write_ready_list.in_or_enqueue(this);
+  }
+}
+
+void
+SSLNetVConnection::sslHandShakeCompleted(SSLHandShakeJob * job)
+{
+  SSLHandShakeQueue *q = (SSLHandShakeQueue *)ETHREAD_GET_PTR(thread, SSLNetProcessor::handshake_queue_offset);
+  SSLNetVConnection *next;
+
+  ink_debug_assert(sslHandShakeOffloaded && thread == this_ethread());
+  sslHandShakeOffloaded = false;
+  job->mutex.clear();
+
+  q->inflight--;
+  if ((next = q->waiting.dequeue()) != NULL) {
+    next->sslHandShakeQueued = false;
+    next->sslHandShakeRetrigger(nh);
+  }
+
+  if (closed) {
+    close_UnixNetVConnection(this, thread);
+    return;
+  }
+
+  // If data came in after SSL_accept() asked for more, the event is
+  // gone: try again instead of waiting for the next one.
+  if (sslHandShakeTriggered && (job->ssl_error == SSL_ERROR_WANT_READ || job->ssl_error == SSL_ERROR_WANT_WRITE)) {
+    sslHandShakeResult = false;
+  } else {
+    sslHandShakeResult = true;
+  }
+  sslHandShakeRetrigger(nh);
+}
+
+int
+SSLHandShakeJob::cryptoEvent(int event, Event * e)
+{
+  NOWARN_UNUSED(event);
+  NOWARN_UNUSED(e);
+
+  // The thread of the connection keeps off it until completeEvent().
+  ERR_clear_error();
+  ret = SSL_accept(vc->ssl);
+  ssl_error = SSL_get_error(vc->ssl, ret);
+  err = errno;
+
+  mutex = vc->nh->mutex;
+  SET_HANDLER(&SSLHandShakeJob::completeEvent);
+  vc->thread->schedule_imm(this);
+
+  return EVENT_DONE;
+}
+
+int
+SSLHandShakeJob::completeEvent(int event, Event * e)
+{
+  NOWARN_UNUSED(event);
+  NOWARN_UNUSED(e);
+
+  vc->sslHandShakeCompleted(this);
+  return EVENT_DONE;
+}
+
 int
 SSLNetVConnection::sslServerHandShakeEvent(int &err)
 {
-  int ret;
   int ssl_error;
+  int ssl_errno;
 
-  ret = SSL_accept(ssl);
-  ssl_error = SSL_get_error(ssl, ret);
+  // A crypto thread has the handshake, or will have it.
+  if (sslHandShakeOffloaded || sslHandShakeQueued) {
+    sslHandShakeTriggered = true;
+    return SSL_HANDSHAKE_WANT_READ;
+  }
+
+  if (sslHandShakeResult) {
+    sslHandShakeResult = false;
+    ssl_error = offloadJob.ssl_error;
+    ssl_errno = offloadJob.err;
+  } else if (sslOffloadHandShake()) {
+    return SSL_HANDSHAKE_WANT_READ;
+  } else {
+    int ret = SSL_accept(ssl);
+    ssl_error = SSL_get_error(ssl, ret);
+    ssl_errno = errno;
+  }
 
   if (ssl_error != SSL_ERROR_NONE) {
-    err = errno;
+    err = ssl_errno;
     Debug("ssl", "SSL handshake error: %s (%d), errno=%d", SSLErrorName(ssl_error), ssl_error, err);
   }
 
@@ -648,3 +888,240 @@ SSLNetVConnection::advertise_next_protocol(
 
   return SSL_TLSEXT_ERR_NOACK;
 }
+
+#if TS_HAS_TESTS
+#include "ts/TestBox.h"
+
+#define SSL_OFFLOAD_TEST_VCS 3
+
+// Drives three server handshakes through the offload path with one
+// handshake per thread on the crypto threads.  The first one is closed
+// while it is away, the other two wait for their turn.
+struct SSLHandShakeOffloadTest:public Continuation
+{
+  enum State
+  {
+    TEST_START,
+    TEST_CLOSED,
+    TEST_TURN,
+    TEST_RESULT
+  };
+
+  RegressionTest *test;
+  int *status;
+  int result;
+  TestBox box;
+  State state;
+  int ticks;
+  int turn;
+  int64_t freed;
+  EThread *ethread;
+  SSL_CTX *ctx;
+  SSLNetVConnection *vcs[SSL_OFFLOAD_TEST_VCS];
+  int saved_max_offload;
+  off_t saved_queue_offset;
+
+  SSLHandShakeQueue *queue()
+  {
+    return (SSLHandShakeQueue *)ETHREAD_GET_PTR(ethread, SSLNetProcessor::handshake_queue_offset);
+  }
+
+  void next(State s)
+  {
+    state = s;
+    ticks = 0;
+  }
+
+  // What the thread freelist got back since start(), when there is one.
+  int64_t freed_vcs()
+  {
+#if defined(TS_USE_FREELIST)
+    return ethread->sslNetVCAllocator.allocated - freed;
+#else
+    return -1;
+#endif
+  }
+
+  bool start()
+  {
+    ctx = SSL_CTX_new(SSLv23_server_method());
+    if (ctx == NULL) {
+      return false;
+    }
+    for (int i = 0; i < SSL_OFFLOAD_TEST_VCS; i++) {
+      SSLNetVConnection *vc = (SSLNetVConnection *)THREAD_ALLOC_INIT(sslNetVCAllocator, ethread);
+
+      NET_SUM_GLOBAL_DYN_STAT(net_connections_currently_open_stat, 1);
+      vc->thread = ethread;
+      vc->nh = get_NetHandler(ethread);
+      vc->mutex = new_ProxyMutex();
+      // no peer: every SSL_accept() stops at SSL_ERROR_WANT_READ
+      vc->ssl = SSL_new(ctx);
+      SSL_set_bio(vc->ssl, BIO_new(BIO_s_mem()), BIO_new(BIO_s_mem()));
+      SSL_set_accept_state(vc->ssl);
+      vcs[i] = vc;
+    }
+#if defined(TS_USE_FREELIST)
+    freed = ethread->sslNetVCAllocator.allocated;
+#endif
+    return true;
+  }
+
+  int done(Event *e)
+  {
+    e->cancel();
+    for (int i = 0; i < SSL_OFFLOAD_TEST_VCS; i++) {
+      if (vcs[i]) {
+        close_UnixNetVConnection(vcs[i], ethread);
+      }
+    }
+    if (ctx) {
+      SSL_CTX_free(ctx);
+    }
+    SSLConfigParams::ssl_handshake_max_offload = saved_max_offload;
+    // a handshake still away needs the queue to come back to
+    if (queue()->inflight == 0) {
+      SSLNetProcessor::handshake_queue_offset = saved_queue_offset;
+    }
+
+    *status = result;
+    delete this;
+    return EVENT_DONE;
+  }
+
+  int mainEvent(int event, Event *e)
+  {
+    SSLHandShakeQueue *q = queue();
+    SSLNetVConnection *vc;
+    int err = 0;
+
+    NOWARN_UNUSED(event);
+    ++ticks;
+    if (!box.check(q->inflight <= 1, "%d handshakes offloaded by the thread, the limit is 1", q->inflight)) {
+      return done(e);
+    }
+
+    switch (state) {
+    case TEST_START:
+      if (!start()) {
+        box.check(false, "unable to create an SSL_CTX");
+        return done(e);
+      }
+      for (int i = 0; i < SSL_OFFLOAD_TEST_VCS; i++) {
+        box.check(vcs[i]->sslServerHandShakeEvent(err) == SSL_HANDSHAKE_WANT_READ,
+                  "handshake %d did not wait for the crypto thread", i);
+      }
+      box.check(vcs[0]->sslHandShakeOffloaded && q->inflight == 1, "the first handshake was not offloaded");
+      box.check(vcs[1]->sslHandShakeQueued && vcs[2]->sslHandShakeQueued, "the other handshakes were not queued");
+      if (result != REGRESSION_TEST_PASSED) {
+        return done(e);
+      }
+      // The crypto thread can only hand the first one back once this
+      // handler returns, the close has to wait for it.
+      close_UnixNetVConnection(vcs[0], ethread);
+      box.check(vcs[0]->closed && vcs[0]->ssl != NULL && freed_vcs() <= 0, "the close did not wait for the crypto thread");
+      next(TEST_CLOSED);
+      return EVENT_CONT;
+
+    case TEST_CLOSED:
+      if (vcs[1]->sslHandShakeQueued) {
+        if (!box.check(ticks < 500, "the closed handshake did not come back")) {
+          vcs[0] = NULL;        // freed or not, it is not ours anymore
+          return done(e);
+        }
+        return EVENT_CONT;
+      }
+      // its completion gave the next connection its turn and freed it
+      vcs[0] = NULL;
+      box.check(freed_vcs() < 0 || freed_vcs() == 1, "the closed connection was freed %" PRId64 " times", freed_vcs());
+      box.check(q->inflight == 0, "the closed handshake is still counted");
+      box.check(vcs[2]->sslHandShakeQueued, "the last connection left the queue early");
+      turn = 1;
+      next(TEST_TURN);
+      // fall through, the turn is now
+
+    case TEST_TURN:
+      vc = vcs[turn];
+      box.check(!vc->sslHandShakeQueued, "connection %d is still queued on its turn", turn);
+      box.check(vc->sslServerHandShakeEvent(err) == SSL_HANDSHAKE_WANT_READ && vc->sslHandShakeOffloaded,
+                "connection %d was not offloaded on its turn", turn);
+      box.check(q->inflight == 1, "%d handshakes offloaded on the turn of connection %d", q->inflight, turn);
+      if (result != REGRESSION_TEST_PASSED) {
+        return done(e);
+      }
+      next(TEST_RESULT);
+      return EVENT_CONT;
+
+    case TEST_RESULT:
+      vc = vcs[turn];
+      if (!vc->sslHandShakeResult) {
+        if (!box.check(ticks < 500, "the handshake of connection %d did not come back", turn)) {
+          return done(e);
+        }
+        return EVENT_CONT;
+      }
+      box.check(!vc->sslHandShakeOffloaded && q->inflight == 0, "connection %d is still offloaded with its result", turn);
+      box.check(vc->sslServerHandShakeEvent(err) == SSL_HANDSHAKE_WANT_READ && !vc->sslHandShakeResult,
+                "the offloaded SSL_accept() result of connection %d was not used", turn);
+      if (++turn < SSL_OFFLOAD_TEST_VCS) {
+        next(TEST_TURN);
+        return EVENT_CONT;
+      }
+      box.check(q->waiting.head == NULL, "connections left in the queue");
+      for (int i = 1; i < SSL_OFFLOAD_TEST_VCS; i++) {
+        close_UnixNetVConnection(vcs[i], ethread);
+        vcs[i] = NULL;
+      }
+      box.check(freed_vcs() < 0 || freed_vcs() == SSL_OFFLOAD_TEST_VCS, "%" PRId64 " connections freed, expected %d",
+                freed_vcs(), SSL_OFFLOAD_TEST_VCS);
+      return done(e);
+    }
+    return EVENT_CONT;
+  }
+
+  SSLHandShakeOffloadTest(RegressionTest *t, int *pstatus, EThread *et)
+    : Continuation(get_NetHandler(et)->mutex), test(t), status(pstatus), result(REGRESSION_TEST_PASSED),
+      box(t, &result), state(TEST_START), ticks(0), turn(0), freed(0), ethread(et), ctx(NULL),
+      saved_max_offload(SSLConfigParams::ssl_handshake_max_offload),
+      saved_queue_offset(SSLNetProcessor::handshake_queue_offset)
+  {
+    memset(vcs, 0, sizeof(vcs));
+    SET_HANDLER(&SSLHandShakeOffloadTest::mainEvent);
+  }
+};
+
+// With max_offload_per_thread=1 the queued handshakes go one at a time,
+// and a close during an offloaded step frees the connection once.
+REGRESSION_TEST(SSLNetVConnection_offload)(RegressionTest * t, int atype, int * pstatus)
+{
+  EThread *ethread = this_ethread();
+  SSLHandShakeOffloadTest *c;
+
+  NOWARN_UNUSED(atype);
+  if (ssl_rsb == NULL || ethread == NULL || get_NetHandler(ethread)->mutex == NULL) {
+    rprintf(t, "SSL is not initialized\n");
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  c = NEW(new SSLHandShakeOffloadTest(t, pstatus, ethread));
+  // Without offload_threads there is no queue: borrow one, the crypto
+  // jobs then run on the net threads.
+  if (!SSLNetProcessor::handshake_queue_offset) {
+    off_t offset = eventProcessor.allocate(sizeof(SSLHandShakeQueue));
+
+    if (offset == -1) {
+      rprintf(t, "no room for the handshake queue\n");
+      *pstatus = REGRESSION_TEST_NOT_RUN;
+      delete c;
+      return;
+    }
+    SSLNetProcessor::handshake_queue_offset = offset;
+  }
+  SSLConfigParams::ssl_handshake_max_offload = 1;
+
+  *pstatus = REGRESSION_TEST_INPROGRESS;
+  ethread->schedule_every(c, HRTIME_MSECONDS(10));
+}
+
+#endif // TS_HAS_TESTS
@@ -0,0 +1,622 @@
+/** @file
+
+  Server side SSL session cache shared by all the SSL contexts
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "libts.h"
+#include "I_Layout.h"
+
+#include "P_Net.h"
+#include "P_SSLConfig.h"
+#include "P_SSLSessionCache.h"
+
+#include <sys/mman.h>
+#include <openssl/rand.h>
+
+struct SSLSessionCache
+{
+  SSLSessionCacheHeader *header;
+  SSLSessionBucket *buckets;
+  SSLSessionSlot *slots;
+  size_t size;
+};
+
+// What we hang off every context we are plugged into
+struct SSLSessionCacheCtx
+{
+  int stats;                    // per certificate stats, -1 if none
+  uint64_t key;                 // the sessions it may resume
+};
+
+static SSLSessionCache *ssl_session_cache = NULL;
+static int ssl_session_cache_index = -1;
+static volatile int ssl_session_cache_ctx_stats = 0;
+
+#define SSL_SESSION_CACHE_HEADER_SIZE INK_ALIGN(sizeof(SSLSessionCacheHeader), 64)
+
+static inline uint32_t
+ssl_session_hash(const unsigned char * id, unsigned len)
+{
+  // FNV-1a, the ids are random already, this just folds them.
+  uint32_t hash = 2166136261U;
+
+  for (unsigned i = 0; i < len; ++i) {
+    hash = (hash ^ id[i]) * 16777619U;
+  }
+  return hash;
+}
+
+static inline SSLSessionBucket *
+ssl_session_bucket_lock(SSLSessionCache * cache, uint32_t hash, SSLSessionSlot ** slots)
+{
+  int b = hash % cache->header->num_buckets;
+  SSLSessionBucket *bucket = &cache->buckets[b];
+
+  if (!ink_mutex_try_acquire(&bucket->mutex)) {
+    SSL_INCREMENT_DYN_STAT(ssl_session_cache_lock_contention_stat);
+    ink_mutex_acquire(&bucket->mutex);
+  }
+  *slots = &cache->slots[b * cache->header->slots_per_bucket];
+  return bucket;
+}
+
+static inline SSLSessionSlot *
+ssl_session_slot_find(SSLSessionCache * cache, SSLSessionSlot * slots, uint32_t hash, uint64_t key,
+                      const unsigned char * id, unsigned len)
+{
+  for (int i = 0; i < cache->header->slots_per_bucket; ++i) {
+    SSLSessionSlot *slot = &slots[i];
+
+    if (slot->expire && slot->hash == hash && slot->key == key && slot->id_len == len &&
+        memcmp(slot->id, id, len) == 0) {
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+static inline SSLSessionCacheCtx *
+ssl_session_cache_ctx(SSL_CTX * ctx)
+{
+  return ctx ? (SSLSessionCacheCtx *)SSL_CTX_get_ex_data(ctx, ssl_session_cache_index) : NULL;
+}
+
+// A session is only handed back to contexts of the certificate line it
+// was negotiated for, anything else would let a client resume it under
+// another certificate, or around the client certificate settings.
+static inline uint64_t
+ssl_session_cache_key(SSL_CTX * ctx)
+{
+  SSLSessionCacheCtx *cctx = ssl_session_cache_ctx(ctx);
+
+  return cctx ? cctx->key : 0;
+}
+
+static inline void
+ssl_session_ctx_stat(SSL * ssl, int stat)
+{
+  SSLSessionCacheCtx *cctx = ssl_session_cache_ctx(SSL_get_SSL_CTX(ssl));
+
+  SSL_INCREMENT_DYN_STAT(stat);
+  if (cctx && cctx->stats >= 0) {
+    SSL_INCREMENT_DYN_STAT(SSL_Stat_Count + cctx->stats * 2 + (stat == ssl_session_cache_miss_stat));
+  }
+}
+
+static void
+ssl_session_cache_store(SSLSessionCache * cache, const unsigned char * id, unsigned id_len, uint64_t key,
+                        const unsigned char * data, int data_len, int64_t expire)
+{
+  int64_t now = time(NULL);
+  uint32_t hash = ssl_session_hash(id, id_len);
+  SSLSessionSlot *slots, *slot, *victim = NULL;
+  SSLSessionBucket *bucket;
+
+  bucket = ssl_session_bucket_lock(cache, hash, &slots);
+  if ((slot = ssl_session_slot_find(cache, slots, hash, key, id, id_len)) == NULL) {
+    for (int i = 0; i < cache->header->slots_per_bucket; ++i) {
+      if (slots[i].expire <= now) {
+        victim = &slots[i];
+        break;
+      }
+      if (victim == NULL || slots[i].expire < victim->expire) {
+        victim = &slots[i];
+      }
+    }
+    if (victim->expire > now) {
+      SSL_INCREMENT_DYN_STAT(ssl_session_cache_eviction_stat);
+    }
+    slot = victim;
+  }
+  slot->hash = hash;
+  slot->key = key;
+  slot->id_len = id_len;
+  memcpy(slot->id, id, id_len);
+  slot->data_len = data_len;
+  memcpy(slot->data, data, data_len);
+  slot->expire = expire;
+  ink_mutex_release(&bucket->mutex);
+}
+
+// Copies the session out to data, returns its length or 0.
+static int
+ssl_session_cache_lookup(SSLSessionCache * cache, const unsigned char * id, unsigned id_len, uint64_t key,
+                         unsigned char * data)
+{
+  uint32_t hash = ssl_session_hash(id, id_len);
+  SSLSessionSlot *slots, *slot;
+  SSLSessionBucket *bucket;
+  int data_len = 0;
+
+  bucket = ssl_session_bucket_lock(cache, hash, &slots);
+  if ((slot = ssl_session_slot_find(cache, slots, hash, key, id, id_len)) != NULL) {
+    if (slot->expire > time(NULL)) {
+      data_len = slot->data_len;
+      memcpy(data, slot->data, data_len);
+    } else {
+      slot->expire = 0;
+    }
+  }
+  ink_mutex_release(&bucket->mutex);
+
+  return data_len;
+}
+
+static void
+ssl_session_cache_erase(SSLSessionCache * cache, const unsigned char * id, unsigned id_len, uint64_t key)
+{
+  uint32_t hash = ssl_session_hash(id, id_len);
+  SSLSessionSlot *slots, *slot;
+  SSLSessionBucket *bucket;
+
+  bucket = ssl_session_bucket_lock(cache, hash, &slots);
+  if ((slot = ssl_session_slot_find(cache, slots, hash, key, id, id_len)) != NULL) {
+    slot->expire = 0;
+  }
+  ink_mutex_release(&bucket->mutex);
+}
+
+static int
+ssl_session_cache_new(SSL * ssl, SSL_SESSION * sess)
+{
+  unsigned char data[SSL_SESSION_CACHE_DATA_LEN];
+  unsigned char *p = data;
+  unsigned int id_len;
+  const unsigned char *id = SSL_SESSION_get_id(sess, &id_len);
+  int data_len = i2d_SSL_SESSION(sess, NULL);
+
+  if (id_len == 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH) {
+    return 0;
+  }
+  if (data_len <= 0 || data_len > SSL_SESSION_CACHE_DATA_LEN) {
+    SSL_INCREMENT_DYN_STAT(ssl_session_cache_too_large_stat);
+    return 0;
+  }
+  // Encode outside of the bucket lock.
+  i2d_SSL_SESSION(sess, &p);
+
+  ssl_session_cache_store(ssl_session_cache, id, id_len, ssl_session_cache_key(SSL_get_SSL_CTX(ssl)), data, data_len,
+                          SSL_SESSION_get_time(sess) + SSL_SESSION_get_timeout(sess));
+
+  SSL_INCREMENT_DYN_STAT(ssl_session_cache_store_stat);
+  Debug("ssl_session_cache", "stored session, %u byte id, %d bytes", id_len, data_len);
+
+  // We keep our own copy, don't take a reference.
+  return 0;
+}
+
+static SSL_SESSION *
+ssl_session_cache_get(SSL * ssl, unsigned char * id, int len, int * copy)
+{
+  unsigned char data[SSL_SESSION_CACHE_DATA_LEN];
+  const unsigned char *p = data;
+  int data_len = 0;
+  SSL_SESSION *sess = NULL;
+
+  // The session is new, OpenSSL owns the only reference.
+  *copy = 0;
+
+  if (len > 0 && len <= SSL_MAX_SSL_SESSION_ID_LENGTH) {
+    data_len = ssl_session_cache_lookup(ssl_session_cache, id, len, ssl_session_cache_key(SSL_get_SSL_CTX(ssl)), data);
+  }
+  if (data_len > 0) {
+    sess = d2i_SSL_SESSION(NULL, &p, data_len);
+  }
+  ssl_session_ctx_stat(ssl, sess ? ssl_session_cache_hit_stat : ssl_session_cache_miss_stat);
+
+  return sess;
+}
+
+static void
+ssl_session_cache_remove(SSL_CTX * ctx, SSL_SESSION * sess)
+{
+  unsigned int id_len;
+  const unsigned char *id = SSL_SESSION_get_id(sess, &id_len);
+
+  if (id_len == 0 || id_len > SSL_MAX_SSL_SESSION_ID_LENGTH) {
+    return;
+  }
+  ssl_session_cache_erase(ssl_session_cache, id, id_len, ssl_session_cache_key(ctx));
+}
+
+static void
+ssl_session_cache_ctx_free(void * parent, void * ptr, CRYPTO_EX_DATA * ad, int idx, long argl, void * argp)
+{
+  NOWARN_UNUSED(parent);
+  NOWARN_UNUSED(ad);
+  NOWARN_UNUSED(idx);
+  NOWARN_UNUSED(argl);
+  NOWARN_UNUSED(argp);
+  ats_free(ptr);
+}
+
+static bool
+ssl_session_cache_index_init()
+{
+  if (ssl_session_cache_index < 0) {
+    ssl_session_cache_index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL, ssl_session_cache_ctx_free);
+  }
+  return ssl_session_cache_index >= 0;
+}
+
+//
+// The file keeps the session master secrets, only we may read it.  The
+// locks of a previous run are meaningless, they are initialized again
+// but the sessions are kept as long as the geometry didn't change.
+//
+static SSLSessionCache *
+ssl_session_cache_map(const char * filename, int num_buckets, int slots_per_bucket)
+{
+  size_t size = SSL_SESSION_CACHE_HEADER_SIZE + num_buckets * sizeof(SSLSessionBucket) +
+    (size_t) num_buckets * slots_per_bucket * sizeof(SSLSessionSlot);
+  SSLSessionCache *cache;
+  void *addr;
+
+  if (filename && *filename) {
+    xptr<char> path(Layout::relative_to(Layout::get()->runtimedir, filename));
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+
+    if (fd < 0) {
+      Error("unable to open SSL session cache '%s': %s", (const char *)path, strerror(errno));
+      return NULL;
+    }
+    if (ftruncate(fd, size) < 0 ||
+        (addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+      Error("unable to map SSL session cache '%s': %s", (const char *)path, strerror(errno));
+      close(fd);
+      return NULL;
+    }
+    close(fd);
+  } else {
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+    if (addr == MAP_FAILED) {
+      Error("unable to allocate SSL session cache: %s", strerror(errno));
+      return NULL;
+    }
+  }
+
+  cache = NEW(new SSLSessionCache);
+  cache->size = size;
+  cache->header = (SSLSessionCacheHeader *)addr;
+  cache->buckets = (SSLSessionBucket *)((char *)addr + SSL_SESSION_CACHE_HEADER_SIZE);
+  cache->slots = (SSLSessionSlot *)(cache->buckets + num_buckets);
+
+  if (cache->header->magic != SSL_SESSION_CACHE_MAGIC || cache->header->version != SSL_SESSION_CACHE_VERSION ||
+      cache->header->num_buckets != num_buckets || cache->header->slots_per_bucket != slots_per_bucket ||
+      cache->header->slot_size != (int32_t)sizeof(SSLSessionSlot)) {
+    memset(addr, 0, size);
+    cache->header->magic = SSL_SESSION_CACHE_MAGIC;
+    cache->header->version = SSL_SESSION_CACHE_VERSION;
+    cache->header->num_buckets = num_buckets;
+    cache->header->slots_per_bucket = slots_per_bucket;
+    cache->header->slot_size = sizeof(SSLSessionSlot);
+  }
+  for (int i = 0; i < num_buckets; ++i) {
+    ink_mutex_init(&cache->buckets[i].mutex, "SSLSessionBucket");
+  }
+
+  return cache;
+}
+
+static void
+ssl_session_cache_unmap(SSLSessionCache * cache)
+{
+  for (int i = 0; i < cache->header->num_buckets; ++i) {
+    ink_mutex_destroy(&cache->buckets[i].mutex);
+  }
+  munmap((caddr_t)cache->header, cache->size);
+  delete cache;
+}
+
+// Contexts sharing a certificate share the stats, also across reloads.
+static int
+ssl_session_cache_ctx_stats_get(const char * name)
+{
+  char hits_name[256], misses_name[256];
+  int id, slot;
+
+  snprintf(hits_name, sizeof(hits_name), "proxy.process.ssl.session_cache.%s.hits", name);
+  snprintf(misses_name, sizeof(misses_name), "proxy.process.ssl.session_cache.%s.misses", name);
+
+  if (RecGetRecordOrderAndId(hits_name, NULL, &id) == REC_ERR_OKAY) {
+    return (id - SSL_Stat_Count) / 2;
+  }
+
+  slot = ink_atomic_increment(&ssl_session_cache_ctx_stats, 1);
+  if (slot >= SSL_SESSION_CACHE_MAX_CTX_STATS) {
+    return -1;
+  }
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, hits_name, RECD_COUNTER, RECP_NULL,
+                     SSL_Stat_Count + slot * 2, RecRawStatSyncCount);
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, misses_name, RECD_COUNTER, RECP_NULL,
+                     SSL_Stat_Count + slot * 2 + 1, RecRawStatSyncCount);
+  return slot;
+}
+
+void
+SSLSessionCacheInit(const SSLConfigParams * params)
+{
+  int num_buckets, slots_per_bucket;
+
+  if (params->ssl_session_cache != SSLConfigParams::SSL_SESSION_CACHE_MODE_SERVER_SHARED) {
+    return;
+  }
+
+  if (!ssl_session_cache_index_init()) {
+    SSLError("failed to create session cache index");
+    return;
+  }
+
+  num_buckets = params->ssl_session_cache_num_buckets > 0 ? params->ssl_session_cache_num_buckets : 1;
+  slots_per_bucket = (params->ssl_session_cache_size + num_buckets - 1) / num_buckets;
+  if (slots_per_bucket < 1) {
+    slots_per_bucket = 1;
+  }
+
+  ssl_session_cache = ssl_session_cache_map(params->ssl_session_cache_filename, num_buckets, slots_per_bucket);
+  if (ssl_session_cache) {
+    Debug("ssl_session_cache", "%d buckets of %d sessions, %zu bytes", num_buckets, slots_per_bucket,
+          ssl_session_cache->size);
+  } else {
+    Warning("SSL session cache unavailable, using the OpenSSL cache of each context");
+  }
+}
+
+bool
+SSLSessionCacheAttach(SSL_CTX * ctx, const char * name, const unsigned char * sid_ctx, unsigned sid_ctx_len)
+{
+  SSLSessionCacheCtx *cctx;
+
+  if (ssl_session_cache == NULL) {
+    return false;
+  }
+
+  cctx = (SSLSessionCacheCtx *)ats_malloc(sizeof(SSLSessionCacheCtx));
+  cctx->stats = name ? ssl_session_cache_ctx_stats_get(name) : -1;
+  // FNV-1a again, never 0 so that a context we don't know matches nothing
+  cctx->key = 14695981039346656037ULL;
+  for (unsigned i = 0; i < sid_ctx_len; ++i) {
+    cctx->key = (cctx->key ^ sid_ctx[i]) * 1099511628211ULL;
+  }
+  cctx->key |= 1;
+  SSL_CTX_set_ex_data(ctx, ssl_session_cache_index, cctx);
+
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+  SSL_CTX_sess_set_new_cb(ctx, ssl_session_cache_new);
+  SSL_CTX_sess_set_get_cb(ctx, ssl_session_cache_get);
+  SSL_CTX_sess_set_remove_cb(ctx, ssl_session_cache_remove);
+
+  return true;
+}
+
+#if TS_HAS_TESTS
+#include "ts/TestBox.h"
+
+static SSL_SESSION *
+test_session_new(SSL * ssl, const unsigned char * id, unsigned id_len, long start, long timeout)
+{
+  SSL_SESSION *sess = SSL_SESSION_new();
+
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+  SSL_SESSION_set1_id(sess, id, id_len);
+  SSL_SESSION_set_protocol_version(sess, TLS1_2_VERSION);
+  SSL_SESSION_set_cipher(sess, SSL_CIPHER_find(ssl, (const unsigned char *)"\x00\x2f"));  // AES128-SHA
+#else
+  NOWARN_UNUSED(ssl);
+  sess->ssl_version = TLS1_VERSION;
+  sess->session_id_length = id_len;
+  memcpy(sess->session_id, id, id_len);
+#endif
+  SSL_SESSION_set_time(sess, start);
+  SSL_SESSION_set_timeout(sess, timeout);
+  return sess;
+}
+
+// A session is stored once, handed back to contexts of its own
+// certificate line only, and gone after it is removed or has expired.
+REGRESSION_TEST(SSLSessionCache_callbacks)(RegressionTest * t, int atype, int * pstatus)
+{
+  TestBox box(t, pstatus);
+  SSLSessionCache *installed = NULL;
+  unsigned char id[SSL_MAX_SSL_SESSION_ID_LENGTH];
+  int copy;
+
+  NOWARN_UNUSED(atype);
+  if (ssl_rsb == NULL || !ssl_session_cache_index_init()) {
+    rprintf(t, "SSL is not initialized\n");
+    box = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+  box = REGRESSION_TEST_PASSED;
+
+  // Without the shared cache configured no context uses the callbacks,
+  // borrow the global for a small cache of our own.
+  if (ssl_session_cache == NULL) {
+    installed = ssl_session_cache = ssl_session_cache_map(NULL, 4, 2);
+    if (installed == NULL) {
+      box = REGRESSION_TEST_FAILED;
+      return;
+    }
+  }
+
+  SSL_CTX *ctx_a = SSL_CTX_new(SSLv23_server_method());
+  SSL_CTX *ctx_a2 = SSL_CTX_new(SSLv23_server_method());
+  SSL_CTX *ctx_b = SSL_CTX_new(SSLv23_server_method());
+
+  SSLSessionCacheAttach(ctx_a, NULL, (const unsigned char *)"line a", 6);
+  SSLSessionCacheAttach(ctx_a2, NULL, (const unsigned char *)"line a", 6);
+  SSLSessionCacheAttach(ctx_b, NULL, (const unsigned char *)"line b", 6);
+
+  SSL *ssl_a = SSL_new(ctx_a);
+  SSL *ssl_a2 = SSL_new(ctx_a2);
+  SSL *ssl_b = SSL_new(ctx_b);
+  SSL_SESSION *sess, *found;
+
+  // random, like the ids OpenSSL makes, not to meet the sessions of a live cache
+  RAND_bytes(id, sizeof(id));
+
+  sess = test_session_new(ssl_a, id, sizeof(id), time(NULL), 300);
+  ssl_session_cache_new(ssl_a, sess);
+
+  found = ssl_session_cache_get(ssl_a, id, sizeof(id), &copy);
+  box.check(found != NULL, "stored session not found");
+  box.check(copy == 0, "the cache should not keep a reference");
+  if (found) {
+    unsigned found_len;
+    const unsigned char *found_id = SSL_SESSION_get_id(found, &found_len);
+    box.check(found_len == sizeof(id) && memcmp(found_id, id, sizeof(id)) == 0, "found another session");
+    SSL_SESSION_free(found);
+  }
+
+  found = ssl_session_cache_get(ssl_a2, id, sizeof(id), &copy);
+  box.check(found != NULL, "session not found by another context of the same certificate line");
+  if (found) {
+    SSL_SESSION_free(found);
+  }
+
+  found = ssl_session_cache_get(ssl_b, id, sizeof(id), &copy);
+  box.check(found == NULL, "session resumed on the context of another certificate line");
+  if (found) {
+    SSL_SESSION_free(found);
+  }
+
+  // only the context it belongs to removes it
+  ssl_session_cache_remove(ctx_b, sess);
+  found = ssl_session_cache_get(ssl_a, id, sizeof(id), &copy);
+  box.check(found != NULL, "session removed through another certificate line");
+  if (found) {
+    SSL_SESSION_free(found);
+  }
+  ssl_session_cache_remove(ctx_a, sess);
+  found = ssl_session_cache_get(ssl_a, id, sizeof(id), &copy);
+  box.check(found == NULL, "removed session still found");
+  if (found) {
+    SSL_SESSION_free(found);
+  }
+  SSL_SESSION_free(sess);
+
+  // expired an hour ago
+  sess = test_session_new(ssl_a, id, sizeof(id), time(NULL) - 3600, 60);
+  ssl_session_cache_new(ssl_a, sess);
+  found = ssl_session_cache_get(ssl_a, id, sizeof(id), &copy);
+  box.check(found == NULL, "expired session found");
+  if (found) {
+    SSL_SESSION_free(found);
+  }
+  SSL_SESSION_free(sess);
+
+  SSL_free(ssl_a);
+  SSL_free(ssl_a2);
+  SSL_free(ssl_b);
+  SSL_CTX_free(ctx_a);
+  SSL_CTX_free(ctx_a2);
+  SSL_CTX_free(ctx_b);
+
+  if (installed) {
+    ssl_session_cache = NULL;
+    ssl_session_cache_unmap(installed);
+  }
+}
+
+// The sessions in the file survive a remap with the same geometry, any
+// other layout starts over.
+REGRESSION_TEST(SSLSessionCache_file)(RegressionTest * t, int atype, int * pstatus)
+{
+  TestBox box(t, pstatus);
+  const char *filename = "ssl_session_cache.regression";
+  xptr<char> path(Layout::relative_to(Layout::get()->runtimedir, filename));
+  const unsigned char id[] = "regression session id";
+  const unsigned char data[] = "regression session data";
+  unsigned char out[SSL_SESSION_CACHE_DATA_LEN];
+  SSLSessionCache *cache;
+  struct stat st;
+
+  NOWARN_UNUSED(atype);
+  if (ssl_rsb == NULL) {
+    rprintf(t, "SSL is not initialized\n");
+    box = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+  box = REGRESSION_TEST_PASSED;
+  unlink(path);
+
+  if ((cache = ssl_session_cache_map(filename, 4, 2)) == NULL) {
+    box.check(false, "unable to map %s", (const char *)path);
+    return;
+  }
+  box.check(stat(path, &st) == 0 && (st.st_mode & 0777) == 0600, "%s should only be readable by us", (const char *)path);
+  ssl_session_cache_store(cache, id, sizeof(id), 7, data, sizeof(data), time(NULL) + 60);
+  ssl_session_cache_unmap(cache);
+
+  // same geometry, the session is still there
+  cache = ssl_session_cache_map(filename, 4, 2);
+  box.check(cache != NULL, "unable to map %s again", (const char *)path);
+  if (cache) {
+    int len = ssl_session_cache_lookup(cache, id, sizeof(id), 7, out);
+    box.check(len == (int)sizeof(data) && memcmp(out, data, len) == 0, "session lost across a remap");
+    box.check(ssl_session_cache_lookup(cache, id, sizeof(id), 8, out) == 0, "session found under another key");
+    // as if an older build had written the file
+    cache->header->version = SSL_SESSION_CACHE_VERSION - 1;
+    ssl_session_cache_unmap(cache);
+  }
+
+  cache = ssl_session_cache_map(filename, 4, 2);
+  box.check(cache != NULL, "unable to map %s again", (const char *)path);
+  if (cache) {
+    box.check(cache->header->version == SSL_SESSION_CACHE_VERSION, "header of another version kept");
+    box.check(ssl_session_cache_lookup(cache, id, sizeof(id), 7, out) == 0, "session of another version kept");
+    ssl_session_cache_store(cache, id, sizeof(id), 7, data, sizeof(data), time(NULL) + 60);
+    ssl_session_cache_unmap(cache);
+  }
+
+  // more buckets, the slots moved
+  cache = ssl_session_cache_map(filename, 8, 2);
+  box.check(cache != NULL, "unable to map %s with other geometry", (const char *)path);
+  if (cache) {
+    box.check(cache->header->num_buckets == 8 && cache->header->slots_per_bucket == 2, "geometry not updated");
+    box.check(ssl_session_cache_lookup(cache, id, sizeof(id), 7, out) == 0, "session kept across a geometry change");
+    ssl_session_cache_unmap(cache);
+  }
+
+  unlink(path);
+}
+
+#endif // TS_HAS_TESTS
@@ -23,6 +23,7 @@
 #include "libts.h"
 #include "I_Layout.h"
 #include "P_Net.h"
+#include "P_SSLSessionCache.h"
 
 #include <openssl/err.h>
 #include <openssl/bio.h>
@@ -79,6 +80,10 @@ struct ssl_ticket_key_t
 static int ssl_callback_session_ticket(SSL *, unsigned char *, unsigned char *, EVP_CIPHER_CTX *, HMAC_CTX *, int);
 #endif /* TS_USE_TLS_TICKETS */
 static int ssl_session_ticket_index = 0;
+static void ssl_session_ticket_free(void *, void *, CRYPTO_EX_DATA *, int, long, void *);
+
+RecRawStatBlock *ssl_rsb = NULL;
+RecHistogramBlock *ssl_rhb = NULL;
 
 
 struct ats_file_bio
@@ -151,34 +156,43 @@ SSL_CTX_add_extra_chain_cert_file(SSL_CTX * ctx, const char *chainfile)
 
 #if TS_USE_TLS_SNI
 
+static SSL_CTX * ssl_load_lazy_context(SSLCertContext * cc);
+
 static int
 ssl_servername_callback(SSL * ssl, int * ad, void * arg)
 {
   SSL_CTX *       ctx = NULL;
-  SSLCertLookup * lookup = (SSLCertLookup *) arg;
+  SSLCertContext * cc = NULL;
   const char *    servername = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
   SSLNetVConnection * netvc = (SSLNetVConnection *)SSL_get_app_data(ssl);
 
-  Debug("ssl", "ssl=%p ad=%d lookup=%p server=%s", ssl, *ad, lookup, servername);
+  // Contexts are carried over from one certificate configuration to the
+  // next, so look in the current one rather than the one this context
+  // was made for.
+  SSLCertificateConfig::scoped_config lookup;
+
+  NOWARN_UNUSED(arg);
+  Debug("ssl", "ssl=%p ad=%d lookup=%p server=%s", ssl, *ad, (SSLCertLookup *)lookup, servername);
 
   // The incoming SSL_CTX is either the one mapped from the inbound IP address or the default one. If we
   // don't find a name-based match at this point, we *do not* want to mess with the context because we've
   // already made a best effort to find the best match.
   if (likely(servername)) {
-    ctx = lookup->findInfoInHash((char *)servername);
+    cc = lookup->find((char *)servername);
   }
 
   // If there's no match on the server name, try to match on the peer address.
-  if (ctx == NULL) {
+  if (cc == NULL) {
     IpEndpoint ip;
     int namelen = sizeof(ip);
 
     safe_getsockname(netvc->get_socket(), &ip.sa, &namelen);
-    ctx = lookup->findInfoInHash(ip);
+    cc = lookup->find(ip);
   }
 
-  if (ctx != NULL) {
-    SSL_set_SSL_CTX(ssl, ctx);
+  // A lazy context gets loaded here, by the first handshake that wants it.
+  if (cc != NULL) {
+    cc->select(ssl, ssl_load_lazy_context, SSLConfigParams::ssl_context_cache_size);
   }
 
   ctx = SSL_get_SSL_CTX(ssl);
@@ -197,17 +211,15 @@ ssl_servername_callback(SSL * ssl, int * ad, void * arg)
 #endif /* TS_USE_TLS_SNI */
 
 static SSL_CTX *
-ssl_context_enable_sni(SSL_CTX * ctx, SSLCertLookup * lookup)
+ssl_context_enable_sni(SSL_CTX * ctx)
 {
 #if TS_USE_TLS_SNI
   Debug("ssl", "setting SNI callbacks with for ctx %p", ctx);
   if (ctx) {
     SSL_CTX_set_tlsext_servername_callback(ctx, ssl_servername_callback);
-    SSL_CTX_set_tlsext_servername_arg(ctx, lookup);
   }
 #else
   NOWARN_UNUSED(ctx);
-  NOWARN_UNUSED(lookup);
 #endif /* TS_USE_TLS_SNI */
 
   return ctx;
@@ -302,7 +314,9 @@ SSLInitializeLibrary()
     CRYPTO_set_id_callback(SSL_pthreads_thread_id);
   }
 
-  int iRet = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+  // The ticket key is owned by the SSL_CTX, OpenSSL frees it with the last
+  // reference, whoever drops that.
+  int iRet = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL, ssl_session_ticket_free);
   if (iRet == -1) {
     SSLError("failed to create session ticket index");
   }
@@ -311,6 +325,44 @@ SSLInitializeLibrary()
   open_ssl_initialized = true;
 }
 
+void
+SSLInitializeStatistics()
+{
+  ssl_rsb = RecAllocateRawStatBlock((int) SSL_Stat_Count + SSL_SESSION_CACHE_MAX_CTX_STATS * 2);
+  ssl_rhb = RecAllocateHistogramBlock((int) SSL_Hist_Count);
+
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.session_cache.hits",
+                     RECD_COUNTER, RECP_NULL, (int) ssl_session_cache_hit_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.session_cache.misses",
+                     RECD_COUNTER, RECP_NULL, (int) ssl_session_cache_miss_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.session_cache.stores",
+                     RECD_COUNTER, RECP_NULL, (int) ssl_session_cache_store_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.session_cache.evictions",
+                     RECD_COUNTER, RECP_NULL, (int) ssl_session_cache_eviction_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.session_cache.too_large",
+                     RECD_COUNTER, RECP_NULL, (int) ssl_session_cache_too_large_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.session_cache.lock_contention",
+                     RECD_COUNTER, RECP_NULL, (int) ssl_session_cache_lock_contention_stat, RecRawStatSyncCount);
+
+
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.handshake.offloaded",
+                     RECD_COUNTER, RECP_NULL, (int) ssl_handshake_offloaded_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.handshake.offload_queued",
+                     RECD_COUNTER, RECP_NULL, (int) ssl_handshake_offload_queued_stat, RecRawStatSyncCount);
+
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.records_written",
+                     RECD_COUNTER, RECP_NULL, (int) ssl_records_written_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.records_coalesced",
+                     RECD_COUNTER, RECP_NULL, (int) ssl_records_coalesced_stat, RecRawStatSyncCount);
+  RecRegisterRawStat(ssl_rsb, RECT_PROCESS, "proxy.process.ssl.write_calls",
+                     RECD_COUNTER, RECP_NULL, (int) ssl_write_calls_stat, RecRawStatSyncCount);
+
+  RecRegisterHistogram(ssl_rhb, RECT_PROCESS, "proxy.process.ssl.record_size", (int) ssl_record_size_hist);
+  RecRegisterHistogram(ssl_rhb, RECT_PROCESS, "proxy.process.ssl.connection.records", (int) ssl_connection_records_hist);
+  RecRegisterHistogram(ssl_rhb, RECT_PROCESS, "proxy.process.ssl.connection.write_calls",
+                       (int) ssl_connection_write_calls_hist);
+}
+
 void
 SSLError(const char *errStr, bool critical)
 {
@@ -368,6 +420,29 @@ SSLDefaultServerContext()
   return SSL_CTX_new(meth);
 }
 
+// A session must not be resumed under another certificate, or around
+// different client certificate settings, so every certificate line
+// gets a session id context of its own.
+static void
+ssl_context_session_id(
+    const SSLConfigParams * params,
+    const char * serverCertPtr,
+    const char * serverCaCertPtr,
+    const char * serverKeyPtr,
+    unsigned char id[16])
+{
+  const char * files[] = { serverCertPtr, serverCaCertPtr, serverKeyPtr };
+  INK_DIGEST_CTX md5;
+
+  ink_code_incr_md5_init(&md5);
+  for (unsigned i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+    // the terminating NUL keeps the names apart
+    ink_code_incr_md5_update(&md5, files[i] ? files[i] : "", files[i] ? strlen(files[i]) + 1 : 1);
+  }
+  ink_code_incr_md5_update(&md5, (const char *)&params->clientCertLevel, sizeof(params->clientCertLevel));
+  ink_code_incr_md5_final((char *)id, &md5);
+}
+
 SSL_CTX *
 SSLInitServerContext(
     const SSLConfigParams * params,
@@ -375,7 +450,7 @@ SSLInitServerContext(
     const char * serverCaCertPtr,
     const char * serverKeyPtr)
 {
-  int         session_id_context;
+  unsigned char session_id_context[16];
   int         server_verify_client;
   xptr<char>  completeServerCertPath;
   SSL_CTX *   ctx = SSLDefaultServerContext();
@@ -383,16 +458,28 @@ SSLInitServerContext(
   // disable selected protocols
   SSL_CTX_set_options(ctx, params->ssl_ctx_options);
 
+  ssl_context_session_id(params, serverCertPtr, serverCaCertPtr, serverKeyPtr, session_id_context);
+  SSL_CTX_set_session_id_context(ctx, session_id_context, sizeof(session_id_context));
+
   switch (params->ssl_session_cache) {
   case SSLConfigParams::SSL_SESSION_CACHE_MODE_OFF:
     SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF|SSL_SESS_CACHE_NO_INTERNAL);
     break;
+  case SSLConfigParams::SSL_SESSION_CACHE_MODE_SERVER_SHARED:
+    if (SSLSessionCacheAttach(ctx, serverCertPtr, session_id_context, sizeof(session_id_context))) {
+      break;
+    }
+    // fall through, the shared cache could not be set up
   case SSLConfigParams::SSL_SESSION_CACHE_MODE_SERVER:
     SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
     SSL_CTX_sess_set_cache_size(ctx, params->ssl_session_cache_size);
     break;
   }
 
+  if (params->ssl_session_cache_timeout > 0) {
+    SSL_CTX_set_timeout(ctx, params->ssl_session_cache_timeout);
+  }
+
 #ifdef SSL_MODE_RELEASE_BUFFERS
   SSL_CTX_set_mode(ctx, SSL_MODE_RELEASE_BUFFERS);
 #endif
@@ -467,11 +554,8 @@ SSLInitServerContext(
       Error("Illegal Client Certification Level in records.config");
     }
 
-    session_id_context = 1;
-
     SSL_CTX_set_verify(ctx, server_verify_client, NULL);
     SSL_CTX_set_verify_depth(ctx, params->verify_depth); // might want to make configurable at some point.
-    SSL_CTX_set_session_id_context(ctx, (const unsigned char *) &session_id_context, sizeof session_id_context);
 
     SSL_CTX_set_client_CA_list(ctx, SSL_load_client_CA_file(params->serverCACertFilename));
   }
@@ -571,18 +655,21 @@ asn1_strdup(ASN1_STRING * s)
     return ats_strndup((const char *)ASN1_STRING_data(s), ASN1_STRING_length(s));
 }
 
-// Given a certificate and it's corresponding SSL_CTX context, insert hash
-// table aliases for all of the subject and subjectAltNames. Note that we don't
-// deal with wildcards (yet).
-static void
-ssl_index_certificate(SSLCertLookup * lookup, SSL_CTX * ctx, const char * certfile)
+// Collect the subject CNs and the subjectAltNames of a certificate, these
+// are the names its context is indexed by.
+static bool
+ssl_certificate_names(SSLCertContext * cc, const char * certfile)
 {
   X509_NAME * subject = NULL;
 
   ats_file_bio bio(certfile, "r");
-  X509* cert = PEM_read_bio_X509_AUX(bio.bio, NULL, NULL, NULL);
+  X509* cert = bio ? PEM_read_bio_X509_AUX(bio.bio, NULL, NULL, NULL) : NULL;
+
+  if (!cert) {
+    SSLError("failed to read certificate from %s", certfile);
+    return false;
+  }
 
-  // Insert a key for the subject CN.
   subject = X509_get_subject_name(cert);
   if (subject) {
     int pos = -1;
@@ -594,15 +681,11 @@ ssl_index_certificate(SSLCertLookup * lookup, SSL_CTX * ctx, const char * certfi
 
       X509_NAME_ENTRY * e = X509_NAME_get_entry(subject, pos);
       ASN1_STRING * cn = X509_NAME_ENTRY_get_data(e);
-      xptr<char> name(asn1_strdup(cn));
-
-      Debug("ssl", "mapping '%s' to certificate %s", (const char *)name, certfile);
-      lookup->insert(ctx, name);
+      cc->names.push_back(asn1_strdup(cn));
     }
   }
 
 #if HAVE_OPENSSL_TS_H
-  // Traverse the subjectAltNames (if any) and insert additional keys for the SSL context.
   GENERAL_NAMES * names = (GENERAL_NAMES *)X509_get_ext_d2i(cert, NID_subject_alt_name, NULL, NULL);
   if (names) {
     unsigned count = sk_GENERAL_NAME_num(names);
@@ -611,9 +694,7 @@ ssl_index_certificate(SSLCertLookup * lookup, SSL_CTX * ctx, const char * certfi
 
       name = sk_GENERAL_NAME_value(names, i);
       if (name->type == GEN_DNS) {
-        xptr<char> dns(asn1_strdup(name->d.dNSName));
-        Debug("ssl", "mapping '%s' to certificate %s", (const char *)dns, certfile);
-        lookup->insert(ctx, dns);
+        cc->names.push_back(asn1_strdup(name->d.dNSName));
       }
     }
 
@@ -621,12 +702,110 @@ ssl_index_certificate(SSLCertLookup * lookup, SSL_CTX * ctx, const char * certfi
   }
 #endif // HAVE_OPENSSL_TS_H
   X509_free(cert);
+  return true;
+}
+
+// Newest modification time of the files of a certificate line, with
+// the global chain and the session ticket key that go into its context.
+static time_t
+ssl_certificate_mtime(const SSLConfigParams * params, const SSLCertContext * cc)
+{
+  const char * dirs[] = {
+    params->serverCertPathOnly, params->serverCertPathOnly, params->serverKeyPathOnly,
+    params->serverCertPathOnly, params->serverCertPathOnly
+  };
+  const char * files[] = {
+    cc->cert, cc->ca, cc->key,
+    params->serverCertChainFilename, cc->session_ticket_enabled ? (const char *)cc->ticket_key_filename : NULL
+  };
+  time_t mtime = 0;
+
+  for (unsigned i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+    struct stat sb;
+
+    if (dirs[i] && files[i]) {
+      xptr<char> path(Layout::relative_to(dirs[i], files[i]));
+      if (stat(path, &sb) == 0 && sb.st_mtime > mtime) {
+        mtime = sb.st_mtime;
+      }
+    }
+  }
+
+  return mtime;
+}
+
+// Digest of the records.config settings SSLInitServerContext() puts in
+// every context, a line is only carried over while they stay the same.
+static void
+ssl_context_params_digest(const SSLConfigParams * params, char hex[33])
+{
+  const char * strings[] = {
+    params->serverCertPathOnly, params->serverCertChainFilename, params->serverKeyPathOnly,
+    params->serverCACertFilename, params->serverCACertPath, params->cipherSuite
+  };
+  const int64_t values[] = {
+    params->clientCertLevel, params->verify_depth, params->ssl_session_cache, params->ssl_session_cache_size,
+    params->ssl_session_cache_timeout, params->ssl_ctx_options
+  };
+  INK_DIGEST_CTX md5;
+  char digest[16];
+
+  ink_code_incr_md5_init(&md5);
+  for (unsigned i = 0; i < sizeof(strings) / sizeof(strings[0]); ++i) {
+    ink_code_incr_md5_update(&md5, strings[i] ? strings[i] : "", strings[i] ? strlen(strings[i]) + 1 : 1);
+  }
+  ink_code_incr_md5_update(&md5, (const char *)values, sizeof(values));
+  ink_code_incr_md5_final(digest, &md5);
+  ink_code_md5_stringify(hex, 33, digest);
+}
+
+static SSL_CTX *
+ssl_load_ssl_context(const SSLConfigParams * params, SSLCertContext * cc)
+{
+  SSL_CTX * ctx;
+
+  ctx = ssl_context_enable_sni(SSLInitServerContext(params, cc->cert, cc->ca, cc->key));
+  if (!ctx) {
+    SSLError("failed to create new SSL server context");
+    return NULL;
+  }
+
+#if TS_USE_TLS_NPN
+  SSL_CTX_set_next_protos_advertised_cb(ctx, SSLNetVConnection::advertise_next_protocol, NULL);
+#endif /* TS_USE_TLS_NPN */
+
+#if defined(SSL_OP_NO_TICKET)
+  // Session tickets are enabled by default. Disable if explicitly requested.
+  if (cc->session_ticket_enabled == 0) {
+      SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+      Debug("ssl", "ssl session ticket is disabled");
+  }
+#endif
+  // Load the session ticket key if session tickets are not disabled and we have key name.
+  if (cc->session_ticket_enabled != 0 && cc->ticket_key_filename) {
+    xptr<char> ticket_key_path(Layout::relative_to(params->serverCertPathOnly, cc->ticket_key_filename));
+    ssl_context_enable_tickets(ctx, ticket_key_path);
+  }
+
+  return ctx;
+}
+
+#if TS_USE_TLS_SNI
+static SSL_CTX *
+ssl_load_lazy_context(SSLCertContext * cc)
+{
+  SSLConfig::scoped_config params;
+
+  Debug("ssl", "loading certificate %s on first use", (const char *)cc->cert);
+  return ssl_load_ssl_context(params, cc);
 }
+#endif /* TS_USE_TLS_SNI */
 
 static void
 ssl_store_ssl_context(
     const SSLConfigParams * params,
     SSLCertLookup *         lookup,
+    const SSLCertLookup *   previous,
     xptr<char>& addr,
     xptr<char>& cert,
     xptr<char>& ca,
@@ -634,55 +813,84 @@ ssl_store_ssl_context(
     const int session_ticket_enabled,
     xptr<char>& ticket_key_filename)
 {
-  SSL_CTX *   ctx;
+  SSLCertContext * cc = NULL;
+  SSLCertContext * prev = NULL;
   xptr<char>  certpath;
-  xptr<char>  session_key_path;
-
-  ctx = ssl_context_enable_sni(SSLInitServerContext(params, cert, ca, key), lookup);
-  if (!ctx) {
-    SSLError("failed to create new SSL server context");
+  xptr<char>  signature;
+  bool        is_default = addr && strcmp(addr, "*") == 0;
+  char        params_digest[33];
+  int         len;
+
+  ssl_context_params_digest(params, params_digest);
+#define _S(_x) ((_x) ? (const char *)(_x) : "-")
+  len = snprintf(NULL, 0, "%s %s %s %s %d %s %s", _S(addr), _S(cert), _S(ca), _S(key), session_ticket_enabled,
+                 _S(ticket_key_filename), params_digest);
+  signature = (char *)ats_malloc(len + 1);
+  snprintf(signature, len + 1, "%s %s %s %s %d %s %s", _S(addr), _S(cert), _S(ca), _S(key), session_ticket_enabled,
+           _S(ticket_key_filename), params_digest);
+#undef _S
+
+  cc = NEW(new SSLCertContext());
+  cc->addr = addr.release();
+  cc->cert = cert.release();
+  cc->ca = ca.release();
+  cc->key = key.release();
+  cc->ticket_key_filename = ticket_key_filename.release();
+  cc->session_ticket_enabled = session_ticket_enabled;
+  cc->signature = signature.release();
+  cc->mtime = ssl_certificate_mtime(params, cc);
+  cc->lazy = params->ssl_lazy_load && !is_default;
+
+  certpath = Layout::relative_to(params->serverCertPathOnly, cc->cert);
+
+  // The same line and settings over files that did not change since:
+  // keep its names and context, there is nothing to read again.
+  if (previous && (prev = previous->findSignature(cc->signature)) && prev->mtime == cc->mtime && prev->lazy == cc->lazy) {
+    Debug("ssl", "certificate %s did not change, reusing SSLCertContext %p", (const char *)certpath, prev);
+    delete cc;
+    cc = prev;
+  } else if (!ssl_certificate_names(cc, certpath)) {
+    delete cc;
     return;
   }
 
-#if TS_USE_TLS_NPN
-  SSL_CTX_set_next_protos_advertised_cb(ctx, SSLNetVConnection::advertise_next_protocol, NULL);
-#endif /* TS_USE_TLS_NPN */
-
-  certpath = Layout::relative_to(params->serverCertPathOnly, cert);
+  if (!cc->lazy && !cc->ctx) {
+    cc->ctx = ssl_load_ssl_context(params, cc);
+    if (!cc->ctx) {
+      if (cc->refcount() == 0) {
+        delete cc;
+      }
+      return;
+    }
+  }
 
   // Index this certificate by the specified IP(v6) address. If the address is "*", make it the default context.
-  if (addr) {
-    if (strcmp(addr, "*") == 0) {
-      lookup->ssl_default = ctx;
-      lookup->insert(ctx, addr);
+  if (cc->addr) {
+    if (is_default) {
+      lookup->ssl_default = cc->ctx;
+      lookup->insert(cc, cc->addr);
     } else {
       IpEndpoint ep;
 
-      if (ats_ip_pton(addr, &ep) == 0) {
-        Debug("ssl", "mapping '%s' to certificate %s", (const char *)addr, (const char *)certpath);
-        lookup->insert(ctx, ep);
+      if (ats_ip_pton(cc->addr, &ep) == 0) {
+        Debug("ssl", "mapping '%s' to certificate %s", (const char *)cc->addr, (const char *)certpath);
+        lookup->insert(cc, ep);
       } else {
-        Error("'%s' is not a valid IPv4 or IPv6 address", (const char *)addr);
+        Error("'%s' is not a valid IPv4 or IPv6 address", (const char *)cc->addr);
       }
     }
   }
-#if defined(SSL_OP_NO_TICKET)
-  // Session tickets are enabled by default. Disable if explicitly requested.
-  if (session_ticket_enabled == 0) {
-      SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
-      Debug("ssl", "ssl session ticket is disabled");
-  }
-#endif
-  // Load the session ticket key if session tickets are not disabled and we have key name.
-  if (session_ticket_enabled != 0 && ticket_key_filename) {
-    xptr<char> ticket_key_path(Layout::relative_to(params->serverCertPathOnly, ticket_key_filename));
-    ssl_context_enable_tickets(ctx, ticket_key_path);
+
+  // Insert additional mappings, for all the names in the certificate. The lookup holds one
+  // reference to the context however many names it is indexed by.
+  for (int i = 0; i < cc->names.count(); ++i) {
+    Debug("ssl", "mapping '%s' to certificate %s", cc->names[i], (const char *)certpath);
+    lookup->insert(cc, cc->names[i]);
   }
 
-  // Insert additional mappings. Note that this maps multiple keys to the same value, so when
-  // this code is updated to reconfigure the SSL certificates, it will need some sort of
-  // refcounting or alternate way of avoiding double frees.
-  ssl_index_certificate(lookup, ctx, certpath);
+  if (cc->refcount() == 0) {
+    delete cc;
+  }
 }
 
 static bool
@@ -742,7 +950,8 @@ ssl_extract_certificate(
 bool
 SSLParseCertificateConfiguration(
     const SSLConfigParams * params,
-    SSLCertLookup *         lookup)
+    SSLCertLookup *         lookup,
+    const SSLCertLookup *   previous)
 {
   char *      tok_state = NULL;
   char *      line = NULL;
@@ -795,7 +1004,7 @@ SSLParseCertificateConfiguration(
         IOCORE_SignalError(errBuf, alarmAlready);
       } else {
         if (ssl_extract_certificate(&line_info, addr, cert, ca, key, session_ticket_enabled, ticket_key_filename)) {
-          ssl_store_ssl_context(params, lookup, addr, cert, ca, key, session_ticket_enabled, ticket_key_filename);
+          ssl_store_ssl_context(params, lookup, previous, addr, cert, ca, key, session_ticket_enabled, ticket_key_filename);
         } else {
           snprintf(errBuf, sizeof(errBuf), "%s: discarding invalid %s entry at line %u",
                        __func__, params->configFilePath, line_num);
@@ -812,7 +1021,7 @@ SSLParseCertificateConfiguration(
   // bootstrap the SSL handshake so that we can subsequently do the SNI lookup to switch to the real
   // context.
   if (lookup->ssl_default == NULL) {
-    lookup->ssl_default = ssl_context_enable_sni(SSLDefaultServerContext(), lookup);
+    lookup->ssl_default = ssl_context_enable_sni(SSLDefaultServerContext());
     lookup->insert(lookup->ssl_default, "*");
   }
 
@@ -865,16 +1074,17 @@ int ssl_callback_session_ticket(SSL *ssl,
 }
 #endif
 
+static void
+ssl_session_ticket_free(void * /*parent*/, void * ptr, CRYPTO_EX_DATA * /*ad*/, int /*idx*/, long /*argl*/, void * /*argp*/)
+{
+  delete (ssl_ticket_key_t *)ptr;
+}
+
 void
 SSLReleaseContext(SSL_CTX * ctx)
 {
-  ssl_ticket_key_t * ssl_ticket_key = (ssl_ticket_key_t*)SSL_CTX_get_ex_data(ctx, ssl_session_ticket_index);
-
-  // Free the ticket if this is the last reference.
-  if (ctx->references == 1 && ssl_ticket_key) {
-    delete ssl_ticket_key;
-  }
-
+  // Connections still using the context hold their own references, the
+  // ticket key goes with the last one (see ssl_session_ticket_free).
   SSL_CTX_free(ctx);
 }
 
@@ -31,9 +31,8 @@ spdy_callbacks_init(spdylay_session_callbacks *callbacks)
 void
 spdy_prepare_status_response(SpdySM *sm, int stream_id, const char *status)
 {
-  SpdyRequest *req = sm->req_map[stream_id];
-  string date_str = http_date(time(0));
-  const char **nv = new const char*[8+req->headers.size()*2+1];
+  char date_str[32];
+  const char *nv[9];
 
   nv[0] = ":status";
   nv[1] = status;
@@ -42,19 +41,13 @@ spdy_prepare_status_response(SpdySM *sm, int stream_id, const char *status)
   nv[4] = "server";
   nv[5] = SPDYD_SERVER;
   nv[6] = "date";
-  nv[7] = date_str.c_str();
-
-  for(size_t i = 0; i < req->headers.size(); ++i) {
-    nv[8+i*2] = req->headers[i].first.c_str();
-    nv[8+i*2+1] = req->headers[i].second.c_str();
-  }
-  nv[8+req->headers.size()*2] = 0;
+  nv[7] = http_date(time(0), date_str, sizeof(date_str));
+  nv[8] = NULL;
 
   int r = spdylay_submit_response(sm->session, stream_id, nv, NULL);
-  TSAssert(r == 0);
+  ink_assert(r == 0);
 
-  TSVIOReenable(sm->write_vio);
-  delete [] nv;
+  sm->schedule_send();
 }
 
 static void
@@ -143,48 +136,6 @@ spdy_show_ctl_frame(const char *head_str, spdylay_session *session, spdylay_fram
   return;
 }
 
-static int
-spdy_fetcher_launch(SpdyRequest *req, TSFetchMethod method)
-{
-  string url;
-  int fetch_flags;
-  const sockaddr *client_addr;
-  SpdySM *sm = req->spdy_sm;
-  NetVConnection *vc = (NetVConnection *)sm->net_vc;
-
-  url = req->scheme + "://" + req->host + req->path;
-  client_addr = TSNetVConnRemoteAddrGet(sm->net_vc);
-
-  req->url = url;
-  Debug("spdy", "++++Request[%" PRIu64 ":%d] %s\n", sm->sm_id, req->stream_id, req->url.c_str());
-
-  //
-  // HTTP content should be dechunked before packed into SPDY.
-  //
-  fetch_flags = TS_FETCH_FLAGS_DECHUNK;
-  req->fetch_sm = TSFetchCreate(sm->contp, method,
-                                url.c_str(), req->version.c_str(),
-                                client_addr, fetch_flags);
-  TSFetchUserDataSet(req->fetch_sm, req);
-  TSFetchProtoTypeSet(req->fetch_sm, (TSNetProtoType)vc->proto_type);
-
-  //
-  // Set header list
-  //
-  for (size_t i = 0; i < req->headers.size(); i++) {
-
-    if (*req->headers[i].first.c_str() == ':')
-      continue;
-
-    TSFetchHeaderAdd(req->fetch_sm,
-                     req->headers[i].first.c_str(), req->headers[i].first.size(),
-                     req->headers[i].second.c_str(), req->headers[i].second.size());
-  }
-
-  TSFetchLaunch(req->fetch_sm);
-  return 0;
-}
-
 ssize_t
 spdy_send_callback(spdylay_session *session, const uint8_t *data, size_t length,
                    int flags, void *user_data)
@@ -192,7 +143,7 @@ spdy_send_callback(spdylay_session *session, const uint8_t *data, size_t length,
   SpdySM  *sm = (SpdySM*)user_data;
 
   sm->total_size += length;
-  TSIOBufferWrite(sm->resp_buffer, data, length);
+  sm->resp_buffer->write(data, length);
 
   Debug("spdy", "----spdy_send_callback, length:%zu\n", length);
 
@@ -203,35 +154,12 @@ ssize_t
 spdy_recv_callback(spdylay_session *session, uint8_t *buf, size_t length,
                    int flags, void *user_data)
 {
-  const char *start;
-  TSIOBufferBlock blk, next_blk;
-  int64_t already, blk_len, need, wavail;
+  int64_t already;
 
   SpdySM  *sm = (SpdySM*)user_data;
 
-  already = 0;
-  blk = TSIOBufferReaderStart(sm->req_reader);
-
-  while (blk) {
-
-    wavail = length - already;
-
-    next_blk = TSIOBufferBlockNext(blk);
-    start = TSIOBufferBlockReadStart(blk, sm->req_reader, &blk_len);
-
-    need = blk_len > wavail ? wavail : blk_len;
-
-    memcpy(&buf[already], start, need);
-    already += need;
-
-    if (already >= (int64_t)length)
-      break;
-
-    blk = next_blk;
-  }
-
-  TSIOBufferReaderConsume(sm->req_reader, already);
-  TSVIOReenable(sm->read_vio);
+  already = sm->req_reader->read(buf, length);
+  sm->read_vio->reenable();
 
   if (!already)
     return SPDYLAY_ERR_WOULDBLOCK;
@@ -239,52 +167,24 @@ spdy_recv_callback(spdylay_session *session, uint8_t *buf, size_t length,
   return already;
 }
 
+//
+// The stream is handed to the HTTP endpoint as a new client
+// connection, from there on it belongs to its HttpSM.
+//
 static void
-spdy_process_syn_stream_frame(SpdySM *sm, SpdyRequest *req)
+spdy_process_syn_stream_frame(SpdySM *sm, spdylay_syn_stream *frame)
 {
-  // validate request headers
-  for(size_t i = 0; i < req->headers.size(); ++i) {
-    const std::string &field = req->headers[i].first;
-    const std::string &value = req->headers[i].second;
-
-    if(field == ":path")
-      req->path = value;
-    else if(field == ":method")
-      req->method = value;
-    else if(field == ":scheme")
-      req->scheme = value;
-    else if(field == ":version")
-      req->version = value;
-    else if(field == ":host")
-      req->host = value;
-  }
+  SpdyStream *stream = spdyStreamAllocator.alloc();
 
-  if(!req->path.size()|| !req->method.size() || !req->scheme.size()
-     || !req->version.size() || !req->host.size()) {
-    spdy_prepare_status_response(sm, req->stream_id, STATUS_400);
+  stream->init(sm, frame->stream_id);
+  if (!stream->request_init(frame->nv, frame->hd.flags & SPDYLAY_CTRL_FLAG_FIN)) {
+    stream->destroy();
+    spdy_prepare_status_response(sm, frame->stream_id, STATUS_400);
     return;
   }
 
-
-  if (req->method == "GET")
-    spdy_fetcher_launch(req, TS_FETCH_METHOD_GET);
-  else if (req->method == "POST")
-    spdy_fetcher_launch(req, TS_FETCH_METHOD_POST);
-  else if (req->method == "PURGE")
-    spdy_fetcher_launch(req, TS_FETCH_METHOD_PURGE);
-  else if (req->method == "PUT")
-    spdy_fetcher_launch(req, TS_FETCH_METHOD_PUT);
-  else if (req->method == "HEAD")
-    spdy_fetcher_launch(req, TS_FETCH_METHOD_HEAD);
-  else if (req->method == "CONNECT")
-    spdy_fetcher_launch(req, TS_FETCH_METHOD_CONNECT);
-  else if (req->method == "DELETE")
-    spdy_fetcher_launch(req, TS_FETCH_METHOD_DELETE);
-  else if (req->method == "LAST")
-    spdy_fetcher_launch(req, TS_FETCH_METHOD_LAST);
-  else
-    spdy_prepare_status_response(sm, req->stream_id, STATUS_405);
-
+  sm->stream_map[frame->stream_id] = stream;
+  sm->endpoint->handleEvent(NET_EVENT_ACCEPT, stream);
 }
 
 void
@@ -292,7 +192,6 @@ spdy_on_ctrl_recv_callback(spdylay_session *session, spdylay_frame_type type,
                            spdylay_frame *frame, void *user_data)
 {
   int         stream_id;
-  SpdyRequest *req;
   SpdySM      *sm = (SpdySM*)user_data;
 
   spdy_show_ctl_frame("++++RECV", session, type, frame, user_data);
@@ -300,22 +199,16 @@ spdy_on_ctrl_recv_callback(spdylay_session *session, spdylay_frame_type type,
   switch (type) {
 
   case SPDYLAY_SYN_STREAM:
-    stream_id = frame->syn_stream.stream_id;
-    req = spdyRequestAllocator.alloc();
-    req->init(sm, stream_id);
-    req->append_nv(frame->syn_stream.nv);
-    sm->req_map[stream_id] = req;
-    spdy_process_syn_stream_frame(sm, req);
+    spdy_process_syn_stream_frame(sm, &frame->syn_stream);
     break;
 
   case SPDYLAY_HEADERS:
-    stream_id = frame->syn_stream.stream_id;
-    req = sm->req_map[stream_id];
-    req->append_nv(frame->headers.nv);
-    break;
-
-  case SPDYLAY_WINDOW_UPDATE:
-    TSVIOReenable(sm->write_vio);
+    // The request went out with the SYN_STREAM, too late to add to it.
+    //  Reset the stream rather than answer with headers missing, its
+    //  HttpSM sees the reset once spdylay closes the stream.
+    stream_id = frame->headers.stream_id;
+    Debug("spdy", "----Request[%" PRIu64 ":%d] late HEADERS frame, resetting the stream\n", sm->sm_id, stream_id);
+    spdylay_submit_rst_stream(session, stream_id, SPDYLAY_INTERNAL_ERROR);
     break;
 
   default:
@@ -340,17 +233,15 @@ spdy_on_data_chunk_recv_callback(spdylay_session *session, uint8_t flags,
                                  size_t len, void *user_data)
 {
   SpdySM *sm = (SpdySM *)user_data;
-  SpdyRequest *req = sm->req_map[stream_id];
+  SpdyStream *stream = sm->find_stream(stream_id);
 
   //
-  // SpdyRequest has been deleted on error, drop this data;
+  // SpdyStream has been deleted, drop this data;
   //
-  if (!req)
+  if (!stream)
     return;
 
-  Debug("spdy", "++++Fetcher Append Data, len:%zu\n", len);
-  TSFetchWriteData(req->fetch_sm, data, len);
-
+  stream->recv_data(data, len);
   return;
 }
 
@@ -358,40 +249,8 @@ void
 spdy_on_data_recv_callback(spdylay_session *session, uint8_t flags,
                            int32_t stream_id, int32_t length, void *user_data)
 {
-  SpdySM *sm = (SpdySM *)user_data;
-  SpdyRequest *req = sm->req_map[stream_id];
-
   spdy_show_data_frame("++++RECV", session, flags, stream_id, length, user_data);
 
-  //
-  // After SpdyRequest has been deleted on error, the corresponding
-  // client might continue to send POST data, We should reenable
-  // sm->write_vio so that WINDOW_UPDATE has a chance to be sent.
-  //
-  if (!req) {
-    TSVIOReenable(sm->write_vio);
-    return;
-  }
-
-  req->delta_window_size += length;
-
-  Debug("spdy", "----sm_id:%"PRId64", stream_id:%d, delta_window_size:%d\n",
-        sm->sm_id, stream_id, req->delta_window_size);
-
-  if (req->delta_window_size >= SPDY_CFG.spdy.initial_window_size/2) {
-    Debug("spdy", "----Reenable write_vio for WINDOW_UPDATE frame, delta_window_size:%d\n",
-          req->delta_window_size);
-
-    //
-    // Need not to send WINDOW_UPDATE frame here, what we should
-    // do is to reenable sm->write_vio, and than spdylay_session_send()
-    // will be triggered and it'll send WINDOW_UPDATE frame automatically.
-    //
-    TSVIOReenable(sm->write_vio);
-
-    req->delta_window_size = 0;
-  }
-
   return;
 }
 
@@ -430,7 +289,7 @@ spdy_on_data_send_callback(spdylay_session *session, uint8_t flags,
 
   spdy_show_data_frame("----SEND", session, flags, stream_id, length, user_data);
 
-  TSVIOReenable(sm->read_vio);
+  sm->read_vio->reenable();
   return;
 }
 
@@ -438,7 +297,11 @@ void
 spdy_on_stream_close_callback(spdylay_session *session, int32_t stream_id,
                               spdylay_status_code status_code, void *user_data)
 {
-  //TODO
+  SpdySM *sm = (SpdySM *)user_data;
+  SpdyStream *stream = sm->find_stream(stream_id);
+
+  if (stream)
+    stream->stream_closed(status_code != SPDYLAY_OK);
   return;
 }
 
@@ -472,7 +335,11 @@ void
 spdy_on_request_recv_callback(spdylay_session *session, int32_t stream_id,
                               void *user_data)
 {
-  //TODO
+  SpdySM *sm = (SpdySM *)user_data;
+  SpdyStream *stream = sm->find_stream(stream_id);
+
+  if (stream)
+    stream->recv_end();
   return;
 }
 
@@ -4,13 +4,15 @@
 
 Config SPDY_CFG;
 
-string
-http_date(time_t t)
+char *
+http_date(time_t t, char *buf, size_t len)
 {
-  char buf[32];
-  tm* tms = gmtime(&t); // returned struct is statically allocated.
-  size_t r = strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", tms);
-  return std::string(&buf[0], &buf[r]);
+  struct tm tms;
+
+  gmtime_r(&t, &tms);
+  if (strftime(buf, len, "%a, %d %b %Y %H:%M:%S GMT", &tms) == 0)
+    buf[0] = '\0';
+  return buf;
 }
 
 
@@ -37,40 +39,44 @@ spdy_config_load()
   return 0;
 }
 
-SpdyNV::SpdyNV(TSFetchSM fetch_sm)
+SpdyNV::SpdyNV(HTTPHdr *hdr)
 {
   int i, len;
   char *p;
   const char *name, *value;
   int name_len, value_len, hdr_len, nr_fields;
-  TSMLoc loc, field_loc, next_loc;
-  TSMBuffer bufp;
-
-  bufp = TSFetchRespHdrMBufGet(fetch_sm);
-  loc = TSFetchRespHdrMLocGet(fetch_sm);
-
-  hdr_len = TSMimeHdrLengthGet(bufp, loc);
-  mime_hdr = malloc(hdr_len);
-  TSReleaseAssert(mime_hdr);
+  HTTPVersion ver;
+  MIMEFieldIter iter;
+  MIMEField *field;
+
+  hdr_len = 0;
+  nr_fields = 0;
+  for (field = hdr->iter_get_first(&iter); field; field = hdr->iter_get_next(&iter)) {
+    field->name_get(&name_len);
+    field->value_get(&value_len);
+    hdr_len += name_len + value_len + 2;
+    nr_fields++;
+  }
 
-  nr_fields = TSMimeHdrFieldsCount(bufp, loc);
-  nv = (const char **)malloc((2*nr_fields + 5) * sizeof(char *));
-  TSReleaseAssert(nv);
+  mime_hdr = ats_malloc(hdr_len + 1);
+  nv = (const char **)ats_malloc((2*nr_fields + 5) * sizeof(char *));
 
   //
   // Process Status and Version
   //
-  i = TSHttpHdrVersionGet(bufp, loc);
-  snprintf(version, sizeof(version), "HTTP/%d.%d", TS_HTTP_MAJOR(i), TS_HTTP_MINOR(i));
+  ver = hdr->version_get();
+  snprintf(version, sizeof(version), "HTTP/%d.%d", HTTP_MAJOR(ver.m_version), HTTP_MINOR(ver.m_version));
 
-  i = TSHttpHdrStatusGet(bufp, loc);
-  value = (char *)TSHttpHdrReasonGet(bufp, loc, &value_len);
-  snprintf(status, sizeof(version), "%d ", i);
+  value = hdr->reason_get(&value_len);
+  snprintf(status, sizeof(status), "%d ", hdr->status_get());
   i = strlen(status);
-  len = sizeof(status) - i;
+  len = sizeof(status) - i - 1;
   len = value_len > len ? len : value_len;
-  strncpy(&status[i], value, len);
-  status[len + i] = '\0';;
+  if (value)
+    memcpy(&status[i], value, len);
+  else
+    len = 0;
+  status[len + i] = '\0';
 
   i = 0;
   nv[i++] = ":version";
@@ -82,56 +88,34 @@ SpdyNV::SpdyNV(TSFetchSM fetch_sm)
   // Process HTTP headers
   //
   p = (char *)mime_hdr;
-  field_loc = TSMimeHdrFieldGet(bufp, loc, 0);
-  while (field_loc) {
-    name = TSMimeHdrFieldNameGet(bufp, loc, field_loc, &name_len);
-    TSReleaseAssert(name && name_len);
+  for (field = hdr->iter_get_first(&iter); field; field = hdr->iter_get_next(&iter)) {
+    name = field->name_get(&name_len);
 
     //
     // According SPDY v3 spec, in RESPONSE:
     // The Connection, Keep-Alive, Proxy-Connection, and
     // Transfer-Encoding headers are not valid and MUST not be sent.
     //
-    if (!strncasecmp(name, "Connection", name_len))
-      goto next;
-
-    if (!strncasecmp(name, "Keep-Alive", name_len))
-      goto next;
+    if (name == MIME_FIELD_CONNECTION || name == MIME_FIELD_KEEP_ALIVE ||
+        name == MIME_FIELD_PROXY_CONNECTION || name == MIME_FIELD_TRANSFER_ENCODING)
+      continue;
 
-    if (!strncasecmp(name, "Proxy-Connection", name_len))
-      goto next;
-
-    if (!strncasecmp(name, "Transfer-Encoding", name_len))
-      goto next;
-
-    strncpy(p, name, name_len);
+    memcpy(p, name, name_len);
     nv[i++] = p;
     p += name_len;
     *p++ = '\0';
 
-    value = TSMimeHdrFieldValueStringGet(bufp, loc, field_loc, -1, &value_len);
-    TSReleaseAssert(value && value_len);
-    strncpy(p, value, value_len);
+    value = field->value_get(&value_len);
+    memcpy(p, value, value_len);
     nv[i++] = p;
     p += value_len;
     *p++ = '\0';
-
-next:
-    next_loc = TSMimeHdrFieldNext(bufp, loc, field_loc);
-    TSHandleMLocRelease(bufp, loc, field_loc);
-    field_loc = next_loc;
   }
   nv[i] = NULL;
-
-  if (field_loc)
-    TSHandleMLocRelease(bufp, loc, field_loc);
 }
 
 SpdyNV::~SpdyNV()
 {
-  if (nv)
-    free(nv);
-
-  if (mime_hdr)
-    free(mime_hdr);
+  ats_free(nv);
+  ats_free(mime_hdr);
 }
@@ -0,0 +1,755 @@
+
+#include "P_SpdyStream.h"
+#include "P_SpdySM.h"
+
+ClassAllocator<SpdyStream> spdyStreamAllocator("SpdyStreamAllocator");
+
+#define SPDY_STREAM_MAX_BYTES   (32 * 1024)
+
+static ssize_t
+spdy_stream_read_callback(spdylay_session *session, int32_t stream_id,
+                          uint8_t *buf, size_t length, int *eof,
+                          spdylay_data_source *source, void *user_data)
+{
+  SpdyStream *stream = (SpdyStream *)source->ptr;
+
+  return stream->send_body(buf, length, eof);
+}
+
+SpdyStream::SpdyStream():
+  NetVConnection(),
+  sm(NULL), stream_id(-1), request(), read_vio(), write_vio(),
+  recv_buffer(NULL), recv_reader(NULL), recv_window_consumed(0),
+  active_timeout(0), inactive_timeout(0),
+  event(NULL), active_event(NULL), inactive_event(NULL), recursion(0),
+  recv_chunked(false), recv_fin(false), recv_trailer_sent(false),
+  read_shutdown(false), write_shutdown(false),
+  reply_submitted(false), send_deferred(false), send_fin(false),
+  need_read(false), need_write(false),
+  closed(false), spdy_closed(false), spdy_reset(false)
+{
+  SET_HANDLER(&SpdyStream::main_handler);
+}
+
+void
+SpdyStream::init(SpdySM *spdy_sm, int32_t id)
+{
+  NetVConnection *netvc = spdy_sm->net_vc;
+
+  sm = spdy_sm;
+  stream_id = id;
+  mutex = spdy_sm->mutex;
+  thread = netvc->thread;
+  proto_type = netvc->proto_type;
+  attributes = netvc->attributes;
+  set_is_transparent(netvc->get_is_transparent());
+
+  ats_ip_copy(&local_addr, netvc->get_local_addr());
+  got_local_addr = true;
+  ats_ip_copy(&remote_addr, netvc->get_remote_addr());
+  got_remote_addr = true;
+}
+
+//
+// Build the request header straight from the SYN_STREAM name/value
+// pairs. Returns false if the pseudo headers needed for the request
+// line are missing.
+//
+bool
+SpdyStream::request_init(char **nv, bool fin)
+{
+  const char *path = NULL;
+  const char *method = NULL;
+  const char *scheme = NULL;
+  const char *version = NULL;
+  const char *host = NULL;
+  bool has_length = false;
+
+  for (int i = 0; nv[i]; i += 2) {
+    const char *field = nv[i];
+    const char *value = nv[i+1];
+
+    if (field[0] != ':') {
+      if (!strcasecmp(field, MIME_FIELD_CONTENT_LENGTH))
+        has_length = true;
+      continue;
+    }
+    if (value[0] == '\0')
+      continue;
+    if (!strcmp(field, ":path"))
+      path = value;
+    else if (!strcmp(field, ":method"))
+      method = value;
+    else if (!strcmp(field, ":scheme"))
+      scheme = value;
+    else if (!strcmp(field, ":version"))
+      version = value;
+    else if (!strcmp(field, ":host"))
+      host = value;
+  }
+
+  if (!path || !method || !scheme || !version || !host)
+    return false;
+
+  request.create(HTTP_TYPE_REQUEST);
+  request.method_set(method, strlen(method));
+  request.version_set(strcmp(version, "HTTP/1.0") ? HTTPVersion(1, 1) : HTTPVersion(1, 0));
+
+  char url_buf[1024];
+  char *url = url_buf;
+  int url_len;
+  MIMEParseResult result;
+
+  url_len = strlen(scheme) + strlen(host) + strlen(path) + sizeof("://");
+  if (url_len > (int)sizeof(url_buf))
+    url = (char *)ats_malloc(url_len);
+  url_len = snprintf(url, url_len, "%s://%s%s", scheme, host, path);
+  result = request.url_get()->parse(url, url_len);
+  if (url != url_buf)
+    ats_free(url);
+  if (result != PARSE_DONE)
+    return false;
+
+  request.value_set(MIME_FIELD_HOST, MIME_LEN_HOST, host, strlen(host));
+
+  for (int i = 0; nv[i]; i += 2) {
+    const char *field = nv[i];
+    const char *value = nv[i+1];
+
+    if (field[0] == ':')
+      continue;
+
+    //
+    // The connection level headers mean nothing inside a stream, and
+    // there is no interim 100 Continue to answer an Expect with.
+    //
+    if (!strcasecmp(field, MIME_FIELD_CONNECTION) ||
+        !strcasecmp(field, MIME_FIELD_KEEP_ALIVE) ||
+        !strcasecmp(field, MIME_FIELD_PROXY_CONNECTION) ||
+        !strcasecmp(field, MIME_FIELD_TRANSFER_ENCODING) ||
+        !strcasecmp(field, MIME_FIELD_EXPECT) ||
+        !strcasecmp(field, MIME_FIELD_HOST))
+      continue;
+
+    MIMEField *f = request.field_create(field, strlen(field));
+    request.field_value_set(f, value, strlen(value));
+    request.field_attach(f);
+  }
+
+  //
+  // A body of unknown length is framed as chunks, so that HttpSM sees
+  // where it ends without waiting for the stream to close.
+  //
+  if (!fin && !has_length) {
+    recv_chunked = true;
+    request.value_set(MIME_FIELD_TRANSFER_ENCODING, MIME_LEN_TRANSFER_ENCODING,
+                      HTTP_VALUE_CHUNKED, HTTP_LEN_CHUNKED);
+  }
+  recv_fin = fin;
+
+  Debug("spdy", "++++Stream[%" PRId64 ":%d] %s %s://%s%s\n", sm->sm_id, stream_id, method, scheme, host, path);
+  return true;
+}
+
+void
+SpdyStream::destroy()
+{
+  Debug("spdy", "****Delete Stream[%d]\n", stream_id);
+
+  if (event) {
+    event->cancel();
+    event = NULL;
+  }
+  if (active_event) {
+    active_event->cancel();
+    active_event = NULL;
+  }
+  if (inactive_event) {
+    inactive_event->cancel();
+    inactive_event = NULL;
+  }
+
+  if (sm) {
+    map<int32_t, SpdyStream*>::iterator iter = sm->stream_map.find(stream_id);
+    if (iter != sm->stream_map.end() && iter->second == this)
+      sm->stream_map.erase(iter);
+    sm = NULL;
+  }
+
+  request.destroy();
+  if (recv_buffer) {
+    free_MIOBuffer(recv_buffer);
+    recv_buffer = NULL;
+    recv_reader = NULL;
+  }
+
+  read_vio.buffer.clear();
+  read_vio.mutex.clear();
+  write_vio.buffer.clear();
+  write_vio.mutex.clear();
+  mutex.clear();
+
+  spdyStreamAllocator.free(this);
+}
+
+int
+SpdyStream::main_handler(int event_in, void *data)
+{
+  Event *e = (Event *)data;
+
+  ink_release_assert(event_in == EVENT_INTERVAL || event_in == EVENT_IMMEDIATE);
+  ink_debug_assert(!closed || !spdy_closed);
+
+  recursion++;
+
+  if (e == active_event) {
+    process_timeout(&active_event, VC_EVENT_ACTIVE_TIMEOUT);
+  } else if (e == inactive_event) {
+    process_timeout(&inactive_event, VC_EVENT_INACTIVITY_TIMEOUT);
+  } else {
+    ink_debug_assert(e == event);
+    event = NULL;
+
+    // Writes go first, a stream that has just sent its last byte
+    //  should see WRITE_COMPLETE before the close of the stream.
+    if (need_write)
+      process_write();
+    if (need_read && !closed)
+      process_read();
+  }
+
+  recursion--;
+  if (closed && spdy_closed && recursion == 0)
+    destroy();
+
+  return EVENT_DONE;
+}
+
+// void SpdyStream::process_read()
+//
+//   Moves the received DATA into the read VIO as far as the buffer has
+//     room, and hands the window back to the peer for what moved.
+//
+void
+SpdyStream::process_read()
+{
+  need_read = false;
+
+  if (read_vio.op != VIO::READ || closed || read_shutdown)
+    return;
+
+  int64_t ntodo = read_vio.ntodo();
+  if (ntodo == 0)
+    return;
+
+  int64_t bytes_avail = recv_reader ? recv_reader->read_avail() : 0;
+  bool trailer = recv_chunked && recv_fin && !recv_trailer_sent && bytes_avail == 0;
+
+  if (bytes_avail == 0 && !trailer) {
+    //
+    // The FIN of a GET must not look like an abort, the read VIO is
+    //  kept open to watch for one. Only a bounded read ends at the FIN.
+    //
+    if (spdy_closed || (recv_fin && read_vio.nbytes != INT64_MAX))
+      read_vio._cont->handleEvent(VC_EVENT_EOS, &read_vio);
+    return;
+  }
+
+  MIOBuffer *output_buffer = read_vio.get_writer();
+  int64_t water_mark = MAX(output_buffer->water_mark, SPDY_STREAM_MAX_BYTES);
+  int64_t buf_space = water_mark - output_buffer->max_read_avail();
+  if (buf_space <= 0) {
+    Debug("spdy", "----Stream[%d] no room in the read buffer\n", stream_id);
+    return;
+  }
+
+  int64_t act_on = MIN(MIN(bytes_avail, ntodo), buf_space);
+  int64_t added = 0;
+
+  if (recv_chunked) {
+    char chunk_hdr[32];
+    int len;
+
+    if (act_on > 0) {
+      len = snprintf(chunk_hdr, sizeof(chunk_hdr), "%" PRIx64 "\r\n", act_on);
+      output_buffer->write(chunk_hdr, len);
+      output_buffer->write(recv_reader, act_on);
+      output_buffer->write("\r\n", 2);
+      added += len + act_on + 2;
+    }
+    if (recv_fin && bytes_avail == act_on) {
+      output_buffer->write("0\r\n\r\n", 5);
+      added += 5;
+      recv_trailer_sent = true;
+    }
+  } else {
+    added = output_buffer->write(recv_reader, act_on);
+  }
+
+  if (act_on > 0) {
+    recv_reader->consume(act_on);
+    credit_window(act_on);
+  }
+  read_vio.ndone += added;
+
+  Debug("spdy", "----Stream[%d] process_read; added %" PRId64 "\n", stream_id, added);
+
+  if (read_vio.ntodo() == 0) {
+    read_vio._cont->handleEvent(VC_EVENT_READ_COMPLETE, &read_vio);
+  } else {
+    read_vio._cont->handleEvent(VC_EVENT_READ_READY, &read_vio);
+  }
+
+  update_inactive_time();
+}
+
+void
+SpdyStream::process_write()
+{
+  need_write = false;
+
+  if (write_vio.op != VIO::WRITE || closed || write_shutdown)
+    return;
+
+  if (spdy_reset) {
+    if (write_vio.ntodo() > 0) {
+      lerrno = ECONNRESET;
+      write_vio._cont->handleEvent(VC_EVENT_ERROR, &write_vio);
+    }
+    return;
+  }
+
+  if (write_vio.ntodo() == 0) {
+    write_vio._cont->handleEvent(VC_EVENT_WRITE_COMPLETE, &write_vio);
+  } else {
+    write_vio._cont->handleEvent(VC_EVENT_WRITE_READY, &write_vio);
+  }
+}
+
+// void SpdyStream::process_timeout(Event** our_eptr, int event_to_send)
+//
+//   The timeout goes to the read side if it waits for data, to the
+//     write side otherwise.
+//
+void
+SpdyStream::process_timeout(Event ** our_eptr, int event_to_send)
+{
+  *our_eptr = NULL;
+
+  if (closed)
+    return;
+
+  if (read_vio.op == VIO::READ && !read_shutdown && read_vio.ntodo() > 0) {
+    read_vio._cont->handleEvent(event_to_send, &read_vio);
+  } else if (write_vio.op == VIO::WRITE && !write_shutdown && write_vio.ntodo() > 0) {
+    write_vio._cont->handleEvent(event_to_send, &write_vio);
+  }
+}
+
+void
+SpdyStream::update_inactive_time()
+{
+  if (inactive_event) {
+    inactive_event->cancel();
+    inactive_event = eventProcessor.schedule_in(this, inactive_timeout);
+  }
+}
+
+void
+SpdyStream::setup_event_cb()
+{
+  if (event == NULL) {
+    if (this_ethread()->tt == REGULAR) {
+      event = this_ethread()->schedule_imm_local(this);
+    } else {
+      event = eventProcessor.schedule_imm(this);
+    }
+  }
+}
+
+void
+SpdyStream::resume_send()
+{
+  if (send_deferred && sm && !spdy_closed) {
+    send_deferred = false;
+    spdylay_session_resume_data(sm->session, stream_id);
+    sm->schedule_send();
+  }
+}
+
+void
+SpdyStream::credit_window(int64_t len)
+{
+  if (!sm || spdy_closed || recv_fin)
+    return;
+
+  recv_window_consumed += len;
+  if (recv_window_consumed >= SPDY_CFG.spdy.initial_window_size / 2) {
+    Debug("spdy", "----Stream[%d] WINDOW_UPDATE, delta_window_size:%" PRId64 "\n", stream_id, recv_window_consumed);
+    spdylay_submit_window_update(sm->session, stream_id, (int32_t)recv_window_consumed);
+    recv_window_consumed = 0;
+    sm->schedule_send();
+  }
+}
+
+void
+SpdyStream::recv_data(const uint8_t *data, size_t len)
+{
+  // Nobody reads it anymore, let the peer send the rest of it
+  if (closed || read_shutdown) {
+    credit_window(len);
+    return;
+  }
+
+  if (!recv_buffer) {
+    recv_buffer = new_MIOBuffer(BUFFER_SIZE_INDEX_4K);
+    recv_reader = recv_buffer->alloc_reader();
+  }
+  recv_buffer->write(data, len);
+
+  need_read = true;
+  setup_event_cb();
+}
+
+void
+SpdyStream::recv_end()
+{
+  if (recv_fin)
+    return;
+
+  recv_fin = true;
+  need_read = true;
+  setup_event_cb();
+}
+
+void
+SpdyStream::stream_closed(bool reset)
+{
+  Debug("spdy", "----Stream[%d] closed by spdylay, reset:%d\n", stream_id, reset);
+
+  spdy_closed = true;
+  spdy_reset = reset;
+
+  if (closed) {
+    if (recursion == 0)
+      destroy();
+    return;
+  }
+
+  need_read = true;
+  if (reset)
+    need_write = true;
+  setup_event_cb();
+}
+
+// ssize_t SpdyStream::send_body(uint8_t* buf, size_t length, int* eof)
+//
+//   Data provider of the SYN_REPLY. spdylay pulls the body out of the
+//     write VIO as its window allows, the FIN goes with the last byte.
+//
+ssize_t
+SpdyStream::send_body(uint8_t *buf, size_t length, int *eof)
+{
+  if (closed || write_shutdown) {
+    *eof = 1;
+    send_fin = true;
+    return 0;
+  }
+
+  IOBufferReader *reader = write_vio.get_reader();
+  if (write_vio.op != VIO::WRITE || !reader) {
+    send_deferred = true;
+    return SPDYLAY_ERR_DEFERRED;
+  }
+
+  int64_t ntodo = write_vio.ntodo();
+  int64_t act_on = MIN(MIN(reader->read_avail(), ntodo), (int64_t)length);
+
+  if (act_on <= 0 && ntodo > 0) {
+    send_deferred = true;
+    return SPDYLAY_ERR_DEFERRED;
+  }
+
+  if (act_on > 0) {
+    reader->read(buf, act_on);
+    write_vio.ndone += act_on;
+    update_inactive_time();
+  }
+
+  if (write_vio.ntodo() == 0) {
+    *eof = 1;
+    send_fin = true;
+  }
+
+  need_write = true;
+  setup_event_cb();
+  return act_on;
+}
+
+VIO *
+SpdyStream::do_io_read(Continuation * c, int64_t nbytes, MIOBuffer * buf)
+{
+  ink_assert(!closed);
+
+  if (buf) {
+    read_vio.buffer.writer_for(buf);
+  } else {
+    read_vio.buffer.clear();
+  }
+
+  // Note: we set vio.op last because process_read looks at it to
+  //  tell if the VConnection is active.
+  read_vio.mutex = c->mutex;
+  read_vio._cont = c;
+  read_vio.nbytes = nbytes;
+  read_vio.ndone = 0;
+  read_vio.vc_server = (VConnection *) this;
+  read_vio.op = VIO::READ;
+
+  // Since reentrant callbacks are not allowed on from do_io
+  //   functions schedule ourselves get on a different stack
+  need_read = true;
+  setup_event_cb();
+
+  return &read_vio;
+}
+
+VIO *
+SpdyStream::do_io_write(Continuation * c, int64_t nbytes, IOBufferReader * abuffer, bool owner)
+{
+  ink_assert(!closed);
+
+  if (abuffer) {
+    ink_assert(!owner);
+    write_vio.buffer.reader_for(abuffer);
+  } else {
+    write_vio.buffer.clear();
+  }
+
+  write_vio.mutex = c->mutex;
+  write_vio._cont = c;
+  write_vio.nbytes = nbytes;
+  write_vio.ndone = 0;
+  write_vio.vc_server = (VConnection *) this;
+  write_vio.op = VIO::WRITE;
+
+  resume_send();
+
+  return &write_vio;
+}
+
+void
+SpdyStream::reenable(VIO * vio)
+{
+  ink_assert(!closed);
+
+  if (vio->op == VIO::WRITE) {
+    ink_assert(vio == &write_vio);
+    resume_send();
+  } else if (vio->op == VIO::READ) {
+    ink_assert(vio == &read_vio);
+    need_read = true;
+    setup_event_cb();
+  } else {
+    ink_release_assert(0);
+  }
+}
+
+void
+SpdyStream::reenable_re(VIO * vio)
+{
+  reenable(vio);
+}
+
+// void SpdyStream::do_io_close(int lerrno)
+//
+//   A stream that sent its whole reply closes when the FIN is out,
+//     anything else is reset.
+//
+void
+SpdyStream::do_io_close(int alerrno)
+{
+  ink_assert(!closed);
+
+  closed = true;
+  read_vio.buffer.clear();
+  read_vio.op = VIO::NONE;
+  write_vio.buffer.clear();
+  write_vio.op = VIO::NONE;
+
+  if (sm && !spdy_closed) {
+    if (alerrno == -1 && reply_submitted && send_fin && recv_fin) {
+      Debug("spdy", "----Stream[%d] closed, waiting for the FIN to go out\n", stream_id);
+    } else {
+      Debug("spdy", "----Stream[%d] closed, resetting\n", stream_id);
+      spdylay_submit_rst_stream(sm->session, stream_id,
+                                alerrno == -1 ? SPDYLAY_CANCEL : SPDYLAY_INTERNAL_ERROR);
+    }
+    sm->schedule_send();
+  }
+
+  if (recursion == 0 && spdy_closed)
+    destroy();
+}
+
+void
+SpdyStream::do_io_shutdown(ShutdownHowTo_t howto)
+{
+  ink_assert(!closed);
+
+  switch (howto) {
+  case IO_SHUTDOWN_READ:
+    read_shutdown = true;
+    break;
+  case IO_SHUTDOWN_WRITE:
+    write_shutdown = true;
+    break;
+  case IO_SHUTDOWN_READWRITE:
+    read_shutdown = true;
+    write_shutdown = true;
+    break;
+  }
+
+  // A write shutdown sends the FIN
+  if (write_shutdown)
+    resume_send();
+}
+
+void
+SpdyStream::set_active_timeout(ink_hrtime timeout_in)
+{
+  active_timeout = timeout_in;
+
+  if (active_event) {
+    active_event->cancel();
+    active_event = NULL;
+  }
+
+  if (active_timeout > 0) {
+    active_event = eventProcessor.schedule_in(this, active_timeout);
+  }
+}
+
+void
+SpdyStream::set_inactivity_timeout(ink_hrtime timeout_in)
+{
+  inactive_timeout = timeout_in;
+
+  if (inactive_event) {
+    inactive_event->cancel();
+    inactive_event = NULL;
+  }
+
+  if (inactive_timeout > 0) {
+    inactive_event = eventProcessor.schedule_in(this, inactive_timeout);
+  }
+}
+
+void
+SpdyStream::cancel_active_timeout()
+{
+  set_active_timeout(0);
+}
+
+void
+SpdyStream::cancel_inactivity_timeout()
+{
+  set_inactivity_timeout(0);
+}
+
+ink_hrtime
+SpdyStream::get_active_timeout()
+{
+  return active_timeout;
+}
+
+ink_hrtime
+SpdyStream::get_inactivity_timeout()
+{
+  return inactive_timeout;
+}
+
+void
+SpdyStream::set_flow_ctl(int op, uint64_t flowctr)
+{
+  // the SPDY window is the flow control of a stream
+}
+
+void
+SpdyStream::cancel_flow_ctl(int op)
+{
+
+}
+
+void
+SpdyStream::apply_options()
+{
+  // do nothing
+}
+
+SOCKET
+SpdyStream::get_socket()
+{
+  return 0;
+}
+
+int
+SpdyStream::set_tcp_init_cwnd(int init_cwnd)
+{
+  return -1;
+}
+
+void
+SpdyStream::set_local_addr()
+{
+  // copied from the session connection in init()
+}
+
+void
+SpdyStream::set_remote_addr()
+{
+  // copied from the session connection in init()
+}
+
+bool
+SpdyStream::get_data(int id, void *data)
+{
+  if (data == NULL) {
+    return false;
+  }
+  switch (id) {
+  case NET_DATA_REQUEST_HDR:
+    *(HTTPHdr **) data = &request;
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool
+SpdyStream::set_data(int id, void *data)
+{
+  switch (id) {
+  case NET_DATA_RESPONSE_HDR: {
+    if (data == NULL || !sm || closed || spdy_closed || reply_submitted) {
+      return false;
+    }
+
+    SpdyNV spdy_nv((HTTPHdr *) data);
+    spdylay_data_provider data_prd;
+
+    data_prd.source.ptr = (void *) this;
+    data_prd.read_callback = spdy_stream_read_callback;
+
+    Debug("spdy", "----spdylay_submit_response, stream_id:%d\n", stream_id);
+    if (spdylay_submit_response(sm->session, stream_id, spdy_nv.nv, &data_prd) != 0) {
+      return false;
+    }
+    reply_submitted = true;
+    sm->schedule_send();
+    return true;
+  }
+  default:
+    return false;
+  }
+}
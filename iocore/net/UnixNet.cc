@@ -104,6 +104,8 @@ PollCont::pollEvent(int event, Event *e) {
       poll_timeout = net_config_poll_timeout;
     }
   }
+  // the wait is idle time for the thread load accounting
+  ink_hrtime wait_start = poll_timeout ? ink_get_hrtime_internal() : 0;
   // wait for fd's to tigger, or don't wait if timeout is 0
 #if TS_USE_EPOLL
   pollDescriptor->result = epoll_wait(pollDescriptor->epoll_fd,
@@ -152,6 +154,11 @@ PollCont::pollEvent(int event, Event *e) {
 #else
 #error port me
 #endif
+  if (wait_start) {
+    EThread *t = this_ethread();
+    if (t)
+      t->idle_time += ink_get_hrtime_internal() - wait_start;
+  }
   return EVENT_CONT;
 }
 
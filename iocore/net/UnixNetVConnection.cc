@@ -172,6 +172,14 @@ void
 close_UnixNetVConnection(UnixNetVConnection *vc, EThread *t)
 {
   NetHandler *nh = vc->nh;
+
+  // A crypto thread is using the connection, it is closed when the
+  // handshake step comes back.
+  if (vc->getSSLHandShakeOffloaded()) {
+    if (!vc->closed)
+      vc->closed = 1;
+    return;
+  }
   vc->cancel_OOB();
   vc->ep.stop();
   vc->con.close();
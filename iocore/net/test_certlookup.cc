@@ -77,6 +77,51 @@ REGRESSION_TEST(SSLCertificateLookup)(RegressionTest* t, int atype, int * pstatu
   // Basic hostname cases.
   box.check(lookup.findInfoInHash("www.foo.com") == foo, "host lookup for www.foo.com");
   box.check(lookup.findInfoInHash("www.bar.com") == NULL, "host lookup for www.bar.com");
+
+  // Names match on whole labels, case insensitively.
+  box.check(lookup.findInfoInHash("wildcard.com") == NULL, "wildcard lookup for wildcard.com");
+  box.check(lookup.findInfoInHash("a.b.wild.com") == wild, "wildcard lookup for a.b.wild.com");
+  box.check(lookup.findInfoInHash("WWW.Foo.COM") == foo, "host lookup for WWW.Foo.COM");
+  box.check(lookup.findInfoInHash("foo.com") == NULL, "host lookup for foo.com");
+}
+
+static int lazy_loads = 0;
+
+static SSL_CTX *
+lazy_load(SSLCertContext *)
+{
+  ++lazy_loads;
+  return SSL_CTX_new(SSLv23_server_method());
+}
+
+REGRESSION_TEST(SSLLazyContext)(RegressionTest* t, int atype, int * pstatus)
+{
+  TestBox       box(t, pstatus);
+  SSLCertLookup lookup;
+
+  SSL_CTX * base = SSL_CTX_new(SSLv23_server_method());
+  SSL * ssl = SSL_new(base);
+  SSLCertContext * a = NEW(new SSLCertContext());
+  SSLCertContext * b = NEW(new SSLCertContext());
+
+  box = REGRESSION_TEST_PASSED;
+
+  a->lazy = b->lazy = true;
+  box.check(lookup.insert(a, "a.lazy.com"), "insert lazy context");
+  box.check(lookup.insert(b, "*.b.lazy.com"), "insert lazy wildcard context");
+  box.check(lookup.find("x.b.lazy.com") == b, "find lazy wildcard context");
+  box.check(lookup.findInfoInHash("a.lazy.com") == NULL, "lazy context is not loaded");
+
+  // Only one of them stays loaded.
+  box.check(a->select(ssl, lazy_load, 1) != NULL && lazy_loads == 1, "load on first use");
+  box.check(SSL_get_SSL_CTX(ssl) == a->ctx, "select loaded context");
+  box.check(a->select(ssl, lazy_load, 1) == a->ctx && lazy_loads == 1, "select loaded context again");
+  box.check(b->select(ssl, lazy_load, 1) != NULL && lazy_loads == 2, "load second context");
+  box.check(a->ctx == NULL && b->ctx != NULL, "least recently used context evicted");
+  box.check(a->select(ssl, lazy_load, 1) != NULL && lazy_loads == 3, "reload evicted context");
+
+  SSL_free(ssl);
+  SSL_CTX_free(base);
 }
 
 REGRESSION_TEST(SSLAddressLookup)(RegressionTest* t, int atype, int * pstatus)
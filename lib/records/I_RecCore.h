@@ -88,11 +88,12 @@ int RecRegisterRawStatUpdateFunc(const char *name, RecRawStatBlock * rsb, int id
 // Record Reading/Writing
 //-------------------------------------------------------------------------
 
-// WARNING!  Avoid deadlocks by calling the following set/get calls
-// with the appropiate locking conventions.  If you're calling these
+// WARNING!  Avoid deadlocks by calling the following set calls with
+// the appropiate locking conventions.  If you're calling these
 // functions from a configuration update callback (RecConfigUpdateCb),
-// be sure to set 'lock' to 'false' as the hash-table rwlock has
-// already been taken out for the callback.
+// be sure to set 'lock' to 'false' as the records rwlock has already
+// been taken out for the callback.  The get calls never take the
+// rwlock, their 'lock' argument is only kept for compatibility.
 
 // RecSetRecordConvert -> WebMgmtUtils.cc::varSetFromStr()
 int RecSetRecordConvert(const char *name, const RecString rec_string, bool lock = true, bool inc_version = true);
@@ -109,6 +110,21 @@ int RecGetRecordCounter(const char *name, RecCounter * rec_counter, bool lock =
 // Convenience to allow us to treat the RecInt as a single byte internally
 int RecGetRecordByte(const char *name, RecByte * rec_byte, bool lock = true);
 
+//------------------------------------------------------------------------
+// Record Handles
+//------------------------------------------------------------------------
+
+// Records are never freed or moved, so a name can be resolved once with
+// RecLookupRecord() and the handle read on every transaction after that,
+// skipping the name lookup.  The lookup itself takes no lock either.
+struct RecRecord;
+
+RecRecord *RecLookupRecord(const char *name);
+int RecGetRecordIntByHandle(RecRecord * r, RecInt * rec_int);
+int RecGetRecordFloatByHandle(RecRecord * r, RecFloat * rec_float);
+int RecGetRecordString_XmallocByHandle(RecRecord * r, RecString * rec_string);
+int RecGetRecordCounterByHandle(RecRecord * r, RecCounter * rec_counter);
+
 //------------------------------------------------------------------------
 // Record Attributes Reading
 //------------------------------------------------------------------------
@@ -160,6 +160,38 @@ struct RecRawStatBlock
 };
 
 
+//-------------------------------------------------------------------------
+// Histograms
+//-------------------------------------------------------------------------
+// Log-linear buckets: the values below REC_HISTOGRAM_SUB_BUCKETS get a
+// bucket each, every power of two above is split in
+// REC_HISTOGRAM_SUB_BUCKETS equal buckets (so a bucket is at most 1/16 of
+// its lower bound wide).  Values of 2^REC_HISTOGRAM_MAX_BITS and more all
+// go in the last bucket.
+#define REC_HISTOGRAM_SUB_BITS     4
+#define REC_HISTOGRAM_SUB_BUCKETS  (1 << REC_HISTOGRAM_SUB_BITS)
+#define REC_HISTOGRAM_MAX_BITS     36
+#define REC_HISTOGRAM_BUCKETS      ((REC_HISTOGRAM_MAX_BITS - REC_HISTOGRAM_SUB_BITS + 1) * REC_HISTOGRAM_SUB_BUCKETS)
+
+struct RecHistogram
+{
+  int64_t sum;
+  int64_t buckets[REC_HISTOGRAM_BUCKETS];
+};
+
+struct RecHistogramInfo;
+
+// Same rule as for the RecRawStatBlock, hands off.
+struct RecHistogramBlock
+{
+  off_t ethr_stat_offset;       // thread local histogram storage
+  RecHistogramInfo *info;       // records and merged totals, per histogram
+  int num_hists;
+  int max_hists;
+  RecHistogramBlock *next;      // list of all the blocks, for the sync
+};
+
+
 //-------------------------------------------------------------------------
 // RecCore Callback Types
 //-------------------------------------------------------------------------
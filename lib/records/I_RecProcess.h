@@ -49,6 +49,24 @@ RecRawStatBlock *RecAllocateRawStatBlock(int num_stats);
 int RecRegisterRawStat(RecRawStatBlock * rsb, RecT rec_type, const char *name, RecDataT data_type, RecPersistT persist_type, int id, RecRawStatSyncCb sync_cb);
 
 
+//-------------------------------------------------------------------------
+// Histogram Registration
+//-------------------------------------------------------------------------
+// A histogram registered as 'name' is exported as the stats
+//   name.count, name.sum   samples and their sum since startup
+//   name.buckets           "lower:count,..." of the non empty buckets
+//   name.p50 ... name.p999 percentiles (bucket upper bounds) of the
+//                          samples of the last one to two minutes
+// which are updated by the raw stat sync.
+RecHistogramBlock *RecAllocateHistogramBlock(int num_hists);
+int RecRegisterHistogram(RecHistogramBlock * rhb, RecT rec_type, const char *name, int id);
+int RecGetHistogram(RecHistogramBlock * rhb, int id, RecHistogram * total);
+
+// Note: like RecIncrRawStat, this only touches the calling thread's
+// slots, no ink_atomic_xxx64()'s or locks.
+inline int RecRecordHistogram(RecHistogramBlock * rhb, EThread * ethread, int id, int64_t value);
+
+
 // RecRawStatRange* RecAllocateRawStatRange (int num_buckets);
 
 // int RecRegisterRawStatRange (RecRawStatRange *rsr,
@@ -162,4 +180,58 @@ RecIncrRawStatCount(RecRawStatBlock * rsb, EThread * ethread, int id, int64_t in
   return REC_ERR_OKAY;
 }
 
+
+//-------------------------------------------------------------------------
+// RecRecordHistogram
+//-------------------------------------------------------------------------
+inline int
+rec_histogram_bucket(int64_t value)
+{
+  if (value < REC_HISTOGRAM_SUB_BUCKETS)
+    return value < 0 ? 0 : (int) value;
+  int msb = 63 - __builtin_clzll((unsigned long long) value);
+  if (msb >= REC_HISTOGRAM_MAX_BITS)
+    return REC_HISTOGRAM_BUCKETS - 1;
+  int shift = msb - REC_HISTOGRAM_SUB_BITS;
+  return ((shift + 1) << REC_HISTOGRAM_SUB_BITS) + (int) ((value >> shift) - REC_HISTOGRAM_SUB_BUCKETS);
+}
+
+// smallest value of bucket i
+inline int64_t
+rec_histogram_bucket_lower(int i)
+{
+  if (i < REC_HISTOGRAM_SUB_BUCKETS)
+    return i;
+  int shift = (i >> REC_HISTOGRAM_SUB_BITS) - 1;
+  return ((int64_t) (REC_HISTOGRAM_SUB_BUCKETS + (i & (REC_HISTOGRAM_SUB_BUCKETS - 1)))) << shift;
+}
+
+// largest value of bucket i (the last bucket is open ended)
+inline int64_t
+rec_histogram_bucket_upper(int i)
+{
+  if (i < REC_HISTOGRAM_SUB_BUCKETS)
+    return i;
+  return rec_histogram_bucket_lower(i) + (((int64_t) 1) << ((i >> REC_HISTOGRAM_SUB_BITS) - 1)) - 1;
+}
+
+inline RecHistogram *
+rec_histogram_get_tlp(RecHistogramBlock * rhb, int id, EThread * ethread)
+{
+  ink_debug_assert((id >= 0) && (id < rhb->max_hists));
+  if (ethread == NULL) {
+    ethread = this_ethread();
+  }
+  return (((RecHistogram *) ((char *) (ethread) + rhb->ethr_stat_offset)) + id);
+}
+
+inline int
+RecRecordHistogram(RecHistogramBlock * rhb, EThread * ethread, int id, int64_t value)
+{
+  RecHistogram *tlp = rec_histogram_get_tlp(rhb, id, ethread);
+  tlp->buckets[rec_histogram_bucket(value)] += 1;
+  tlp->sum += value;
+  return REC_ERR_OKAY;
+}
+
 #endif /* !_I_REC_PROCESS_H_ */
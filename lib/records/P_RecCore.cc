@@ -28,6 +28,7 @@
 #include "P_RecCompatibility.h"
 #include "P_RecUtils.h"
 #include "P_RecMessage.h"
+#include "P_RecShm.h"
 #include "P_RecCore.h"
 
 RecModeT g_mode_type = RECM_NULL;
@@ -83,6 +84,9 @@ send_push_message()
   int i, num_records;
   bool send_msg = false;
 
+  // whatever fits in the shared stats segment doesn't need a message
+  RecShmExport();
+
   m = RecMessageAlloc(RECG_PUSH);
   num_records = g_num_records;
   for (i = 0; i < num_records; i++) {
@@ -351,12 +355,12 @@ RecSetRecord(RecT rec_type, const char *name, RecDataT data_type, RecData *data,
   RecRecord *r1;
 
   // FIXME: Most of the time we set, we don't actually need to wrlock
-  // since we are not modifying the g_records_ht.
+  // since we are not modifying the record index.
   if (lock) {
     ink_rwlock_wrlock(&g_records_rwlock);
   }
 
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r1)) {
+  if ((r1 = RecLookupRecord(name)) != NULL) {
     if (i_am_the_record_owner(r1->rec_type)) {
       rec_mutex_acquire(&(r1->lock));
       if ((data_type != RECD_NULL) && (r1->data_type != data_type)) {
@@ -436,7 +440,7 @@ RecSetRecord(RecT rec_type, const char *name, RecDataT data_type, RecData *data,
     } else {
       err = send_set_message(r1);
     }
-    ink_hash_table_insert(g_records_ht, name, (void *) r1);
+    RecIndexInsert(r1);
 
   }
 
@@ -794,7 +798,7 @@ RecSyncConfigToTB(textBuffer * tb, bool *inc_version)
           tb->copyFrom(cfe->entry, strlen(cfe->entry));
           tb->copyFrom("\n", 1);
         } else {
-          if (ink_hash_table_lookup(g_records_ht, cfe->entry, (void **) &r)) {
+          if ((r = RecLookupRecord(cfe->entry)) != NULL) {
             rec_mutex_acquire(&(r->lock));
             // rec_type
             switch (r->rec_type) {
@@ -912,7 +916,7 @@ RecResetStatRecord(char *name)
   RecRecord *r1 = NULL;
   int err = REC_ERR_OKAY;
 
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r1)) {
+  if ((r1 = RecLookupRecord(name)) != NULL) {
     if (i_am_the_record_owner(r1->rec_type)) {
       rec_mutex_acquire(&(r1->lock));
       RecDataSet(r1->data_type, &(r1->data), &(r1->data_default));
@@ -983,12 +987,12 @@ RecSetSyncRequired(char *name, bool lock)
   RecRecord *r1;
 
   // FIXME: Most of the time we set, we don't actually need to wrlock
-  // since we are not modifying the g_records_ht.
+  // since we are not modifying the record index.
   if (lock) {
     ink_rwlock_wrlock(&g_records_rwlock);
   }
 
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r1)) {
+  if ((r1 = RecLookupRecord(name)) != NULL) {
     if (i_am_the_record_owner(r1->rec_type)) {
       rec_mutex_acquire(&(r1->lock));
       r1->sync_required = REC_SYNC_REQUIRED;
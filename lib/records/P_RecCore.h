@@ -34,9 +34,9 @@
 #include "P_RecDefs.h"
 #include "P_RecTree.h"
 
-// records, record hash-table, and hash-table rwlock
+// records and the rwlock serializing their registration and sets (the
+// name index itself is read without it, see RecLookupRecord)
 extern RecRecord *g_records;
-extern InkHashTable *g_records_ht;
 extern ink_rwlock g_records_rwlock;
 extern int g_num_records;
 extern int g_num_update[];
@@ -58,6 +58,12 @@ extern const char *g_stats_snap_fpath;
 
 int RecCoreInit(RecModeT mode_type, Diags * diags);
 
+//-------------------------------------------------------------------------
+// Record Index
+//-------------------------------------------------------------------------
+
+void RecIndexInsert(RecRecord * r);
+
 //-------------------------------------------------------------------------
 // Registration/Insertion
 //-------------------------------------------------------------------------
@@ -79,6 +85,7 @@ int RecSetRecord(RecT rec_type, const char *name, RecDataT data_type,
                  RecData *data, RecRawStat *raw_stat, bool lock = true, bool inc_version = true);
 
 int RecGetRecord_Xmalloc(const char *name, RecDataT data_type, RecData * data, bool lock = true);
+int RecGetRecordByHandle_Xmalloc(RecRecord * r, RecDataT data_type, RecData * data);
 
 //-------------------------------------------------------------------------
 // Read/Sync to Disk
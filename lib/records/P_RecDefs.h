@@ -31,6 +31,7 @@
 #define REC_CONFIG_FILE                "records.config"
 #define REC_SHADOW_EXT                 ".shadow"
 #define REC_RAW_STATS_FILE             "records.snap"
+#define REC_SHM_STATS_FILE             "stats.shm"
 #define REC_PIPE_NAME                  "librecords_pipe"
 
 #define REC_MESSAGE_ELE_MAGIC           0xF00DF00D
@@ -42,8 +43,10 @@
 
 #define REC_CONFIG_UPDATE_INTERVAL_MS  3000
 #define REC_REMOTE_SYNC_INTERVAL_MS    5000
+#define REC_SHM_IMPORT_INTERVAL_MS     1000
 
 #define REC_RAW_STAT_SYNC_INTERVAL_MS  5000
+#define REC_HISTOGRAM_WINDOW_MS        60000
 #define REC_STAT_UPDATE_INTERVAL_MS    10000
 
 //-------------------------------------------------------------------------
@@ -125,6 +128,7 @@ struct RecRecord
   };
   int order;
   int rsb_id;
+  uint32_t name_hash;           // set when the record goes in the index
 };
 
 // Used for cluster. TODO: Do we still need this?
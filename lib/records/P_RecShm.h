@@ -0,0 +1,84 @@
+/** @file
+
+  Private shared memory stats segment declarations
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#ifndef _P_REC_SHM_H_
+#define _P_REC_SHM_H_
+
+#include "P_RecDefs.h"
+
+//-------------------------------------------------------------------------
+// Segment Layout
+//-------------------------------------------------------------------------
+
+// The server (librecprocess) owns the segment and writes its stats in
+// place, one slot per record id (RecRecord::order), every slot guarded
+// by its own seqlock: 'seq' is odd while a write is in progress.  The
+// manager (libreclocal) maps it and pulls the slots whose 'seq' moved;
+// the only thing it writes is 'acked_generation', once it has attached
+// to the current generation.  Until then the server keeps the records
+// marked for peer sync and they go through RECG_PUSH messages, as do
+// the stats that don't fit (strings, long names).
+
+#define REC_SHM_MAGIC                   0x52534853      // "RSHS"
+#define REC_SHM_VERSION                 2
+#define REC_SHM_NAME_LEN                128
+
+struct RecShmSlot
+{
+  volatile int32_t seq;
+  int32_t rec_type;
+  int32_t data_type;
+  int32_t reserved;
+  RecData data;
+  RecRawStat data_raw;
+  char name[REC_SHM_NAME_LEN];
+};
+
+struct RecShmHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  int32_t num_slots;
+  volatile int32_t num_used;    // high water mark of the written slots
+  volatile int32_t generation;  // bumped every time the server starts
+  volatile int32_t acked_generation;    // written by the manager
+  int32_t reserved[2];
+  RecShmSlot slots[1];
+};
+
+#define REC_SHM_SIZE(_n)  (sizeof(RecShmHeader) + ((_n) - 1) * sizeof(RecShmSlot))
+
+//-------------------------------------------------------------------------
+// Server Side
+//-------------------------------------------------------------------------
+
+int RecShmCreate();
+int RecShmExport();
+
+//-------------------------------------------------------------------------
+// Manager Side
+//-------------------------------------------------------------------------
+
+int RecShmImport();
+
+#endif
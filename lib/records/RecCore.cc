@@ -34,7 +34,6 @@ static bool g_initialized = false;
 Diags *g_diags = NULL;
 
 RecRecord *g_records = NULL;
-InkHashTable *g_records_ht = NULL;
 ink_rwlock g_records_rwlock;
 int g_num_records = 0;
 
@@ -48,6 +47,72 @@ int g_num_update[RECT_MAX];
 
 RecTree *g_records_tree = NULL;
 
+//-------------------------------------------------------------------------
+// Record index
+//
+// Open addressed name -> record table.  It is sized once in RecCoreInit()
+// to twice REC_MAX_RECORDS (RecAlloc() refuses more records) so it never
+// has to be rehashed, and since records are never removed a slot only
+// ever goes from NULL to a record.  Writers fill the record in before
+// claiming the slot with a CAS, so readers walk the table with no lock.
+//-------------------------------------------------------------------------
+static RecRecord * volatile *g_records_index = NULL;
+static uint32_t g_records_index_mask = 0;
+
+static inline uint32_t
+rec_index_hash(const char *name)
+{
+  // FNV-1a
+  uint32_t hash = 2166136261U;
+
+  for (const unsigned char *p = (const unsigned char *) name; *p; ++p) {
+    hash ^= *p;
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+static void
+rec_index_init()
+{
+  uint32_t slots = 1;
+
+  while (slots < 2 * REC_MAX_RECORDS) {
+    slots <<= 1;
+  }
+  g_records_index = (RecRecord * volatile *)ats_malloc(slots * sizeof(RecRecord *));
+  memset((void *) g_records_index, 0, slots * sizeof(RecRecord *));
+  g_records_index_mask = slots - 1;
+}
+
+void
+RecIndexInsert(RecRecord *r)
+{
+  uint32_t i;
+
+  r->name_hash = rec_index_hash(r->name);
+  for (i = r->name_hash & g_records_index_mask;; i = (i + 1) & g_records_index_mask) {
+    if (g_records_index[i] == NULL && ink_atomic_cas_ptr((pvvoidp) &g_records_index[i], NULL, r)) {
+      break;
+    }
+  }
+}
+
+RecRecord *
+RecLookupRecord(const char *name)
+{
+  uint32_t hash = rec_index_hash(name);
+  RecRecord *r;
+
+  for (uint32_t i = hash & g_records_index_mask; (r = g_records_index[i]) != NULL; i = (i + 1) & g_records_index_mask) {
+    if (r->name_hash == hash && strcmp(r->name, name) == 0) {
+      return r;
+    }
+  }
+  return NULL;
+}
+
+
 //-------------------------------------------------------------------------
 // register_record
 //-------------------------------------------------------------------------
@@ -56,7 +121,7 @@ register_record(RecT rec_type, const char *name, RecDataT data_type, RecData dat
 {
   RecRecord *r = NULL;
 
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     ink_release_assert(r->rec_type == rec_type);
     ink_release_assert(r->data_type == data_type);
     // Note: do not set r->data as we want to keep the previous value
@@ -68,7 +133,7 @@ register_record(RecT rec_type, const char *name, RecDataT data_type, RecData dat
     // Set the r->data to its default value as this is a new record
     RecDataSet(r->data_type, &(r->data), &(data_default));
     RecDataSet(r->data_type, &(r->data_default), &(data_default));
-    ink_hash_table_insert(g_records_ht, name, (void *) r);
+    RecIndexInsert(r);
   }
 
   // we're now registered
@@ -183,12 +248,9 @@ RecCoreInit(RecModeT mode_type, Diags *_diags)
   g_records = (RecRecord *)ats_malloc(REC_MAX_RECORDS * sizeof(RecRecord));
   memset(g_records, 0, REC_MAX_RECORDS * sizeof(RecRecord));
 
-  // initialize record hash index
-  g_records_ht = ink_hash_table_create(InkHashTableKeyType_String);
+  // initialize record index
+  rec_index_init();
   ink_rwlock_init(&g_records_rwlock);
-  if (!g_records_ht) {
-    return REC_ERR_FAIL;
-  }
   // read stats
   if ((mode_type == RECM_SERVER) || (mode_type == RECM_STAND_ALONE)) {
     g_stats_snap_fpath = Layout::relative_to(Layout::get()->runtimedir, REC_RAW_STATS_FILE);
@@ -314,7 +376,7 @@ RecRegisterConfigUpdateCb(const char *name, RecConfigUpdateCb update_cb, void *c
 
   ink_rwlock_rdlock(&g_records_rwlock);
 
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     rec_mutex_acquire(&(r->lock));
     if (REC_TYPE_IS_CONFIG(r->rec_type)) {
       /* -- upgrade to support a list of callback functions
@@ -383,12 +445,10 @@ RecGetRecordFloat(const char *name, RecFloat * rec_float, bool lock)
 int
 RecGetRecordString(const char *name, char *buf, int buf_len, bool lock)
 {
+  REC_NOWARN_UNUSED(lock);
   int err = REC_ERR_OKAY;
   RecRecord *r;
-  if (lock) {
-    ink_rwlock_rdlock(&g_records_rwlock);
-  }
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     rec_mutex_acquire(&(r->lock));
     if (!r->registered || (r->data_type != RECD_STRING)) {
       err = REC_ERR_FAIL;
@@ -403,9 +463,6 @@ RecGetRecordString(const char *name, char *buf, int buf_len, bool lock)
   } else {
     err = REC_ERR_FAIL;
   }
-  if (lock) {
-    ink_rwlock_unlock(&g_records_rwlock);
-  }
   return err;
 }
 
@@ -440,30 +497,67 @@ RecGetRecordByte(const char *name, RecByte *rec_byte, bool lock)
 }
 
 
+//-------------------------------------------------------------------------
+// RecGetRecordXXXByHandle
+//-------------------------------------------------------------------------
+int
+RecGetRecordIntByHandle(RecRecord *r, RecInt *rec_int)
+{
+  int err;
+  RecData data;
+  if ((err = RecGetRecordByHandle_Xmalloc(r, RECD_INT, &data)) == REC_ERR_OKAY)
+    *rec_int = data.rec_int;
+  return err;
+}
+
+int
+RecGetRecordFloatByHandle(RecRecord *r, RecFloat *rec_float)
+{
+  int err;
+  RecData data;
+  if ((err = RecGetRecordByHandle_Xmalloc(r, RECD_FLOAT, &data)) == REC_ERR_OKAY)
+    *rec_float = data.rec_float;
+  return err;
+}
+
+int
+RecGetRecordString_XmallocByHandle(RecRecord *r, RecString *rec_string)
+{
+  int err;
+  RecData data;
+  if ((err = RecGetRecordByHandle_Xmalloc(r, RECD_STRING, &data)) == REC_ERR_OKAY)
+    *rec_string = data.rec_string;
+  return err;
+}
+
+int
+RecGetRecordCounterByHandle(RecRecord *r, RecCounter *rec_counter)
+{
+  int err;
+  RecData data;
+  if ((err = RecGetRecordByHandle_Xmalloc(r, RECD_COUNTER, &data)) == REC_ERR_OKAY)
+    *rec_counter = data.rec_counter;
+  return err;
+}
+
+
 //-------------------------------------------------------------------------
 // RecGetRec Attributes
 //-------------------------------------------------------------------------
 int
 RecGetRecordType(const char *name, RecT * rec_type, bool lock)
 {
+  REC_NOWARN_UNUSED(lock);
   int err = REC_ERR_FAIL;
   RecRecord *r;
 
-  if (lock) {
-    ink_rwlock_rdlock(&g_records_rwlock);
-  }
-
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     rec_mutex_acquire(&(r->lock));
     *rec_type = r->rec_type;
     err = REC_ERR_OKAY;
     rec_mutex_release(&(r->lock));
   }
 
-  if (lock) {
-    ink_rwlock_unlock(&g_records_rwlock);
-  }
-
   return err;
 }
 
@@ -471,14 +565,11 @@ RecGetRecordType(const char *name, RecT * rec_type, bool lock)
 int
 RecGetRecordDataType(const char *name, RecDataT * data_type, bool lock)
 {
+  REC_NOWARN_UNUSED(lock);
   int err = REC_ERR_FAIL;
   RecRecord *r = NULL;
 
-  if (lock) {
-    ink_rwlock_rdlock(&g_records_rwlock);
-  }
-
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     rec_mutex_acquire(&(r->lock));
     if (!r->registered) {
       err = REC_ERR_FAIL;
@@ -489,10 +580,6 @@ RecGetRecordDataType(const char *name, RecDataT * data_type, bool lock)
     rec_mutex_release(&(r->lock));
   }
 
-  if (lock) {
-    ink_rwlock_unlock(&g_records_rwlock);
-  }
-
   return err;
 }
 
@@ -505,14 +592,11 @@ RecGetRecordUpdateCount(RecT data_type)
 int
 RecGetRecordOrderAndId(const char *name, int* order, int* id, bool lock)
 {
+  REC_NOWARN_UNUSED(lock);
   int err = REC_ERR_FAIL;
   RecRecord *r = NULL;
 
-  if (lock) {
-    ink_rwlock_rdlock(&g_records_rwlock);
-  }
-
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     rec_mutex_acquire(&(r->lock));
     if (order)
       *order = r->order;
@@ -522,24 +606,17 @@ RecGetRecordOrderAndId(const char *name, int* order, int* id, bool lock)
     rec_mutex_release(&(r->lock));
   }
 
-  if (lock) {
-    ink_rwlock_unlock(&g_records_rwlock);
-  }
-
   return err;
 }
 
 int
 RecGetRecordUpdateType(const char *name, RecUpdateT *update_type, bool lock)
 {
+  REC_NOWARN_UNUSED(lock);
   int err = REC_ERR_FAIL;
   RecRecord *r = NULL;
 
-  if (lock) {
-    ink_rwlock_rdlock(&g_records_rwlock);
-  }
-
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     rec_mutex_acquire(&(r->lock));
     if (REC_TYPE_IS_CONFIG(r->rec_type)) {
       *update_type = r->config_meta.update_type;
@@ -550,10 +627,6 @@ RecGetRecordUpdateType(const char *name, RecUpdateT *update_type, bool lock)
     rec_mutex_release(&(r->lock));
   }
 
-  if (lock) {
-    ink_rwlock_unlock(&g_records_rwlock);
-  }
-
   return err;
 }
 
@@ -561,14 +634,11 @@ RecGetRecordUpdateType(const char *name, RecUpdateT *update_type, bool lock)
 int
 RecGetRecordCheckType(const char *name, RecCheckT *check_type, bool lock)
 {
+  REC_NOWARN_UNUSED(lock);
   int err = REC_ERR_FAIL;
   RecRecord *r = NULL;
 
-  if (lock) {
-    ink_rwlock_rdlock(&g_records_rwlock);
-  }
-
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     rec_mutex_acquire(&(r->lock));
     if (REC_TYPE_IS_CONFIG(r->rec_type)) {
       *check_type = r->config_meta.check_type;
@@ -579,10 +649,6 @@ RecGetRecordCheckType(const char *name, RecCheckT *check_type, bool lock)
     rec_mutex_release(&(r->lock));
   }
 
-  if (lock) {
-    ink_rwlock_unlock(&g_records_rwlock);
-  }
-
   return err;
 }
 
@@ -590,14 +656,11 @@ RecGetRecordCheckType(const char *name, RecCheckT *check_type, bool lock)
 int
 RecGetRecordCheckExpr(const char *name, char **check_expr, bool lock)
 {
+  REC_NOWARN_UNUSED(lock);
   int err = REC_ERR_FAIL;
   RecRecord *r = NULL;
 
-  if (lock) {
-    ink_rwlock_rdlock(&g_records_rwlock);
-  }
-
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     rec_mutex_acquire(&(r->lock));
     if (REC_TYPE_IS_CONFIG(r->rec_type)) {
       *check_expr = r->config_meta.check_expr;
@@ -608,10 +671,6 @@ RecGetRecordCheckExpr(const char *name, char **check_expr, bool lock)
     rec_mutex_release(&(r->lock));
   }
 
-  if (lock) {
-    ink_rwlock_unlock(&g_records_rwlock);
-  }
-
   return err;
 }
 
@@ -623,7 +682,7 @@ RecGetRecordDefaultDataString_Xmalloc(char *name, char **buf, bool lock)
   int err;
   RecRecord *r = NULL;
 
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     *buf = (char *)ats_malloc(sizeof(char) * 1024);
     memset(*buf, 0, 1024);
     err = REC_ERR_OKAY;
@@ -663,24 +722,17 @@ RecGetRecordDefaultDataString_Xmalloc(char *name, char **buf, bool lock)
 int
 RecGetRecordAccessType(const char *name, RecAccessT *access, bool lock)
 {
+  REC_NOWARN_UNUSED(lock);
   int err = REC_ERR_FAIL;
   RecRecord *r = NULL;
 
-  if (lock) {
-    ink_rwlock_rdlock(&g_records_rwlock);
-  }
-
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     rec_mutex_acquire(&(r->lock));
     *access = r->config_meta.access_type;
     err = REC_ERR_OKAY;
     rec_mutex_release(&(r->lock));
   }
 
-  if (lock) {
-    ink_rwlock_unlock(&g_records_rwlock);
-  }
-
   return err;
 }
 
@@ -695,7 +747,7 @@ RecSetRecordAccessType(const char *name, RecAccessT access, bool lock)
     ink_rwlock_rdlock(&g_records_rwlock);
   }
 
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     rec_mutex_acquire(&(r->lock));
     r->config_meta.access_type = access;
     err = REC_ERR_OKAY;
@@ -763,14 +815,16 @@ RecRegisterConfig(RecT rec_type, const char *name, RecDataT data_type,
 int
 RecGetRecord_Xmalloc(const char *name, RecDataT data_type, RecData *data, bool lock)
 {
-  int err = REC_ERR_OKAY;
-  RecRecord *r;
+  REC_NOWARN_UNUSED(lock);
+  return RecGetRecordByHandle_Xmalloc(RecLookupRecord(name), data_type, data);
+}
 
-  if (lock) {
-    ink_rwlock_rdlock(&g_records_rwlock);
-  }
+int
+RecGetRecordByHandle_Xmalloc(RecRecord *r, RecDataT data_type, RecData *data)
+{
+  int err = REC_ERR_OKAY;
 
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if (r != NULL) {
     rec_mutex_acquire(&(r->lock));
     if (!r->registered || (r->data_type != data_type)) {
       err = REC_ERR_FAIL;
@@ -785,10 +839,6 @@ RecGetRecord_Xmalloc(const char *name, RecDataT data_type, RecData *data, bool l
     err = REC_ERR_FAIL;
   }
 
-  if (lock) {
-    ink_rwlock_unlock(&g_records_rwlock);
-  }
-
   return err;
 }
 
@@ -804,7 +854,7 @@ RecForceInsert(RecRecord * record)
 
   ink_rwlock_wrlock(&g_records_rwlock);
 
-  if (ink_hash_table_lookup(g_records_ht, record->name, (void **) &r)) {
+  if ((r = RecLookupRecord(record->name)) != NULL) {
     r_is_a_new_record = false;
     rec_mutex_acquire(&(r->lock));
     r->rec_type = record->rec_type;
@@ -834,7 +884,7 @@ RecForceInsert(RecRecord * record)
   }
 
   if (r_is_a_new_record) {
-    ink_hash_table_insert(g_records_ht, r->name, (void *) r);
+    RecIndexInsert(r);
   } else {
     rec_mutex_release(&(r->lock));
   }
@@ -26,6 +26,7 @@
 #include "P_RecCore.h"
 #include "P_RecLocal.h"
 #include "P_RecMessage.h"
+#include "P_RecShm.h"
 #include "P_RecUtils.h"
 #include "P_RecCompatibility.h"
 
@@ -133,6 +134,21 @@ sync_thr(void *data)
   return NULL;
 }
 
+
+//-------------------------------------------------------------------------
+// shm_import_thr
+//-------------------------------------------------------------------------
+static void *
+shm_import_thr(void *data)
+{
+  REC_NOWARN_UNUSED(data);
+  while (true) {
+    RecShmImport();
+    usleep(REC_SHM_IMPORT_INTERVAL_MS * 1000);
+  }
+  return NULL;
+}
+
 #endif
 
 
@@ -213,6 +229,9 @@ RecLocalStart()
 {
   ink_thread_create(sync_thr, NULL);
   ink_thread_create(config_update_thr, NULL);
+#if defined (REC_BUILD_MGMT)
+  ink_thread_create(shm_import_thr, NULL);
+#endif
 
   return REC_ERR_OKAY;
 }
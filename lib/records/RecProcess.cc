@@ -27,6 +27,7 @@
 #include "P_RecCore.h"
 #include "P_RecProcess.h"
 #include "P_RecMessage.h"
+#include "P_RecShm.h"
 #include "P_RecUtils.h"
 #include "P_RecCompatibility.h"
 
@@ -35,6 +36,8 @@
 static bool g_initialized = false;
 static bool g_message_initialized = false;
 static bool g_started = false;
+static RecHistogramBlock *g_histogram_blocks = NULL;
+static ink_mutex g_histogram_mutex = PTHREAD_MUTEX_INITIALIZER;
 static EventNotify g_force_req_notify;
 static int g_rec_raw_stat_sync_interval_ms = REC_RAW_STAT_SYNC_INTERVAL_MS;
 static int g_rec_config_update_interval_ms = REC_CONFIG_UPDATE_INTERVAL_MS;
@@ -277,7 +280,9 @@ struct raw_stat_sync_cont: public Continuation
     REC_NOWARN_UNUSED(event);
     REC_NOWARN_UNUSED(e);
     while (true) {
+      RecExecHistogramSyncs();
       RecExecRawStatSyncCbs();
+      RecShmExport();
       Debug("statsproc", "raw_stat_sync_cont() processed");
       usleep(g_rec_raw_stat_sync_interval_ms * 1000);
     }
@@ -433,6 +438,11 @@ RecProcessStart()
     return REC_ERR_OKAY;
   }
 
+  if (g_mode_type == RECM_CLIENT) {
+    Debug("statsproc", "\tshared stats segment");
+    RecShmCreate();
+  }
+
   Debug("statsproc", "Starting sync processors:");
   raw_stat_sync_cont *rssc = NEW(new raw_stat_sync_cont(new_ProxyMutex()));
   Debug("statsproc", "\traw-stat syncer");
@@ -521,6 +531,223 @@ Ldone:
 }
 
 
+//-------------------------------------------------------------------------
+// Histograms
+//-------------------------------------------------------------------------
+#define HISTOGRAM_PERCENTILES 4
+static const int histogram_permille[HISTOGRAM_PERCENTILES] = { 500, 900, 990, 999 };
+static const char *histogram_permille_names[HISTOGRAM_PERCENTILES] = { "p50", "p90", "p99", "p999" };
+
+// "<lower>:<count>," of one bucket, both at most 20 digits
+#define HISTOGRAM_BUCKET_STR_LEN 42
+
+struct RecHistogramInfo
+{
+  RecRecord *count;
+  RecRecord *sum;
+  RecRecord *buckets;
+  RecRecord *percentiles[HISTOGRAM_PERCENTILES];
+  RecHistogram total;           // as of the last sync
+  RecHistogram window_start;    // percentiles are over total - window_start
+  RecHistogram window_next;     // window_start of the next window
+  ink_hrtime window_time;
+};
+
+static RecRecord *
+histogram_register_record(RecT rec_type, const char *name, const char *suffix, RecDataT data_type)
+{
+  char buf[1024];
+  RecData data_default;
+  RecRecord *r;
+
+  memset(&data_default, 0, sizeof(RecData));
+  if (data_type == RECD_STRING)
+    data_default.rec_string = (char *) "";
+  snprintf(buf, sizeof(buf), "%s.%s", name, suffix);
+  if ((r = RecRegisterStat(rec_type, buf, data_type, data_default, RECP_NON_PERSISTENT)) == NULL) {
+    return NULL;
+  }
+  if (i_am_the_record_owner(r->rec_type)) {
+    r->sync_required = r->sync_required | REC_PEER_SYNC_REQUIRED;
+  } else {
+    send_register_message(r);
+  }
+  return r;
+}
+
+static void
+histogram_get_total(RecHistogramBlock *rhb, int id, RecHistogram *total)
+{
+  RecHistogram *tlp;
+  int i, j;
+
+  // no locks, each slot only ever grows and is written by its own thread
+  memset(total, 0, sizeof(RecHistogram));
+  for (i = 0; i < eventProcessor.n_ethreads; i++) {
+    tlp = ((RecHistogram *) ((char *) (eventProcessor.all_ethreads[i]) + rhb->ethr_stat_offset)) + id;
+    total->sum += tlp->sum;
+    for (j = 0; j < REC_HISTOGRAM_BUCKETS; j++)
+      total->buckets[j] += tlp->buckets[j];
+  }
+
+  for (i = 0; i < eventProcessor.n_dthreads; i++) {
+    tlp = ((RecHistogram *) ((char *) (eventProcessor.all_dthreads[i]) + rhb->ethr_stat_offset)) + id;
+    total->sum += tlp->sum;
+    for (j = 0; j < REC_HISTOGRAM_BUCKETS; j++)
+      total->buckets[j] += tlp->buckets[j];
+  }
+}
+
+static void
+histogram_set_record(RecRecord *r, RecData *data)
+{
+  if (r == NULL)
+    return;
+  rec_mutex_acquire(&(r->lock));
+  if (RecDataSet(r->data_type, &(r->data), data))
+    r->sync_required = REC_SYNC_REQUIRED;
+  rec_mutex_release(&(r->lock));
+}
+
+static void
+histogram_sync(RecHistogramInfo *hi, RecHistogramBlock *rhb, int id, ink_hrtime now)
+{
+  int64_t window[REC_HISTOGRAM_BUCKETS];
+  int64_t count = 0, window_count = 0;
+  // room for every bucket; only used under g_histogram_mutex
+  static char buf[REC_HISTOGRAM_BUCKETS * HISTOGRAM_BUCKET_STR_LEN + 1];
+  int len = 0;
+  RecData data;
+  int i, j;
+
+  histogram_get_total(rhb, id, &hi->total);
+
+  // a new window every REC_HISTOGRAM_WINDOW_MS, the percentiles always
+  // cover between one and two windows worth of samples
+  if (now - hi->window_time >= HRTIME_MSECONDS(REC_HISTOGRAM_WINDOW_MS)) {
+    memcpy(&hi->window_start, &hi->window_next, sizeof(RecHistogram));
+    memcpy(&hi->window_next, &hi->total, sizeof(RecHistogram));
+    hi->window_time = now;
+  }
+
+  buf[0] = '\0';
+  for (i = 0; i < REC_HISTOGRAM_BUCKETS; i++) {
+    int64_t n = hi->total.buckets[i];
+    window[i] = n - hi->window_start.buckets[i];
+    count += n;
+    window_count += window[i];
+    if (n > 0)
+      len += snprintf(buf + len, sizeof(buf) - len, "%s%" PRId64 ":%" PRId64, len ? "," : "", rec_histogram_bucket_lower(i), n);
+  }
+
+  data.rec_int = count;
+  histogram_set_record(hi->count, &data);
+  data.rec_int = hi->total.sum;
+  histogram_set_record(hi->sum, &data);
+  data.rec_string = buf;
+  histogram_set_record(hi->buckets, &data);
+
+  for (j = 0, i = 0, count = 0; j < HISTOGRAM_PERCENTILES; j++) {
+    int64_t rank = (window_count * histogram_permille[j] + 999) / 1000;
+    while (i < REC_HISTOGRAM_BUCKETS - 1 && count + window[i] < rank)
+      count += window[i++];
+    data.rec_int = window_count ? rec_histogram_bucket_upper(i) : 0;
+    histogram_set_record(hi->percentiles[j], &data);
+  }
+}
+
+int
+RecExecHistogramSyncs()
+{
+  ink_hrtime now = ink_get_hrtime();
+
+  ink_mutex_acquire(&g_histogram_mutex);
+  for (RecHistogramBlock *rhb = g_histogram_blocks; rhb; rhb = rhb->next) {
+    for (int id = 0; id < rhb->max_hists; id++) {
+      if (rhb->info[id].count)
+        histogram_sync(&rhb->info[id], rhb, id, now);
+    }
+  }
+  ink_mutex_release(&g_histogram_mutex);
+
+  return REC_ERR_OKAY;
+}
+
+
+//-------------------------------------------------------------------------
+// RecAllocateHistogramBlock
+//-------------------------------------------------------------------------
+RecHistogramBlock *
+RecAllocateHistogramBlock(int num_hists)
+{
+  off_t ethr_stat_offset;
+  RecHistogramBlock *rhb;
+
+  // allocate thread-local histogram memory
+  if ((ethr_stat_offset = eventProcessor.allocate(num_hists * sizeof(RecHistogram))) == -1) {
+    return NULL;
+  }
+  rhb = (RecHistogramBlock *)ats_malloc(sizeof(RecHistogramBlock));
+  memset(rhb, 0, sizeof(RecHistogramBlock));
+  rhb->ethr_stat_offset = ethr_stat_offset;
+  rhb->info = (RecHistogramInfo *)ats_malloc(num_hists * sizeof(RecHistogramInfo));
+  memset(rhb->info, 0, num_hists * sizeof(RecHistogramInfo));
+  rhb->num_hists = 0;
+  rhb->max_hists = num_hists;
+
+  ink_mutex_acquire(&g_histogram_mutex);
+  rhb->next = g_histogram_blocks;
+  g_histogram_blocks = rhb;
+  ink_mutex_release(&g_histogram_mutex);
+  return rhb;
+}
+
+
+//-------------------------------------------------------------------------
+// RecRegisterHistogram
+//-------------------------------------------------------------------------
+int
+RecRegisterHistogram(RecHistogramBlock *rhb, RecT rec_type, const char *name, int id)
+{
+  Debug("stats", "RecRegisterHistogram(%s): rhb pointer:%p id:%d\n", name, rhb, id);
+
+  ink_debug_assert(id < rhb->max_hists);
+
+  RecHistogramInfo *hi = &rhb->info[id];
+  RecRecord *count, *sum, *buckets;
+
+  if ((count = histogram_register_record(rec_type, name, "count", RECD_INT)) == NULL ||
+      (sum = histogram_register_record(rec_type, name, "sum", RECD_INT)) == NULL ||
+      (buckets = histogram_register_record(rec_type, name, "buckets", RECD_STRING)) == NULL) {
+    return REC_ERR_FAIL;
+  }
+  for (int j = 0; j < HISTOGRAM_PERCENTILES; j++) {
+    if ((hi->percentiles[j] = histogram_register_record(rec_type, name, histogram_permille_names[j], RECD_INT)) == NULL)
+      return REC_ERR_FAIL;
+  }
+
+  ink_mutex_acquire(&g_histogram_mutex);
+  hi->sum = sum;
+  hi->buckets = buckets;
+  hi->count = count;            // the sync skips histograms without one
+  rhb->num_hists++;
+  ink_mutex_release(&g_histogram_mutex);
+
+  return REC_ERR_OKAY;
+}
+
+
+//-------------------------------------------------------------------------
+// RecGetHistogram
+//-------------------------------------------------------------------------
+int
+RecGetHistogram(RecHistogramBlock *rhb, int id, RecHistogram *total)
+{
+  histogram_get_total(rhb, id, total);
+  return REC_ERR_OKAY;
+}
+
+
 //-------------------------------------------------------------------------
 // RecRawStatSync...
 //-------------------------------------------------------------------------
@@ -797,7 +1024,7 @@ RecRegisterRawStatSyncCb(const char *name, RecRawStatSyncCb sync_cb, RecRawStatB
   RecRecord *r;
 
   ink_rwlock_rdlock(&g_records_rwlock);
-  if (ink_hash_table_lookup(g_records_ht, name, (void **) &r)) {
+  if ((r = RecLookupRecord(name)) != NULL) {
     rec_mutex_acquire(&(r->lock));
     if (REC_TYPE_IS_STAT(r->rec_type)) {
       if (!(r->stat_meta.sync_cb)) {
@@ -841,3 +1068,145 @@ RecExecRawStatSyncCbs()
 
   return REC_ERR_OKAY;
 }
+
+
+#if TS_HAS_TESTS
+
+// Every value falls in the bucket whose bounds contain it, the buckets
+// are contiguous, and a bucket is at most 1/REC_HISTOGRAM_SUB_BUCKETS of
+// its lower bound wide.
+REGRESSION_TEST(RecHistogram_buckets) (RegressionTest * t, int atype, int *pstatus)
+{
+  NOWARN_UNUSED(atype);
+  int status = REGRESSION_TEST_PASSED;
+  int i, b;
+
+  if (rec_histogram_bucket(-5) != 0 || rec_histogram_bucket(0) != 0 ||
+      rec_histogram_bucket(INT64_MAX) != REC_HISTOGRAM_BUCKETS - 1) {
+    rprintf(t, "out of range values are not clamped to the first and last bucket\n");
+    status = REGRESSION_TEST_FAILED;
+  }
+
+  for (i = 0; i < REC_HISTOGRAM_BUCKETS && status == REGRESSION_TEST_PASSED; i++) {
+    int64_t lower = rec_histogram_bucket_lower(i);
+    int64_t upper = rec_histogram_bucket_upper(i);
+    int64_t width = upper - lower + 1;
+
+    if (i + 1 < REC_HISTOGRAM_BUCKETS && rec_histogram_bucket_lower(i + 1) != upper + 1) {
+      rprintf(t, "bucket %d ends at %" PRId64 " but bucket %d starts at %" PRId64 "\n", i, upper, i + 1,
+              rec_histogram_bucket_lower(i + 1));
+      status = REGRESSION_TEST_FAILED;
+    }
+    if (lower >= REC_HISTOGRAM_SUB_BUCKETS && width * REC_HISTOGRAM_SUB_BUCKETS > lower) {
+      rprintf(t, "bucket %d [%" PRId64 ", %" PRId64 "] is too wide\n", i, lower, upper);
+      status = REGRESSION_TEST_FAILED;
+    }
+    if (rec_histogram_bucket(lower) != i || rec_histogram_bucket(upper) != i ||
+        rec_histogram_bucket(lower + width / 2) != i) {
+      rprintf(t, "values of bucket %d [%" PRId64 ", %" PRId64 "] map to another bucket\n", i, lower, upper);
+      status = REGRESSION_TEST_FAILED;
+    }
+  }
+
+  // around every power of two, and everything past the last bound
+  for (i = 0; i < 63 && status == REGRESSION_TEST_PASSED; i++) {
+    int64_t p = ((int64_t) 1) << i;
+    int64_t values[] = { p - 1, p, p + 1 };
+
+    for (unsigned j = 0; j < sizeof(values) / sizeof(values[0]); j++) {
+      b = rec_histogram_bucket(values[j]);
+      if (values[j] < rec_histogram_bucket_lower(b) ||
+          (b < REC_HISTOGRAM_BUCKETS - 1 && values[j] > rec_histogram_bucket_upper(b))) {
+        rprintf(t, "%" PRId64 " maps to bucket %d [%" PRId64 ", %" PRId64 "]\n", values[j], b,
+                rec_histogram_bucket_lower(b), rec_histogram_bucket_upper(b));
+        status = REGRESSION_TEST_FAILED;
+      }
+    }
+  }
+
+  *pstatus = status;
+}
+
+
+// Times RecGetRecordInt() by name and through a RecLookupRecord() handle
+// from 1 to REC_LOOKUP_BENCH_THREADS threads at once.  Neither takes the
+// records rwlock, so the per lookup cost should stay flat as threads are
+// added.
+#define REC_LOOKUP_BENCH_THREADS  8
+#define REC_LOOKUP_BENCH_LOOPS    1000000
+#define REC_LOOKUP_BENCH_RECORD   "proxy.config.diags.debug.enabled"
+
+struct RecLookupBench
+{
+  RecRecord *record;
+  bool by_handle;
+  volatile int mismatches;
+};
+
+static void *
+rec_lookup_bench_thread(void *arg)
+{
+  RecLookupBench *bench = (RecLookupBench *) arg;
+  RecInt expected = 0, rec_int = 0;
+
+  RecGetRecordIntByHandle(bench->record, &expected);
+  for (int i = 0; i < REC_LOOKUP_BENCH_LOOPS; i++) {
+    if (bench->by_handle) {
+      RecGetRecordIntByHandle(bench->record, &rec_int);
+    } else {
+      RecGetRecordInt(REC_LOOKUP_BENCH_RECORD, &rec_int);
+    }
+    if (rec_int != expected) {
+      ink_atomic_increment((int *) &bench->mismatches, 1);
+      break;
+    }
+  }
+  return NULL;
+}
+
+EXCLUSIVE_REGRESSION_TEST(RecCore_lookup_throughput) (RegressionTest * t, int atype, int *pstatus)
+{
+  RecLookupBench bench;
+  ink_thread threads[REC_LOOKUP_BENCH_THREADS];
+  char tag[64];
+
+  if (atype < REGRESSION_TEST_EXTENDED) {
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  bench.record = RecLookupRecord(REC_LOOKUP_BENCH_RECORD);
+  bench.mismatches = 0;
+  if (bench.record == NULL) {
+    rprintf(t, "%s is not registered\n", REC_LOOKUP_BENCH_RECORD);
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  for (int by_handle = 0; by_handle < 2; by_handle++) {
+    bench.by_handle = by_handle;
+    for (int nthreads = 1; nthreads <= REC_LOOKUP_BENCH_THREADS; nthreads *= 2) {
+      int64_t start = ink_get_hrtime();
+
+      for (int i = 0; i < nthreads; i++) {
+        threads[i] = ink_thread_create(rec_lookup_bench_thread, &bench);
+      }
+      for (int i = 0; i < nthreads; i++) {
+        ink_thread_join(threads[i]);
+      }
+
+      int64_t elapsed = ink_get_hrtime() - start;
+      snprintf(tag, sizeof(tag), "%s ns/lookup, %d threads", by_handle ? "by handle" : "by name", nthreads);
+      rperf(t, tag, (double) elapsed / REC_LOOKUP_BENCH_LOOPS);
+    }
+  }
+
+  if (bench.mismatches) {
+    rprintf(t, "%d threads read a value other than the one set\n", bench.mismatches);
+    *pstatus = REGRESSION_TEST_FAILED;
+  } else {
+    *pstatus = REGRESSION_TEST_PASSED;
+  }
+}
+
+#endif /* TS_HAS_TESTS */
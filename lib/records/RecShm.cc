@@ -0,0 +1,303 @@
+/** @file
+
+  Shared memory stats segment between traffic_server and traffic_manager
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+#include "libts.h"
+
+#include "P_RecCore.h"
+#include "P_RecShm.h"
+#include "P_RecUtils.h"
+#include "I_Layout.h"
+
+#include <sys/mman.h>
+
+// server side, mapped read/write
+static RecShmHeader *g_shm_writer = NULL;
+
+// manager side, plus what we already pulled from it
+static RecShmHeader *g_shm_reader = NULL;
+static int32_t g_shm_reader_generation = 0;
+static int32_t *g_shm_reader_seq = NULL;
+static RecRecord **g_shm_reader_recs = NULL;
+
+static char *
+rec_shm_path()
+{
+  return Layout::relative_to(Layout::get()->runtimedir, REC_SHM_STATS_FILE);
+}
+
+//-------------------------------------------------------------------------
+// seqlock
+//-------------------------------------------------------------------------
+static inline void
+rec_shm_write_begin(RecShmSlot *slot)
+{
+  ink_atomic_increment((pvint32) &slot->seq, 1);
+}
+
+static inline void
+rec_shm_write_end(RecShmSlot *slot)
+{
+  ink_atomic_increment((pvint32) &slot->seq, 1);
+}
+
+// Copy a slot out, returns false if the server kept writing it.
+static bool
+rec_shm_read_slot(RecShmSlot *slot, RecShmSlot *copy)
+{
+  for (int tries = 0; tries < 100; tries++) {
+    int32_t seq = slot->seq;
+    if (seq & 1) {
+      continue;
+    }
+    __sync_synchronize();
+    memcpy(copy, (void *) slot, sizeof(RecShmSlot));
+    __sync_synchronize();
+    if (slot->seq == seq) {
+      copy->seq = seq;
+      copy->name[REC_SHM_NAME_LEN - 1] = '\0';
+      return true;
+    }
+  }
+  return false;
+}
+
+//-------------------------------------------------------------------------
+// RecShmCreate
+//-------------------------------------------------------------------------
+int
+RecShmCreate()
+{
+  int num_slots = REC_MAX_RECORDS;
+  size_t size = REC_SHM_SIZE(num_slots);
+  char *path = rec_shm_path();
+  RecShmHeader *shm;
+  int fd;
+
+  // Never truncate or unlink the file, a manager that already mapped it
+  // keeps reading the same inode across server restarts.
+  if ((fd = open(path, O_RDWR | O_CREAT, 0644)) < 0) {
+    RecLog(DL_Warning, "unable to open stats segment '%s': %s", path, strerror(errno));
+    ats_free(path);
+    return REC_ERR_FAIL;
+  }
+  if (ftruncate(fd, size) < 0 ||
+      (shm = (RecShmHeader *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    RecLog(DL_Warning, "unable to map stats segment '%s': %s", path, strerror(errno));
+    close(fd);
+    ats_free(path);
+    return REC_ERR_FAIL;
+  }
+  close(fd);
+  ats_free(path);
+
+  // Forget the previous server's slots.  The generation bump tells the
+  // manager to drop what it cached about them.
+  if (shm->magic != REC_SHM_MAGIC || shm->version != REC_SHM_VERSION || shm->num_slots != num_slots) {
+    memset(shm, 0, size);
+  }
+  for (int i = 0; i < num_slots; i++) {
+    RecShmSlot *slot = &(shm->slots[i]);
+    rec_shm_write_begin(slot);
+    slot->name[0] = '\0';
+    rec_shm_write_end(slot);
+  }
+  shm->num_used = 0;
+  shm->num_slots = num_slots;
+  shm->version = REC_SHM_VERSION;
+  shm->magic = REC_SHM_MAGIC;
+  ink_atomic_increment((pvint32) &shm->generation, 1);
+
+  g_shm_writer = shm;
+
+  return REC_ERR_OKAY;
+}
+
+
+//-------------------------------------------------------------------------
+// RecShmExport
+//-------------------------------------------------------------------------
+int
+RecShmExport()
+{
+  RecShmHeader *shm = g_shm_writer;
+  int i, num_records;
+
+  if (shm == NULL) {
+    return REC_ERR_FAIL;
+  }
+  // Nobody reads the segment yet (the manager is not up, could not map
+  // it, or is from another build), leave the records to RECG_PUSH.
+  if (shm->acked_generation != shm->generation) {
+    return REC_ERR_FAIL;
+  }
+
+  num_records = g_num_records;
+  if (num_records > shm->num_slots) {
+    num_records = shm->num_slots;
+  }
+  for (i = 0; i < num_records; i++) {
+    RecRecord *r = &(g_records[i]);
+    if (!REC_TYPE_IS_STAT(r->rec_type) || !i_am_the_record_owner(r->rec_type) ||
+        (r->data_type == RECD_STRING) || (strlen(r->name) >= REC_SHM_NAME_LEN)) {
+      continue;
+    }
+    rec_mutex_acquire(&(r->lock));
+    if (r->registered && (r->sync_required & REC_PEER_SYNC_REQUIRED)) {
+      RecShmSlot *slot = &(shm->slots[i]);
+      rec_shm_write_begin(slot);
+      if (slot->name[0] == '\0') {
+        slot->rec_type = r->rec_type;
+        slot->data_type = r->data_type;
+        ink_strlcpy(slot->name, r->name, REC_SHM_NAME_LEN);
+      }
+      slot->data = r->data;
+      slot->data_raw = r->stat_meta.data_raw;
+      rec_shm_write_end(slot);
+      r->sync_required = r->sync_required & ~REC_PEER_SYNC_REQUIRED;
+    }
+    rec_mutex_release(&(r->lock));
+  }
+  if (shm->num_used < num_records) {
+    shm->num_used = num_records;
+  }
+
+  return REC_ERR_OKAY;
+}
+
+
+//-------------------------------------------------------------------------
+// RecShmImport
+//-------------------------------------------------------------------------
+static int
+rec_shm_attach()
+{
+  char *path = rec_shm_path();
+  RecShmHeader *shm;
+  struct stat sb;
+  int fd;
+
+  if ((fd = open(path, O_RDWR)) < 0) {
+    ats_free(path);
+    return REC_ERR_FAIL;
+  }
+  ats_free(path);
+
+  // The server may not have laid it out yet, or be from another build.
+  if (fstat(fd, &sb) < 0 || (size_t) sb.st_size < REC_SHM_SIZE(REC_MAX_RECORDS)) {
+    close(fd);
+    return REC_ERR_FAIL;
+  }
+  shm = (RecShmHeader *) mmap(NULL, REC_SHM_SIZE(REC_MAX_RECORDS), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shm == MAP_FAILED) {
+    return REC_ERR_FAIL;
+  }
+  if (shm->magic != REC_SHM_MAGIC || shm->version != REC_SHM_VERSION || shm->num_slots != REC_MAX_RECORDS) {
+    munmap((caddr_t) shm, REC_SHM_SIZE(REC_MAX_RECORDS));
+    return REC_ERR_FAIL;
+  }
+
+  g_shm_reader_seq = (int32_t *)ats_malloc(shm->num_slots * sizeof(int32_t));
+  g_shm_reader_recs = (RecRecord **)ats_malloc(shm->num_slots * sizeof(RecRecord *));
+  memset(g_shm_reader_seq, 0, shm->num_slots * sizeof(int32_t));
+  memset(g_shm_reader_recs, 0, shm->num_slots * sizeof(RecRecord *));
+  g_shm_reader_generation = shm->generation;
+  g_shm_reader = shm;
+  shm->acked_generation = g_shm_reader_generation;
+
+  RecDebug(DL_Note, "attached to the stats segment, generation %d", g_shm_reader_generation);
+
+  return REC_ERR_OKAY;
+}
+
+static void
+rec_shm_detach()
+{
+  munmap((caddr_t) g_shm_reader, REC_SHM_SIZE(REC_MAX_RECORDS));
+  ats_free(g_shm_reader_seq);
+  ats_free(g_shm_reader_recs);
+  g_shm_reader_seq = NULL;
+  g_shm_reader_recs = NULL;
+  g_shm_reader = NULL;
+}
+
+int
+RecShmImport()
+{
+  RecShmHeader *shm;
+  RecShmSlot copy;
+  int i, num_used;
+
+  if ((g_shm_reader == NULL) && (rec_shm_attach() != REC_ERR_OKAY)) {
+    return REC_ERR_FAIL;
+  }
+  shm = g_shm_reader;
+
+  if (shm->generation != g_shm_reader_generation) {
+    g_shm_reader_generation = shm->generation;
+    memset(g_shm_reader_seq, 0, shm->num_slots * sizeof(int32_t));
+    memset(g_shm_reader_recs, 0, shm->num_slots * sizeof(RecRecord *));
+    // A new server, it keeps pushing messages until it sees this.
+    if (shm->magic != REC_SHM_MAGIC || shm->version != REC_SHM_VERSION) {
+      rec_shm_detach();
+      return REC_ERR_FAIL;
+    }
+    shm->acked_generation = g_shm_reader_generation;
+  }
+
+  num_used = shm->num_used;
+  if (num_used > shm->num_slots) {
+    num_used = shm->num_slots;
+  }
+  for (i = 0; i < num_used; i++) {
+    RecShmSlot *slot = &(shm->slots[i]);
+    RecRecord *r;
+
+    if (slot->seq == g_shm_reader_seq[i] || !rec_shm_read_slot(slot, &copy)) {
+      continue;
+    }
+    if (copy.name[0] == '\0') {
+      g_shm_reader_seq[i] = copy.seq;
+      continue;
+    }
+    // Resolve the name once per slot, the handle stays good until the
+    // server restarts and hands the id to another record.
+    r = g_shm_reader_recs[i];
+    if ((r == NULL) || (strcmp(r->name, copy.name) != 0)) {
+      if ((r = RecLookupRecord(copy.name)) == NULL) {
+        // not registered with us yet, the RECG_REGISTER is on its way
+        continue;
+      }
+      g_shm_reader_recs[i] = r;
+    }
+    rec_mutex_acquire(&(r->lock));
+    if (r->data_type == copy.data_type) {
+      RecDataSet(r->data_type, &(r->data), &(copy.data));
+      r->stat_meta.data_raw = copy.data_raw;
+    }
+    rec_mutex_release(&(r->lock));
+    g_shm_reader_seq[i] = copy.seq;
+  }
+
+  return REC_ERR_OKAY;
+}
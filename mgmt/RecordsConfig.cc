@@ -133,10 +133,18 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.exec_thread.limit", RECD_INT, "2", RECU_RESTART_TS, RR_NULL, RECC_INT, "[1-1024]", RECA_READ_ONLY}
   ,
+  // pin every event thread to a cpu
+  {RECT_CONFIG, "proxy.config.exec_thread.affinity", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_READ_ONLY}
+  ,
+  // schedule on the less loaded of two threads instead of round robin
+  {RECT_CONFIG, "proxy.config.exec_thread.load_aware", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_READ_ONLY}
+  ,
   {RECT_CONFIG, "proxy.config.accept_threads", RECD_INT, "1", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_READ_ONLY}
   ,
   {RECT_CONFIG, "proxy.config.task_threads", RECD_INT, "2", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-99999]", RECA_READ_ONLY}
   ,
+  {RECT_CONFIG, "proxy.config.task_threads.work_stealing", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_READ_ONLY}
+  ,
   {RECT_CONFIG, "proxy.config.thread.default.stacksize", RECD_INT, "1048576", RECU_RESTART_TS, RR_NULL, RECC_INT, "[131072-104857600]", RECA_READ_ONLY}
   ,
   {RECT_CONFIG, "proxy.config.user_name", RECD_STRING, "nobody", RECU_NULL, RR_NULL, RECC_NULL, NULL, RECA_NULL}
@@ -487,6 +495,22 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.http.share_server_sessions", RECD_INT, "2", RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //       #  with per thread sessions (2), take an idle session from another
+  //       #  thread's pool when ours has none for the origin
+  {RECT_CONFIG, "proxy.config.http.server_session_steal_enabled", RECD_INT, "1", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  //       #  max idle sessions kept per origin in a pool, 0 is no limit
+  {RECT_CONFIG, "proxy.config.http.server_session_max_idle_per_origin", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
+  //       #  with per thread sessions (2), requests in flight on an origin
+  //       #  connection, small GETs get pipelined behind the active one.
+  //       #  0 or 1 is off
+  {RECT_CONFIG, "proxy.config.http.origin_pipeline_depth", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-17]", RECA_NULL}
+  ,
+  //       #  a response bigger than this stops the connection taking
+  //       #  pipelined requests
+  {RECT_CONFIG, "proxy.config.http.origin_pipeline_max_object_size", RECD_INT, "65536", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.http.wuts_enabled", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
   {RECT_CONFIG, "proxy.config.http.log_spider_codes", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
@@ -895,9 +919,14 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.cluster.flow_ctrl.max_send_wait_time", RECD_INT, "5000", RECU_RESTART_TS, RR_REQUIRED, RECC_NULL, NULL, RECA_NULL}
   ,
-  {RECT_CONFIG, "proxy.config.cluster.flow_ctrl.min_loop_interval", RECD_INT, "0", RECU_RESTART_TS, RR_REQUIRED, RECC_NULL, NULL, RECA_NULL}
+  // deprecated, the cluster io threads no longer poll
+  {RECT_CONFIG, "proxy.config.cluster.flow_ctrl.min_loop_interval", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.cluster.flow_ctrl.max_loop_interval", RECD_INT, "1000", RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
-  {RECT_CONFIG, "proxy.config.cluster.flow_ctrl.max_loop_interval", RECD_INT, "1000", RECU_RESTART_TS, RR_REQUIRED, RECC_NULL, NULL, RECA_NULL}
+  //# size of the cluster machine table, the most machines (including
+  //# this one) the cluster can have
+  {RECT_CONFIG, "proxy.config.cluster.max_machines", RECD_INT, "255", RECU_RESTART_TS, RR_NULL, RECC_INT, "[2-4096]", RECA_NULL}
   ,
   {RECT_CONFIG, "proxy.config.cluster.max_sessions_per_machine", RECD_INT, "1000000", RECU_RESTART_TS, RR_NULL, RECC_INT, "[1000-4000000]", RECA_NULL}
   ,
@@ -905,10 +934,46 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.cluster.read_buffer_size", RECD_INT, "2097152", RECU_RESTART_TS, RR_NULL, RECC_INT, "[65536-2097152]", RECA_NULL}
   ,
+  //# compress the bodies of text like objects on links to machines that
+  //# support it, bodies smaller than min_size are sent as they are
+  {RECT_CONFIG, "proxy.config.cluster.compress.enabled", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.cluster.compress.min_size", RECD_INT, "1024", RECU_DYNAMIC, RR_NULL, RECC_INT, "[64-1048576]", RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.cluster.cluster_configuration", RECD_STRING, "cluster.config", RECU_NULL, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
   {RECT_CONFIG, "proxy.config.cluster.default_cluster_configuration", RECD_STRING, "default_cluster.config", RECU_NULL, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //# object placement, all the machines of a cluster must use the same values
+  //#   consistent_hash: 1 = weighted hash ring, 0 = the old per machine tables
+  //#   hash_virtual_nodes: ring points of a machine with the default weight
+  //#   hash_load_factor: percent (100 or more) of its fair share of buckets a
+  //#     machine may own before the rest spill to its successor, 0 = unbounded
+  {RECT_CONFIG, "proxy.config.cluster.consistent_hash", RECD_INT, "1", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.cluster.hash_virtual_nodes", RECD_INT, "160", RECU_RESTART_TS, RR_NULL, RECC_INT, "[1-1000]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.cluster.hash_load_factor", RECD_INT, "125", RECU_RESTART_TS, RR_NULL, RECC_STR, "^(0|[1-9][0-9][0-9]+)$", RECA_NULL}
+  ,
+  //# hot object replication: keys read from their owner read_threshold
+  //# times within window_secs are copied into the local cache, and read
+  //# from it for replica_ttl_secs
+  {RECT_CONFIG, "proxy.config.cluster.diffuse.enabled", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.cluster.diffuse.read_threshold", RECD_INT, "100", RECU_DYNAMIC, RR_NULL, RECC_INT, "[1-1000000]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.cluster.diffuse.window_secs", RECD_INT, "10", RECU_DYNAMIC, RR_NULL, RECC_INT, "[1-3600]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.cluster.diffuse.replica_ttl_secs", RECD_INT, "300", RECU_DYNAMIC, RR_NULL, RECC_INT, "[1-86400]", RECA_NULL}
+  ,
+  //# request coalescing: a write of an object the owner is already
+  //# writing reads that write instead, waiting up to max_delay ms for
+  //# its response header. needs proxy.config.cache.enable_read_while_writer
+  //# on the owner
+  {RECT_CONFIG, "proxy.config.cluster.coalesce.enabled", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.cluster.coalesce.max_delay", RECD_INT, "1000", RECU_DYNAMIC, RR_NULL, RECC_INT, "[1-60000]", RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.cluster.ethernet_interface", RECD_STRING, TS_BUILD_DEFAULT_LOOPBACK_IFACE, RECU_RESTART_TS, RR_REQUIRED, RECC_STR, "^[^[:space:]]*$", RECA_NULL}
   ,
   {RECT_CONFIG, "proxy.config.cluster.enable_monitor", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
@@ -1213,6 +1278,14 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.log.max_secs_per_buffer", RECD_INT, "5", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //# 1: each event thread writes log entries into its own buffer per log object
+  {RECT_CONFIG, "proxy.config.log.per_thread_buffers", RECD_INT, "1", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  //# 0: binary logs are written as raw LogBuffers
+  //# 1: binary logs are written as columnar segments
+  //# 2: columnar segments with zlib compressed columns
+  {RECT_CONFIG, "proxy.config.log.columnar_binary", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-2]", RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.log.max_space_mb_for_logs", RECD_INT, "2500", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
   ,
   {RECT_CONFIG, "proxy.config.log.max_space_mb_for_orphan_logs", RECD_INT, "25", RECU_DYNAMIC, RR_NULL, RECC_STR, "^[0-9]+$", RECA_NULL}
@@ -1279,6 +1352,12 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.log.collation_max_send_buffers", RECD_INT, "16", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //# buffers sent to the collation host that may be waiting for its ack
+  {RECT_CONFIG, "proxy.config.log.collation_max_inflight_buffers", RECD_INT, "16", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
+  ,
+  //# 1: send columnar, zlib compressed buffers to hosts that accept them
+  {RECT_CONFIG, "proxy.config.log.collation_compress", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.log.collation_preproc_threads", RECD_INT, "1", RECU_DYNAMIC, RR_REQUIRED, RECC_INT, "[1-128]", RECA_NULL}
   ,
   {RECT_CONFIG, "proxy.config.log.rolling_enabled", RECD_INT, "1", RECU_DYNAMIC, RR_NULL, RECC_INT, "[0-4]", RECA_NULL}
@@ -1397,12 +1476,37 @@ RecordElement RecordsConfig[] = {
   ,
   {RECT_CONFIG, "proxy.config.ssl.client.CA.cert.path", RECD_STRING, NULL, RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
-  {RECT_CONFIG, "proxy.config.ssl.session_cache", RECD_INT, "1", RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
+  //        ##############################################################
+  //        # session_cache: 0 = off, 1 = OpenSSL cache of every context,  #
+  //        #                2 = one cache shared by all the contexts      #
+  //        # session_cache.filename: keeps the shared cache across        #
+  //        #                restarts, relative to the runtime directory   #
+  //        ##############################################################
+  {RECT_CONFIG, "proxy.config.ssl.session_cache", RECD_INT, "1", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-2]", RECA_NULL}
   ,
   {RECT_CONFIG, "proxy.config.ssl.session_cache.size", RECD_INT, "20480", RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  {RECT_CONFIG, "proxy.config.ssl.session_cache.num_buckets", RECD_INT, "256", RECU_RESTART_TS, RR_NULL, RECC_INT, "[1-65536]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.ssl.session_cache.timeout", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.ssl.session_cache.filename", RECD_STRING, NULL, RECU_RESTART_TS, RR_NULL, RECC_NULL, NULL, RECA_NULL}
+  ,
   {RECT_CONFIG, "proxy.config.ssl.max_record_size", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
   ,
+  //        ######################################################################
+  //        # lazy_load makes a context on the first handshake that asks for it, #
+  //        # reading its files on that net thread while the other handshakes    #
+  //        # for the same line wait.                                            #
+  //        ######################################################################
+  {RECT_CONFIG, "proxy.config.ssl.server.lazy_load", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-1]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.ssl.server.context_cache.size", RECD_INT, "0", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.ssl.handshake.offload_threads", RECD_INT, "0", RECU_RESTART_TS, RR_NULL, RECC_INT, "[0-256]", RECA_NULL}
+  ,
+  {RECT_CONFIG, "proxy.config.ssl.handshake.max_offload_per_thread", RECD_INT, "64", RECU_DYNAMIC, RR_NULL, RECC_NULL, NULL, RECA_NULL}
+  ,
 
   //##############################################################################
   //# ICP Configuration
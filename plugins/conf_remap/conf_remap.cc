@@ -91,7 +91,7 @@ RemapConfigs::parse_file(const char* fn)
   }
 
   while (NULL != TSfgets(file, buf, sizeof(buf))) {
-    char *ln, *tok;
+    char *ln, *tok, *tok_name;
     char *s = buf;
 
     ++line_num; // First line is #1 ...
@@ -109,7 +109,7 @@ RemapConfigs::parse_file(const char* fn)
     }
 
     // Find the configuration name
-    tok = strtok_r(NULL, " \t", &ln);
+    tok_name = tok = strtok_r(NULL, " \t", &ln);
     if (TSHttpTxnConfigFind(tok, -1, &name, &expected_type) != TS_SUCCESS) {
       TSError("conf_remap: file %s, line %d: no records.config name given", fn, line_num);
       continue;
@@ -127,6 +127,27 @@ RemapConfigs::parse_file(const char* fn)
       continue;
     }
 
+    // The overridable has to be backed by a records.config variable of
+    // the same type, its handle also gives us the global value cheaply.
+    TSMgmtRecord rec = TSMgmtRecordFind(tok_name);
+    TSMgmtInt global_int;
+    TSMgmtString global_str;
+
+    if (!rec) {
+      TSError("conf_remap: file %s, line %d: %s is not a records.config variable", fn, line_num, tok_name);
+      continue;
+    }
+    if (TS_RECORDDATATYPE_INT == type && TS_SUCCESS == TSMgmtIntGetByRecord(rec, &global_int)) {
+      TSDebug(PLUGIN_NAME, "%s overrides the global value %"PRId64"", tok_name, global_int);
+    } else if (TS_RECORDDATATYPE_STRING == type && TS_SUCCESS == TSMgmtStringGetByRecord(rec, &global_str)) {
+      TSDebug(PLUGIN_NAME, "%s overrides the global value %s", tok_name, global_str);
+      TSfree(global_str);
+    } else {
+      TSError("conf_remap: file %s, line %d: %s is not a records.config %s", fn, line_num, tok_name,
+              TS_RECORDDATATYPE_INT == type ? "INT" : "STRING");
+      continue;
+    }
+
     // Find the value (which depends on the type above)
     if (ln) {
       while (isspace(*ln))
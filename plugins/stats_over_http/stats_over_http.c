@@ -30,9 +30,19 @@
 #include <limits.h>
 #include <ts/ts.h>
 #include <string.h>
+#include <time.h>
+#include <regex.h>
 
 #include <inttypes.h>
 
+#define STATS_QUERY_MAX  256
+
+typedef enum
+{
+  STATS_FORMAT_JSON,
+  STATS_FORMAT_PROMETHEUS
+} stats_format;
+
 typedef struct stats_state_t
 {
   TSVConn net_vc;
@@ -44,9 +54,37 @@ typedef struct stats_state_t
   TSIOBufferReader resp_reader;
 
   int output_bytes;
-  int body_written;
+  char query[STATS_QUERY_MAX];
 } stats_state;
 
+/* A rendering of the stats for one query string.  Scrapes that come in
+   within cache_seconds of it get the same body: the response buffer
+   just takes references on its blocks, nothing is formatted or copied. */
+typedef struct stats_render_t
+{
+  char query[STATS_QUERY_MAX];
+  TSIOBuffer buffer;
+  TSIOBufferReader reader;
+  time_t rendered;
+} stats_render;
+
+#define STATS_CACHE_SIZE 8
+
+static stats_render stats_cache[STATS_CACHE_SIZE];
+static TSMutex stats_cache_mutex;
+static int cache_seconds = 5;     /* the records' raw stat sync interval */
+
+/* the filter and output format picked by the query string */
+typedef struct stats_filter_t
+{
+  TSIOBuffer buffer;
+  stats_format format;
+  char prefix[STATS_QUERY_MAX];
+  int prefix_len;
+  regex_t regex;
+  int have_regex;
+} stats_filter;
+
 static void
 stats_cleanup(TSCont contp, stats_state * my_state)
 {
@@ -85,21 +123,26 @@ stats_add_data_to_resp_buffer(const char *s, stats_state * my_state)
 }
 
 static int
-stats_add_resp_header(stats_state * my_state)
+stats_add_resp_header(stats_state * my_state, stats_format format, int64_t content_length)
 {
-  char resp[] = "HTTP/1.0 200 Ok\r\nContent-Type: text/javascript\r\nCache-Control: no-cache\r\n\r\n";
+  char resp[256];
 
+  snprintf(resp, sizeof(resp), "HTTP/1.0 200 Ok\r\nContent-Type: %s\r\nContent-Length: %" PRId64 "\r\n"
+           "Cache-Control: no-cache\r\n\r\n",
+           format == STATS_FORMAT_PROMETHEUS ? "text/plain; version=0.0.4" : "text/javascript", content_length);
   return stats_add_data_to_resp_buffer(resp, my_state);
 }
 
+static void stats_out_body(stats_state * my_state);
+
 static void
 stats_process_read(TSCont contp, TSEvent event, stats_state * my_state)
 {
   TSDebug("istats", "stats_process_read(%d)", event);
   if (event == TS_EVENT_VCONN_READ_READY) {
-    my_state->output_bytes = stats_add_resp_header(my_state);
+    stats_out_body(my_state);
     TSVConnShutdown(my_state->net_vc, 1, 0);
-    my_state->write_vio = TSVConnWrite(my_state->net_vc, contp, my_state->resp_reader, INT64_MAX);
+    my_state->write_vio = TSVConnWrite(my_state->net_vc, contp, my_state->resp_reader, my_state->output_bytes);
   } else if (event == TS_EVENT_ERROR) {
     TSError("stats_process_read: Received TS_EVENT_ERROR\n");
   } else if (event == TS_EVENT_VCONN_EOS) {
@@ -113,18 +156,36 @@ stats_process_read(TSCont contp, TSEvent event, stats_state * my_state)
   }
 }
 
-#define APPEND(a) my_state->output_bytes += stats_add_data_to_resp_buffer(a, my_state)
+#define APPEND(a) TSIOBufferWrite(filter->buffer, a, strlen(a))
 #define APPEND_STAT(a, fmt, v) do { \
   char b[256]; \
   if(snprintf(b, sizeof(b), "\"%s\": \"" fmt "\",\n", a, v) < sizeof(b)) \
     APPEND(b); \
 } while(0)
+#define APPEND_PROM(a, fmt, v) do { \
+  char b[256]; \
+  if(snprintf(b, sizeof(b), "%s " fmt "\n", a, v) < sizeof(b)) \
+    APPEND(b); \
+} while(0)
+
+static int
+stats_filter_match(stats_filter * filter, const char *name)
+{
+  if (filter->prefix_len && strncmp(name, filter->prefix, filter->prefix_len))
+    return 0;
+  if (filter->have_regex && regexec(&filter->regex, name, 0, NULL, 0))
+    return 0;
+  return 1;
+}
 
 static void
 json_out_stat(TSRecordType rec_type, void *edata, int registered,
               const char *name, TSRecordDataType data_type,
               TSRecordData *datum) {
-  stats_state *my_state = edata;
+  stats_filter *filter = edata;
+
+  if (!stats_filter_match(filter, name))
+    return;
 
   switch(data_type) {
   case TS_RECORDDATATYPE_COUNTER:
@@ -140,13 +201,14 @@ json_out_stat(TSRecordType rec_type, void *edata, int registered,
     break;
   }
 }
+
 static void
-json_out_stats(stats_state * my_state)
+json_out_stats(stats_filter * filter)
 {
   const char *version;
   APPEND("{ \"global\": {\n");
 
-  TSRecordDump(TS_RECORDTYPE_PROCESS, json_out_stat, my_state);
+  TSRecordDump(TS_RECORDTYPE_PROCESS, json_out_stat, filter);
   version = TSTrafficServerVersionGet();
   APPEND("\"server\": \"");
   APPEND(version);
@@ -154,18 +216,137 @@ json_out_stats(stats_state * my_state)
   APPEND("  }\n}\n");
 }
 
+/* Prometheus metric names only take [a-zA-Z0-9_:], strings have no
+   sample value so they are left out. */
+static void
+prometheus_out_stat(TSRecordType rec_type, void *edata, int registered,
+                    const char *name, TSRecordDataType data_type,
+                    TSRecordData *datum) {
+  stats_filter *filter = edata;
+  char metric[STATS_QUERY_MAX];
+  int i;
+
+  if (!stats_filter_match(filter, name))
+    return;
+
+  for (i = 0; name[i] && i < sizeof(metric) - 1; i++)
+    metric[i] = isalnum((unsigned char) name[i]) ? name[i] : '_';
+  metric[i] = '\0';
+
+  switch(data_type) {
+  case TS_RECORDDATATYPE_COUNTER:
+    APPEND_PROM(metric, "%" PRIu64, datum->rec_counter); break;
+  case TS_RECORDDATATYPE_INT:
+    APPEND_PROM(metric, "%" PRIu64, datum->rec_int); break;
+  case TS_RECORDDATATYPE_FLOAT:
+    APPEND_PROM(metric, "%f", datum->rec_float); break;
+  default:
+    break;
+  }
+}
+
+/* Copy the value of 'key' out of the query string, %-decoded. */
+static int
+stats_query_param(const char *query, const char *key, char *value, int value_len)
+{
+  int key_len = strlen(key);
+  const char *p = query;
+
+  while (p && *p) {
+    if (!strncmp(p, key, key_len) && p[key_len] == '=') {
+      int n = 0;
+      for (p += key_len + 1; *p && *p != '&' && n < value_len - 1; p++) {
+        if (*p == '%' && isxdigit((unsigned char) p[1]) && isxdigit((unsigned char) p[2])) {
+          char hex[3] = { p[1], p[2], '\0' };
+          value[n++] = (char) strtol(hex, NULL, 16);
+          p += 2;
+        } else {
+          value[n++] = (*p == '+') ? ' ' : *p;
+        }
+      }
+      value[n] = '\0';
+      return 1;
+    }
+    if ((p = strchr(p, '&')) != NULL)
+      p++;
+  }
+  return 0;
+}
+
+/* Format the stats for 'query' into 'buffer'. */
+static void
+stats_render_body(const char *query, TSIOBuffer buffer, stats_format format)
+{
+  stats_filter filter;
+  char regex[STATS_QUERY_MAX];
+
+  memset(&filter, 0, sizeof(filter));
+  filter.buffer = buffer;
+  filter.format = format;
+  if (stats_query_param(query, "prefix", filter.prefix, sizeof(filter.prefix)))
+    filter.prefix_len = strlen(filter.prefix);
+  if (stats_query_param(query, "regex", regex, sizeof(regex))) {
+    if (regcomp(&filter.regex, regex, REG_EXTENDED | REG_NOSUB) == 0)
+      filter.have_regex = 1;
+    else
+      TSDebug("istats", "bad regex '%s', ignored", regex);
+  }
+
+  if (format == STATS_FORMAT_PROMETHEUS)
+    TSRecordDump(TS_RECORDTYPE_PROCESS, prometheus_out_stat, &filter);
+  else
+    json_out_stats(&filter);
+
+  if (filter.have_regex)
+    regfree(&filter.regex);
+}
+
+/* Find a fresh rendering of 'query' or make one, and hand its blocks to
+   the response buffer after the header. */
+static void
+stats_out_body(stats_state * my_state)
+{
+  stats_format format = STATS_FORMAT_JSON;
+  stats_render *render = NULL;
+  char value[32];
+  time_t now = time(NULL);
+  int64_t length;
+  int i;
+
+  if (stats_query_param(my_state->query, "format", value, sizeof(value)) && !strcmp(value, "prometheus"))
+    format = STATS_FORMAT_PROMETHEUS;
+
+  TSMutexLock(stats_cache_mutex);
+  for (i = 0; i < STATS_CACHE_SIZE; i++) {
+    if (stats_cache[i].buffer && !strcmp(stats_cache[i].query, my_state->query)) {
+      render = &stats_cache[i];
+      break;
+    }
+    if (!render || stats_cache[i].rendered < render->rendered)
+      render = &stats_cache[i];   /* oldest so far, reused on a miss */
+  }
+  if (i == STATS_CACHE_SIZE || now - render->rendered >= cache_seconds) {
+    TSDebug("istats", "rendering stats for '%s'", my_state->query);
+    if (render->buffer)
+      TSIOBufferDestroy(render->buffer);
+    render->buffer = TSIOBufferCreate();
+    render->reader = TSIOBufferReaderAlloc(render->buffer);
+    strcpy(render->query, my_state->query);
+    render->rendered = now;
+    stats_render_body(my_state->query, render->buffer, format);
+  }
+  length = TSIOBufferReaderAvail(render->reader);
+  my_state->output_bytes = stats_add_resp_header(my_state, format, length);
+  my_state->output_bytes += TSIOBufferCopy(my_state->resp_buffer, render->reader, length, 0);
+  TSMutexUnlock(stats_cache_mutex);
+}
+
 static void
 stats_process_write(TSCont contp, TSEvent event, stats_state * my_state)
 {
   if (event == TS_EVENT_VCONN_WRITE_READY) {
-    if (my_state->body_written == 0) {
-      TSDebug("istats", "plugin adding response body");
-      my_state->body_written = 1;
-      json_out_stats(my_state);
-      TSVIONBytesSet(my_state->write_vio, my_state->output_bytes);
-    }
     TSVIOReenable(my_state->write_vio);
-  } else if (TS_EVENT_VCONN_WRITE_COMPLETE) {
+  } else if (event == TS_EVENT_VCONN_WRITE_COMPLETE) {
     stats_cleanup(contp, my_state);
   } else if (event == TS_EVENT_ERROR) {
     TSError("stats_process_write: Received TS_EVENT_ERROR\n");
@@ -200,6 +381,8 @@ stats_origin(TSCont contp, TSEvent event, void *edata)
   TSMBuffer reqp;
   TSMLoc hdr_loc = NULL, url_loc = NULL;
   TSEvent reenable = TS_EVENT_HTTP_CONTINUE;
+  const char *query;
+  int query_len = 0;
 
   TSDebug("istats", "in the read stuff");
  
@@ -225,6 +408,10 @@ stats_origin(TSCont contp, TSEvent event, void *edata)
   icontp = TSContCreate(stats_dostuff, TSMutexCreate());
   my_state = (stats_state *) TSmalloc(sizeof(*my_state));
   memset(my_state, 0, sizeof(*my_state));
+  /* queries too long for the cache key are served unfiltered */
+  query = TSUrlHttpQueryGet(reqp, url_loc, &query_len);
+  if (query && query_len < sizeof(my_state->query))
+    memcpy(my_state->query, query, query_len);
   TSContDataSet(icontp, my_state);
   TSHttpTxnIntercept(icontp, txnp);
   goto cleanup;
@@ -279,6 +466,11 @@ TSPluginInit(int argc, const char *argv[])
   if (TSPluginRegister(TS_SDK_VERSION_2_0, &info) != TS_SUCCESS)
     TSError("Plugin registration failed. \n");
 
+  /* optional argument: how long, in seconds, a rendering is reused */
+  if (argc > 1)
+    cache_seconds = atoi(argv[1]);
+  stats_cache_mutex = TSMutexCreate();
+
   if (!check_ts_version()) {
     TSError("Plugin requires Traffic Server 2.0 or later\n");
     return;
@@ -4235,26 +4235,70 @@ TSMgmtUpdateRegister(TSCont contp, const char *plugin_name)
 TSReturnCode
 TSMgmtIntGet(const char *var_name, TSMgmtInt *result)
 {
-  return RecGetRecordInt((char *) var_name, (RecInt *) result) == REC_ERR_OKAY ? TS_SUCCESS : TS_ERROR;
+  return TSMgmtIntGetByRecord(TSMgmtRecordFind(var_name), result);
 }
 
 TSReturnCode
 TSMgmtCounterGet(const char *var_name, TSMgmtCounter *result)
 {
-  return RecGetRecordCounter((char *) var_name, (RecCounter *) result) == REC_ERR_OKAY ? TS_SUCCESS : TS_ERROR;
+  return TSMgmtCounterGetByRecord(TSMgmtRecordFind(var_name), result);
 }
 
 TSReturnCode
 TSMgmtFloatGet(const char *var_name, TSMgmtFloat *result)
 {
-  return RecGetRecordFloat((char *) var_name, (RecFloat *) result) == REC_ERR_OKAY ? TS_SUCCESS : TS_ERROR;
+  return TSMgmtFloatGetByRecord(TSMgmtRecordFind(var_name), result);
 }
 
 TSReturnCode
 TSMgmtStringGet(const char *var_name, TSMgmtString *result)
 {
+  return TSMgmtStringGetByRecord(TSMgmtRecordFind(var_name), result);
+}
+
+// The name lookup is done once here, the ByRecord getters go straight
+// to the record and fail on a NULL one (see RecLookupRecord()).
+TSMgmtRecord
+TSMgmtRecordFind(const char *var_name)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)var_name) == TS_SUCCESS);
+
+  return (TSMgmtRecord) RecLookupRecord(var_name);
+}
+
+TSReturnCode
+TSMgmtIntGetByRecord(TSMgmtRecord rec, TSMgmtInt *result)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)result) == TS_SUCCESS);
+
+  return RecGetRecordIntByHandle((RecRecord *) rec, (RecInt *) result) == REC_ERR_OKAY ? TS_SUCCESS : TS_ERROR;
+}
+
+TSReturnCode
+TSMgmtCounterGetByRecord(TSMgmtRecord rec, TSMgmtCounter *result)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)result) == TS_SUCCESS);
+
+  return RecGetRecordCounterByHandle((RecRecord *) rec, (RecCounter *) result) == REC_ERR_OKAY ? TS_SUCCESS : TS_ERROR;
+}
+
+TSReturnCode
+TSMgmtFloatGetByRecord(TSMgmtRecord rec, TSMgmtFloat *result)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)result) == TS_SUCCESS);
+
+  return RecGetRecordFloatByHandle((RecRecord *) rec, (RecFloat *) result) == REC_ERR_OKAY ? TS_SUCCESS : TS_ERROR;
+}
+
+TSReturnCode
+TSMgmtStringGetByRecord(TSMgmtRecord rec, TSMgmtString *result)
+{
+  sdk_assert(sdk_sanity_check_null_ptr((void*)result) == TS_SUCCESS);
+
   RecString tmp = 0;
-  (void) RecGetRecordString_Xmalloc((char *) var_name, &tmp);
+
+  if (rec)
+    (void) RecGetRecordString_XmallocByHandle((RecRecord *) rec, &tmp);
 
   if (tmp) {
     *result = tmp;
@@ -8072,6 +8116,10 @@ _conf_to_memberp(TSOverridableConfigKey conf,
     typ = OVERRIDABLE_TYPE_INT;
     ret = &overridableHttpConfig->max_cache_open_read_retries;
     break;
+  case TS_CONFIG_HTTP_ORIGIN_PIPELINE_DEPTH:
+    typ = OVERRIDABLE_TYPE_INT;
+    ret = &overridableHttpConfig->origin_pipeline_depth;
+    break;
 
     // This helps avoiding compiler warnings, yet detect unhandled enum members.
   case TS_CONFIG_NULL:
@@ -8393,6 +8441,10 @@ TSHttpTxnConfigFind(const char* name, int length, TSOverridableConfigKey *conf,
       else if (!strncmp(name, "proxy.config.http.share_server_sessions", length))
         cnf = TS_CONFIG_HTTP_SHARE_SERVER_SESSIONS;
       break;
+    case 'h':
+      if (!strncmp(name, "proxy.config.http.origin_pipeline_depth", length))
+        cnf = TS_CONFIG_HTTP_ORIGIN_PIPELINE_DEPTH;
+      break;
     }
     break;
 
@@ -5561,6 +5561,8 @@ REGRESSION_TEST(SDK_API_TSTextLog) (RegressionTest * test, int atype, int *pstat
 //                     TSMgmtFloatGet
 //                     TSMgmtIntGet
 //                     TSMgmtStringGet
+//                     TSMgmtRecordFind
+//                     TSMgmt*GetByRecord
 //////////////////////////////////////////////
 
 REGRESSION_TEST(SDK_API_TSMgmtGet) (RegressionTest * test, int atype, int *pstatus)
@@ -5624,6 +5626,30 @@ REGRESSION_TEST(SDK_API_TSMgmtGet) (RegressionTest * test, int atype, int *pstat
     SDK_RPRINT(test, "TSMgmtStringGet", "TestCase1.4", TC_PASS, "ok");
   }
 
+  // The same values through record handles
+  TSMgmtRecord crec = TSMgmtRecordFind(CONFIG_PARAM_COUNTER_NAME);
+  TSMgmtRecord frec = TSMgmtRecordFind(CONFIG_PARAM_FLOAT_NAME);
+  TSMgmtRecord irec = TSMgmtRecordFind(CONFIG_PARAM_INT_NAME);
+  TSMgmtRecord srec = TSMgmtRecordFind(CONFIG_PARAM_STRING_NAME);
+  TSMgmtString hsvalue = NULL;
+
+  if (!crec || !frec || !irec || !srec) {
+    SDK_RPRINT(test, "TSMgmtRecordFind", "TestCase1.5", TC_FAIL, "can not find the params");
+    err = 1;
+  } else if (TSMgmtCounterGetByRecord(crec, &cvalue) != TS_SUCCESS || cvalue != CONFIG_PARAM_COUNTER_VALUE ||
+             TSMgmtFloatGetByRecord(frec, &fvalue) != TS_SUCCESS || fvalue != CONFIG_PARAM_FLOAT_VALUE ||
+             TSMgmtIntGetByRecord(irec, &ivalue) != TS_SUCCESS || ivalue != CONFIG_PARAM_INT_VALUE ||
+             TSMgmtStringGetByRecord(srec, &hsvalue) != TS_SUCCESS || strcmp(hsvalue, CONFIG_PARAM_STRING_VALUE) != 0) {
+    SDK_RPRINT(test, "TSMgmt*GetByRecord", "TestCase1.5", TC_FAIL, "handle values differ from the named values");
+    err = 1;
+  } else if (TSMgmtIntGetByRecord(srec, &ivalue) != TS_ERROR || TSMgmtRecordFind("proxy.config.no.such.variable")) {
+    SDK_RPRINT(test, "TSMgmt*GetByRecord", "TestCase1.5", TC_FAIL, "wrong type or unknown name not rejected");
+    err = 1;
+  } else {
+    SDK_RPRINT(test, "TSMgmt*GetByRecord", "TestCase1.5", TC_PASS, "ok");
+  }
+  TSfree(hsvalue);
+
   if (err) {
     *pstatus = REGRESSION_TEST_FAILED;
     return;
@@ -7593,6 +7619,7 @@ const char *SDK_Overridable_Configs[] = {
   "proxy.config.net.sock_packet_tos_out",
   "proxy.config.http.cache.open_read_retry_time",
   "proxy.config.http.cache.max_open_read_retries",
+  "proxy.config.http.origin_pipeline_depth",
 
   NULL
 };
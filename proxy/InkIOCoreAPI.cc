@@ -111,6 +111,7 @@ ink_thread_trampoline(void *data)
 
   thread = (INKThreadInternal *) data;
   thread->set_specific();
+  eventProcessor.unbind_thread();
   retval = thread->func(thread->data);
   delete thread;
 
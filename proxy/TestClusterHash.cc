@@ -62,7 +62,6 @@ test()
     ClusterConfiguration *cc = new ClusterConfiguration;
     cc->n_machines = 1;
     cc->machines[0] = this_cluster_machine();
-    memset(cc->hash_table, 0, CLUSTER_HASH_TABLE_SIZE);
     clusterProcessor.this_cluster->configurations.push(cc);
 
     ClusterConfiguration *c = this_cluster()->current_configuration();
@@ -772,6 +772,7 @@ RangeTransform::RangeTransform(ProxyMutex *mut, MIMEField *range_field, HTTPHdr
     m_output_vio(NULL),
     m_unsatisfiable_range(true),
     m_not_handle_range(false),
+    m_precut(false),
     m_num_range_fields(0),
     m_current_range(0), m_content_type(NULL), m_content_type_len(0), m_ranges(NULL), m_output_cl(0), m_done(0)
 {
@@ -993,6 +994,10 @@ RangeTransform::transform_to_range()
   avail = reader->read_avail();
 
   while (true) {
+    // the cache already left out the bytes between the ranges
+    if (m_precut && *done_byte < (*start - 1))
+      *done_byte = *start - 1;
+
     if (*done_byte < (*start - 1)) {
       toskip = *start - *done_byte - 1;
 
@@ -85,6 +85,7 @@ public:
   VIO *m_output_vio;
   bool m_unsatisfiable_range;
   bool m_not_handle_range;
+  bool m_precut;                // input is only the bytes of the ranges, back to back
   int64_t m_content_length;
   int m_num_chars_for_cl;
   int m_num_range_fields;
@@ -28,6 +28,7 @@
 #include <string.h>
 #include "HTTP.h"
 #include "HdrToken.h"
+#include "HttpCompat.h"
 #include "Diags.h"
 
 
@@ -1654,6 +1655,7 @@ m_response_hdr(), m_request_sent_time(0), m_response_received_time(0), m_ext_buf
   m_object_key[3] = 0;
   m_object_size[0] = 0;
   m_object_size[1] = 0;
+  m_signature.clear();
 }
 
 void
@@ -1694,6 +1696,7 @@ HTTPCacheAlt::copy(HTTPCacheAlt *to_copy)
 
   m_request_sent_time = to_copy->m_request_sent_time;
   m_response_received_time = to_copy->m_response_received_time;
+  m_signature = to_copy->m_signature;
 }
 
 const int HTTP_ALT_MARSHAL_SIZE = ROUND(sizeof(HTTPCacheAlt), HDR_PTR_SIZE);
@@ -1754,6 +1757,13 @@ HTTPInfo::marshal(char *buf, int len)
   marshal_alt->m_writeable = 0;
   marshal_alt->m_unmarshal_len = -1;
   marshal_alt->m_ext_buffer = NULL;
+  // The headers are final once we are writing them out, so this
+  //   is where the alternate selection signature is built.
+  if (m_alt->m_request_hdr.valid() && m_alt->m_response_hdr.valid()) {
+    marshal_alt->m_signature.compute(&m_alt->m_request_hdr, &m_alt->m_response_hdr);
+  } else {
+    marshal_alt->m_signature.clear();
+  }
   buf += HTTP_ALT_MARSHAL_SIZE;
   used += HTTP_ALT_MARSHAL_SIZE;
 
@@ -1949,3 +1959,292 @@ HTTPInfo::get_handle(char *buf, int len)
   clear();
   return -1;
 }
+
+/*-------------------------------------------------------------------------
+  Alternate selection signatures
+  -------------------------------------------------------------------------*/
+
+static const uint64_t HTTP_SIG_HASH_BASIS = 0xcbf29ce484222325ULL;
+static const uint64_t HTTP_SIG_HASH_PRIME = 0x100000001b3ULL;
+
+// FNV-1a, folding case unless this is a raw (case sensitive) value.
+static inline uint64_t
+http_sig_hash_impl(const char *s, int len, bool fold_case)
+{
+  uint64_t h = HTTP_SIG_HASH_BASIS;
+
+  for (int i = 0; i < len; ++i) {
+    h ^= (unsigned char) (fold_case ? ParseRules::ink_tolower(s[i]) : s[i]);
+    h *= HTTP_SIG_HASH_PRIME;
+  }
+  return h;
+}
+
+uint64_t
+http_sig_hash(const char *s, int len, uint64_t seed)
+{
+  return http_sig_hash_impl(s, len, true) ^ seed;
+}
+
+// rfc2616,sec3.5: "x-gzip" and "x-compress" are equivalent to "gzip" and
+// "compress", so they hash to the same value.
+uint64_t
+http_sig_hash_encoding(const char *s, int len)
+{
+  if ((len == 6 && strncasecmp(s, "x-gzip", 6) == 0) || (len == 10 && strncasecmp(s, "x-compress", 10) == 0)) {
+    s += 2;
+    len -= 2;
+  }
+  return http_sig_hash_impl(s, len, true);
+}
+
+static inline uint64_t
+http_sig_hash_raw(MIMEField *field)
+{
+  int len;
+  const char *raw = field->value_get(&len);
+
+  return http_sig_hash_impl(raw, raw ? len : 0, false);
+}
+
+static inline bool
+http_sig_is_asterisk(const char *s)
+{
+  return ((s[0] == '*') && (s[1] == NUL));
+}
+
+// Mirrors HttpTransactCache::match_gzip().
+static inline bool
+http_sig_accepts_gzip(MIMEField *accept_field)
+{
+  static const uint64_t gzip_hash = http_sig_hash_encoding("gzip", 4);
+  StrList a_values_list;
+
+  accept_field->value_get_comma_list(&a_values_list);
+  for (Str *a_value = a_values_list.head; a_value; a_value = a_value->next) {
+    StrList a_param_list;
+
+    HttpCompat::parse_semicolon_list(&a_param_list, a_value->str);
+    if (!a_param_list.head)
+      continue;
+    if (HttpCompat::find_Q_param_in_strlist(&a_param_list) != 0 &&
+        (http_sig_is_asterisk(a_param_list.head->str) ||
+         http_sig_hash_encoding(a_param_list.head->str, a_param_list.head->len) == gzip_hash)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+  Build the signature of a cached alternate from its request and response
+  headers. If any of the headers has more values than the signature can
+  hold, the signature is left invalid and selection falls back to string
+  matching for this alternate.
+
+*/
+void
+HTTPAltSignature::compute(HTTPHdr *request, HTTPHdr *response)
+{
+  MIMEField *field;
+  int len;
+  const char *raw;
+
+  clear();
+
+  // Content-Type and charset
+  if ((field = response->field_find(MIME_FIELD_CONTENT_TYPE, MIME_LEN_CONTENT_TYPE)) != NULL) {
+    StrList c_param_list;
+    char c_type[32], c_subtype[32], c_charset[128];
+
+    m_flags |= HTTP_ALT_SIG_CONTENT_TYPE;
+    raw = field->value_get(&len);
+    HttpCompat::parse_semicolon_list(&c_param_list, raw, len);
+    if (c_param_list.head) {
+      m_flags |= HTTP_ALT_SIG_CONTENT_TYPE_PARAM;
+      HttpCompat::parse_mime_type(c_param_list.head->str, c_type, c_subtype, sizeof(c_type), sizeof(c_subtype));
+      m_content_type = http_sig_hash(c_type, strlen(c_type));
+      m_content_subtype = http_sig_hash(c_subtype, strlen(c_subtype));
+    }
+    if (!HttpCompat::lookup_param_in_semicolon_string(raw, len, "charset", c_charset, sizeof(c_charset) - 1)) {
+      ink_strlcpy(c_charset, "iso-8859-1", sizeof(c_charset));
+    }
+    if (strcasecmp(c_charset, "iso-8859-1") == 0) {
+      m_flags |= HTTP_ALT_SIG_CHARSET_DEFAULT;
+    }
+    m_content_charset = http_sig_hash(c_charset, strlen(c_charset));
+  }
+
+  // Content-Encoding
+  if ((field = response->field_find(MIME_FIELD_CONTENT_ENCODING, MIME_LEN_CONTENT_ENCODING)) != NULL) {
+    StrList values;
+
+    m_flags |= HTTP_ALT_SIG_CONTENT_ENCODING;
+    field->value_get_comma_list(&values);
+    if (values.count > HTTP_ALT_SIG_MAX_ENCODINGS) {
+      clear();
+      return;
+    }
+    field->value_get(&len);
+    if (len == 0) {
+      m_flags |= HTTP_ALT_SIG_IDENTITY_ENCODING;
+    }
+    for (Str *c_value = values.head; c_value; c_value = c_value->next) {
+      if ((c_value->len >= 8) && (strncasecmp(c_value->str, "identity", 8) == 0)) {
+        m_flags |= HTTP_ALT_SIG_IDENTITY_ENCODING;
+      }
+      m_encoding[m_encoding_count++] = http_sig_hash_encoding(c_value->str, c_value->len);
+    }
+  } else {
+    m_flags |= HTTP_ALT_SIG_IDENTITY_ENCODING;
+  }
+
+  // Content-Language, with every language range that would match each tag
+  if ((field = response->field_find(MIME_FIELD_CONTENT_LANGUAGE, MIME_LEN_CONTENT_LANGUAGE)) != NULL) {
+    StrList values;
+    int n_prefix = 0;
+
+    m_flags |= HTTP_ALT_SIG_CONTENT_LANGUAGE;
+    field->value_get_comma_list(&values);
+    if (values.count > HTTP_ALT_SIG_MAX_LANGUAGES) {
+      clear();
+      return;
+    }
+    for (Str *c_value = values.head; c_value; c_value = c_value->next) {
+      for (int i = 0; i <= (int) c_value->len; ++i) {
+        if (i == (int) c_value->len || c_value->str[i] == '-') {
+          if (n_prefix >= HTTP_ALT_SIG_MAX_LANGUAGE_PREFIXES) {
+            clear();
+            return;
+          }
+          m_language_prefix[n_prefix++] = http_sig_hash(c_value->str, i);
+        }
+      }
+      m_language_prefix_end[m_language_count++] = n_prefix;
+    }
+  }
+
+  // Accept* of the request which fetched this alternate
+  if ((field = request->field_find(MIME_FIELD_ACCEPT_CHARSET, MIME_LEN_ACCEPT_CHARSET)) != NULL) {
+    m_flags |= HTTP_ALT_SIG_ACCEPT_CHARSET;
+    m_accept_charset_raw = http_sig_hash_raw(field);
+  }
+  if ((field = request->field_find(MIME_FIELD_ACCEPT_ENCODING, MIME_LEN_ACCEPT_ENCODING)) != NULL) {
+    m_flags |= HTTP_ALT_SIG_ACCEPT_ENCODING;
+    m_accept_encoding_raw = http_sig_hash_raw(field);
+    if (http_sig_accepts_gzip(field)) {
+      m_flags |= HTTP_ALT_SIG_ACCEPT_ENCODING_GZIP;
+    }
+  }
+  if ((field = request->field_find(MIME_FIELD_ACCEPT_LANGUAGE, MIME_LEN_ACCEPT_LANGUAGE)) != NULL) {
+    m_flags |= HTTP_ALT_SIG_ACCEPT_LANGUAGE;
+    m_accept_language_raw = http_sig_hash_raw(field);
+  }
+
+  m_flags |= HTTP_ALT_SIG_VALID;
+}
+
+enum HTTPAcceptKind
+{
+  HTTP_ACCEPT_KIND_TYPE,
+  HTTP_ACCEPT_KIND_CHARSET,
+  HTTP_ACCEPT_KIND_ENCODING,
+  HTTP_ACCEPT_KIND_LANGUAGE
+};
+
+// Parse one client Accept* header the same way the corresponding
+// HttpTransactCache::calculate_quality_of_*_match() would.
+static bool
+http_accept_list_compute(HTTPAcceptList *list, HTTPHdr *request, const char *name, int name_len, HTTPAcceptKind kind)
+{
+  static const uint64_t gzip_hash = http_sig_hash_encoding("gzip", 4);
+  MIMEField *field = request->field_find(name, name_len);
+  StrList a_values_list;
+
+  list->m_present = false;
+  list->m_overflow = false;
+  list->m_gzip = false;
+  list->m_count = 0;
+  list->m_raw = 0;
+
+  if (!field) {
+    return true;
+  }
+
+  list->m_present = true;
+  list->m_raw = http_sig_hash_raw(field);
+  field->value_get_comma_list(&a_values_list);
+
+  for (Str *a_value = a_values_list.head; a_value; a_value = a_value->next) {
+    StrList a_param_list;
+    HTTPAcceptEntry *e;
+    const char *a_str;
+
+    HttpCompat::parse_semicolon_list(&a_param_list, a_value->str, a_value->len);
+    if (!a_param_list.head)
+      continue;
+
+    if (list->m_count >= HTTP_ACCEPT_SIG_MAX_ENTRIES) {
+      list->m_overflow = true;
+      return false;
+    }
+
+    e = &list->m_entries[list->m_count++];
+    e->m_q = HttpCompat::find_Q_param_in_strlist(&a_param_list);
+    e->m_flags = 0;
+    e->m_subtype_hash = 0;
+    a_str = a_param_list.head->str;
+
+    switch (kind) {
+    case HTTP_ACCEPT_KIND_TYPE:
+      {
+        char a_type[32], a_subtype[32];
+
+        HttpCompat::parse_mime_type(a_str, a_type, a_subtype, sizeof(a_type), sizeof(a_subtype));
+        if (http_sig_is_asterisk(a_type))
+          e->m_flags |= HTTP_ACCEPT_ENTRY_STAR;
+        else if (a_type[0] == NUL)
+          e->m_flags |= HTTP_ACCEPT_ENTRY_EMPTY;
+        if (http_sig_is_asterisk(a_subtype))
+          e->m_flags |= HTTP_ACCEPT_ENTRY_SUBTYPE_STAR;
+        else if (a_subtype[0] == NUL)
+          e->m_flags |= HTTP_ACCEPT_ENTRY_SUBTYPE_EMPTY;
+        e->m_hash = http_sig_hash(a_type, strlen(a_type));
+        e->m_subtype_hash = http_sig_hash(a_subtype, strlen(a_subtype));
+      }
+      break;
+    case HTTP_ACCEPT_KIND_ENCODING:
+      e->m_hash = http_sig_hash_encoding(a_str, a_param_list.head->len);
+      if (http_sig_is_asterisk(a_str))
+        e->m_flags |= HTTP_ACCEPT_ENTRY_STAR;
+      if (e->m_q != 0 && ((e->m_flags & HTTP_ACCEPT_ENTRY_STAR) || e->m_hash == gzip_hash))
+        list->m_gzip = true;
+      break;
+    default:
+      e->m_hash = http_sig_hash(a_str, a_param_list.head->len);
+      if (http_sig_is_asterisk(a_str))
+        e->m_flags |= HTTP_ACCEPT_ENTRY_STAR;
+      else if (a_str[0] == NUL)
+        e->m_flags |= HTTP_ACCEPT_ENTRY_EMPTY;
+      break;
+    }
+  }
+  return true;
+}
+
+/**
+  Parse the Accept* headers of a client request, once per lookup, into
+  the form compared against each HTTPAltSignature.
+
+*/
+void
+HTTPAcceptSignature::compute(HTTPHdr *request)
+{
+  m_valid = http_accept_list_compute(&m_accept, request, MIME_FIELD_ACCEPT, MIME_LEN_ACCEPT, HTTP_ACCEPT_KIND_TYPE) &&
+    http_accept_list_compute(&m_charset, request, MIME_FIELD_ACCEPT_CHARSET, MIME_LEN_ACCEPT_CHARSET,
+                             HTTP_ACCEPT_KIND_CHARSET) &&
+    http_accept_list_compute(&m_encoding, request, MIME_FIELD_ACCEPT_ENCODING, MIME_LEN_ACCEPT_ENCODING,
+                             HTTP_ACCEPT_KIND_ENCODING) &&
+    http_accept_list_compute(&m_language, request, MIME_FIELD_ACCEPT_LANGUAGE, MIME_LEN_ACCEPT_LANGUAGE,
+                             HTTP_ACCEPT_KIND_LANGUAGE);
+}
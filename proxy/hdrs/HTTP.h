@@ -1247,6 +1247,107 @@ enum
   CACHE_ALT_MAGIC_DEAD = 0xdeadeed
 };
 
+/*-------------------------------------------------------------------------
+  Alternate selection signatures.
+
+  Selecting among the alternates of a cached object compares the client's
+  Accept* headers against the Content-* headers of each cached response
+  (and the Accept* headers of the request that fetched it).  Rather than
+  re-parsing all of those strings on every lookup, each alternate carries
+  an HTTPAltSignature built when it is marshaled into the cache, and the
+  client request is parsed once per lookup into an HTTPAcceptSignature.
+  All tokens are reduced to case-insensitive 64 bit hashes, so the
+  matching in HttpTransactCache only compares integers.  Either side can
+  be marked unusable (too many values, missing headers), in which case
+  the string based matching is used instead.
+  -------------------------------------------------------------------------*/
+
+#define HTTP_ALT_SIG_MAX_ENCODINGS          4
+#define HTTP_ALT_SIG_MAX_LANGUAGES          4
+#define HTTP_ALT_SIG_MAX_LANGUAGE_PREFIXES  8
+#define HTTP_ACCEPT_SIG_MAX_ENTRIES         16
+
+enum
+{
+  HTTP_ALT_SIG_VALID = 0x0001,
+  HTTP_ALT_SIG_CONTENT_TYPE = 0x0002,           // response has a Content-Type
+  HTTP_ALT_SIG_CONTENT_TYPE_PARAM = 0x0004,     // ... with a non-empty media type
+  HTTP_ALT_SIG_CHARSET_DEFAULT = 0x0008,        // charset is (or defaults to) iso-8859-1
+  HTTP_ALT_SIG_CONTENT_ENCODING = 0x0010,       // response has a Content-Encoding
+  HTTP_ALT_SIG_IDENTITY_ENCODING = 0x0020,      // response is identity encoded
+  HTTP_ALT_SIG_CONTENT_LANGUAGE = 0x0040,       // response has a Content-Language
+  HTTP_ALT_SIG_ACCEPT_CHARSET = 0x0080,         // cached request had Accept-Charset
+  HTTP_ALT_SIG_ACCEPT_ENCODING = 0x0100,        // cached request had Accept-Encoding
+  HTTP_ALT_SIG_ACCEPT_LANGUAGE = 0x0200,        // cached request had Accept-Language
+  HTTP_ALT_SIG_ACCEPT_ENCODING_GZIP = 0x0400    // ... and it accepted gzip
+};
+
+struct HTTPAltSignature
+{
+  uint32_t m_flags;
+  uint8_t m_encoding_count;
+  uint8_t m_language_count;
+  // End index (exclusive) into m_language_prefix for each Content-Language value.
+  uint8_t m_language_prefix_end[HTTP_ALT_SIG_MAX_LANGUAGES];
+
+  uint64_t m_content_type;
+  uint64_t m_content_subtype;
+  uint64_t m_content_charset;
+  uint64_t m_encoding[HTTP_ALT_SIG_MAX_ENCODINGS];
+  // Every '-' delimited prefix of every Content-Language value, plus the value itself.
+  uint64_t m_language_prefix[HTTP_ALT_SIG_MAX_LANGUAGE_PREFIXES];
+
+  // Hashes of the raw Accept* values of the cached request, for exact matches.
+  uint64_t m_accept_charset_raw;
+  uint64_t m_accept_encoding_raw;
+  uint64_t m_accept_language_raw;
+
+  bool valid() const { return (m_flags & HTTP_ALT_SIG_VALID) != 0; }
+  void clear() { memset(this, 0, sizeof(*this)); }
+  void compute(HTTPHdr *request, HTTPHdr *response);
+};
+
+enum
+{
+  HTTP_ACCEPT_ENTRY_STAR = 0x01,                // value (or type) is "*"
+  HTTP_ACCEPT_ENTRY_EMPTY = 0x02,               // value (or type) is ""
+  HTTP_ACCEPT_ENTRY_SUBTYPE_STAR = 0x04,        // Accept only: subtype is "*"
+  HTTP_ACCEPT_ENTRY_SUBTYPE_EMPTY = 0x08        // Accept only: subtype is ""
+};
+
+struct HTTPAcceptEntry
+{
+  uint64_t m_hash;
+  uint64_t m_subtype_hash;      // Accept only
+  float m_q;
+  uint32_t m_flags;
+};
+
+struct HTTPAcceptList
+{
+  bool m_present;
+  bool m_overflow;
+  bool m_gzip;                  // Accept-Encoding only, see HttpTransactCache::match_gzip()
+  int m_count;
+  uint64_t m_raw;
+  HTTPAcceptEntry m_entries[HTTP_ACCEPT_SIG_MAX_ENTRIES];
+};
+
+struct HTTPAcceptSignature
+{
+  bool m_valid;
+  HTTPAcceptList m_accept;
+  HTTPAcceptList m_charset;
+  HTTPAcceptList m_encoding;
+  HTTPAcceptList m_language;
+
+  HTTPAcceptSignature() : m_valid(false) { }
+  void compute(HTTPHdr *request);
+};
+
+uint64_t http_sig_hash(const char *s, int len, uint64_t seed = 0);
+uint64_t http_sig_hash_encoding(const char *s, int len);
+
 // struct HTTPCacheAlt
 struct HTTPCacheAlt
 {
@@ -1276,6 +1377,10 @@ struct HTTPCacheAlt
   time_t m_request_sent_time;
   time_t m_response_received_time;
 
+  // Computed from the headers when the alternate is marshaled,
+  //  used by HttpTransactCache::SelectFromAlternates()
+  HTTPAltSignature m_signature;
+
   // With clustering, our alt may be in cluster
   //  incoming channel buffer, when we are
   //  destroyed we decrement the refcount
@@ -1338,6 +1443,8 @@ public:
   time_t request_sent_time_get() { return m_alt->m_request_sent_time; }
   time_t response_received_time_get() { return m_alt->m_response_received_time; }
 
+  const HTTPAltSignature *signature_get() const { return &m_alt->m_signature; }
+
   void object_key_set(INK_MD5 & md5);
   void object_size_set(int64_t size);
 
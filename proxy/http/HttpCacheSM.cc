@@ -187,6 +187,18 @@ HttpCacheSM::state_cache_open_write(int event, void *data)
     master_sm->handleEvent(event, data);
     break;
 
+  case CACHE_EVENT_OPEN_READ:
+    // The cluster owner of the object already had a write of it
+    // in progress and handed us a read of that write instead
+    HTTP_INCREMENT_DYN_STAT(http_current_cache_connections_stat);
+    ink_assert(cache_read_vc == NULL);
+    open_write_cb = true;
+    cache_read_vc = (CacheVConnection *) data;
+    if (cache_read_vc->is_read_from_writer())
+      set_readwhilewrite_inprogress(true);
+    master_sm->handleEvent(event, data);
+    break;
+
   default:
     ink_release_assert(0);
   }
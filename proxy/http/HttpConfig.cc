@@ -60,6 +60,7 @@
 
 
 RecRawStatBlock *http_rsb;
+RecHistogramBlock *http_rhb;
 #define HTTP_CLEAR_DYN_STAT(x) \
 do { \
 	RecSetRawStatSum(http_rsb, x, 0); \
@@ -258,6 +259,26 @@ register_stat_callbacks()
                      "proxy.process.http.avg_transactions_per_parent_connection",
                      RECD_FLOAT, RECP_NULL, (int) http_transactions_per_parent_con, RecRawStatSyncAvg);
 
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.origin_server_session_reuse",
+                     RECD_COUNTER, RECP_NULL, (int) http_origin_session_reuse_stat, RecRawStatSyncCount);
+
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.origin_server_session_steal",
+                     RECD_COUNTER, RECP_NULL, (int) http_origin_session_steal_stat, RecRawStatSyncCount);
+
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.origin_server_session_idle_evict",
+                     RECD_COUNTER, RECP_NULL, (int) http_origin_session_idle_evict_stat, RecRawStatSyncCount);
+
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.origin_server_pipelined_requests",
+                     RECD_COUNTER, RECP_NULL, (int) http_origin_pipelined_requests_stat, RecRawStatSyncCount);
+
+  RecRegisterRawStat(http_rsb, RECT_PROCESS,
+                     "proxy.process.http.origin_server_pipeline_fallbacks",
+                     RECD_COUNTER, RECP_NULL, (int) http_origin_pipeline_fallbacks_stat, RecRawStatSyncCount);
+
   RecRegisterRawStat(http_rsb, RECT_PROCESS,
                      "proxy.process.http.client_connection_time",
                      RECD_INT, RECP_NULL, (int) http_client_connection_time_stat, RecRawStatSyncSum);
@@ -1141,6 +1162,10 @@ register_stat_callbacks()
                      RECD_FLOAT, RECP_NULL,
                      (int) http_server_first_response_time_stat, RecRawStatSyncIntMsecsToFloatSeconds);
 
+  // Latency histograms
+  RecRegisterHistogram(http_rhb, RECT_PROCESS, "proxy.process.http.ttfb_usecs", (int) http_ttfb_hist);
+  RecRegisterHistogram(http_rhb, RECT_PROCESS, "proxy.process.http.origin_connect_usecs", (int) http_origin_connect_hist);
+  RecRegisterHistogram(http_rhb, RECT_PROCESS, "proxy.process.http.cache_open_read_usecs", (int) http_cache_open_read_hist);
 }
 
 
@@ -1154,6 +1179,7 @@ HttpConfig::startup()
 {
 
   http_rsb = RecAllocateRawStatBlock((int) http_stat_count);
+  http_rhb = RecAllocateHistogramBlock((int) http_hist_count);
   register_configs();
   register_stat_callbacks();
 
@@ -1184,6 +1210,11 @@ HttpConfig::startup()
   HttpEstablishStaticConfigLongLong(c.oride.server_tcp_init_cwnd, "proxy.config.http.server_tcp_init_cwnd");
   HttpEstablishStaticConfigLongLong(c.oride.origin_max_connections, "proxy.config.http.origin_max_connections");
   HttpEstablishStaticConfigLongLong(c.origin_min_keep_alive_connections, "proxy.config.http.origin_min_keep_alive_connections");
+  HttpEstablishStaticConfigLongLong(c.server_session_max_idle_per_origin,
+                                    "proxy.config.http.server_session_max_idle_per_origin");
+  HttpEstablishStaticConfigByte(c.server_session_steal_enabled, "proxy.config.http.server_session_steal_enabled");
+  HttpEstablishStaticConfigLongLong(c.oride.origin_pipeline_depth, "proxy.config.http.origin_pipeline_depth");
+  HttpEstablishStaticConfigLongLong(c.origin_pipeline_max_object_size, "proxy.config.http.origin_pipeline_max_object_size");
 
   HttpEstablishStaticConfigByte(c.parent_proxy_routing_enable, "proxy.config.http.parent_proxy_routing_enable");
 
@@ -1477,6 +1508,10 @@ HttpConfig::reconfigure()
   params->oride.server_tcp_init_cwnd = m_master.oride.server_tcp_init_cwnd;
   params->oride.origin_max_connections = m_master.oride.origin_max_connections;
   params->origin_min_keep_alive_connections = m_master.origin_min_keep_alive_connections;
+  params->server_session_max_idle_per_origin = m_master.server_session_max_idle_per_origin;
+  params->server_session_steal_enabled = INT_TO_BOOL(m_master.server_session_steal_enabled);
+  params->oride.origin_pipeline_depth = m_master.oride.origin_pipeline_depth;
+  params->origin_pipeline_max_object_size = m_master.origin_pipeline_max_object_size;
 
   if (params->oride.origin_max_connections &&
       params->oride.origin_max_connections < params->origin_min_keep_alive_connections ) {
@@ -102,6 +102,13 @@ enum
   http_transactions_per_server_con,
   http_transactions_per_parent_con,
 
+  // Http origin session pool stats
+  http_origin_session_reuse_stat,
+  http_origin_session_steal_stat,
+  http_origin_session_idle_evict_stat,
+  http_origin_pipelined_requests_stat,
+  http_origin_pipeline_fallbacks_stat,
+
   // Http Time Stuff
   http_client_connection_time_stat,
   http_parent_proxy_connection_time_stat,
@@ -351,7 +358,18 @@ enum
   http_stat_count
 };
 
+// Latency histograms, in microseconds
+enum
+{
+  http_ttfb_hist,                       // client request to first response byte
+  http_origin_connect_hist,             // origin server connect
+  http_cache_open_read_hist,            // cache lookup
+
+  http_hist_count
+};
+
 extern RecRawStatBlock *http_rsb;
+extern RecHistogramBlock *http_rhb;
 extern volatile int g_current_active_client_connections;
 
 /* Stats should only be accessed using these macros */
@@ -366,6 +384,8 @@ do { \
         RecSetRawStatCount(http_rsb, x, 0); \
  } while (0);
 
+#define HTTP_RECORD_HIST(x, t) RecRecordHistogram(http_rhb, mutex->thread_holding, (int) x, ink_hrtime_to_usec(t))
+
 #define HTTP_READ_DYN_SUM(x, S) RecGetRawStatSum(http_rsb, (int)x, &S) // This aggregates threads too
 #define HTTP_READ_GLOBAL_DYN_SUM(x, S) RecGetGlobalRawStatSum(http_rsb, (int)x, &S)
 
@@ -432,6 +452,7 @@ struct OverridableHttpConfigParams {
        transaction_request_active_timeout_in(0),
        transaction_active_timeout_out(0),
        origin_max_connections(0), max_active_client_connections(0), max_bandwidth(0),
+       origin_pipeline_depth(0),
        connect_attempts_max_retries(0), connect_attempts_max_retries_dead_server(0),
        connect_attempts_rr_retries(0), connect_attempts_timeout(0),
        post_connect_attempts_timeout(0),
@@ -562,6 +583,7 @@ struct OverridableHttpConfigParams {
   MgmtInt origin_max_connections;
   MgmtInt max_active_client_connections;
   MgmtInt max_bandwidth;
+  MgmtInt origin_pipeline_depth;
 
   ////////////////////////////////////
   // origin server connect attempts //
@@ -639,6 +661,9 @@ public:
   MgmtInt max_active_client_connections;
   MgmtInt server_max_connections;
   MgmtInt origin_min_keep_alive_connections; // TODO: This one really ought to be overridable, but difficult right now.
+  MgmtInt server_session_max_idle_per_origin;
+  MgmtByte server_session_steal_enabled;
+  MgmtInt origin_pipeline_max_object_size;
 
   MgmtByte parent_proxy_routing_enable;
   MgmtByte disable_ssl_parenting;
@@ -929,6 +954,9 @@ HttpConfigParams::HttpConfigParams()
     max_active_client_connections(0),
     server_max_connections(0),
     origin_min_keep_alive_connections(0),
+    server_session_max_idle_per_origin(0),
+    server_session_steal_enabled(1),
+    origin_pipeline_max_object_size(65536),
     parent_proxy_routing_enable(0),
     disable_ssl_parenting(0),
     enable_url_expandomatic(0),
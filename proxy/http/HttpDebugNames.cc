@@ -29,6 +29,7 @@
 #include "Transform.h"
 #include "ICPevents.h"
 #include "HttpSM.h"
+#include "HttpServerSession.h"
 #include "HttpUpdateSM.h"
 
 //----------------------------------------------------------------------------
@@ -213,6 +214,11 @@ HttpDebugNames::get_event_name(int event)
   case HTTP_TUNNEL_EVENT_CONSUMER_DETACH:
     return ("HTTP_TUNNEL_EVENT_CONSUMER_DETACH");
 
+  case HTTP_SS_EVENT_PIPELINE_READY:
+    return ("HTTP_SS_EVENT_PIPELINE_READY");
+  case HTTP_SS_EVENT_PIPELINE_FAILED:
+    return ("HTTP_SS_EVENT_PIPELINE_FAILED");
+
     //////////////////////////
     //  ICP Events
     //////////////////////////
@@ -323,7 +323,7 @@ HttpSM::HttpSM()
     history_pos(0), tunnel(), ua_entry(NULL),
     ua_session(NULL), background_fill(BACKGROUND_FILL_NONE),
     server_entry(NULL), server_session(NULL), shared_session_retries(0),
-    server_buffer_reader(NULL),
+    server_buffer_reader(NULL), pipeline_session(NULL), pipeline_fallback(false),
     transform_info(), post_transform_info(), second_cache_sm(NULL),
     default_handler(NULL), pending_action(NULL), historical_action(NULL),
     last_action(HttpTransact::STATE_MACHINE_ACTION_UNDEFINED),
@@ -613,6 +613,8 @@ HttpSM::attach_client_session(HttpClientSession * client_vc, IOBufferReader * bu
   ats_ip_copy(&t_state.client_info.addr, netvc->get_remote_addr());
   t_state.client_info.port = netvc->get_local_port();
   t_state.client_info.is_transparent = netvc->get_is_transparent();
+  HTTPHdr *framed_request = NULL;
+  t_state.client_info.is_framed = netvc->get_data(NET_DATA_REQUEST_HDR, &framed_request);
   t_state.backdoor_request = client_vc->backdoor_connect;
   t_state.client_info.port_attribute = static_cast<HttpProxyPort::TransportType>(netvc->attributes);
 
@@ -652,8 +654,9 @@ HttpSM::setup_client_read_request_header()
   ua_entry->read_vio = ua_session->do_io_read(this, INT64_MAX, ua_buffer_reader->mbuf);
 
   // The header may already be in the buffer if this
-  //  a request from a keep-alive connection
-  if (ua_buffer_reader->read_avail() > 0)
+  //  a request from a keep-alive connection, a framed
+  //  connection has it parsed already
+  if (ua_buffer_reader->read_avail() > 0 || t_state.client_info.is_framed)
     handleEvent(VC_EVENT_READ_READY, ua_entry->read_vio);
 }
 
@@ -716,10 +719,19 @@ HttpSM::state_read_client_request_header(int event, void *data)
   // tokenize header //
   /////////////////////
 
-  int state = t_state.hdr_info.client_request.parse_req(&http_parser,
-                                                        ua_buffer_reader,
-                                                        &bytes_used,
-                                                        ua_entry->eos);
+  int state;
+  if (t_state.client_info.is_framed) {
+    // The request comes as a header, not as bytes to parse
+    HTTPHdr *framed_request = NULL;
+    ua_session->get_netvc()->get_data(NET_DATA_REQUEST_HDR, &framed_request);
+    t_state.hdr_info.client_request.copy(framed_request);
+    state = PARSE_DONE;
+  } else {
+    state = t_state.hdr_info.client_request.parse_req(&http_parser,
+                                                      ua_buffer_reader,
+                                                      &bytes_used,
+                                                      ua_entry->eos);
+  }
 
   client_request_hdr_bytes += bytes_used;
 
@@ -1636,6 +1648,8 @@ HttpSM::state_http_server_open(int event, void *data)
 
   switch (event) {
   case NET_EVENT_OPEN:
+    if (milestones.server_connect != 0)
+      HTTP_RECORD_HIST(http_origin_connect_hist, ink_get_hrtime() - milestones.server_connect);
     session = (2 == t_state.txn_conf->share_server_sessions) ? 
       THREAD_ALLOC_INIT(httpServerSessionAllocator, mutex->thread_holding) :
       httpServerSessionAllocator.alloc();
@@ -1848,6 +1862,10 @@ HttpSM::state_read_server_response_header(int event, void *data)
     t_state.transact_return_point = HttpTransact::HandleResponse;
     t_state.api_next_action = HttpTransact::HTTP_API_READ_REPONSE_HDR;
 
+    if (server_session->pipeline_listed || server_session->pipeline_count > 0) {
+      check_pipeline_response();
+    }
+
     // YTS Team, yamsat Plugin
     // Incrementing redirection_tries according to config parameter
     // if exceeded limit deallocate postdata buffers and disable redirection
@@ -1902,6 +1920,13 @@ HttpSM::state_send_server_request_header(int event, void *data)
         do_setup_post_tunnel(HTTP_SERVER_VC);
       }
     } else {
+      // Let the next small GETs to the origin from this thread queue
+      //  their requests behind ours
+      if (is_pipelinable_request(false) && server_session->share_session == 2 &&
+          !server_session->private_session && server_session->get_netvc()->thread == this_ethread()) {
+        server_session->attach_hostname(t_state.current.server->name);
+        httpSessionManager.add_pipeline_session(server_session, t_state.txn_conf->origin_pipeline_depth);
+      }
       // It's time to start reading the response
       setup_server_read_response_header();
     }
@@ -1964,6 +1989,49 @@ HttpSM::state_send_server_request_header(int event, void *data)
   return 0;
 }
 
+// int HttpSM::state_pipeline_wait(int event, void* data)
+//
+//   Our request went out on a connection busy with other transactions,
+//    the session tells us when the response is next.  If the connection
+//    is lost first we open our own, the request is an idempotent GET.
+//
+int
+HttpSM::state_pipeline_wait(int event, void *data)
+{
+  STATE_ENTER(&HttpSM::state_pipeline_wait, event);
+  ink_assert(pending_action == (Action *) data);
+  NOWARN_UNUSED(data);
+  pending_action = NULL;
+
+  switch (event) {
+  case HTTP_SS_EVENT_PIPELINE_READY:
+    {
+      HttpServerSession *s = pipeline_session;
+
+      pipeline_session = NULL;
+      if (s->pipeline_resume(this)) {
+        attach_server_session(s);
+        setup_server_read_response_header();
+        break;
+      }
+    }
+    // FALLTHROUGH, the origin closed the connection
+  case HTTP_SS_EVENT_PIPELINE_FAILED:
+    DebugSM("http", "[%" PRId64 "] pipelined request failed, opening a connection", sm_id);
+    pipeline_fallback = true;
+    HTTP_INCREMENT_DYN_STAT(http_origin_pipeline_fallbacks_stat);
+    HTTP_SM_SET_DEFAULT_HANDLER(&HttpSM::state_http_server_open);
+    do_http_server_open();
+    break;
+
+  default:
+    ink_release_assert(0);
+    break;
+  }
+
+  return 0;
+}
+
 //void
 //HttpSM::process_srv_info(HostDBInfo * r)
 //{
@@ -2992,9 +3060,10 @@ HttpSM::tunnel_handler_server(int event, HttpTunnelProducer * p)
     // we turn off private binding when outbound connections are being
     // limit since it makes it too expensive to initiate a purge of idle
     // server keep-alive sessions
+    // Pipelined sessions go to the next request in their queue.
     if (ua_session && t_state.client_info.keep_alive == HTTP_KEEPALIVE &&
         t_state.http_config_param->server_max_connections <= 0 &&
-        t_state.txn_conf->origin_max_connections <= 0) {
+        t_state.txn_conf->origin_max_connections <= 0 && !server_session->pipeline_active()) {
       ua_session->attach_server_session(server_session);
     } else {
       // Release the session back into the shared session pool
@@ -4133,6 +4202,17 @@ HttpSM::do_range_setup_if_necessary(bool from_server)
           t_state.single_range._end = range_trans->m_ranges[0]._end;
           delete range_trans;
           return;
+        } else if (!from_server && range_trans->m_num_range_fields > 1 &&
+                   cache_sm.cache_read_vc->is_pread_ranges_capable()) {
+          // let the cache read only what the ranges need, the transform
+          // just adds the multipart framing
+          t_state.num_pread_ranges = range_trans->m_num_range_fields;
+          t_state.pread_ranges = (CacheRange *)ats_malloc(t_state.num_pread_ranges * sizeof(CacheRange));
+          for (int i = 0; i < t_state.num_pread_ranges; i++) {
+            t_state.pread_ranges[i].start = range_trans->m_ranges[i]._start;
+            t_state.pread_ranges[i].end = range_trans->m_ranges[i]._end;
+          }
+          range_trans->m_precut = true;
         } else if (from_server)
           t_state.api_info.cache_untransformed = true;
         api_hooks.append(TS_HTTP_RESPONSE_TRANSFORM_HOOK, range_trans);
@@ -4444,6 +4524,11 @@ HttpSM::do_http_server_open(bool raw)
     default:
       hsm_release_assert(0);
     }
+
+    // No idle session, queue behind a busy one if we may
+    if (is_pipelinable_request(true) && do_pipelined_server_request()) {
+      return;
+    }
   }
   // This bug was due to when share_server_sessions is set to 0
   // and we have keep-alive, we are trying to open a new server session
@@ -4599,6 +4684,36 @@ HttpSM::do_http_server_open(bool raw)
   return;
 }
 
+// bool HttpSM::do_pipelined_server_request()
+//
+//   Write our request behind the ones in flight on a session of this
+//    thread to the origin, if there is one with room left.
+//
+bool
+HttpSM::do_pipelined_server_request()
+{
+  HttpServerSession *s = httpSessionManager.acquire_pipelined_session(&t_state.current.server->addr.sa,
+                                                                     t_state.current.server->name);
+
+  if (s == NULL) {
+    return false;
+  }
+
+  MIOBuffer *buf = new_MIOBuffer(buffer_size_to_index(HTTP_HEADER_BUFFER_SIZE));
+  IOBufferReader *buf_start = buf->alloc_reader();
+
+  server_request_hdr_bytes = write_header_into_buffer(&t_state.hdr_info.server_request, buf);
+  s->pipeline_enqueue(this, buf_start);
+  free_MIOBuffer(buf);
+
+  DebugSM("http", "[%" PRId64 "] request pipelined on server session %" PRId64, sm_id, s->con_id);
+  HTTP_INCREMENT_DYN_STAT(http_origin_pipelined_requests_stat);
+  pipeline_session = s;
+  HTTP_SM_SET_DEFAULT_HANDLER(&HttpSM::state_pipeline_wait);
+
+  return true;
+}
+
 
 void
 HttpSM::do_icp_lookup()
@@ -4845,7 +4960,8 @@ HttpSM::release_server_session(bool serve_from_cache)
       HTTP_DECREMENT_DYN_STAT(http_current_server_transactions_stat);
       server_session->server_trans_stat--;
       server_session->attach_hostname(t_state.current.server->name);
-      if (t_state.www_auth_content == HttpTransact::CACHE_AUTH_NONE || serve_from_cache == false)
+      if (t_state.www_auth_content == HttpTransact::CACHE_AUTH_NONE || serve_from_cache == false ||
+          server_session->pipeline_active())
         server_session->release();
       else {
         // an authenticated server connection - attach to the local client
@@ -4865,6 +4981,78 @@ HttpSM::release_server_session(bool serve_from_cache)
   }
 }
 
+// bool HttpSM::is_pipelinable_request(bool follower)
+//
+//   Only small idempotent requests go on a pipelined connection, a
+//    follower's request is written out as soon as it is queued so nothing
+//    may want to see it go out.
+//
+bool
+HttpSM::is_pipelinable_request(bool follower)
+{
+  HTTPHdr *request = &t_state.hdr_info.server_request;
+
+  if (t_state.txn_conf->origin_pipeline_depth <= 1 || t_state.txn_conf->share_server_sessions != 2 ||
+      pipeline_fallback || ua_session == NULL || is_private() || plugin_tunnel_type != HTTP_NO_PLUGIN_TUNNEL) {
+    return false;
+  }
+  if (request->method_get_wksidx() != HTTP_WKSIDX_GET || t_state.hdr_info.request_content_length > 0 ||
+      t_state.api_server_request_body_set) {
+    return false;
+  }
+  if (request->presence(MIME_PRESENCE_AUTHORIZATION | MIME_PRESENCE_PROXY_AUTHORIZATION | MIME_PRESENCE_WWW_AUTHENTICATE)) {
+    return false;
+  }
+  if (request->version_get() != HTTPVersion(1, 1) || t_state.current.server->keep_alive == HTTP_NO_KEEPALIVE) {
+    return false;
+  }
+  if (follower && (http_global_hooks->get(TS_HTTP_SEND_REQUEST_HDR_HOOK) ||
+                   ua_session->ssn_hook_get(TS_HTTP_SEND_REQUEST_HDR_HOOK) ||
+                   api_hooks.get(TS_HTTP_SEND_REQUEST_HDR_HOOK))) {
+    return false;
+  }
+
+  return true;
+}
+
+// bool HttpSM::is_pipeline_delimited(HTTPHdr *response)
+//
+//   Whether we know where the response ends without the origin closing
+//    the connection.  Chunked ones we don't parse our way through.
+//
+bool
+HttpSM::is_pipeline_delimited(HTTPHdr *response)
+{
+  int status = response->status_get();
+
+  return (status == HTTP_STATUS_NOT_MODIFIED || status == HTTP_STATUS_NO_CONTENT ||
+          (response->presence(MIME_PRESENCE_CONTENT_LENGTH) &&
+           !response->presence(MIME_PRESENCE_TRANSFER_ENCODING)));
+}
+
+// void HttpSM::check_pipeline_response()
+//
+//   The next response on a pipelined connection starts where ours ends,
+//    if we can't tell where that is the queued requests have to go
+//    elsewhere.  Big responses would hold the queue up, stop taking more.
+//
+void
+HttpSM::check_pipeline_response()
+{
+  HTTPHdr *response = &t_state.hdr_info.server_response;
+  int status = response->status_get();
+
+  if (!is_pipeline_delimited(response)) {
+    DebugSM("http", "[%" PRId64 "] response not delimited, no pipelining on server session %" PRId64,
+            sm_id, server_session->con_id);
+    server_session->pipeline_fail();
+  } else if (server_session->pipeline_listed && status != HTTP_STATUS_NOT_MODIFIED &&
+             status != HTTP_STATUS_NO_CONTENT &&
+             response->get_content_length() > t_state.http_config_param->origin_pipeline_max_object_size) {
+    httpSessionManager.remove_pipeline_session(server_session);
+  }
+}
+
 // void HttpSM::handle_post_failure()
 //
 //   We failed in our attempt post (or put) a document
@@ -5426,8 +5614,11 @@ HttpSM::attach_server_session(HttpServerSession * s)
   // read holds: server_entry->read_vio == INT64_MAX
   // This block of read events gets undone in setup_server_read_response()
 
-  // Transfer control of the write side as well
-  server_session->do_io_write(this, 0, NULL);
+  // Transfer control of the write side as well, unless the session is
+  //  still writing pipelined requests
+  if (server_session->pipeline_write_vio == NULL) {
+    server_session->do_io_write(this, 0, NULL);
+  }
 
   // Setup the timeouts
   // Set the inactivity timeout to the connect timeout so that we
@@ -5462,6 +5653,17 @@ HttpSM::attach_server_session(HttpServerSession * s)
   }
 }
 
+void
+HttpSM::pipeline_notify(int event)
+{
+  ink_assert(pending_action == NULL);
+  if (event == HTTP_SS_EVENT_PIPELINE_FAILED) {
+    pipeline_session = NULL;
+  }
+  // Don't run from under the session
+  pending_action = this_ethread()->schedule_imm(this, event);
+}
+
 void
 HttpSM::setup_server_send_request_api()
 {
@@ -5650,6 +5852,11 @@ HttpSM::setup_cache_transfer_to_transform()
   cache_response_hdr_bytes = t_state.hdr_info.cache_response.length_get();
 
   doc_size = t_state.cache_info.object_read->object_size_get();
+  if (t_state.num_pread_ranges > 0) {
+    doc_size = 0;
+    for (int i = 0; i < t_state.num_pread_ranges; i++)
+      doc_size += t_state.pread_ranges[i].end - t_state.pread_ranges[i].start + 1;
+  }
   alloc_index = buffer_size_to_index(doc_size);
   MIOBuffer *buf = new_MIOBuffer(alloc_index);
   IOBufferReader *buf_start = buf->alloc_reader();
@@ -5912,12 +6119,18 @@ HttpSM::server_transfer_init(MIOBuffer * buf, int hdr_size)
   //   of the document out of the header buffer make
   //   sure the server isn't screwing us by having sent too
   //   much.  If it did, we want to close the server connection
-  if (server_response_pre_read_bytes == to_copy && server_buffer_reader->read_avail() > 0) {
+  //  With pipelined requests behind us that is the next response, it
+  //   stays in the buffer for its state machine.
+  bool pipelined = server_session->pipeline_count > 0;
+
+  if (server_response_pre_read_bytes == to_copy && server_buffer_reader->read_avail() > 0 && !pipelined) {
     t_state.current.server->keep_alive = HTTP_NO_KEEPALIVE;
   }
 #ifdef LAZY_BUF_ALLOC
   // reset the server session buffer
-  server_session->reset_read_buffer();
+  if (!pipelined) {
+    server_session->reset_read_buffer();
+  }
 #endif
   return nbytes;
 }
@@ -6291,6 +6504,11 @@ HttpSM::kill_this()
       pending_action->cancel();
       pending_action = NULL;
     }
+    // We may still be queued on a pipelined origin connection
+    if (pipeline_session) {
+      pipeline_session->pipeline_abandon(this);
+      pipeline_session = NULL;
+    }
 
     cache_sm.end_both();
     if (second_cache_sm)
@@ -6496,10 +6714,14 @@ HttpSM::update_stats()
   ink_hrtime cache_lookup_time;
   if (milestones.cache_open_read_end != 0 && milestones.cache_open_read_begin != 0) {
     cache_lookup_time = milestones.cache_open_read_end - milestones.cache_open_read_begin;
+    HTTP_RECORD_HIST(http_cache_open_read_hist, cache_lookup_time);
   } else {
     cache_lookup_time = -1;
   }
 
+  if (milestones.ua_begin_write != 0 && milestones.ua_begin != 0)
+    HTTP_RECORD_HIST(http_ttfb_hist, milestones.ua_begin_write - milestones.ua_begin);
+
   HttpTransact::update_size_and_time_stats(&t_state,
                                            total_time,
                                            ua_write_time,
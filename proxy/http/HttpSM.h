@@ -209,6 +209,12 @@ public:
   //  holding the lock for the server session
   void attach_server_session(HttpServerSession * s);
 
+  // Called by the server session we pipelined our request on, with
+  //  HTTP_SS_EVENT_PIPELINE_READY or HTTP_SS_EVENT_PIPELINE_FAILED
+  virtual void pipeline_notify(int event);
+  // Can the next response on the connection be found after this one
+  static bool is_pipeline_delimited(HTTPHdr *response);
+
   // Called by transact.  Updates are fire and forget
   //  so there are no callbacks and are safe to do
   //  directly from transact
@@ -326,6 +332,10 @@ protected:
   IOBufferReader *server_buffer_reader;
   void remove_server_entry();
 
+  // Session our request is queued on, waiting for the response
+  HttpServerSession *pipeline_session;
+  bool pipeline_fallback;
+
   HttpTransformInfo transform_info;
   HttpTransformInfo post_transform_info;
 
@@ -384,6 +394,7 @@ protected:
   int state_send_server_request_header(int event, void *data);
   int state_acquire_server_read(int event, void *data);
   int state_read_server_response_header(int event, void *data);
+  int state_pipeline_wait(int event, void *data);
 
   // API
   int state_request_wait_for_transform_read(int event, void *data);
@@ -408,6 +419,7 @@ protected:
   void do_hostdb_reverse_lookup();
   void do_cache_lookup_and_read();
   void do_http_server_open(bool raw = false);
+  bool do_pipelined_server_request();
   void do_setup_post_tunnel(HttpVC_t to_vc_type);
   void do_cache_prepare_write();
   void do_cache_prepare_write_transform();
@@ -434,6 +446,8 @@ protected:
   void mark_host_failure(HostDBInfo * info, time_t time_down);
   void mark_server_down_on_client_abort();
   void release_server_session(bool serve_from_cache = false);
+  bool is_pipelinable_request(bool follower);
+  void check_pipeline_response();
   void set_ua_abort(HttpTransact::AbortState_t ua_abort, int event);
   int write_header_into_buffer(HTTPHdr * h, MIOBuffer * b);
   int write_response_header_into_buffer(HTTPHdr * h, MIOBuffer * b);
@@ -574,6 +588,10 @@ HttpSM::write_response_header_into_buffer(HTTPHdr * h, MIOBuffer * b)
 {
   if (t_state.client_info.http_version == HTTPVersion(0, 9)) {
     return 0;
+  } else if (t_state.client_info.is_framed) {
+    // The connection frames the header itself
+    ua_session->get_netvc()->set_data(NET_DATA_RESPONSE_HDR, h);
+    return 0;
   } else {
     return write_header_into_buffer(h, b);
   }
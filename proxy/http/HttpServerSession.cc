@@ -33,6 +33,7 @@
 #include "HttpServerSession.h"
 #include "HttpSessionManager.h"
 #include "HttpSM.h"
+#include "HttpDebugNames.h"
 
 static int64_t next_ss_id = (int64_t) 0;
 ClassAllocator<HttpServerSession> httpServerSessionAllocator("httpServerSessionAllocator");
@@ -49,6 +50,10 @@ HttpServerSession::destroy()
     free_MIOBuffer(read_buffer);
     read_buffer = NULL;
   }
+  if (pipeline_buffer) {
+    free_MIOBuffer(pipeline_buffer);
+    pipeline_buffer = NULL;
+  }
 
   if (hostname != fixed_hostname && hostname != NULL) {
     ats_free(hostname);
@@ -117,6 +122,10 @@ HttpServerSession::do_io_shutdown(ShutdownHowTo_t howto)
 void
 HttpServerSession::do_io_close(int alerrno)
 {
+  if (pipeline_listed || pipeline_count > 0) {
+    pipeline_fail();
+  }
+
   if (state == HSS_ACTIVE) {
     HTTP_DECREMENT_DYN_STAT(http_current_server_transactions_stat);
     this->server_trans_stat--;
@@ -166,6 +175,19 @@ HttpServerSession::release()
   // Set our state to KA for stat issues
   state = HSS_KA_SHARED;
 
+  // Requests were written after one we couldn't find the end of, or the
+  //  origin went away, nobody can use the connection anymore
+  if (pipeline_broken) {
+    this->do_io_close();
+    return;
+  }
+  // The next response on the wire belongs to the first queued request
+  if (pipeline_count > 0) {
+    pipeline_handoff();
+    return;
+  }
+  pipeline_clear();
+
   // Private sessions are never released back to the shared pool
   if (private_session || share_session == 0) {
     this->do_io_close();
@@ -187,3 +209,578 @@ HttpServerSession::release()
     ink_assert(r == HSM_DONE);
   }
 }
+
+// void HttpServerSession::pipeline_enqueue(HttpSM *sm, IOBufferReader *request)
+//
+//   The write side belongs to us from the first queued request on, the
+//    active state machine is done writing by then.  We are all on the
+//    thread of the netvc so nothing here needs a lock.
+//
+void
+HttpServerSession::pipeline_enqueue(HttpSM *sm, IOBufferReader *request)
+{
+  ink_assert(pipeline_listed && !pipeline_broken);
+  ink_assert(pipeline_count < HTTP_SS_PIPELINE_MAX);
+
+  pipeline_queue[pipeline_count++] = sm;
+  Debug("http_ss", "[%" PRId64 "] [pipeline] queued request of sm %" PRId64 ", %d waiting",
+        con_id, sm->sm_id, pipeline_count);
+
+  if (pipeline_buffer == NULL) {
+    pipeline_buffer = new_MIOBuffer(HTTP_HEADER_BUFFER_SIZE_INDEX);
+    pipeline_reader = pipeline_buffer->alloc_reader();
+  }
+  pipeline_buffer->write(request, request->read_avail());
+
+  if (pipeline_write_vio == NULL) {
+    SET_HANDLER(&HttpServerSession::pipeline_handler);
+    pipeline_write_vio = server_vc->do_io_write(this, INT64_MAX, pipeline_reader);
+  } else {
+    pipeline_write_vio->reenable();
+  }
+}
+
+bool
+HttpServerSession::pipeline_resume(HttpSM *sm)
+{
+  ink_assert(sm == pipeline_next);
+  NOWARN_UNUSED(sm);
+  pipeline_next = NULL;
+
+  if (pipeline_error) {
+    Debug("http_ss", "[%" PRId64 "] [pipeline] origin closed before the next response", con_id);
+    this->do_io_close();
+    return false;
+  }
+  state = HSS_ACTIVE;
+  return true;
+}
+
+void
+HttpServerSession::pipeline_abandon(HttpSM *sm)
+{
+  // Its response is the next one, nobody is left to read it
+  if (sm == pipeline_next) {
+    pipeline_next = NULL;
+    this->do_io_close();
+    return;
+  }
+
+  for (int i = 0; i < pipeline_count; i++) {
+    if (pipeline_queue[i] == sm) {
+      Debug("http_ss", "[%" PRId64 "] [pipeline] sm %" PRId64 " left the queue", con_id, sm->sm_id);
+      pipeline_queue[i] = NULL;
+      // Whoever comes after it will be failed, don't add more
+      if (pipeline_listed) {
+        httpSessionManager.remove_pipeline_session(this);
+      }
+      break;
+    }
+  }
+}
+
+void
+HttpServerSession::pipeline_fail()
+{
+  if (pipeline_listed) {
+    httpSessionManager.remove_pipeline_session(this);
+  }
+  if (pipeline_count > 0) {
+    Debug("http_ss", "[%" PRId64 "] [pipeline] failing %d queued requests", con_id, pipeline_count);
+    pipeline_broken = true;
+  }
+  for (int i = 0; i < pipeline_count; i++) {
+    HttpSM *sm = pipeline_queue[i];
+
+    pipeline_queue[i] = NULL;
+    if (sm != NULL) {
+      sm->pipeline_notify(HTTP_SS_EVENT_PIPELINE_FAILED);
+    }
+  }
+  pipeline_count = 0;
+}
+
+// int HttpServerSession::pipeline_handler(int event, void *data)
+//
+//   Gets the write side events while requests are queued, and the read
+//    side ones between two transactions
+//
+int
+HttpServerSession::pipeline_handler(int event, void *data)
+{
+  NOWARN_UNUSED(data);
+
+  switch (event) {
+  case VC_EVENT_WRITE_READY:
+    if (pipeline_reader->read_avail() > 0) {
+      pipeline_write_vio->reenable();
+    }
+    break;
+
+  case VC_EVENT_READ_READY:
+    // The next response is early, it waits in the buffer for its
+    //  state machine
+    break;
+
+  case VC_EVENT_WRITE_COMPLETE:
+  case VC_EVENT_READ_COMPLETE:
+  case VC_EVENT_EOS:
+  case VC_EVENT_ERROR:
+  case VC_EVENT_INACTIVITY_TIMEOUT:
+  case VC_EVENT_ACTIVE_TIMEOUT:
+  default:
+    Debug("http_ss", "[%" PRId64 "] [pipeline] %s on the connection", con_id, HttpDebugNames::get_event_name(event));
+    pipeline_error = true;
+    pipeline_broken = true;
+    // Nothing more goes on this connection
+    if (pipeline_listed) {
+      httpSessionManager.remove_pipeline_session(this);
+    }
+    break;
+  }
+
+  return 0;
+}
+
+// void HttpServerSession::pipeline_handoff()
+//
+//   The active transaction is done, pass the connection to the first
+//    queued state machine.  We park the read side on ourselves until the
+//    state machine gets its event.
+//
+void
+HttpServerSession::pipeline_handoff()
+{
+  HttpSM *next = pipeline_queue[0];
+
+  pipeline_count--;
+  memmove(pipeline_queue, pipeline_queue + 1, pipeline_count * sizeof(HttpSM *));
+  pipeline_queue[pipeline_count] = NULL;
+
+  if (next == NULL) {
+    this->do_io_close();
+    return;
+  }
+
+  Debug("http_ss", "[%" PRId64 "] [pipeline] handing off to sm %" PRId64, con_id, next->sm_id);
+  mutex = next->mutex;
+  SET_HANDLER(&HttpServerSession::pipeline_handler);
+  server_vc->do_io_read(this, INT64_MAX, read_buffer);
+  pipeline_next = next;
+  next->pipeline_notify(HTTP_SS_EVENT_PIPELINE_READY);
+}
+
+// Nothing in flight anymore, the session goes back to be a plain one
+void
+HttpServerSession::pipeline_clear()
+{
+  if (pipeline_listed) {
+    httpSessionManager.remove_pipeline_session(this);
+  }
+  if (pipeline_write_vio != NULL) {
+    server_vc->do_io_write(NULL, 0, NULL);
+    pipeline_write_vio = NULL;
+  }
+  if (pipeline_buffer != NULL) {
+    free_MIOBuffer(pipeline_buffer);
+    pipeline_buffer = NULL;
+    pipeline_reader = NULL;
+  }
+  pipeline_depth = 0;
+}
+
+#if TS_HAS_TESTS
+#include "Regression.h"
+
+// Stands in for the origin connection, it only records what the session
+//  asks of it.
+class PipelineTestVC : public NetVConnection
+{
+public:
+  PipelineTestVC()
+    : read_cont(NULL), write_cont(NULL), write_reader(NULL), write_reenables(0), closed(false)
+  {
+    thread = this_ethread();
+    mutex = thread->mutex;
+  }
+
+  VIO *do_io_read(Continuation *c, int64_t nbytes, MIOBuffer *buf)
+  {
+    NOWARN_UNUSED(nbytes);
+    NOWARN_UNUSED(buf);
+    read_cont = c;
+    read_vio._cont = c;
+    read_vio.vc_server = this;
+    return &read_vio;
+  }
+  VIO *do_io_write(Continuation *c, int64_t nbytes, IOBufferReader *buf, bool owner = false)
+  {
+    NOWARN_UNUSED(nbytes);
+    NOWARN_UNUSED(owner);
+    write_cont = c;
+    write_reader = buf;
+    write_vio._cont = c;
+    write_vio.vc_server = this;
+    return &write_vio;
+  }
+  void do_io_close(int lerrno = -1)
+  {
+    NOWARN_UNUSED(lerrno);
+    closed = true;
+  }
+  void do_io_shutdown(ShutdownHowTo_t howto) { NOWARN_UNUSED(howto); }
+  void reenable(VIO *vio)
+  {
+    if (vio == &write_vio) {
+      write_reenables++;
+    }
+  }
+  void reenable_re(VIO *vio) { reenable(vio); }
+  void set_active_timeout(ink_hrtime timeout_in) { NOWARN_UNUSED(timeout_in); }
+  void set_inactivity_timeout(ink_hrtime timeout_in) { NOWARN_UNUSED(timeout_in); }
+  void cancel_active_timeout() { }
+  void cancel_inactivity_timeout() { }
+  ink_hrtime get_active_timeout() { return 0; }
+  ink_hrtime get_inactivity_timeout() { return 0; }
+  void set_flow_ctl(int op, uint64_t flowctr = 0) { NOWARN_UNUSED(op); NOWARN_UNUSED(flowctr); }
+  void cancel_flow_ctl(int op) { NOWARN_UNUSED(op); }
+  void apply_options() { }
+  SOCKET get_socket() { return -1; }
+  int set_tcp_init_cwnd(int init_cwnd) { NOWARN_UNUSED(init_cwnd); return 0; }
+  void set_local_addr() { }
+  void set_remote_addr() { }
+
+  VIO read_vio;
+  VIO write_vio;
+  Continuation *read_cont;
+  Continuation *write_cont;
+  IOBufferReader *write_reader;
+  int write_reenables;
+  bool closed;
+};
+
+// A queued transaction, counts the events the session sends it instead
+//  of going back to the origin.
+class PipelineTestSM : public HttpSM
+{
+public:
+  PipelineTestSM(int64_t id)
+    : ready(0), failed(0)
+  {
+    sm_id = id;
+    mutex = this_ethread()->mutex;
+  }
+
+  void pipeline_notify(int event)
+  {
+    if (event == HTTP_SS_EVENT_PIPELINE_READY) {
+      ready++;
+    } else if (event == HTTP_SS_EVENT_PIPELINE_FAILED) {
+      failed++;
+    }
+  }
+
+  bool got(int r, int f) const
+  {
+    return ready == r && failed == f;
+  }
+
+  int ready;
+  int failed;
+};
+
+#define PIPELINE_TEST_HOST "pipeline.test"
+
+// An active session of this thread, taking up to depth requests in flight
+static HttpServerSession *
+pipeline_test_session(PipelineTestVC *vc, int depth)
+{
+  HttpServerSession *s = THREAD_ALLOC_INIT(httpServerSessionAllocator, this_ethread());
+
+  s->share_session = 2;
+  ats_ip4_set(&s->server_ip, htonl(INADDR_LOOPBACK), htons(8080));
+  s->new_connection(vc);
+  s->attach_hostname(PIPELINE_TEST_HOST);
+  s->state = HSS_ACTIVE;
+  s->server_trans_stat++;
+  httpSessionManager.add_pipeline_session(s, depth);
+  return s;
+}
+
+static void
+pipeline_test_enqueue(HttpServerSession *s, HttpSM *sm, const char *request)
+{
+  MIOBuffer *buf = new_MIOBuffer(buffer_size_to_index(HTTP_HEADER_BUFFER_SIZE));
+  IOBufferReader *reader = buf->alloc_reader();
+
+  buf->write(request, strlen(request));
+  s->pipeline_enqueue(sm, reader);
+  free_MIOBuffer(buf);
+}
+
+// What HttpSM does when it is done with the response, and when it
+//  picks the session up after HTTP_SS_EVENT_PIPELINE_READY
+static void
+pipeline_test_release(HttpServerSession *s)
+{
+  s->server_trans_stat--;
+  s->release();
+}
+
+static bool
+pipeline_test_resume(HttpServerSession *s, HttpSM *sm)
+{
+  if (!s->pipeline_resume(sm)) {
+    return false;
+  }
+  s->server_trans_stat++;
+  return true;
+}
+
+#define PIPELINE_TEST_CHECK(_c) do { \
+    if (!(_c)) { \
+      rprintf(t, "%s:%d: failed '%s'\n", __FILE__, __LINE__, #_c); \
+      *pstatus = REGRESSION_TEST_FAILED; \
+      goto Ldone; \
+    } \
+  } while (0)
+
+#define PIPELINE_TEST_START() do { \
+    NOWARN_UNUSED(atype); \
+    if (this_ethread()->l1_hash == NULL) { \
+      rprintf(t, "no per thread session pools on this thread\n"); \
+      *pstatus = REGRESSION_TEST_NOT_RUN; \
+      return; \
+    } \
+    *pstatus = REGRESSION_TEST_PASSED; \
+  } while (0)
+
+// Both requests go out back to back, and each response goes to its own
+//  transaction in request order.
+REGRESSION_TEST(HttpServerSession_pipeline_handoff) (RegressionTest * t, int atype, int *pstatus)
+{
+  PIPELINE_TEST_START();
+
+  PipelineTestVC *vc = NEW(new PipelineTestVC);
+  PipelineTestSM *sm1 = NEW(new PipelineTestSM(1));
+  PipelineTestSM *sm2 = NEW(new PipelineTestSM(2));
+  HttpServerSession *s = pipeline_test_session(vc, 3);
+  char wire[128];
+  int64_t n;
+
+  PIPELINE_TEST_CHECK(httpSessionManager.acquire_pipelined_session(&s->server_ip.sa, PIPELINE_TEST_HOST) == s);
+  pipeline_test_enqueue(s, sm1, "GET /1 HTTP/1.1\r\n\r\n");
+  pipeline_test_enqueue(s, sm2, "GET /2 HTTP/1.1\r\n\r\n");
+  PIPELINE_TEST_CHECK(vc->write_cont == s && vc->write_reenables == 1);
+  n = vc->write_reader->read_avail();
+  PIPELINE_TEST_CHECK(n < (int64_t) sizeof(wire));
+  vc->write_reader->memcpy(wire, n);
+  wire[n] = '\0';
+  PIPELINE_TEST_CHECK(strcmp(wire, "GET /1 HTTP/1.1\r\n\r\nGET /2 HTTP/1.1\r\n\r\n") == 0);
+  // depth 3 is two queued behind the active one
+  PIPELINE_TEST_CHECK(httpSessionManager.acquire_pipelined_session(&s->server_ip.sa, PIPELINE_TEST_HOST) == NULL);
+
+  pipeline_test_release(s);
+  PIPELINE_TEST_CHECK(sm1->got(1, 0) && sm2->got(0, 0));
+  PIPELINE_TEST_CHECK(vc->read_cont == s && !vc->closed);
+  PIPELINE_TEST_CHECK(pipeline_test_resume(s, sm1));
+
+  pipeline_test_release(s);
+  PIPELINE_TEST_CHECK(sm1->got(1, 0) && sm2->got(1, 0));
+  PIPELINE_TEST_CHECK(pipeline_test_resume(s, sm2));
+
+  // The last one leaves a plain session behind, nothing writes anymore
+  s->private_session = true;
+  pipeline_test_release(s);
+  s = NULL;
+  PIPELINE_TEST_CHECK(vc->write_cont == NULL && vc->closed);
+
+Ldone:
+  if (s != NULL && !vc->closed) {
+    s->do_io_close();
+  }
+  delete sm1;
+  delete sm2;
+  delete vc;
+}
+
+// We can't find where a response without a Content-Length ends, the
+//  requests queued behind it go back to open their own connections and
+//  the session is closed after the response.
+REGRESSION_TEST(HttpServerSession_pipeline_undelimited) (RegressionTest * t, int atype, int *pstatus)
+{
+  PIPELINE_TEST_START();
+
+  static const struct
+  {
+    const char *response;
+    bool delimited;
+  } responses[] = {
+    { "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n", true },
+    { "HTTP/1.1 200 OK\r\nConnection: keep-alive\r\n\r\n", false },
+    { "HTTP/1.1 200 OK\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n", false },
+    { "HTTP/1.1 304 Not Modified\r\n\r\n", true },
+    { "HTTP/1.1 204 No Content\r\n\r\n", true },
+  };
+  PipelineTestVC *vc = NEW(new PipelineTestVC);
+  PipelineTestSM *sm1 = NEW(new PipelineTestSM(1));
+  PipelineTestSM *sm2 = NEW(new PipelineTestSM(2));
+  HttpServerSession *s = NULL;
+
+  for (unsigned i = 0; i < sizeof(responses) / sizeof(responses[0]); i++) {
+    HTTPHdr response;
+    HTTPParser parser;
+    const char *start = responses[i].response;
+    const char *end = start + strlen(start);
+    MIMEParseResult err;
+
+    http_parser_init(&parser);
+    response.create(HTTP_TYPE_RESPONSE);
+    do {
+      err = response.parse_resp(&parser, &start, end, true);
+    } while (err == PARSE_CONT);
+    http_parser_clear(&parser);
+    bool delimited = HttpSM::is_pipeline_delimited(&response);
+    response.destroy();
+
+    PIPELINE_TEST_CHECK(err == PARSE_DONE);
+    if (delimited != responses[i].delimited) {
+      rprintf(t, "response %u is%s taken as delimited\n", i, delimited ? "" : " not");
+      *pstatus = REGRESSION_TEST_FAILED;
+    }
+  }
+
+  s = pipeline_test_session(vc, 4);
+  pipeline_test_enqueue(s, sm1, "GET /1 HTTP/1.1\r\n\r\n");
+  pipeline_test_enqueue(s, sm2, "GET /2 HTTP/1.1\r\n\r\n");
+
+  // what HttpSM::check_pipeline_response() does with such a response
+  s->pipeline_fail();
+  PIPELINE_TEST_CHECK(sm1->got(0, 1) && sm2->got(0, 1));
+  PIPELINE_TEST_CHECK(!s->pipeline_listed && s->pipeline_count == 0);
+  PIPELINE_TEST_CHECK(httpSessionManager.acquire_pipelined_session(&s->server_ip.sa, PIPELINE_TEST_HOST) == NULL);
+  PIPELINE_TEST_CHECK(!vc->closed);
+
+  pipeline_test_release(s);
+  s = NULL;
+  PIPELINE_TEST_CHECK(vc->closed);
+  PIPELINE_TEST_CHECK(sm1->got(0, 1) && sm2->got(0, 1));
+
+Ldone:
+  if (s != NULL && !vc->closed) {
+    s->do_io_close();
+  }
+  delete sm1;
+  delete sm2;
+  delete vc;
+}
+
+// A transaction that goes away while queued can't have its response
+//  skipped, whoever is behind it falls back and the session is closed
+//  when its turn comes.
+REGRESSION_TEST(HttpServerSession_pipeline_abandon) (RegressionTest * t, int atype, int *pstatus)
+{
+  PIPELINE_TEST_START();
+
+  PipelineTestVC *vc = NEW(new PipelineTestVC);
+  PipelineTestVC *vc2 = NEW(new PipelineTestVC);
+  PipelineTestSM *sm1 = NEW(new PipelineTestSM(1));
+  PipelineTestSM *sm2 = NEW(new PipelineTestSM(2));
+  PipelineTestSM *sm3 = NEW(new PipelineTestSM(3));
+  PipelineTestSM *sm4 = NEW(new PipelineTestSM(4));
+  HttpServerSession *s = pipeline_test_session(vc, 4);
+  HttpServerSession *s2 = NULL;
+
+  pipeline_test_enqueue(s, sm1, "GET /1 HTTP/1.1\r\n\r\n");
+  pipeline_test_enqueue(s, sm2, "GET /2 HTTP/1.1\r\n\r\n");
+  pipeline_test_enqueue(s, sm3, "GET /3 HTTP/1.1\r\n\r\n");
+
+  s->pipeline_abandon(sm2);
+  PIPELINE_TEST_CHECK(!s->pipeline_listed && s->pipeline_count == 3);
+
+  pipeline_test_release(s);
+  PIPELINE_TEST_CHECK(sm1->got(1, 0) && sm2->got(0, 0) && sm3->got(0, 0));
+  PIPELINE_TEST_CHECK(pipeline_test_resume(s, sm1));
+
+  // the response of sm2 is next, nobody reads it
+  pipeline_test_release(s);
+  s = NULL;
+  PIPELINE_TEST_CHECK(vc->closed);
+  PIPELINE_TEST_CHECK(sm1->got(1, 0) && sm2->got(0, 0) && sm3->got(0, 1));
+
+  // Same when the one handed the connection goes before picking it up
+  s2 = pipeline_test_session(vc2, 4);
+  pipeline_test_enqueue(s2, sm4, "GET /4 HTTP/1.1\r\n\r\n");
+  pipeline_test_release(s2);
+  PIPELINE_TEST_CHECK(sm4->got(1, 0));
+  s2->pipeline_abandon(sm4);
+  s2 = NULL;
+  PIPELINE_TEST_CHECK(vc2->closed);
+
+Ldone:
+  if (s != NULL && !vc->closed) {
+    s->do_io_close();
+  }
+  if (s2 != NULL && !vc2->closed) {
+    s2->do_io_close();
+  }
+  delete sm1;
+  delete sm2;
+  delete sm3;
+  delete sm4;
+  delete vc;
+  delete vc2;
+}
+
+// The origin closes between two responses, or while the active one is
+//  still reading, the waiting transactions fall back.
+REGRESSION_TEST(HttpServerSession_pipeline_origin_close) (RegressionTest * t, int atype, int *pstatus)
+{
+  PIPELINE_TEST_START();
+
+  PipelineTestVC *vc = NEW(new PipelineTestVC);
+  PipelineTestVC *vc2 = NEW(new PipelineTestVC);
+  PipelineTestSM *sm1 = NEW(new PipelineTestSM(1));
+  PipelineTestSM *sm2 = NEW(new PipelineTestSM(2));
+  PipelineTestSM *sm3 = NEW(new PipelineTestSM(3));
+  HttpServerSession *s = pipeline_test_session(vc, 4);
+  HttpServerSession *s2 = NULL;
+
+  pipeline_test_enqueue(s, sm1, "GET /1 HTTP/1.1\r\n\r\n");
+  pipeline_test_enqueue(s, sm2, "GET /2 HTTP/1.1\r\n\r\n");
+
+  pipeline_test_release(s);
+  PIPELINE_TEST_CHECK(sm1->got(1, 0) && vc->read_cont == s);
+
+  // EOS before sm1 gets to read its response
+  s->handleEvent(VC_EVENT_EOS, &vc->read_vio);
+  PIPELINE_TEST_CHECK(s->pipeline_broken && !s->pipeline_listed && !vc->closed);
+  PIPELINE_TEST_CHECK(!pipeline_test_resume(s, sm1));
+  s = NULL;
+  PIPELINE_TEST_CHECK(vc->closed);
+  PIPELINE_TEST_CHECK(sm1->got(1, 0) && sm2->got(0, 1));
+
+  // A write error while the active transaction reads its response
+  s2 = pipeline_test_session(vc2, 4);
+  pipeline_test_enqueue(s2, sm3, "GET /3 HTTP/1.1\r\n\r\n");
+  s2->handleEvent(VC_EVENT_ERROR, &vc2->write_vio);
+  PIPELINE_TEST_CHECK(s2->pipeline_broken && !s2->pipeline_listed && sm3->got(0, 0));
+  pipeline_test_release(s2);
+  s2 = NULL;
+  PIPELINE_TEST_CHECK(vc2->closed && sm3->got(0, 1));
+
+Ldone:
+  if (s != NULL && !vc->closed) {
+    s->do_io_close();
+  }
+  if (s2 != NULL && !vc2->closed) {
+    s2->do_io_close();
+  }
+  delete sm1;
+  delete sm2;
+  delete sm3;
+  delete vc;
+  delete vc2;
+}
+
+#endif /* TS_HAS_TESTS */
@@ -49,6 +49,7 @@
 #include "HttpConnectionCount.h"
 
 class HttpSM;
+class SessionBucket;
 class MIOBuffer;
 class IOBufferReader;
 
@@ -64,6 +65,14 @@ enum {
   HTTP_SS_MAGIC_DEAD = 0xDEADFEED
 };
 
+// Sent to the HttpSM waiting on a pipelined session, either it is its
+//  turn to read the response or the session went away
+#define HTTP_SS_EVENT_PIPELINE_READY    (HTTP_SESSION_EVENTS_START + 0)
+#define HTTP_SS_EVENT_PIPELINE_FAILED   (HTTP_SESSION_EVENTS_START + 1)
+
+// Most requests we queue behind the active one
+#define HTTP_SS_PIPELINE_MAX            16
+
 class HttpServerSession : public VConnection
 {
 public:
@@ -74,11 +83,16 @@ public:
       state(HSS_INIT), to_parent_proxy(false), server_trans_stat(0),
       private_session(false), share_session(0),
       enable_origin_connection_limiting(false), read_buffer(NULL),
-      server_vc(NULL), magic(HTTP_SS_MAGIC_DEAD), buf_reader(NULL)
+      pipeline_count(0), pipeline_depth(0), pipeline_listed(false),
+      pipeline_broken(false), pipeline_error(false), pipeline_buffer(NULL),
+      pipeline_reader(NULL), pipeline_write_vio(NULL), pipeline_bucket(NULL),
+      server_vc(NULL), magic(HTTP_SS_MAGIC_DEAD), buf_reader(NULL),
+      pipeline_next(NULL)
     {
       hostname = NULL;
       host_len = 0;
       ink_zero(server_ip);
+      ink_zero(pipeline_queue);
     }
 
   void destroy();
@@ -109,6 +123,21 @@ public:
 
   void release();
   void attach_hostname(const char *host);
+
+  // Pipelining: send the request of sm behind the ones in flight and
+  //  queue sm for its response
+  void pipeline_enqueue(HttpSM *sm, IOBufferReader *request);
+  // sm got HTTP_SS_EVENT_PIPELINE_READY, false if the origin closed on
+  //  us in the meantime, the session is gone then
+  bool pipeline_resume(HttpSM *sm);
+  // sm is going away before getting its response
+  void pipeline_abandon(HttpSM *sm);
+  // Send all the queued requests back to open their own connection
+  void pipeline_fail();
+  bool pipeline_active() const
+  {
+    return pipeline_listed || pipeline_count > 0 || pipeline_broken;
+  }
   NetVConnection *get_netvc()
   {
     return server_vc;
@@ -173,13 +202,36 @@ public:
   //   an asyncronous cancel on NT
   MIOBuffer *read_buffer;
 
+  // HTTP/1.1 pipelining.  The requests are written back to back while
+  //  the active transaction reads its response, the queue holds the
+  //  state machines waiting for theirs, in order.  A NULL entry is an
+  //  abandoned request, we can't skip its response so we close then.
+  //  Everything is confined to the thread of the netvc.
+  HttpSM *pipeline_queue[HTTP_SS_PIPELINE_MAX];
+  int pipeline_count;
+  int pipeline_depth;
+  bool pipeline_listed;         // in the session manager, taking requests
+  bool pipeline_broken;         // can't tell where a response ends
+  bool pipeline_error;          // the origin went away between two responses
+  MIOBuffer *pipeline_buffer;
+  IOBufferReader *pipeline_reader;
+  VIO *pipeline_write_vio;
+  LINK(HttpServerSession, pipeline_link);
+  SessionBucket *pipeline_bucket;
+
 private:
   HttpServerSession(HttpServerSession &);
 
+  int pipeline_handler(int event, void *data);
+  void pipeline_handoff();
+  void pipeline_clear();
+
   NetVConnection *server_vc;
   int magic;
 
   IOBufferReader *buf_reader;
+
+  HttpSM *pipeline_next;
 };
 
 extern ClassAllocator<HttpServerSession> httpServerSessionAllocator;
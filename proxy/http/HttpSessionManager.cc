@@ -155,19 +155,17 @@ HttpSessionManager::acquire_session_hc(sockaddr const* ip, const char *hostname,
 
   EThread *ethread = this_ethread();
   SessionBucket *bucket;
-  bool condition = false;
 
+  // The per thread buckets are locked too, other threads may be
+  // stealing from them.
   if (2 == hcsm->txn_conf.share_server_sessions) {
     ink_assert(ethread->l1_hash);
     bucket = ethread->l1_hash + l1_index;
-    condition = true;
   } else {
     bucket = g_l1_hash + l1_index;
-    MUTEX_TRY_LOCK(lock, bucket->mutex, ethread);
-    if (lock)
-      condition = true;
   }
-  if (!condition)
+  MUTEX_TRY_LOCK(lock, bucket->mutex, ethread);
+  if (!lock)
     return NULL;
   INK_MD5 hostname_hash;
   ink_code_MMH((unsigned char *) hostname, strlen(hostname), (unsigned char *) &hostname_hash);
@@ -220,34 +218,101 @@ HttpSessionManager::purge_keepalives()
   }
 }
 
-HSMresult_t
-_acquire_session(SessionBucket *bucket, sockaddr const* ip, INK_MD5 &hostname_hash, HttpSM *sm)
+// Look for an idle session to the origin (ip, port and host) in the
+// 2nd level bucket.  The most recently released one is returned, it is
+// the least likely to have been closed by the origin.  If count is given
+// it is set to the number of idle sessions to the origin in the bucket.
+static HttpServerSession *
+_find_session(SessionBucket *bucket, sockaddr const* ip, INK_MD5 &hostname_hash, int *count = NULL)
 {
   HttpServerSession *b;
-  HttpServerSession *to_return = NULL;
+  HttpServerSession *found = NULL;
   int l2_index = SECOND_LEVEL_HASH(ip);
 
   ink_assert(l2_index < HSM_LEVEL2_BUCKETS);
 
-  // Check to see if an appropriate connection is in
-  //  the 2nd level bucket
-  b = bucket->l2_hash[l2_index].head;
-  while (b != NULL) {
+  for (b = bucket->l2_hash[l2_index].head; b != NULL; b = b->hash_link.next) {
     if (ats_ip_addr_eq(&b->server_ip.sa, ip) &&
-      ats_ip_port_cast(ip) == ats_ip_port_cast(&b->server_ip)
+      ats_ip_port_cast(ip) == ats_ip_port_cast(&b->server_ip) &&
+      hostname_hash == b->hostname_hash
     ) {
-      if (hostname_hash == b->hostname_hash) {
-        bucket->lru_list.remove(b);
-        bucket->l2_hash[l2_index].remove(b);
-        b->state = HSS_ACTIVE;
-        to_return = b;
-        Debug("http_ss", "[%" PRId64 "] [acquire session] " "return session from shared pool", to_return->con_id);
-        sm->attach_server_session(to_return);
+      if (found == NULL)
+        found = b;
+      if (count == NULL)
+        break;
+      (*count)++;
+    }
+  }
+
+  return found;
+}
+
+static void
+_take_session(SessionBucket *bucket, HttpServerSession *b, HttpSM *sm)
+{
+  ProxyMutex *mutex = sm->mutex;
+  int l2_index = SECOND_LEVEL_HASH(&b->server_ip.sa);
+
+  bucket->lru_list.remove(b);
+  bucket->l2_hash[l2_index].remove(b);
+  b->state = HSS_ACTIVE;
+  HTTP_INCREMENT_DYN_STAT(http_origin_session_reuse_stat);
+  sm->attach_server_session(b);
+}
+
+HSMresult_t
+_acquire_session(SessionBucket *bucket, sockaddr const* ip, INK_MD5 &hostname_hash, HttpSM *sm)
+{
+  HttpServerSession *b = _find_session(bucket, ip, hostname_hash);
+
+  if (b != NULL) {
+    Debug("http_ss", "[%" PRId64 "] [acquire session] " "return session from shared pool", b->con_id);
+    _take_session(bucket, b, sm);
+    return HSM_DONE;
+  }
+
+  return HSM_NOT_FOUND;
+}
+
+// Our thread has no idle session to the origin, take one from another
+// net thread.  The first pass only robs pools holding more than one, so
+// a thread keeps a session for its own traffic as long as we can help it.
+// Busy buckets are skipped, we never wait on another thread.
+static HSMresult_t
+_steal_session(EThread *ethread, sockaddr const* ip, INK_MD5 &hostname_hash, HttpSM *sm)
+{
+  int l1_index = FIRST_LEVEL_HASH(ip);
+  int n_threads = eventProcessor.n_threads_for_type[ET_NET];
+  int start;
+
+  if (n_threads <= 1)
+    return HSM_NOT_FOUND;
+  // don't have every thread go after the first one
+  start = (int) (sm->sm_id % n_threads);
+
+  for (int min_idle = 2; min_idle >= 1; min_idle--) {
+    for (int i = 0; i < n_threads; i++) {
+      EThread *thread = eventProcessor.eventthread[ET_NET][(start + i) % n_threads];
+
+      if (thread == ethread || thread->l1_hash == NULL)
+        continue;
+
+      SessionBucket *bucket = thread->l1_hash + l1_index;
+      MUTEX_TRY_LOCK(lock, bucket->mutex, ethread);
+      if (!lock)
+        continue;
+
+      int count = 0;
+      HttpServerSession *b = _find_session(bucket, ip, hostname_hash, &count);
+      if (b != NULL && count >= min_idle) {
+        ProxyMutex *mutex = sm->mutex;
+
+        Debug("http_ss", "[%" PRId64 "] [acquire session] " "stole session from thread %p", b->con_id, thread);
+        HTTP_INCREMENT_DYN_STAT(http_origin_session_steal_stat);
+        _take_session(bucket, b, sm);
         return HSM_DONE;
       }
     }
-
-    b = b->hash_link.next;
   }
 
   return HSM_NOT_FOUND;
@@ -290,6 +355,10 @@ HttpSessionManager::acquire_session(Continuation *cont, sockaddr const* ip,
       if (hostname_hash == to_return->hostname_hash) {
         Debug("http_ss", "[%" PRId64 "] [acquire session] returning attached session ", to_return->con_id);
         to_return->state = HSS_ACTIVE;
+        {
+          ProxyMutex *mutex = sm->mutex;
+          HTTP_INCREMENT_DYN_STAT(http_origin_session_reuse_stat);
+        }
         sm->attach_server_session(to_return);
         return HSM_DONE;
       }
@@ -313,8 +382,20 @@ HttpSessionManager::acquire_session(Continuation *cont, sockaddr const* ip,
     ink_code_MMH((unsigned char *) hostname, strlen(hostname), (unsigned char *) &hostname_hash);
 
   if (2 == sm->t_state.txn_conf->share_server_sessions) {
+    SessionBucket *bucket = ethread->l1_hash + l1_index;
+    HSMresult_t result = HSM_RETRY;
+
     ink_assert(ethread->l1_hash);
-    return _acquire_session(ethread->l1_hash + l1_index, ip, hostname_hash, sm);
+    // Only thieves contend for our own bucket.
+    {
+      MUTEX_TRY_LOCK(lock, bucket->mutex, ethread);
+      if (lock)
+        result = _acquire_session(bucket, ip, hostname_hash, sm);
+    }
+    if (result != HSM_DONE && sm->t_state.http_config_param->server_session_steal_enabled &&
+        _steal_session(ethread, ip, hostname_hash, sm) == HSM_DONE)
+      return HSM_DONE;
+    return result;
   } else {
     SessionBucket *bucket = g_l1_hash + l1_index;
 
@@ -347,9 +428,38 @@ HttpSessionManager::release_session(HttpServerSession *to_release)
   MUTEX_TRY_LOCK(lock, bucket->mutex, ethread);
   if (lock) {
     int l2_index = SECOND_LEVEL_HASH(&to_release->server_ip.sa);
+    HttpConfigParams *http_config_params = HttpConfig::acquire();
 
     ink_assert(l2_index < HSM_LEVEL2_BUCKETS);
 
+    // Keep the pool to server_session_max_idle_per_origin sessions for
+    // this origin by closing the one idle the longest, it's the last one
+    // in the 2nd level bucket.
+    if (http_config_params->server_session_max_idle_per_origin > 0) {
+      HttpServerSession *oldest = NULL;
+      int count = 0;
+
+      for (HttpServerSession *b = bucket->l2_hash[l2_index].head; b != NULL; b = b->hash_link.next) {
+        if (ats_ip_addr_eq(&b->server_ip.sa, &to_release->server_ip.sa) &&
+          ats_ip_port_cast(&b->server_ip) == ats_ip_port_cast(&to_release->server_ip) &&
+          b->hostname_hash == to_release->hostname_hash
+        ) {
+          oldest = b;
+          count++;
+        }
+      }
+      if (count >= http_config_params->server_session_max_idle_per_origin) {
+        ProxyMutex *mutex = to_release->mutex;
+
+        Debug("http_ss", "[%" PRId64 "] [release session] " "closing session idle the longest to the origin", oldest->con_id);
+        bucket->lru_list.remove(oldest);
+        bucket->l2_hash[l2_index].remove(oldest);
+        oldest->do_io_close();
+        HTTP_INCREMENT_DYN_STAT(http_origin_session_idle_evict_stat);
+      }
+    }
+    HttpConfig::release(http_config_params);
+
     // First insert the session on to our lists
     bucket->lru_list.enqueue(to_release);
     bucket->l2_hash[l2_index].push(to_release);
@@ -376,3 +486,72 @@ HttpSessionManager::release_session(HttpServerSession *to_release)
 
   return HSM_RETRY;
 }
+
+// void HttpSessionManager::add_pipeline_session(HttpServerSession *s, int depth)
+//
+//   Let other transactions of this thread queue requests on the active
+//    session s, up to depth of them in flight.  Only for the per thread
+//    pools: the session and everyone queued on it stay on the thread of
+//    its netvc, so the pipeline lists need no lock.  Thieves from other
+//    threads only look at the idle sessions.
+//
+void
+HttpSessionManager::add_pipeline_session(HttpServerSession *s, int depth)
+{
+  EThread *ethread = this_ethread();
+
+  ink_assert(2 == s->share_session);
+  ink_assert(s->get_netvc()->thread == ethread);
+  if (s->pipeline_listed || s->pipeline_broken || s->private_session)
+    return;
+
+  SessionBucket *bucket = ethread->l1_hash + FIRST_LEVEL_HASH(&s->server_ip.sa);
+  int l2_index = SECOND_LEVEL_HASH(&s->server_ip.sa);
+
+  ink_assert(l2_index < HSM_LEVEL2_BUCKETS);
+  s->pipeline_depth = depth;
+  s->pipeline_bucket = bucket;
+  s->pipeline_listed = true;
+  bucket->pipeline_hash[l2_index].push(s);
+  Debug("http_ss", "[%" PRId64 "] [pipeline] session takes up to %d requests", s->con_id, depth);
+}
+
+void
+HttpSessionManager::remove_pipeline_session(HttpServerSession *s)
+{
+  int l2_index = SECOND_LEVEL_HASH(&s->server_ip.sa);
+
+  ink_assert(s->pipeline_listed);
+  ink_assert(s->get_netvc() == NULL || s->get_netvc()->thread == this_ethread());
+  s->pipeline_bucket->pipeline_hash[l2_index].remove(s);
+  s->pipeline_bucket = NULL;
+  s->pipeline_listed = false;
+}
+
+HttpServerSession *
+HttpSessionManager::acquire_pipelined_session(sockaddr const* ip, const char *hostname)
+{
+  EThread *ethread = this_ethread();
+  SessionBucket *bucket = ethread->l1_hash + FIRST_LEVEL_HASH(ip);
+  int l2_index = SECOND_LEVEL_HASH(ip);
+  INK_MD5 hostname_hash;
+
+  ink_assert(l2_index < HSM_LEVEL2_BUCKETS);
+  if (bucket->pipeline_hash[l2_index].head == NULL)
+    return NULL;
+
+  ink_code_MMH((unsigned char *) hostname, strlen(hostname), (unsigned char *) &hostname_hash);
+  for (HttpServerSession *b = bucket->pipeline_hash[l2_index].head; b != NULL; b = b->pipeline_link.next) {
+    if (ats_ip_addr_eq(&b->server_ip.sa, ip) &&
+      ats_ip_port_cast(ip) == ats_ip_port_cast(&b->server_ip) &&
+      hostname_hash == b->hostname_hash &&
+      b->pipeline_count + 1 < b->pipeline_depth &&
+      b->pipeline_count < HTTP_SS_PIPELINE_MAX
+    ) {
+      ink_assert(!b->pipeline_broken && b->get_netvc()->thread == ethread);
+      return b;
+    }
+  }
+
+  return NULL;
+}
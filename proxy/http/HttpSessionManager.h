@@ -59,6 +59,9 @@ public:
   int session_handler(int event, void *data);
   Que(HttpServerSession, lru_link) lru_list;
   DList(HttpServerSession, hash_link) l2_hash[HSM_LEVEL2_BUCKETS];
+  // Active sessions taking pipelined requests, only the owning thread
+  //  touches these
+  DList(HttpServerSession, pipeline_link) pipeline_hash[HSM_LEVEL2_BUCKETS];
 };
 
 enum HSMresult_t
@@ -78,6 +81,9 @@ public:
                               const char *hostname, HttpClientSession *ua_session, HttpSM *sm);
   HttpServerSession* acquire_session_hc(sockaddr const* ip, const char *hostname, HCSM *hcsm);
   HSMresult_t release_session(HttpServerSession *to_release);
+  void add_pipeline_session(HttpServerSession *s, int depth);
+  void remove_pipeline_session(HttpServerSession *s);
+  HttpServerSession *acquire_pipelined_session(sockaddr const* ip, const char *hostname);
   void purge_keepalives();
   void init();
   int main_handler(int event, void *data);
@@ -5803,7 +5803,9 @@ HttpTransact::initialize_state_variables_from_request(State* s, HTTPHdr* obsolet
   //
   MIMEField *pc = incoming_request->field_find(MIME_FIELD_PROXY_CONNECTION, MIME_LEN_PROXY_CONNECTION);
 
-  if (!s->txn_conf->keep_alive_enabled_in || (s->http_config_param->server_transparency_enabled && pc != NULL)) {
+  // A stream carries a single transaction, it ends with the response.
+  if (!s->txn_conf->keep_alive_enabled_in || s->client_info.is_framed ||
+      (s->http_config_param->server_transparency_enabled && pc != NULL)) {
     s->client_info.keep_alive = HTTP_NO_KEEPALIVE;
 
     // If we need to send a close header later,
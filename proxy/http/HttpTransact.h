@@ -802,6 +802,9 @@ public:
 
     /// @c true if the connection is transparent.
     bool is_transparent;
+    /// @c true if the connection is one stream of a framed protocol
+    /// (SPDY), the request header comes already parsed.
+    bool is_framed;
 
     _ConnectionAttributes()
       : http_version(),
@@ -817,7 +820,8 @@ public:
         state(STATE_UNDEFINED),
         abort(ABORT_UNDEFINED),
         port_attribute(HttpProxyPort::TRANSPORT_DEFAULT),
-        is_transparent(false)
+        is_transparent(false),
+        is_framed(false)
     {
       memset(&addr, 0, sizeof(addr));
     }
@@ -1002,6 +1006,8 @@ public:
     // for Range: to avoid write transfomed Range response into cache
     RangeSetup_t range_setup;
     RangeRecord single_range;
+    CacheRange *pread_ranges;   // multiple ranges read straight from the cache
+    int num_pread_ranges;
 
     // for authenticated content caching
     CacheAuth_t www_auth_content;
@@ -1136,6 +1142,8 @@ public:
         first_stats(),
         current_stats(NULL),
         range_setup(RANGE_NONE),
+        pread_ranges(NULL),
+        num_pread_ranges(0),
         www_auth_content(CACHE_AUTH_NONE),
         fp_tsremap_os_response(NULL),
         remap_plugin_instance(0),
@@ -1245,6 +1253,8 @@ public:
       }
       if (internal_msg_buffer_type)
         ats_free(internal_msg_buffer_type);
+      if (pread_ranges)
+        ats_free(pread_ranges);
 
       ParentConfig::release(parent_params);
       parent_params = NULL;
@@ -201,6 +201,12 @@ HttpTransactCache::SelectFromAlternates(CacheHTTPInfoVector * cache_vector,
     return 0;
   }
 
+  // Parse the client's Accept* headers once for all alternates
+  HTTPAcceptSignature client_signature;
+  if (alt_count > 1) {
+    client_signature.compute(client_request);
+  }
+
   for (int i = 0; i < alt_count; i++) {
     float Q;
     CacheHTTPInfo *obj = cache_vector->get(i);
@@ -211,7 +217,8 @@ HttpTransactCache::SelectFromAlternates(CacheHTTPInfoVector * cache_vector,
       ink_debug_assert(cached_request->valid());
       ink_debug_assert(cached_response->valid());
 
-      Q = calculate_quality_of_match(http_config_params, client_request, cached_request, cached_response);
+      Q = calculate_quality_of_match(http_config_params, client_request, cached_request, cached_response,
+                                     &client_signature, obj->signature_get());
 
       if (alt_count > 1) {
         if (t_now == 0)
@@ -300,7 +307,9 @@ float
 HttpTransactCache::calculate_quality_of_match(CacheLookupHttpConfig * http_config_param,        // in
                                               HTTPHdr * client_request, // in
                                               HTTPHdr * obj_client_request,     // in
-                                              HTTPHdr * obj_origin_server_response      // in
+                                              HTTPHdr * obj_origin_server_response,     // in
+                                              const HTTPAcceptSignature * client_signature,     // in
+                                              const HTTPAltSignature * obj_signature    // in
   )
 {
   float q[4], Q;
@@ -319,66 +328,70 @@ HttpTransactCache::calculate_quality_of_match(CacheLookupHttpConfig * http_confi
 
   q[1] = (q[2] = (q[3] = -2.0));        /* just to make debug output happy :) */
 
-  // Accept //
-  // A NULL Accept or a NULL Content-Type field are perfect matches.
-  content_field = obj_origin_server_response->field_find(MIME_FIELD_CONTENT_TYPE, MIME_LEN_CONTENT_TYPE);
-  accept_field = client_request->field_find(MIME_FIELD_ACCEPT, MIME_LEN_ACCEPT);
-  q[0] = (content_field != 0 && accept_field != 0 && !http_config_param->ignore_accept_mismatch) ?
-    calculate_quality_of_accept_match(accept_field, content_field) : 1.0;
-
-  if (q[0] >= 0.0) {
-    // Accept-Charset
-    if (http_config_param->ignore_accept_charset_mismatch) {    //Bug 2393700 /ebalsa
-      q[1] = 1.0;
-    } else {
-      accept_field = client_request->field_find(MIME_FIELD_ACCEPT_CHARSET, MIME_LEN_ACCEPT_CHARSET);
-      cached_accept_field = obj_client_request->field_find(MIME_FIELD_ACCEPT_CHARSET, MIME_LEN_ACCEPT_CHARSET);
-      // content_field lookup is same as above
-      // content_field = obj_origin_server_response->field_find(MIME_FIELD_CONTENT_TYPE, MIME_LEN_CONTENT_TYPE);
-
-      // absence in both requests counts as exact match
-      if (accept_field == NULL && cached_accept_field == NULL) {
-        Debug("http_alternate", "Exact match for ACCEPT CHARSET");
-        q[1] = 1.001;           //slightly higher weight to this guy
-      } else {
-        q[1] = calculate_quality_of_accept_charset_match(accept_field, content_field, cached_accept_field);
-      }
-    }
-
-    if (q[1] >= 0.0) {
-      // Accept-Encoding //
-      if (http_config_param->ignore_accept_encoding_mismatch) { //Bug 2393700 /ebalsa
-        q[2] = 1.0;
+  if (client_signature && client_signature->m_valid && obj_signature && obj_signature->valid()) {
+    calculate_quality_of_signature_match(http_config_param, client_signature, obj_signature, q);
+  } else {
+    // Accept //
+    // A NULL Accept or a NULL Content-Type field are perfect matches.
+    content_field = obj_origin_server_response->field_find(MIME_FIELD_CONTENT_TYPE, MIME_LEN_CONTENT_TYPE);
+    accept_field = client_request->field_find(MIME_FIELD_ACCEPT, MIME_LEN_ACCEPT);
+    q[0] = (content_field != 0 && accept_field != 0 && !http_config_param->ignore_accept_mismatch) ?
+      calculate_quality_of_accept_match(accept_field, content_field) : 1.0;
+
+    if (q[0] >= 0.0) {
+      // Accept-Charset
+      if (http_config_param->ignore_accept_charset_mismatch) {    //Bug 2393700 /ebalsa
+        q[1] = 1.0;
       } else {
-        accept_field = client_request->field_find(MIME_FIELD_ACCEPT_ENCODING, MIME_LEN_ACCEPT_ENCODING);
-        content_field = obj_origin_server_response->field_find(MIME_FIELD_CONTENT_ENCODING, MIME_LEN_CONTENT_ENCODING);
-        cached_accept_field = obj_client_request->field_find(MIME_FIELD_ACCEPT_ENCODING, MIME_LEN_ACCEPT_ENCODING);
+        accept_field = client_request->field_find(MIME_FIELD_ACCEPT_CHARSET, MIME_LEN_ACCEPT_CHARSET);
+        cached_accept_field = obj_client_request->field_find(MIME_FIELD_ACCEPT_CHARSET, MIME_LEN_ACCEPT_CHARSET);
+        // content_field lookup is same as above
+        // content_field = obj_origin_server_response->field_find(MIME_FIELD_CONTENT_TYPE, MIME_LEN_CONTENT_TYPE);
 
         // absence in both requests counts as exact match
         if (accept_field == NULL && cached_accept_field == NULL) {
-          Debug("http_alternate", "Exact match for ACCEPT ENCODING");
-          q[2] = 1.001;         //slightly higher weight to this guy
+          Debug("http_alternate", "Exact match for ACCEPT CHARSET");
+          q[1] = 1.001;           //slightly higher weight to this guy
         } else {
-          q[2] = calculate_quality_of_accept_encoding_match(accept_field, content_field, cached_accept_field);
+          q[1] = calculate_quality_of_accept_charset_match(accept_field, content_field, cached_accept_field);
         }
       }
 
-      if (q[2] >= 0.0) {
-        // Accept-Language //
-        if (http_config_param->ignore_accept_language_mismatch) {       //Bug 2393700 /ebalsa
-          q[3] = 1.0;
+      if (q[1] >= 0.0) {
+        // Accept-Encoding //
+        if (http_config_param->ignore_accept_encoding_mismatch) { //Bug 2393700 /ebalsa
+          q[2] = 1.0;
         } else {
-          accept_field = client_request->field_find(MIME_FIELD_ACCEPT_LANGUAGE, MIME_LEN_ACCEPT_LANGUAGE);
-          content_field =
-            obj_origin_server_response->field_find(MIME_FIELD_CONTENT_LANGUAGE, MIME_LEN_CONTENT_LANGUAGE);
-          cached_accept_field = obj_client_request->field_find(MIME_FIELD_ACCEPT_LANGUAGE, MIME_LEN_ACCEPT_LANGUAGE);
+          accept_field = client_request->field_find(MIME_FIELD_ACCEPT_ENCODING, MIME_LEN_ACCEPT_ENCODING);
+          content_field = obj_origin_server_response->field_find(MIME_FIELD_CONTENT_ENCODING, MIME_LEN_CONTENT_ENCODING);
+          cached_accept_field = obj_client_request->field_find(MIME_FIELD_ACCEPT_ENCODING, MIME_LEN_ACCEPT_ENCODING);
 
           // absence in both requests counts as exact match
           if (accept_field == NULL && cached_accept_field == NULL) {
-            Debug("http_alternate", "Exact match for ACCEPT LANGUAGE");
-            q[3] = 1.001;       //slightly higher weight to this guy
+            Debug("http_alternate", "Exact match for ACCEPT ENCODING");
+            q[2] = 1.001;         //slightly higher weight to this guy
+          } else {
+            q[2] = calculate_quality_of_accept_encoding_match(accept_field, content_field, cached_accept_field);
+          }
+        }
+
+        if (q[2] >= 0.0) {
+          // Accept-Language //
+          if (http_config_param->ignore_accept_language_mismatch) {       //Bug 2393700 /ebalsa
+            q[3] = 1.0;
           } else {
-            q[3] = calculate_quality_of_accept_language_match(accept_field, content_field, cached_accept_field);
+            accept_field = client_request->field_find(MIME_FIELD_ACCEPT_LANGUAGE, MIME_LEN_ACCEPT_LANGUAGE);
+            content_field =
+              obj_origin_server_response->field_find(MIME_FIELD_CONTENT_LANGUAGE, MIME_LEN_CONTENT_LANGUAGE);
+            cached_accept_field = obj_client_request->field_find(MIME_FIELD_ACCEPT_LANGUAGE, MIME_LEN_ACCEPT_LANGUAGE);
+
+            // absence in both requests counts as exact match
+            if (accept_field == NULL && cached_accept_field == NULL) {
+              Debug("http_alternate", "Exact match for ACCEPT LANGUAGE");
+              q[3] = 1.001;       //slightly higher weight to this guy
+            } else {
+              q[3] = calculate_quality_of_accept_language_match(accept_field, content_field, cached_accept_field);
+            }
           }
         }
       }
@@ -1132,6 +1145,296 @@ language_wildcard:
   return (q);
 }
 
+/**
+  Signature based equivalents of the calculate_quality_of_*_match()
+  functions above. Each one follows the same rules as its string based
+  counterpart, but operates on the hashes in an HTTPAcceptSignature
+  (client request) and HTTPAltSignature (cached alternate).
+
+*/
+static float
+signature_accept_match(const HTTPAcceptList * accept, const HTTPAltSignature * sig)
+{
+  float q = -1.0;
+  bool wildcard_type_present = false;
+  bool wildcard_subtype_present = false;
+  float wildcard_type_q = 1.0;
+  float wildcard_subtype_q = 1.0;
+
+  if (!(sig->m_flags & HTTP_ALT_SIG_CONTENT_TYPE_PARAM)) {
+    return (1.0);
+  }
+
+  for (int i = 0; i < accept->m_count; i++) {
+    const HTTPAcceptEntry *e = &accept->m_entries[i];
+
+    if (e->m_flags & HTTP_ACCEPT_ENTRY_STAR) {
+      wildcard_type_present = true;
+      wildcard_type_q = e->m_q;
+    } else if ((e->m_flags & HTTP_ACCEPT_ENTRY_SUBTYPE_STAR) && (e->m_hash == sig->m_content_type)) {
+      wildcard_subtype_present = true;
+      wildcard_subtype_q = e->m_q;
+    } else if (((e->m_flags & HTTP_ACCEPT_ENTRY_EMPTY) || (e->m_hash == sig->m_content_type)) &&
+               ((e->m_flags & (HTTP_ACCEPT_ENTRY_SUBTYPE_STAR | HTTP_ACCEPT_ENTRY_SUBTYPE_EMPTY)) ||
+                (e->m_subtype_hash == sig->m_content_subtype))) {
+      q = (e->m_q > q ? e->m_q : q);
+    }
+  }
+
+  if ((q == -1.0) && wildcard_subtype_present) {
+    q = wildcard_subtype_q;
+  }
+  if ((q == -1.0) && wildcard_type_present) {
+    q = wildcard_type_q;
+  }
+  return (q);
+}
+
+static float
+signature_accept_charset_match(const HTTPAcceptList * accept, const HTTPAltSignature * sig)
+{
+  float q = -1.0;
+  bool wildcard_present = false;
+  float wildcard_q = 1.0;
+
+  // prefer exact matches
+  if (accept->m_present && (sig->m_flags & HTTP_ALT_SIG_ACCEPT_CHARSET) && accept->m_raw == sig->m_accept_charset_raw) {
+    Debug("http_alternate", "Exact match for ACCEPT CHARSET");
+    return (float) 1.001;
+  }
+  if (!accept->m_present || !(sig->m_flags & HTTP_ALT_SIG_CONTENT_TYPE)) {
+    return (float) 1.0;
+  }
+
+  for (int i = 0; i < accept->m_count; i++) {
+    const HTTPAcceptEntry *e = &accept->m_entries[i];
+
+    if (e->m_flags & HTTP_ACCEPT_ENTRY_STAR) {
+      wildcard_present = true;
+      wildcard_q = e->m_q;
+    } else if ((e->m_flags & HTTP_ACCEPT_ENTRY_EMPTY) || (e->m_hash == sig->m_content_charset)) {
+      q = (e->m_q > q ? e->m_q : q);
+    }
+  }
+
+  if ((q == -1.0) && wildcard_present) {
+    q = wildcard_q;
+  }
+  if ((q == -1.0) && (sig->m_flags & HTTP_ALT_SIG_CHARSET_DEFAULT)) {
+    q = 1.0;
+  }
+  return (q);
+}
+
+static inline bool
+signature_match_accept_content_encoding(uint64_t c_encoding, const HTTPAcceptList * accept,
+                                        bool *wildcard_present, float *wildcard_q, float *q)
+{
+  for (int i = 0; i < accept->m_count; i++) {
+    const HTTPAcceptEntry *e = &accept->m_entries[i];
+
+    if (e->m_flags & HTTP_ACCEPT_ENTRY_STAR) {
+      *wildcard_present = true;
+      *wildcard_q = e->m_q;
+      return true;
+    } else if (e->m_hash == c_encoding) {
+      *q = (e->m_q > *q ? e->m_q : *q);
+      return true;
+    }
+  }
+  return false;
+}
+
+static float
+signature_accept_encoding_match(const HTTPAcceptList * accept, const HTTPAltSignature * sig)
+{
+  static const uint64_t identity_hash = http_sig_hash_encoding("identity", 8);
+  float q = -1.0;
+  bool is_identity_encoding = (sig->m_flags & HTTP_ALT_SIG_IDENTITY_ENCODING) != 0;
+  bool has_content_encoding = (sig->m_flags & HTTP_ALT_SIG_CONTENT_ENCODING) != 0;
+  bool has_cached_accept = (sig->m_flags & HTTP_ALT_SIG_ACCEPT_ENCODING) != 0;
+  bool cached_accept_gzip = (sig->m_flags & HTTP_ALT_SIG_ACCEPT_ENCODING_GZIP) != 0;
+  bool wildcard_present = false;
+  float wildcard_q = 1.0;
+
+  // prefer exact matches
+  if (accept->m_present && has_cached_accept && accept->m_raw == sig->m_accept_encoding_raw) {
+    Debug("http_alternate", "Exact match for ACCEPT ENCODING");
+    return (float) 1.001;
+  }
+  if (!accept->m_present && !has_content_encoding) {
+    return (float) 1.0;
+  }
+
+  // if no Accept-Encoding header, only match identity
+  if (!accept->m_present) {
+    if (is_identity_encoding) {
+      return has_cached_accept ? (float) 0.001 : (float) 1.0;
+    } else {
+      return (float) -1.0;
+    }
+  }
+
+  if (!has_content_encoding) {
+    if (!signature_match_accept_content_encoding(identity_hash, accept, &wildcard_present, &wildcard_q, &q)) {
+      if (accept->m_gzip && cached_accept_gzip) {
+        return (float) 1.0;
+      }
+      goto encoding_wildcard;
+    }
+  } else {
+    float combined_q = 1.0;
+    for (int i = 0; i < sig->m_encoding_count; i++) {
+      float this_q = -1.0;
+      if (!signature_match_accept_content_encoding(sig->m_encoding[i], accept, &wildcard_present, &wildcard_q, &this_q)) {
+        goto encoding_wildcard;
+      }
+      combined_q *= this_q;
+    }
+    q = combined_q;
+  }
+
+encoding_wildcard:
+  if ((q == -1.0) && wildcard_present) {
+    q = wildcard_q;
+  }
+  if ((q == -1.0) && is_identity_encoding) {
+    if (accept->m_gzip) {
+      return cached_accept_gzip ? (float) 1.0 : (float) -1.0;
+    } else if (has_cached_accept && !cached_accept_gzip) {
+      return (float) 0.001;
+    } else {
+      return (float) -1.0;
+    }
+  }
+  return (q);
+}
+
+static inline bool
+signature_match_accept_content_language(const uint64_t * c_prefix, int c_prefix_count, const HTTPAcceptList * accept,
+                                        bool *wildcard_present, float *wildcard_q, float *q)
+{
+  for (int i = 0; i < accept->m_count; i++) {
+    const HTTPAcceptEntry *e = &accept->m_entries[i];
+
+    if (e->m_flags & HTTP_ACCEPT_ENTRY_STAR) {
+      *wildcard_present = true;
+      *wildcard_q = e->m_q;
+      return true;
+    }
+    for (int j = 0; j < c_prefix_count; j++) {
+      if (e->m_hash == c_prefix[j]) {
+        *q = e->m_q;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static float
+signature_accept_language_match(const HTTPAcceptList * accept, const HTTPAltSignature * sig)
+{
+  static const uint64_t identity_hash = http_sig_hash("identity", 8);
+  float q = -1.0;
+  bool wildcard_present = false;
+  float wildcard_q = 1.0;
+  float min_q = 1.0;
+  bool match_found = false;
+  int prefix_start = 0;
+
+  // prefer exact matches
+  if (accept->m_present && (sig->m_flags & HTTP_ALT_SIG_ACCEPT_LANGUAGE) &&
+      accept->m_raw == sig->m_accept_language_raw) {
+    Debug("http_alternate", "Exact match for ACCEPT LANGUAGE");
+    return (float) 1.001;
+  }
+  if (!accept->m_present) {
+    return (1.0);
+  }
+
+  if (!(sig->m_flags & HTTP_ALT_SIG_CONTENT_LANGUAGE)) {
+    if (signature_match_accept_content_language(&identity_hash, 1, accept, &wildcard_present, &wildcard_q, &q)) {
+      goto language_wildcard;
+    }
+    return (1.0);
+  }
+
+  for (int i = 0; i < sig->m_language_count; i++) {
+    int prefix_end = sig->m_language_prefix_end[i];
+
+    if (signature_match_accept_content_language(sig->m_language_prefix + prefix_start, prefix_end - prefix_start,
+                                                accept, &wildcard_present, &wildcard_q, &q)) {
+      min_q = (min_q < q ? min_q : q);
+      match_found = true;
+    }
+    prefix_start = prefix_end;
+  }
+  q = match_found ? min_q : -1.0;
+
+language_wildcard:
+  if ((q == -1.0) && wildcard_present) {
+    q = wildcard_q;
+  }
+  return (q);
+}
+
+void
+HttpTransactCache::calculate_quality_of_signature_match(CacheLookupHttpConfig * http_config_param,
+                                                        const HTTPAcceptSignature * client_signature,
+                                                        const HTTPAltSignature * obj_signature, float q[4])
+{
+  const HTTPAcceptList *accept;
+  uint32_t cached_flag;
+
+  // Accept //
+  accept = &client_signature->m_accept;
+  q[0] = ((obj_signature->m_flags & HTTP_ALT_SIG_CONTENT_TYPE) && accept->m_present &&
+          !http_config_param->ignore_accept_mismatch) ? signature_accept_match(accept, obj_signature) : 1.0;
+  if (q[0] < 0.0)
+    return;
+
+  // Accept-Charset //
+  accept = &client_signature->m_charset;
+  cached_flag = obj_signature->m_flags & HTTP_ALT_SIG_ACCEPT_CHARSET;
+  if (http_config_param->ignore_accept_charset_mismatch) {
+    q[1] = 1.0;
+  } else if (!accept->m_present && !cached_flag) {
+    Debug("http_alternate", "Exact match for ACCEPT CHARSET");
+    q[1] = 1.001;
+  } else {
+    q[1] = signature_accept_charset_match(accept, obj_signature);
+  }
+  if (q[1] < 0.0)
+    return;
+
+  // Accept-Encoding //
+  accept = &client_signature->m_encoding;
+  cached_flag = obj_signature->m_flags & HTTP_ALT_SIG_ACCEPT_ENCODING;
+  if (http_config_param->ignore_accept_encoding_mismatch) {
+    q[2] = 1.0;
+  } else if (!accept->m_present && !cached_flag) {
+    Debug("http_alternate", "Exact match for ACCEPT ENCODING");
+    q[2] = 1.001;
+  } else {
+    q[2] = signature_accept_encoding_match(accept, obj_signature);
+  }
+  if (q[2] < 0.0)
+    return;
+
+  // Accept-Language //
+  accept = &client_signature->m_language;
+  cached_flag = obj_signature->m_flags & HTTP_ALT_SIG_ACCEPT_LANGUAGE;
+  if (http_config_param->ignore_accept_language_mismatch) {
+    q[3] = 1.0;
+  } else if (!accept->m_present && !cached_flag) {
+    Debug("http_alternate", "Exact match for ACCEPT LANGUAGE");
+    q[3] = 1.001;
+  } else {
+    q[3] = signature_accept_language_match(accept, obj_signature);
+  }
+}
+
 /**
   If the cached object contains a Vary header, then the object only
   matches if ALL of the headers named in Vary are present in the new
@@ -1521,3 +1824,119 @@ CacheLookupHttpConfig::unmarshal(Arena * arena, const char *buf, int buflen)
 
   return (p - buf);
 }
+
+#if TS_HAS_TESTS
+
+static bool
+test_alt_parse(HTTPHdr *hdr, HTTPType type, const char *first_line, const char *fields)
+{
+  char buf[1024];
+  const char *start = buf;
+  const char *end;
+  HTTPParser parser;
+  MIMEParseResult err;
+
+  snprintf(buf, sizeof(buf), "%s\r\n%s\r\n", first_line, fields);
+  end = buf + strlen(buf);
+  http_parser_init(&parser);
+  hdr->create(type);
+  do {
+    err = (type == HTTP_TYPE_REQUEST) ? hdr->parse_req(&parser, &start, end, true) :
+      hdr->parse_resp(&parser, &start, end, true);
+  } while (err == PARSE_CONT);
+  http_parser_clear(&parser);
+  return err == PARSE_DONE;
+}
+
+// The signature scoring has to give the same quality as the string
+// matching it replaces, for every client against every alternate.
+REGRESSION_TEST(HttpTransactCache_signature_quality) (RegressionTest * t, int atype, int *pstatus)
+{
+  NOWARN_UNUSED(atype);
+  static const char *clients[] = {
+    "",
+    "Accept: text/html\r\n",
+    "Accept: text/*;q=0.5, image/png\r\n",
+    "Accept: */*;q=0.1, text/html;q=0\r\n",
+    "Accept-Charset: utf-8, iso-8859-1;q=0.3\r\n",
+    "Accept-Charset: *;q=0.2\r\n",
+    "Accept-Encoding: gzip\r\n",
+    "Accept-Encoding: gzip;q=0, deflate\r\n",
+    "Accept-Encoding: identity;q=0, *;q=0.5\r\n",
+    "Accept-Language: en-us, fr;q=0.4\r\n",
+    "Accept-Language: EN\r\n",
+    "Accept-Language: *;q=0.1, de\r\n",
+    "Accept: text/html\r\nAccept-Charset: utf-8\r\nAccept-Encoding: gzip, deflate\r\nAccept-Language: en\r\n",
+  };
+  static const struct
+  {
+    const char *request;
+    const char *response;
+  } alternates[] = {
+    { "", "Content-Type: text/html\r\n" },
+    { "", "Content-Type: text/html; charset=UTF-8\r\n" },
+    { "Accept-Charset: utf-8\r\n", "Content-Type: text/plain; charset=utf-8\r\n" },
+    { "Accept-Encoding: gzip\r\n", "Content-Type: text/html\r\nContent-Encoding: gzip\r\n" },
+    { "Accept-Encoding: deflate, gzip\r\n", "Content-Type: text/html\r\nContent-Encoding: deflate\r\n" },
+    { "Accept-Encoding: gzip\r\n", "Content-Type: text/html\r\n" },
+    { "Accept-Language: en-us\r\n", "Content-Type: image/png\r\nContent-Language: en-US\r\n" },
+    { "Accept-Language: fr\r\n", "Content-Type: text/html\r\nContent-Language: fr, de\r\n" },
+    { "", "Content-Language: en-gb\r\n" },
+    { "", "" },
+  };
+  CacheLookupHttpConfig config;
+  HTTPHdr client, cached_request, cached_response;
+  HTTPAcceptSignature client_signature;
+  HTTPAltSignature alt_signature;
+  int checked = 0;
+  int status = REGRESSION_TEST_PASSED;
+
+  for (unsigned i = 0; i < sizeof(clients) / sizeof(clients[0]); i++) {
+    if (!test_alt_parse(&client, HTTP_TYPE_REQUEST, "GET http://www.example.com/ HTTP/1.1",
+                        clients[i])) {
+      rprintf(t, "unable to parse client %u\n", i);
+      *pstatus = REGRESSION_TEST_FAILED;
+      return;
+    }
+    client_signature.compute(&client);
+
+    for (unsigned j = 0; j < sizeof(alternates) / sizeof(alternates[0]); j++) {
+      if (!test_alt_parse(&cached_request, HTTP_TYPE_REQUEST, "GET http://www.example.com/ HTTP/1.1",
+                          alternates[j].request) ||
+          !test_alt_parse(&cached_response, HTTP_TYPE_RESPONSE, "HTTP/1.1 200 OK", alternates[j].response)) {
+        rprintf(t, "unable to parse alternate %u\n", j);
+        *pstatus = REGRESSION_TEST_FAILED;
+        return;
+      }
+      alt_signature.clear();
+      alt_signature.compute(&cached_request, &cached_response);
+
+      float by_string = HttpTransactCache::calculate_quality_of_match(&config, &client, &cached_request,
+                                                                      &cached_response);
+      float by_signature = HttpTransactCache::calculate_quality_of_match(&config, &client, &cached_request,
+                                                                         &cached_response, &client_signature,
+                                                                         &alt_signature);
+      if (client_signature.m_valid && alt_signature.valid()) {
+        checked++;
+      }
+      float delta = by_string - by_signature;
+      if (delta > 0.00001 || delta < -0.00001) {
+        rprintf(t, "client %u, alternate %u: quality %g by string, %g by signature\n", i, j, by_string,
+                by_signature);
+        status = REGRESSION_TEST_FAILED;
+      }
+      cached_request.destroy();
+      cached_response.destroy();
+    }
+    client.destroy();
+  }
+
+  if (checked == 0) {
+    rprintf(t, "no signature was usable\n");
+    status = REGRESSION_TEST_FAILED;
+  }
+  rprintf(t, "%d client/alternate pairs scored by signature\n", checked);
+  *pstatus = status;
+}
+
+#endif /* TS_HAS_TESTS */
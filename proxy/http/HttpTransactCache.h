@@ -34,6 +34,8 @@
 #include "libts.h"
 
 struct CacheHTTPInfoVector;
+struct HTTPAcceptSignature;
+struct HTTPAltSignature;
 
 class CacheLookupHttpConfig
 {
@@ -114,7 +116,13 @@ public:
 
   static float calculate_quality_of_match(CacheLookupHttpConfig * http_config_params, HTTPHdr * client_request, // in
                                           HTTPHdr * obj_client_request, // in
-                                          HTTPHdr * obj_origin_server_response);        // in
+                                          HTTPHdr * obj_origin_server_response, // in
+                                          const HTTPAcceptSignature * client_signature = NULL, // in
+                                          const HTTPAltSignature * obj_signature = NULL);      // in
+
+  static void calculate_quality_of_signature_match(CacheLookupHttpConfig * http_config_params,
+                                                   const HTTPAcceptSignature * client_signature,
+                                                   const HTTPAltSignature * obj_signature, float q[4]);
 
   static float calculate_quality_of_accept_match(MIMEField * accept_field, MIMEField * content_field);
 
@@ -967,6 +967,9 @@ HttpTunnel::producer_run(HttpTunnelProducer * p)
       if (p->vc_type == HT_CACHE_READ && sm->t_state.range_setup == HttpTransact::RANGE_HANDLED_NO_TRANSFORM) {
         p->read_vio = ((CacheVConnection*) p->vc)->do_io_pread(this, producer_n, p->read_buffer,
             sm->t_state.single_range._start);
+      } else if (p->vc_type == HT_CACHE_READ && sm->t_state.num_pread_ranges > 0) {
+        p->read_vio = ((CacheVConnection*) p->vc)->do_io_pread_ranges(this, producer_n, p->read_buffer,
+            sm->t_state.num_pread_ranges, sm->t_state.pread_ranges);
       } else
         p->read_vio = p->vc->do_io_read(this, producer_n, p->read_buffer);
     }
@@ -121,7 +121,7 @@ void HotUrlManager::UrlArray::replace(const HotUrlMap::UrlMapEntry *head,
   ++_generation;
   if (_count == 0) {
     while (head != eofEntry) {
-      add(&head->_url, false);
+      add(head->_url, head->_url_len, false);
       head = head->_next;
     }
     return;
@@ -131,13 +131,13 @@ void HotUrlManager::UrlArray::replace(const HotUrlMap::UrlMapEntry *head,
   int oldCount = _count;
   HotUrlManager::HotUrlEntry *found;
   while (head != eofEntry) {
-    found = find(&head->_url);
+    found = find(head->_url, head->_url_len);
     if (found != NULL) {
       found->generation = _generation;
       ++replaceCount;
     }
     else {
-      add(&head->_url, false);
+      add(head->_url, head->_url_len, false);
     }
 
     head = head->_next;
@@ -24,212 +24,420 @@
 #include "HotUrlMap.h"
 #include "HotUrlStats.h"
 
-#define CLEAR_INTERVAL (100 * HRTIME_MSECOND)
-
-inline int64_t HotUrlMap::UrlMapEntry::getOrderBy()
+inline int64_t HotUrlMap::UrlMapEntry::getOrderBy() const
 {
   return (HotUrlStats::getDetecType() & HOT_URLS_DETECT_TYPE_BYTES) ?
     _bytes : _count;
 }
 
-HotUrlMap::PriorityQueue::PriorityQueue()
-  : _maxCount(0), _count(0), _head(NULL), _tail(NULL), _min(0)
+HotUrlMap::Summary::Summary()
+  : _capacity(0), _count(0), _entries(NULL), _heap(NULL), _buckets(NULL),
+  _bucketMask(0)
 {
-  ink_mutex_init(&_mutex, "HotUrlPriorityQueue");
 }
 
-HotUrlMap::PriorityQueue::~PriorityQueue()
+HotUrlMap::Summary::~Summary()
 {
-  ink_mutex_destroy(&_mutex);
+  resize(0);
 }
 
-void HotUrlMap::PriorityQueue::add(UrlMapEntry *entry)
+void HotUrlMap::Summary::resize(const int capacity)
 {
-  if (entry->getOrderBy() <= _min) {
+  uint32_t bucketCount;
+
+  for (int i=0; i<_capacity; i++) {
+    ats_free(_entries[i]._url);
+  }
+  ats_free(_entries);
+  ats_free(_heap);
+  ats_free(_buckets);
+  _entries = NULL;
+  _heap = NULL;
+  _buckets = NULL;
+  _bucketMask = 0;
+  _count = 0;
+  _capacity = capacity;
+  if (capacity <= 0) {
+    _capacity = 0;
     return;
   }
 
-  ink_mutex_acquire(&_mutex);
-  do {
-    if (entry->getOrderBy() <= _min) {
-      break;
-    }
+  //keep the chains short: at least two buckets per entry
+  for (bucketCount = 2; bucketCount < (uint32_t)capacity * 2; bucketCount <<= 1);
+  _bucketMask = bucketCount - 1;
 
-    if (!entry->_inQueue) {
-      entry->_inQueue = true;
-      if (_count < _maxCount) {
-        ++_count;
-      }
-      else if (_tail != NULL) {  //remove the tail node
-        _tail->_inQueue = false;
-        if (_tail->_prev != NULL) {
-          _tail->_prev->_next = NULL;
-          _tail = _tail->_prev;
-        }
-        else {
-          _head = NULL;
-          _tail = NULL;
-        }
-      }
-
-      entry->_prev = _tail;
-      entry->_next = NULL;
-      if (_tail == NULL) {
-        _head = entry;
-      }
-      else {
-        _tail->_next = entry;
-      }
-
-      _tail = entry;
-      _min = entry->getOrderBy();
-    }
-    else
-    {
-      if (entry->_next == NULL) {  //i am the tail node
-        _min = entry->getOrderBy();
-      }
-    }
+  _entries = (UrlMapEntry *)ats_malloc(sizeof(UrlMapEntry) * capacity);
+  memset(_entries, 0, sizeof(UrlMapEntry) * capacity);
+  _heap = (int *)ats_malloc(sizeof(int) * capacity);
+  _buckets = (int *)ats_malloc(sizeof(int) * bucketCount);
+  memset(_buckets, 0xFF, sizeof(int) * bucketCount);
+}
 
-    if (entry->_prev == NULL) { //i am the largest, do NOT resort
-      break;
+void HotUrlMap::Summary::reset()
+{
+  _count = 0;
+  if (_buckets != NULL) {
+    memset(_buckets, 0xFF, sizeof(int) * (_bucketMask + 1));
+  }
+}
+
+void HotUrlMap::Summary::setUrl(UrlMapEntry *entry, const char *url, const int url_len)
+{
+  if (url_len >= entry->_url_size) {
+    int size = entry->_url_size > 0 ? entry->_url_size : 64;
+    while (size <= url_len) {
+      size *= 2;
     }
+    entry->_url = (char *)ats_realloc(entry->_url, size);
+    entry->_url_size = size;
+  }
+  memcpy(entry->_url, url, url_len);
+  *(entry->_url + url_len) = '\0';
+  entry->_url_len = url_len;
+}
+
+void HotUrlMap::Summary::unchain(UrlMapEntry *entry)
+{
+  int index = entry - _entries;
+  int *link = _buckets + (entry->_hash & _bucketMask);
+
+  while (*link != index) {
+    link = &(_entries[*link]._chain);
+  }
+  *link = entry->_chain;
+}
+
+void HotUrlMap::Summary::siftUp(int pos)
+{
+  int parent;
 
-    if (entry->getOrderBy() <= entry->_prev->getOrderBy()) { //order is OK
+  while (pos > 0) {
+    parent = (pos - 1) / 2;
+    if (weight(pos) >= weight(parent)) {
       break;
     }
+    swap(pos, parent);
+    pos = parent;
+  }
+}
 
-    //remove this entry first
-    if (entry->_next == NULL) { //i am the tail node
-      _tail = entry->_prev;
-      _tail->_next = NULL;
-      _min = _tail->getOrderBy();
-    }
-    else {
-      entry->_next->_prev = entry->_prev;
-      entry->_prev->_next = entry->_next;
-    }
+void HotUrlMap::Summary::siftDown(int pos)
+{
+  int child;
 
-    //then insert this entry
-    UrlMapEntry *prev = entry->_prev->_prev;
-    while (prev != NULL && entry->getOrderBy() > prev->getOrderBy()) {
-      prev = prev->_prev;
+  while ((child = 2 * pos + 1) < _count) {
+    if (child + 1 < _count && weight(child + 1) < weight(child)) {
+      child++;
     }
-    if (prev == NULL) {
-      entry->_prev = NULL;
-      entry->_next = _head;
-      _head->_prev = entry;
-      _head = entry;
+    if (weight(pos) <= weight(child)) {
+      break;
     }
-    else {
-      prev->_next->_prev = entry;
-      entry->_next = prev->_next;
-      entry->_prev = prev;
-      prev->_next = entry;
+    swap(pos, child);
+    pos = child;
+  }
+}
+
+void HotUrlMap::Summary::add(const uint64_t hash, const char *url, const int url_len,
+    const int count, const int64_t bytes, const int64_t error)
+{
+  UrlMapEntry *entry;
+  int *bucket;
+  int index;
+  bool fresh;
+
+  if (_capacity == 0) {
+    return;
+  }
+
+  bucket = _buckets + (hash & _bucketMask);
+  for (index = *bucket; index >= 0; index = entry->_chain) {
+    entry = _entries + index;
+    if (entry->_hash == hash && entry->equals(url, url_len)) {
+      entry->_count += count;
+      entry->_bytes += bytes;
+      entry->_error += error;
+      siftDown(entry->_heap);
+      return;
     }
-  } while (0);
-  ink_mutex_release(&_mutex);
+  }
+
+  fresh = _count < _capacity;
+  if (fresh) {
+    index = _count++;
+    entry = _entries + index;
+    entry->_count = count;
+    entry->_bytes = bytes;
+    entry->_error = error;
+    entry->_heap = index;
+    _heap[index] = index;
+  }
+  else {
+    //the smallest counter is taken over, its weight bounds our error
+    index = _heap[0];
+    entry = _entries + index;
+    unchain(entry);
+    entry->_error = entry->getOrderBy() + error;
+    entry->_count += count;
+    entry->_bytes += bytes;
+  }
+
+  entry->_hash = hash;
+  setUrl(entry, url, url_len);
+  entry->_chain = *bucket;
+  *bucket = index;
+  if (fresh) {
+    siftUp(entry->_heap);
+  }
+  else {
+    siftDown(entry->_heap);
+  }
+}
+
+HotUrlMap::ThreadSummary::ThreadSummary()
+  : _active(_summaries), _next(NULL)
+{
+  ink_mutex_init(&_mutex, "HotUrlThreadSummary");
+}
+
+HotUrlMap::ThreadSummary::~ThreadSummary()
+{
+  ink_mutex_destroy(&_mutex);
 }
 
 HotUrlMap::HotUrlMap()
+  : _capacity(0), _maxCount(0), _threadOffset(-1), _threads(NULL),
+  _sorted(NULL), _sortedSize(0)
+{
+  ink_mutex_init(&_mutex, "HotUrlMapMutex");
+}
+
+HotUrlMap::~HotUrlMap()
 {
-  int64_t bytes;
-  UrlHashBucket *pBucket;
-  UrlHashBucket *pEnd;
+  ThreadSummary *ts;
 
-  bytes = sizeof(UrlHashBucket) * URL_HASH_TABLE_SIZE;
-  _urlTable._buckets = (UrlHashBucket *)ats_malloc(bytes);
+  while ((ts = _threads) != NULL) {
+    _threads = ts->_next;
+    delete ts;
+  }
+  ats_free(_sorted);
+  ink_mutex_destroy(&_mutex);
+}
 
-  bytes = sizeof(int) * URL_HASH_TABLE_SIZE;
-  _urlTable._counts = (int *)ats_malloc(bytes);
-  memset(_urlTable._counts, 0, bytes);
+void HotUrlMap::setMaxCount(const uint32_t maxCount)
+{
+  int capacity;
 
-  pEnd = _urlTable._buckets + URL_HASH_TABLE_SIZE;
-  for (pBucket=_urlTable._buckets; pBucket<pEnd; pBucket++) {
-    ink_mutex_init(&pBucket->_mutex, "HotUrlMapMutex");
+  if (maxCount == 0) {
+    capacity = 0;
   }
+  else {
+    capacity = maxCount * HOT_URL_SUMMARY_FACTOR;
+    if (capacity < HOT_URL_SUMMARY_MIN_CAPACITY) {
+      capacity = HOT_URL_SUMMARY_MIN_CAPACITY;
+    }
+
+    //the event threads are running by now, there is no allocate at static init
+    ink_mutex_acquire(&_mutex);
+    if (_threadOffset < 0) {
+      _threadOffset = eventProcessor.allocate(sizeof(ThreadSummary *));
+    }
+    ink_mutex_release(&_mutex);
+  }
+
+  _maxCount = maxCount;
+  _capacity = capacity;
 }
 
-const HotUrlMap::UrlMapEntry *HotUrlMap::get(const char *url, const int url_len)
+HotUrlMap::ThreadSummary *HotUrlMap::getThreadSummary()
 {
-  unsigned int index;
-  UrlMapEntry *found;
+  EThread *thread;
+  ThreadSummary **slot;
+  ThreadSummary *ts;
 
-  index = time33Hash(url, url_len) % URL_HASH_TABLE_SIZE;
-  ink_mutex_acquire(&(_urlTable._buckets[index]._mutex));
-  found = find(index, url, url_len);
-  ink_mutex_release(&(_urlTable._buckets[index]._mutex));
-  return found;
+  if (_threadOffset < 0 || (thread = this_ethread()) == NULL) {
+    return &_shared;
+  }
+
+  slot = (ThreadSummary **)ETHREAD_GET_PTR(thread, _threadOffset);
+  if ((ts = *slot) == NULL) {
+    ts = new ThreadSummary();
+    ts->_summaries[0].resize(_capacity);
+    ts->_summaries[1].resize(_capacity);
+
+    ink_mutex_acquire(&_mutex);
+    ts->_next = _threads;
+    _threads = ts;
+    ink_mutex_release(&_mutex);
+    *slot = ts;
+  }
+  return ts;
 }
 
 void HotUrlMap::incrementBytes(const char *url, const int url_len, const int64_t bytes)
 {
-  unsigned int index;
-  UrlMapEntry *found;
+  ThreadSummary *ts;
+  uint64_t hash;
 
-  if (url_len >= MAX_URL_SIZE) {
+  if (url_len >= MAX_URL_SIZE) {  //the hot url list can't hold it
     return;
   }
 
-  index = time33Hash(url, url_len) % URL_HASH_TABLE_SIZE;
-  ink_mutex_acquire(&(_urlTable._buckets[index]._mutex));
-  found = find(index, url, url_len);
-  if (found != NULL) {
-    found->_bytes += bytes;
-    found->_count += 1;
+  ts = getThreadSummary();
+  hash = urlHash(url, url_len);
+  ink_mutex_acquire(&ts->_mutex);
+  ts->_active->add(hash, url, url_len, 1, bytes, 0);
+  ink_mutex_release(&ts->_mutex);
+}
+
+void HotUrlMap::resetSummary(Summary *summary)
+{
+  if (summary->getCapacity() != _capacity) {
+    summary->resize(_capacity);
   }
   else {
-    if (_urlTable._counts[index] >= MAX_URL_COUNT_PER_BUCKET) {
-      ink_mutex_release(&(_urlTable._buckets[index]._mutex));
-      return;
+    summary->reset();
+  }
+}
+
+static int compareUrlMapEntry(const void *p1, const void *p2)
+{
+  int64_t w1 = (*(const HotUrlMap::UrlMapEntry **)p1)->getOrderBy();
+  int64_t w2 = (*(const HotUrlMap::UrlMapEntry **)p2)->getOrderBy();
+
+  return w1 > w2 ? -1 : (w1 < w2 ? 1 : 0);
+}
+
+const HotUrlMap::UrlMapEntry *HotUrlMap::collect()
+{
+  ThreadSummary *ts;
+  ThreadSummary *head;
+  Summary *done;
+  UrlMapEntry *entry;
+  int count;
+
+  resetSummary(&_merged);
+
+  ink_mutex_acquire(&_mutex);
+  head = _threads;
+  ink_mutex_release(&_mutex);
+
+  //the list only grows at the head, walking it from a snapshot is safe
+  for (ts = head; ; ts = ts->_next) {
+    if (ts == NULL) {
+      ts = &_shared;
+    }
+
+    ink_mutex_acquire(&ts->_mutex);
+    done = ts->_active;
+    ts->_active = (done == ts->_summaries) ? ts->_summaries + 1 : ts->_summaries;
+    ink_mutex_release(&ts->_mutex);
+
+    //nobody records into done until the next swap
+    for (int i=0; i<done->getCount(); i++) {
+      entry = done->getEntry(i);
+      _merged.add(entry->_hash, entry->_url, entry->_url_len,
+          entry->_count, entry->_bytes, entry->_error);
     }
+    resetSummary(done);
 
-    found = _urlTable._buckets[index]._urls + _urlTable._counts[index];
-    found->_inQueue = false;
-    found->_bytes = bytes;
-    found->_count = 1;
-    found->setUrl(url, url_len);
-    _urlTable._counts[index]++;
+    if (ts == &_shared) {
+      break;
+    }
   }
-  ink_mutex_release(&(_urlTable._buckets[index]._mutex));
 
-  _urlQueue.add(found);
-  return;
+  count = _merged.getCount();
+  if (count == 0) {
+    return NULL;
+  }
+  if (count > _sortedSize) {
+    _sorted = (UrlMapEntry **)ats_realloc(_sorted, sizeof(UrlMapEntry *) * count);
+    _sortedSize = count;
+  }
+  for (int i=0; i<count; i++) {
+    _sorted[i] = _merged.getEntry(i);
+  }
+  qsort(_sorted, count, sizeof(UrlMapEntry *), compareUrlMapEntry);
+
+  if ((uint32_t)count > _maxCount) {
+    count = _maxCount;
+  }
+  for (int i=0; i<count; i++) {
+    _sorted[i]->_next = (i + 1 < count) ? _sorted[i + 1] : NULL;
+  }
+  return count > 0 ? _sorted[0] : NULL;
 }
 
-void HotUrlMap::urlTableStat(int &urlCount, int &min, int &max, double &avg)
+void HotUrlMap::clear()
 {
-  int *pCount;
-  int *pEnd;
-  int usedCount;
+  ThreadSummary *ts;
+  ThreadSummary *head;
 
-  urlCount = 0;
-  usedCount = 0;
-  min = -1;
-  max = 0;
-  pEnd = _urlTable._counts + URL_HASH_TABLE_SIZE;
-  for (pCount=_urlTable._counts; pCount<pEnd; pCount++) {
-    if (*pCount > 0) {
-      usedCount++;
-      urlCount += *pCount;
+  ink_mutex_acquire(&_mutex);
+  head = _threads;
+  ink_mutex_release(&_mutex);
 
-      if (*pCount > max) {
-        max = *pCount;
-      }
+  for (ts = head; ; ts = ts->_next) {
+    if (ts == NULL) {
+      ts = &_shared;
     }
 
-    if (min < 0) {
-      min = *pCount;
-    }
-    else if (*pCount < min) {
-      min = *pCount;
+    ink_mutex_acquire(&ts->_mutex);
+    resetSummary(ts->_summaries);
+    resetSummary(ts->_summaries + 1);
+    ink_mutex_release(&ts->_mutex);
+
+    if (ts == &_shared) {
+      break;
     }
   }
-  if (usedCount > 0) {
-    avg = (double)urlCount / (double)usedCount;
+}
+
+#if TS_HAS_TESTS
+
+EXCLUSIVE_REGRESSION_TEST(HotUrlMap_summary) (RegressionTest * t, int atype, int *pstatus)
+{
+  NOWARN_UNUSED(atype);
+  const int updates = 1000000;
+  const int distinct = 100000;
+  HotUrlMap map;
+  const HotUrlMap::UrlMapEntry *head;
+  ink_hrtime start, elapsed;
+  char url[64];
+  int len, n;
+
+  map.setMaxCount(10);
+
+  // one url takes a quarter of the requests, the others are spread thin
+  start = ink_get_hrtime_internal();
+  for (int i=0; i<updates; i++) {
+    n = (i % 4 == 0) ? 0 : 1 + (int)(((int64_t)i * 7919) % (distinct - 1));
+    len = snprintf(url, sizeof(url), "http://www.example.com/object/%d", n);
+    map.incrementBytes(url, len, 1000);
+  }
+  elapsed = ink_get_hrtime_internal() - start;
+  if (elapsed <= 0) {
+    elapsed = 1;
   }
-  else {
-    avg = 0.00;
+  rprintf(t, "%d updates over %d urls in %.3f msec\n", updates, distinct,
+      (double)elapsed / (double)HRTIME_MSECOND);
+  rperf(t, "HotUrlMap updates/sec", (double)updates * (double)HRTIME_SECOND / (double)elapsed);
+
+  head = map.collect();
+  len = snprintf(url, sizeof(url), "http://www.example.com/object/%d", 0);
+  if (head == NULL || !head->equals(url, len) || head->_count < updates / 4) {
+    rprintf(t, "the hot url was not found\n");
+    *pstatus = REGRESSION_TEST_FAILED;
+    return;
+  }
+  rprintf(t, "hot url %.*s, count=%d, error=%"PRId64"\n", head->_url_len, head->_url,
+      head->_count, head->_error);
+
+  if (map.collect() != NULL) {
+    rprintf(t, "collect did not start a new interval\n");
+    *pstatus = REGRESSION_TEST_FAILED;
+    return;
   }
+  *pstatus = REGRESSION_TEST_PASSED;
 }
 
+#endif /* TS_HAS_TESTS */
@@ -27,101 +27,110 @@
 #ifndef _HOT_URL_MAP_H_
 #define _HOT_URL_MAP_H_
 
-#define URL_HASH_TABLE_SIZE  10949
-#define MAX_URL_COUNT_PER_BUCKET  4
+// Heavy hitter detection with the Space-Saving algorithm: a summary keeps
+// a fixed number of counters, a url that is not monitored takes over the
+// smallest one and inherits its weight as the error bound.  Every thread
+// records into its own summary, the detect thread merges them once per
+// interval, so the request path never touches a shared lock.
+
+#define HOT_URL_SUMMARY_FACTOR        8     //counters kept per reported url
+#define HOT_URL_SUMMARY_MIN_CAPACITY  64
 
 class HotUrlMap
 {
   public:
     struct UrlMapEntry {
-      UrlEntry _url;
+      char *_url;
+      int _url_len;
+      int _url_size;  //allocated size of _url
       int _count;     //access count
-      bool _inQueue;
       int64_t _bytes;
-      UrlMapEntry *_next;  //for priority queue
-      UrlMapEntry *_prev;  //for priority queue
-
-      inline bool equals(const UrlEntry *url) {
-        return _url.equals(url);
-      }
-
-      inline bool equals(const char *url, const int url_len) {
-        return _url.equals(url, url_len);
+      int64_t _error; //weight inherited from the evicted url
+      uint64_t _hash;
+      int _chain;     //next entry in the hash bucket
+      int _heap;      //position in the min heap
+      UrlMapEntry *_next;  //the hot list returned by collect
+
+      inline bool equals(const char *url, const int url_len) const {
+        return _url_len == url_len && memcmp(_url, url, url_len) == 0;
       }
 
-      inline void setUrl(const char *url, const int url_len) {
-        memcpy(_url.url, url, url_len);
-        *(_url.url + url_len) = '\0';
-        _url.length = url_len;
-      }
-
-      inline int64_t getOrderBy();
+      inline int64_t getOrderBy() const;
     };
 
-    class PriorityQueue {
+    class Summary {
       public:
-        PriorityQueue();
-        ~PriorityQueue();
+        Summary();
+        ~Summary();
 
-        inline const UrlMapEntry *head() const {
-          return _head;
+        inline int getCapacity() const {
+          return _capacity;
         }
 
-        inline void clear() {
-          ink_mutex_acquire(&_mutex);
-          _count = 0;
-          _head = NULL;
-          _tail = NULL;
-          _min = 0;
-          ink_mutex_release(&_mutex);
+        inline int getCount() const {
+          return _count;
         }
 
-        void setMaxCount(const uint32_t maxCount) {
-          _maxCount = maxCount;
+        inline UrlMapEntry *getEntry(const int index) {
+          return _entries + index;
         }
 
-        void add(UrlMapEntry *entry);
+        void resize(const int capacity);
+
+        //drop the counters, keep the memory
+        void reset();
 
+        void add(const uint64_t hash, const char *url, const int url_len,
+            const int count, const int64_t bytes, const int64_t error);
 
       private:
-        uint32_t _maxCount;
-        uint32_t _count;
-        UrlMapEntry *_head;  //the largest
-        UrlMapEntry *_tail;  //the smallest
-        int64_t _min;
-        ink_mutex _mutex;
-    };
+        void setUrl(UrlMapEntry *entry, const char *url, const int url_len);
+        void unchain(UrlMapEntry *entry);
+        void siftUp(int pos);
+        void siftDown(int pos);
+
+        inline void swap(const int a, const int b) {
+          int index = _heap[a];
+          _heap[a] = _heap[b];
+          _heap[b] = index;
+          _entries[_heap[a]]._heap = a;
+          _entries[_heap[b]]._heap = b;
+        }
+
+        inline int64_t weight(const int pos) const {
+          return _entries[_heap[pos]].getOrderBy();
+        }
 
-    struct UrlHashBucket {
-      ink_mutex _mutex;  //use for locking this bucket
-      UrlMapEntry _urls[MAX_URL_COUNT_PER_BUCKET]; //urls items
+        int _capacity;
+        int _count;
+        UrlMapEntry *_entries;
+        int *_heap;       //entry indexes, the smallest first
+        int *_buckets;    //first entry index of the hash chain
+        uint32_t _bucketMask;
     };
 
-    struct UrlHashTable {
-      UrlHashBucket *_buckets;
-      int *_counts;
+    // The summaries of one thread, the detect thread swaps _active and
+    // drains the other one.
+    struct ThreadSummary {
+      ink_mutex _mutex;
+      Summary _summaries[2];
+      Summary *_active;
+      ThreadSummary *_next;
+
+      ThreadSummary();
+      ~ThreadSummary();
     };
 
   public:
     HotUrlMap();
-
-    inline PriorityQueue *getUrlQueue() {
-      return &_urlQueue;
-    }
-
-    inline void clear() {
-      memset(_urlTable._counts, 0, sizeof(int) * URL_HASH_TABLE_SIZE);
-      _urlQueue.clear();
-    }
-
+    ~HotUrlMap();
 
     /**
-     * Gets the entry for the url
-     * @param url the url
-     * @param url_len the url length
-     * @return the url entry
+     * Sets the count of the hot urls to report, the per thread summaries
+     * pick up the new size at the next collect
+     * @param maxCount the max hot url count
      */
-    const UrlMapEntry *get(const char *url, const int url_len);
+    void setMaxCount(const uint32_t maxCount);
 
     /**
      * Change (increment/decrement) the send bytes
@@ -132,49 +141,49 @@ class HotUrlMap
     void incrementBytes(const char *url, const int url_len, const int64_t bytes);
 
     /**
-     * stat url hash table
-     * @param urlCount the url count
-     * @param min the min url count of a bucket
-     * @param max the max url count of a bucket
-     * @param avg the avg url count
+     * Merges what all the threads recorded since the last call and starts
+     * a new interval
+     * @return the hottest urls linked by _next, valid until the next call
+     */
+    const UrlMapEntry *collect();
+
+    /**
+     * Drops what was recorded so far
      */
-    void urlTableStat(int &urlCount, int &min, int &max, double &avg);
+    void clear();
 
   protected:
-    inline uint64_t time33Hash(const char *key, const int key_len)
+    static inline uint64_t urlHash(const char *key, const int key_len)
     {
       uint64_t nHash;
       unsigned char *pKey;
       unsigned char *pEnd;
 
-      nHash = 0;
+      nHash = 14695981039346656037ULL;  //FNV-1a
       pEnd = (unsigned char *)key + key_len;
       for (pKey = (unsigned char *)key; pKey < pEnd; pKey++) {
-        nHash += (nHash << 5) + (*pKey);
+        nHash ^= *pKey;
+        nHash *= 1099511628211ULL;
       }
       return nHash;
     }
 
-    inline UrlMapEntry *find(const unsigned int index, const char *url, const int url_len)
-    {
-      UrlMapEntry *urls = _urlTable._buckets[index]._urls;
-      int count = _urlTable._counts[index];
-
-      for (int i=0; i<count; i++) {
-        if (urls[i].equals(url, url_len)) {
-          return urls  + i;
-        }
-      }
-      return NULL;
-    }
+    ThreadSummary *getThreadSummary();
+    void resetSummary(Summary *summary);
 
   private:
-    // Hide the constructor and copy constructor
+    // Hide the copy constructor
     HotUrlMap(const HotUrlMap & x) { NOWARN_UNUSED(x); }
 
-    UrlHashTable _urlTable;
-    PriorityQueue _urlQueue;
+    volatile int _capacity;
+    uint32_t _maxCount;
+    int _threadOffset;          //per EThread ThreadSummary pointer
+    ThreadSummary *_threads;    //all the thread summaries
+    ThreadSummary _shared;      //for the non EThread callers
+    ink_mutex _mutex;
+    Summary _merged;
+    UrlMapEntry **_sorted;
+    int _sortedSize;
 };
 
 #endif
-
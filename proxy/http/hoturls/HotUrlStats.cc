@@ -14,7 +14,6 @@ HotUrlStats::HotUrlStats()
   _current_send_bps(0),
   _current_qps(0.00)
 {
-  _currentHotUrlMap = _hotUrlMaps;
 }
 
 void HotUrlStats::doCalcSendBps()
@@ -123,31 +122,21 @@ void HotUrlStats::doCalcHotUrls()
   double current_qps  = _current_qps;
   if (current_send_bytes == 0 || current_qps < 0.0001) {
     HotUrlManager::clear();
+    _hotUrlMap.clear();
     last_calc_time = current_time;
     return;
   }
 
-  HotUrlMap *OldUrlMap;
-  HotUrlMap *newUrlMap;
-  OldUrlMap = _currentHotUrlMap;
-  if (_currentHotUrlMap == _hotUrlMaps) {
-    newUrlMap = _hotUrlMaps + 1;
-  }
-  else {
-    newUrlMap = _hotUrlMaps;
-  }
-  newUrlMap->clear();
-  _currentHotUrlMap = newUrlMap;
+  const HotUrlMap::UrlMapEntry *hotUrls = _hotUrlMap.collect();
   last_calc_time = current_time;
 
-  HotUrlMap::PriorityQueue *urlQueue = OldUrlMap->getUrlQueue();
   const HotUrlMap::UrlMapEntry *head;
   const HotUrlMap::UrlMapEntry *lastMatchEntry = NULL;
   bool matched;
   int i;
 
   i = 0;
-  head = urlQueue->head();
+  head = hotUrls;
   while (head != NULL) {
     matched = false;
     if (_config.detect_type & HOT_URLS_DETECT_TYPE_BYTES) {
@@ -157,7 +146,7 @@ void HotUrlStats::doCalcHotUrls()
         lastMatchEntry = head;
         matched = true;
         Debug(HOT_URLS_DEBUG_TAG, "single %d. %.*s, bytes=%"PRId64", "
-            "ratio=%.2f, qps=%.2f", i + 1, head->_url.length, head->_url.url,
+            "ratio=%.2f, qps=%.2f", i + 1, head->_url_len, head->_url,
             head->_bytes, ((double)head->_bytes / delta_time) /
             (double)current_send_bytes, (double)head->_count / delta_time);
       }
@@ -167,7 +156,7 @@ void HotUrlStats::doCalcHotUrls()
         lastMatchEntry = head;
         matched = true;
         Debug(HOT_URLS_DEBUG_TAG, "single %d. %.*s, count=%d, "
-            "ratio=%.2f, qps=%.2f", i + 1, head->_url.length, head->_url.url,
+            "ratio=%.2f, qps=%.2f", i + 1, head->_url_len, head->_url,
             head->_count, ((double)head->_count / delta_time) / current_qps,
             (double)head->_count / delta_time);
       }
@@ -185,7 +174,7 @@ void HotUrlStats::doCalcHotUrls()
     int64_t bytes_sum = 0;
     int64_t count_sum = 0;
     i = 0;
-    head = urlQueue->head();
+    head = hotUrls;
     while (head != NULL) {
       if (_config.detect_type & HOT_URLS_DETECT_TYPE_BYTES) {
         bytes_sum += head->_bytes;
@@ -193,7 +182,7 @@ void HotUrlStats::doCalcHotUrls()
             _config.multi_url_select_ratio) {
           lastMatchEntry = head;
           Debug(HOT_URLS_DEBUG_TAG, "multi %d. %.*s: %"PRId64"", i + 1,
-              head->_url.length, head->_url.url, head->_bytes);
+              head->_url_len, head->_url, head->_bytes);
           break;
         }
       }
@@ -202,7 +191,7 @@ void HotUrlStats::doCalcHotUrls()
         if ((double)count_sum / delta_time / current_qps >= _config.multi_url_select_ratio) {
           lastMatchEntry = head;
           Debug(HOT_URLS_DEBUG_TAG, "multi %d. %.*s: %d", i + 1,
-              head->_url.length, head->_url.url, head->_count);
+              head->_url_len, head->_url, head->_count);
           break;
         }
       }
@@ -216,7 +205,7 @@ void HotUrlStats::doCalcHotUrls()
     HotUrlManager::clear();
   }
   else {
-    HotUrlManager::replace(urlQueue->head(), lastMatchEntry);
+    HotUrlManager::replace(hotUrls, lastMatchEntry);
   }
 }
 
@@ -228,6 +217,7 @@ void HotUrlStats::setDetect(const bool detect)
       Debug(HOT_URLS_DEBUG_TAG, "disable hot url detect.");
     }
     else {
+      _hotUrlMap.clear();
       Debug(HOT_URLS_DEBUG_TAG, "enable hot url detect.");
     }
     _detect = detect;
@@ -236,9 +226,7 @@ void HotUrlStats::setDetect(const bool detect)
 
 void HotUrlStats::setMaxCount(const uint32_t maxCount)
 {
-  for (int i=0; i<2; i++) {
-    _hotUrlMaps[i].getUrlQueue()->setMaxCount(maxCount);
-  }
+  _hotUrlMap.setMaxCount(maxCount);
 
   int oldMaxCount = _config.max_count;
   _config.max_count = maxCount;
@@ -54,7 +54,7 @@ class HotUrlStats {
         ink_atomic_increment64(&instance->_total_send_bytes, bytes);
         ink_atomic_increment64(&instance->_total_query_count, 1);
         if (instance->_detect) {
-          instance->_currentHotUrlMap->incrementBytes(url, url_len, bytes);
+          instance->_hotUrlMap.incrementBytes(url, url_len, bytes);
         }
       }
     }
@@ -104,8 +104,7 @@ class HotUrlStats {
     volatile int64_t _current_send_bps;
     volatile double _current_qps;
     HotUrlConfig _config;
-    HotUrlMap _hotUrlMaps[2];
-    HotUrlMap *_currentHotUrlMap;
+    HotUrlMap _hotUrlMap;
 };
 
 #endif
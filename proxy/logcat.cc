@@ -44,6 +44,7 @@
 #include "LogObject.h"
 #include "LogConfig.h"
 #include "LogBuffer.h"
+#include "LogColumnar.h"
 #include "LogUtils.h"
 #include "LogSock.h"
 #include "Log.h"
@@ -177,6 +178,17 @@ process_file(int in_fd, int out_fd)
     if (elf2_flag)
       alt_format = (char *) LogFormat::extended2_format;
 
+    // columnar segments are expanded back into a regular LogBuffer
+    //
+    if (LogColumnar::is_columnar(header)) {
+      static char row_buffer[MAX_LOGBUFFER_SIZE];
+
+      if (LogColumnar::decode(header, row_buffer, sizeof(row_buffer)) < 0) {
+        fprintf(stderr, "Bad columnar LogBuffer!\n");
+        return 1;
+      }
+      header = (LogBufferHeader *) row_buffer;
+    }
     // convert the buffer to ascii entries and place onto stdout
     //
     if (header->fmt_fieldlist()) {
@@ -1388,7 +1388,7 @@ Log::flush_thread_main(void *args)
       bytes_written = 0;
       logfile = fdata->m_logfile;
 
-      if (logfile->m_file_format == BINARY_LOG) {
+      if (logfile->m_file_format == BINARY_LOG && fdata->m_len < 0) {
 
         logbuffer = (LogBuffer *)fdata->m_data;
         LogBufferHeader *buffer_header = logbuffer->header();
@@ -1396,7 +1396,8 @@ Log::flush_thread_main(void *args)
         buf = (char *)buffer_header;
         total_bytes = buffer_header->byte_count;
 
-      } else if (logfile->m_file_format == ASCII_LOG
+      } else if (logfile->m_file_format == BINARY_LOG
+                 || logfile->m_file_format == ASCII_LOG
                  || logfile->m_file_format == ASCII_PIPE){
 
         buf = (char *)fdata->m_data;
@@ -1645,3 +1646,87 @@ Log::match_logobject(LogBufferHeader * header)
   }
   return obj;
 }
+
+#if TS_HAS_TESTS
+/*-------------------------------------------------------------------------
+  Log::access throughput benchmark
+
+  Drives Log::access() concurrently from the ET_NET threads with a minimal
+  LogAccess and reports the aggregate entries/sec for an increasing number
+  of logging threads.  Only run at the extended regression level since it
+  writes into whatever log objects are configured.
+  -------------------------------------------------------------------------*/
+
+struct LogAccessBench: public LogAccess
+{
+  LogEntryType entry_type() { return LOG_ENTRY_HTTP; }
+};
+
+struct LogAccessBenchCont: public Continuation
+{
+  int nentries;
+  volatile int *ndone;
+
+  LogAccessBenchCont(int n, volatile int *done)
+    : Continuation(new_ProxyMutex()), nentries(n), ndone(done)
+  {
+    SET_HANDLER(&LogAccessBenchCont::mainEvent);
+  }
+
+  int mainEvent(int /* event */, void * /* data */)
+  {
+    LogAccessBench lad;
+
+    for (int i = 0; i < nentries; i++)
+      Log::access(&lad);
+    ink_atomic_increment(ndone, 1);
+    delete this;
+    return EVENT_DONE;
+  }
+};
+
+#define LOG_BENCH_ENTRIES 100000
+
+EXCLUSIVE_REGRESSION_TEST(Log_access_throughput) (RegressionTest * t, int atype, int *pstatus) {
+  if (atype < REGRESSION_TEST_EXTENDED) {
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  EThread *self = this_ethread();
+  EThread *threads[MAX_EVENT_THREADS];
+  int nthreads = 0;
+
+  for (int i = 0; i < eventProcessor.n_threads_for_type[ET_NET]; i++) {
+    if (eventProcessor.eventthread[ET_NET][i] != self)
+      threads[nthreads++] = eventProcessor.eventthread[ET_NET][i];
+  }
+
+  if (nthreads == 0) {
+    rprintf(t, "no ET_NET threads available\n");
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  for (int n = 1; n <= nthreads; n *= 2) {
+    volatile int ndone = 0;
+    ink_hrtime start = ink_get_hrtime();
+
+    for (int i = 0; i < n; i++)
+      threads[i]->schedule_imm(NEW(new LogAccessBenchCont(LOG_BENCH_ENTRIES, &ndone)));
+    while (ndone < n)
+      usleep(1000);
+
+    ink_hrtime elapsed = ink_get_hrtime() - start;
+    double rate = (double) n * LOG_BENCH_ENTRIES / ((double) elapsed / HRTIME_SECOND);
+    char tag[64];
+
+    snprintf(tag, sizeof(tag), "entries_per_sec_%d_threads", n);
+    rprintf(t, "%d threads: %d entries in %" PRId64 " ms (%.0f entries/sec, per_thread_buffers=%d)\n",
+            n, n * LOG_BENCH_ENTRIES, (int64_t) ink_hrtime_to_msec(elapsed), rate, Log::config->per_thread_buffers);
+    rperf(t, tag, rate);
+  }
+
+  *pstatus = REGRESSION_TEST_PASSED;
+}
+#endif /* TS_HAS_TESTS */
@@ -46,6 +46,7 @@
 #include "LogAccess.h"
 #include "LogConfig.h"
 #include "LogBuffer.h"
+#include "LogColumnar.h"
 #include "LogFormatType.h"
 #include "Log.h"
 
@@ -63,6 +64,16 @@ enum
 
 FieldListCacheElement fieldlist_cache[FIELDLIST_CACHE_SIZE];
 int fieldlist_cache_entries = 0;
+
+struct AsciiPlanCacheElement
+{
+  LogAsciiPlan *plan;
+  char *symbol_str;
+  char *printf_str;
+};
+
+AsciiPlanCacheElement ascii_plan_cache[FIELDLIST_CACHE_SIZE];
+int ascii_plan_cache_entries = 0;
 vint32 LogBuffer::M_ID = 0;
 
 /*-------------------------------------------------------------------------
@@ -131,7 +142,7 @@ LogBufferHeader::log_filename()
 LogBuffer::LogBuffer(LogObject * owner, size_t size, size_t buf_align, size_t write_align):
   m_size(size),
   m_buf_align(buf_align),
-  m_write_align(write_align), m_owner(owner),
+  m_write_align(write_align), m_owner(owner), m_first_timestamp(0),
   m_references(0)
 {
   size_t hdr_size;
@@ -162,7 +173,7 @@ LogBuffer::LogBuffer(LogObject * owner, LogBufferHeader * header):
   m_size(0),
   m_buf_align(LB_DEFAULT_ALIGN),
   m_write_align(INK_MIN_ALIGN), m_expiration_time(0), m_owner(owner), m_header(header),
-  m_references(0)
+  m_first_timestamp(0), m_references(0)
 {
   // This constructor does not allocate a buffer because it gets it as
   // an argument. We set m_unaligned_buffer to NULL, which means that
@@ -428,6 +439,39 @@ LogBuffer::update_header_data()
     m_header->byte_count = m_state.s.offset;
     m_header->high_timestamp = LogUtils::timestamp();
   }
+
+  // cache the sort key for compare_first_timestamp(); columnar segments
+  // received from collation clients keep their own layout
+  int64_t ts = 0, usec = 0;
+
+  if (LogColumnar::is_columnar(m_header)) {
+    LogColumnar::first_timestamp(m_header, &ts, &usec);
+  } else if (m_header->entry_count) {
+    LogEntryHeader *e = (LogEntryHeader *) ((char *) m_header + m_header->data_offset);
+    ts = e->timestamp;
+    usec = e->timestamp_usec;
+  }
+  m_first_timestamp = ts * 1000000 + usec;
+}
+
+/*-------------------------------------------------------------------------
+  LogBuffer::compare_first_timestamp
+
+  qsort() comparator for an array of LogBuffer pointers which orders them
+  by the timestamp of their first entry, then by buffer id so that buffers
+  from the same thread keep their relative order. update_header_data()
+  must have been called on each of them.
+  -------------------------------------------------------------------------*/
+int
+LogBuffer::compare_first_timestamp(const void *a, const void *b)
+{
+  LogBuffer *lb[2] = { *(LogBuffer **) a, *(LogBuffer **) b };
+
+  if (lb[0]->m_first_timestamp != lb[1]->m_first_timestamp)
+    return lb[0]->m_first_timestamp < lb[1]->m_first_timestamp ? -1 : 1;
+  if (lb[0]->m_id != lb[1]->m_id)
+    return lb[0]->m_id < lb[1]->m_id ? -1 : 1;
+  return 0;
 }
 
 /*-------------------------------------------------------------------------
@@ -620,6 +664,40 @@ LogBuffer::resolve_custom_entry(LogFieldList * fieldlist,
   return bytes_written;
 }
 
+/*-------------------------------------------------------------------------
+  lookup_fieldlist
+
+  Return the (cached) LogFieldList for the given symbol string, parsing
+  and caching it if we have not seen it before.
+  -------------------------------------------------------------------------*/
+static LogFieldList *
+lookup_fieldlist(char *symbol_str)
+{
+  LogFieldList *fieldlist = NULL;
+
+  for (int i = 0; i < fieldlist_cache_entries; i++) {
+    if (strcmp(symbol_str, fieldlist_cache[i].symbol_str) == 0) {
+      Debug("log-fieldlist", "Fieldlist for %s found in cache, #%d", symbol_str, i);
+      return fieldlist_cache[i].fieldlist;
+    }
+  }
+
+  Debug("log-fieldlist", "Fieldlist for %s not found; creating ...", symbol_str);
+  fieldlist = NEW(new LogFieldList);
+  ink_assert(fieldlist != NULL);
+  bool contains_aggregates = false;
+  LogFormat::parse_symbol_string(symbol_str, fieldlist, &contains_aggregates);
+
+  if (fieldlist_cache_entries < FIELDLIST_CACHE_SIZE) {
+    Debug("log-fieldlist", "Fieldlist cached as entry %d", fieldlist_cache_entries);
+    fieldlist_cache[fieldlist_cache_entries].fieldlist = fieldlist;
+    fieldlist_cache[fieldlist_cache_entries].symbol_str = ats_strdup(symbol_str);
+    fieldlist_cache_entries++;
+  }
+
+  return fieldlist;
+}
+
 /*-------------------------------------------------------------------------
   LogBuffer::to_ascii
 
@@ -661,32 +739,44 @@ LogBuffer::to_ascii(LogEntryHeader * entry, LogFormatType type,
   // these stored plans.
   //
 
-  int i;
-  LogFieldList *fieldlist = NULL;
+  // The usual case is converting with the format the buffer was logged
+  // with; that goes through a compiled plan.  Alternate formats (logcat
+  // -f) are rare enough to keep using the interpreted path.
+  //
+  if (printf_str == NULL)
+    return 0;
 
-  for (i = 0; i < fieldlist_cache_entries; i++) {
-    if (strcmp(symbol_str, fieldlist_cache[i].symbol_str) == 0) {
-      Debug("log-fieldlist", "Fieldlist for %s found in cache, #%d", symbol_str, i);
-      fieldlist = fieldlist_cache[i].fieldlist;
-      break;
+  if (!alt_format) {
+    LogAsciiPlan *plan = NULL;
+
+    for (int i = 0; i < ascii_plan_cache_entries; i++) {
+      if (strcmp(symbol_str, ascii_plan_cache[i].symbol_str) == 0 &&
+          strcmp(printf_str, ascii_plan_cache[i].printf_str) == 0) {
+        plan = ascii_plan_cache[i].plan;
+        break;
+      }
     }
-  }
 
-  if (!fieldlist) {
-    Debug("log-fieldlist", "Fieldlist for %s not found; creating ...", symbol_str);
-    fieldlist = NEW(new LogFieldList);
-    ink_assert(fieldlist != NULL);
-    bool contains_aggregates = false;
-    LogFormat::parse_symbol_string(symbol_str, fieldlist, &contains_aggregates);
+    if (plan) {
+      return plan->format(read_from, write_to, buf_len, entry->timestamp, entry->timestamp_usec, buffer_version);
+    }
 
-    if (fieldlist_cache_entries < FIELDLIST_CACHE_SIZE) {
-      Debug("log-fieldlist", "Fieldlist cached as entry %d", fieldlist_cache_entries);
-      fieldlist_cache[fieldlist_cache_entries].fieldlist = fieldlist;
-      fieldlist_cache[fieldlist_cache_entries].symbol_str = ats_strdup(symbol_str);
-      fieldlist_cache_entries++;
+    plan = NEW(new LogAsciiPlan(lookup_fieldlist(symbol_str), printf_str));
+    int ret = plan->format(read_from, write_to, buf_len, entry->timestamp, entry->timestamp_usec, buffer_version);
+
+    if (ascii_plan_cache_entries < FIELDLIST_CACHE_SIZE) {
+      Debug("log-fieldlist", "Ascii plan for %s cached as entry %d", symbol_str, ascii_plan_cache_entries);
+      ascii_plan_cache[ascii_plan_cache_entries].plan = plan;
+      ascii_plan_cache[ascii_plan_cache_entries].symbol_str = ats_strdup(symbol_str);
+      ascii_plan_cache[ascii_plan_cache_entries].printf_str = ats_strdup(printf_str);
+      ascii_plan_cache_entries++;
+    } else {
+      delete plan;
     }
+    return ret;
   }
 
+  LogFieldList *fieldlist = lookup_fieldlist(symbol_str);
   LogFieldList *alt_fieldlist = NULL;
   char *alt_printf_str = NULL;
   char *alt_symbol_str = NULL;
@@ -733,6 +823,304 @@ LogBuffer::to_ascii(LogEntryHeader * entry, LogFormatType type,
   return ret;
 }
 
+/*-------------------------------------------------------------------------
+  LogAsciiPlan::LogAsciiPlan
+
+  Compile the printf string into a list of operations.  Runs of literal
+  characters become a single OP_LITERAL, and each LOG_FIELD_MARKER becomes
+  the op for the corresponding field in the fieldlist.  A printf string
+  with more markers than fields yields an invalid plan, which formats
+  every entry as an error just like resolve_custom_entry() does.
+  -------------------------------------------------------------------------*/
+
+LogAsciiPlan::LogAsciiPlan(LogFieldList * fieldlist, const char *printf_str)
+  : m_printf_str(NULL), m_ops(NULL), m_n_ops(0), m_max_ops(0), m_valid(false)
+{
+  if (fieldlist == NULL || printf_str == NULL)
+    return;
+
+  m_printf_str = ats_strdup(printf_str);
+  m_max_ops = 2 * fieldlist->count() + 1;
+  m_ops = (Op *)ats_malloc(m_max_ops * sizeof(Op));
+
+  LogField *field = fieldlist->first();
+  const char *p = m_printf_str;
+  const char *literal = p;
+
+  for (; *p; p++) {
+    if (*p != LOG_FIELD_MARKER)
+      continue;
+
+    if (p > literal)
+      add_op(OP_LITERAL, literal, (int)(p - literal));
+    literal = p + 1;
+
+    if (field == NULL) {
+      Note("There are more field markers than fields;" " cannot process log entry");
+      return;
+    }
+    add_op(field_op(field), NULL, 0, field);
+    field = fieldlist->next(field);
+  }
+  if (p > literal)
+    add_op(OP_LITERAL, literal, (int)(p - literal));
+
+  m_valid = true;
+}
+
+LogAsciiPlan::~LogAsciiPlan()
+{
+  ats_free(m_ops);
+  ats_free(m_printf_str);
+}
+
+void
+LogAsciiPlan::add_op(OpType type, const char *literal, int len, LogField * field)
+{
+  ink_assert(m_n_ops < m_max_ops);
+
+  Op *op = &m_ops[m_n_ops++];
+  op->type = type;
+  op->literal = literal;
+  op->len = len;
+  op->field = field;
+}
+
+/*-------------------------------------------------------------------------
+  LogAsciiPlan::field_op
+
+  Pick the specialized op for a field.  Non-aggregate timestamp fields
+  take their value from the entry header; plain integer, IP and string
+  fields are formatted inline; everything else (alias maps, slices,
+  http text, ...) goes through LogField::unmarshal.
+  -------------------------------------------------------------------------*/
+
+LogAsciiPlan::OpType
+LogAsciiPlan::field_op(LogField * field)
+{
+  if (field->aggregate() == LogField::NO_AGGREGATE) {
+    const char *sym = field->symbol();
+
+    if (strcmp(sym, "cqts") == 0)
+      return OP_TS_SEC;
+    if (strcmp(sym, "cqth") == 0)
+      return OP_TS_HEX;
+    if (strcmp(sym, "cqtq") == 0)
+      return OP_TS_SQUID;
+    if (strcmp(sym, "cqtn") == 0)
+      return OP_TS_NETSCAPE;
+    if (strcmp(sym, "cqtd") == 0)
+      return OP_TS_DATE;
+    if (strcmp(sym, "cqtt") == 0)
+      return OP_TS_TIME;
+  }
+
+  if (field->map() != NULL)
+    return OP_FIELD;
+
+  LogField::UnmarshalFunc func = field->unmarshal_func();
+
+  if (func == &LogAccess::unmarshal_int_to_str)
+    return OP_INT;
+  if (func == &LogAccess::unmarshal_int_to_str_hex)
+    return OP_INT_HEX;
+  if (func == &LogAccess::unmarshal_ip_to_str)
+    return OP_IP;
+  if (func == (LogField::UnmarshalFunc)LogAccess::unmarshal_str && !field->m_slice.m_enable)
+    return OP_STR;
+  return OP_FIELD;
+}
+
+/*-------------------------------------------------------------------------
+  Inline formatters used by LogAsciiPlan::format.  Each one returns the
+  number of bytes written, or -1 if the value does not fit in len bytes
+  (one byte is always left free, matching the unmarshal routines).
+  -------------------------------------------------------------------------*/
+
+static inline int
+plan_format_int(int64_t val, char *dest, int len)
+{
+  char val_buf[32];
+  int val_len = LogAccess::unmarshal_itoa(val, val_buf + sizeof(val_buf) - 1);
+
+  if (val_len < len) {
+    memcpy(dest, val_buf + sizeof(val_buf) - val_len, val_len);
+    return val_len;
+  }
+  return -1;
+}
+
+static inline int
+plan_format_hex(int64_t val, char *dest, int len)
+{
+  char val_buf[32];
+  int val_len = LogAccess::unmarshal_itox(val, val_buf + sizeof(val_buf) - 1);
+
+  if (val_len < len) {
+    memcpy(dest, val_buf + sizeof(val_buf) - val_len, val_len);
+    return val_len;
+  }
+  return -1;
+}
+
+static inline int
+plan_format_octet(unsigned v, char *dest)
+{
+  if (v >= 100) {
+    dest[0] = '0' + v / 100;
+    dest[1] = '0' + (v / 10) % 10;
+    dest[2] = '0' + v % 10;
+    return 3;
+  } else if (v >= 10) {
+    dest[0] = '0' + v / 10;
+    dest[1] = '0' + v % 10;
+    return 2;
+  }
+  dest[0] = '0' + v;
+  return 1;
+}
+
+static inline int
+plan_format_ip(char **buf, char *dest, int len)
+{
+  LogFieldIp *raw = reinterpret_cast<LogFieldIp *>(*buf);
+
+  if (AF_INET != raw->_family || len <= INET_ADDRSTRLEN)
+    return LogAccess::unmarshal_ip_to_str(buf, dest, len);
+
+  const uint8_t *octets = reinterpret_cast<const uint8_t *>(&static_cast<LogFieldIp4 *>(raw)->_addr);
+  int n = 0;
+
+  for (int i = 0; i < 4; i++) {
+    if (i)
+      dest[n++] = '.';
+    n += plan_format_octet(octets[i], dest + n);
+  }
+  *buf += INK_ALIGN_DEFAULT(sizeof(LogFieldIp4));
+  return n;
+}
+
+static inline int
+plan_format_cstr(const char *str, char *dest, int len)
+{
+  int n = (int)::strlen(str);
+
+  if (n < len) {
+    memcpy(dest, str, n);
+    return n;
+  }
+  return -1;
+}
+
+/*-------------------------------------------------------------------------
+  LogAsciiPlan::format
+
+  Run the plan against one entry.  Same contract as
+  LogBuffer::resolve_custom_entry(): returns the number of bytes written,
+  or 0 if the entry could not be converted.
+  -------------------------------------------------------------------------*/
+
+int
+LogAsciiPlan::format(char *read_from, char *write_to, int write_to_len,
+                     long timestamp, long timestamp_usec, unsigned buffer_version)
+{
+  if (!m_valid)
+    return 0;
+
+  // for non-aggregate timestamps, space was reserved in the read buffer
+  int ts_skip = (buffer_version > 1) ? INK_MIN_ALIGN : 0;
+  int bytes_written = 0;
+  int res = 0;
+
+  for (int i = 0; i < m_n_ops; i++) {
+    const Op *op = &m_ops[i];
+    char *to = &write_to[bytes_written];
+    int room = write_to_len - bytes_written;
+
+    switch (op->type) {
+    case OP_LITERAL:
+      if (op->len < room) {
+        memcpy(to, op->literal, op->len);
+        res = op->len;
+      } else {
+        res = -1;
+      }
+      break;
+
+    case OP_INT:
+      res = plan_format_int(LogAccess::unmarshal_int(&read_from), to, room);
+      break;
+
+    case OP_INT_HEX:
+      res = plan_format_hex(LogAccess::unmarshal_int(&read_from), to, room);
+      break;
+
+    case OP_STR:
+      {
+        int val_len = (int)::strlen(read_from);
+
+        if (val_len < room) {
+          memcpy(to, read_from, val_len);
+          res = val_len;
+        } else {
+          res = -1;
+        }
+        read_from += LogAccess::strlen(read_from);
+      }
+      break;
+
+    case OP_IP:
+      res = plan_format_ip(&read_from, to, room);
+      break;
+
+    case OP_TS_SEC:
+      res = plan_format_int(timestamp, to, room);
+      read_from += ts_skip;
+      break;
+
+    case OP_TS_HEX:
+      res = plan_format_hex(timestamp, to, room);
+      read_from += ts_skip;
+      break;
+
+    case OP_TS_SQUID:
+      res = squid_timestamp_to_buf(to, room, timestamp, timestamp_usec);
+      if (res < 0)
+        res = -1;
+      read_from += ts_skip;
+      break;
+
+    case OP_TS_NETSCAPE:
+      res = plan_format_cstr(LogUtils::timestamp_to_netscape_str(timestamp), to, room);
+      read_from += ts_skip;
+      break;
+
+    case OP_TS_DATE:
+      res = plan_format_cstr(LogUtils::timestamp_to_date_str(timestamp), to, room);
+      read_from += ts_skip;
+      break;
+
+    case OP_TS_TIME:
+      res = plan_format_cstr(LogUtils::timestamp_to_time_str(timestamp), to, room);
+      read_from += ts_skip;
+      break;
+
+    case OP_FIELD:
+      res = op->field->unmarshal(&read_from, to, room);
+      break;
+    }
+
+    if (res < 0) {
+      Note("Traffic Server is skipping the current log entry because its size "
+           "exceeds the maximum line (entry) size for an ascii log buffer");
+      return 0;
+    }
+    bytes_written += res;
+  }
+
+  return bytes_written;
+}
+
 /*-------------------------------------------------------------------------
   LogBufferList
 
@@ -823,3 +1211,136 @@ LogBufferIterator::next()
 
   return ret_val;
 }
+
+#if TS_HAS_TESTS
+
+// A compiled plan has to print exactly what resolve_custom_entry() prints,
+// including giving up on the same entries when the line does not fit.
+REGRESSION_TEST(LogAsciiPlan_format) (RegressionTest * t, int atype, int *pstatus) {
+  NOWARN_UNUSED(atype);
+
+  static const int n_entries = 12;
+  static const char *urls[] = { "http://a.example.com/index.html", "", "/relative", "-" };
+  int64_t storage[256];
+  char plan_out[1024], resolve_out[1024];
+  int status = REGRESSION_TEST_PASSED;
+
+  // One field for every op kind: header timestamps, ints, hex, strings,
+  // IPs (v4 inline, v6 through the unmarshal fallback) and fields that
+  // keep their unmarshal routine (status codes, sliced strings).
+  LogField cqts("client_req_timestamp_sec", "cqts", LogField::sINT,
+                &LogAccess::marshal_client_req_timestamp_sec, &LogAccess::unmarshal_int_to_str);
+  LogField cqth("client_req_timestamp_hex_sec", "cqth", LogField::sINT,
+                &LogAccess::marshal_client_req_timestamp_sec, &LogAccess::unmarshal_int_to_str_hex);
+  LogField cqtq("client_req_timestamp_squid", "cqtq", LogField::sINT,
+                &LogAccess::marshal_client_req_timestamp_sec, &LogAccess::unmarshal_int_to_str);
+  LogField cqtn("client_req_timestamp_netscape", "cqtn", LogField::sINT,
+                &LogAccess::marshal_client_req_timestamp_sec, &LogAccess::unmarshal_int_to_str);
+  LogField cqtd("client_req_timestamp_date", "cqtd", LogField::sINT,
+                &LogAccess::marshal_client_req_timestamp_sec, &LogAccess::unmarshal_int_to_str);
+  LogField cqtt("client_req_timestamp_time", "cqtt", LogField::sINT,
+                &LogAccess::marshal_client_req_timestamp_sec, &LogAccess::unmarshal_int_to_str);
+  LogField port("client_host_port", "chp", LogField::sINT,
+                &LogAccess::marshal_client_host_port, &LogAccess::unmarshal_int_to_str);
+  LogField hex("client_host_port_hex", "chph", LogField::sINT,
+               &LogAccess::marshal_client_host_port, &LogAccess::unmarshal_int_to_str_hex);
+  LogField url("client_req_url", "cqu", LogField::STRING,
+               &LogAccess::marshal_client_req_url, (LogField::UnmarshalFunc)&LogAccess::unmarshal_str);
+  LogField ip("client_host_ip", "chi", LogField::IP,
+              &LogAccess::marshal_client_host_ip, &LogAccess::unmarshal_ip_to_str);
+  LogField sssc("server_resp_status_code", "sssc", LogField::sINT,
+                &LogAccess::marshal_server_resp_status_code, &LogAccess::unmarshal_http_status);
+  LogField sliced("client_req_url", "cqu", LogField::STRING,
+                  &LogAccess::marshal_client_req_url, (LogField::UnmarshalFunc)&LogAccess::unmarshal_str);
+  LogField *fields[] = { &cqts, &cqth, &cqtq, &cqtn, &cqtd, &cqtt, &port, &hex, &url, &ip, &sssc, &sliced };
+  const int n_fields = sizeof(fields) / sizeof(fields[0]);
+
+  LogFieldList fieldlist;
+  LogField *f;
+  char printf_str[256];
+  int n = 0;
+
+  n += snprintf(printf_str + n, sizeof(printf_str) - n, "[");
+  for (int i = 0; i < n_fields; i++) {
+    fieldlist.add(fields[i]);
+    n += snprintf(printf_str + n, sizeof(printf_str) - n, "%s%c", i ? (i % 3 ? " " : " | ") : "", LOG_FIELD_MARKER);
+  }
+  snprintf(printf_str + n, sizeof(printf_str) - n, "]");
+
+  // the list holds copies, which don't carry the slice over
+  for (f = fieldlist.first(); fieldlist.next(f); f = fieldlist.next(f))
+    ;
+  f->m_slice.m_enable = true;
+  f->m_slice.m_start = 2;
+  f->m_slice.m_end = 9;
+
+  LogAsciiPlan plan(&fieldlist, printf_str);
+  if (!plan.valid()) {
+    rprintf(t, "plan for a valid format is not valid\n");
+    *pstatus = REGRESSION_TEST_FAILED;
+    return;
+  }
+
+  for (int e = 0; e < n_entries; e++) {
+    char *p = (char *) storage;
+    const char *u = urls[e % 4];
+    IpEndpoint addr;
+    long timestamp = 1350000000 + e * 86399;
+    long timestamp_usec = e * 83333;
+
+    memset(storage, 0, sizeof(storage));
+    for (int i = 0; i < 6; i++)
+      p += INK_MIN_ALIGN;       // reserved for the header timestamps
+    LogAccess::marshal_int(p, e * 1013 - 2000);
+    p += INK_MIN_ALIGN;
+    LogAccess::marshal_int(p, e * 65521);
+    p += INK_MIN_ALIGN;
+    LogAccess::marshal_str(p, u, LogAccess::strlen(u));
+    p += LogAccess::strlen(u);
+    if (e % 3)
+      ats_ip4_set(&addr, htonl(0x0a000000 | (e << 8) | (e * 37 % 256)));
+    else
+      ats_ip_pton("2001:db8::1", &addr);
+    p += LogAccess::marshal_ip(p, &addr.sa);
+    LogAccess::marshal_int(p, e * 50);
+    p += INK_MIN_ALIGN;
+    LogAccess::marshal_str(p, u, LogAccess::strlen(u));
+    p += LogAccess::strlen(u);
+
+    // The full line, then every length it gets cut at.
+    int full = LogBuffer::resolve_custom_entry(&fieldlist, printf_str, (char *) storage, resolve_out,
+                                               sizeof(resolve_out), timestamp, timestamp_usec, LOG_SEGMENT_VERSION);
+    if (full <= 0) {
+      rprintf(t, "entry %d did not resolve\n", e);
+      status = REGRESSION_TEST_FAILED;
+      continue;
+    }
+    for (int len = full + 1; len > 0; len--) {
+      int plan_len = plan.format((char *) storage, plan_out, len, timestamp, timestamp_usec, LOG_SEGMENT_VERSION);
+      int resolve_len = LogBuffer::resolve_custom_entry(&fieldlist, printf_str, (char *) storage, resolve_out,
+                                                        len, timestamp, timestamp_usec, LOG_SEGMENT_VERSION);
+
+      if (plan_len != resolve_len || memcmp(plan_out, resolve_out, plan_len) != 0) {
+        rprintf(t, "entry %d in %d bytes: plan wrote %d bytes \"%.*s\", resolve_custom_entry %d bytes \"%.*s\"\n",
+                e, len, plan_len, plan_len, plan_out, resolve_len, resolve_len, resolve_out);
+        status = REGRESSION_TEST_FAILED;
+        break;
+      }
+    }
+  }
+
+  // More markers than fields: both give up on every entry.
+  char extra_str[sizeof(printf_str) + 2];
+  snprintf(extra_str, sizeof(extra_str), "%s%c", printf_str, LOG_FIELD_MARKER);
+  LogAsciiPlan extra(&fieldlist, extra_str);
+  if (extra.valid() || extra.format((char *) storage, plan_out, sizeof(plan_out), 0, 0, LOG_SEGMENT_VERSION) != 0 ||
+      LogBuffer::resolve_custom_entry(&fieldlist, extra_str, (char *) storage, resolve_out, sizeof(resolve_out),
+                                      0, 0, LOG_SEGMENT_VERSION) != 0) {
+    rprintf(t, "a format with more markers than fields was converted\n");
+    status = REGRESSION_TEST_FAILED;
+  }
+
+  *pstatus = status;
+}
+
+#endif
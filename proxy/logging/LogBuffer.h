@@ -36,6 +36,7 @@ class LogBufferIterator;
 
 #define LOG_SEGMENT_COOKIE 0xaceface
 #define LOG_SEGMENT_VERSION 2
+#define LOG_SEGMENT_COLUMNAR_VERSION 3   // see LogColumnar.h
 
 #if defined(linux)
 #define LB_DEFAULT_ALIGN 512
@@ -196,6 +197,7 @@ public:
       LogEntryHeader * entry, LogFormatType type,
       char *buf, int max_len, char *symbol_str, char *printf_str,
       unsigned buffer_version, char *alt_format = NULL);
+  static int compare_first_timestamp(const void *a, const void *b);
   static int resolve_custom_entry(
       LogFieldList * fieldlist,
       char *printf_str, char *read_from, char *write_to,
@@ -231,6 +233,7 @@ private:
   LogBufferHeader *m_header;
 
   uint32_t m_id;                // unique buffer id (for debugging)
+  int64_t m_first_timestamp;    // usecs, see update_header_data
 public:
   volatile LB_State m_state;    // buffer state
   volatile int m_references;    // oustanding checkout_write references.
@@ -248,6 +251,69 @@ private:
   friend class LogBufferIterator;
 };
 
+/*-------------------------------------------------------------------------
+  LogAsciiPlan
+
+  A LogFormat's printf string and field list compiled into a flat list of
+  operations, so converting an entry to ascii does not have to rescan the
+  printf string, compare field symbols, or dispatch through LogField for
+  the common integer, IP, string and timestamp fields.  Plans are built
+  once per (symbol string, printf string) pair and cached by to_ascii().
+  -------------------------------------------------------------------------*/
+
+class LogAsciiPlan
+{
+public:
+  enum OpType
+  {
+    OP_LITERAL = 0,
+    OP_INT,
+    OP_INT_HEX,
+    OP_STR,
+    OP_IP,
+    OP_TS_SEC,
+    OP_TS_HEX,
+    OP_TS_SQUID,
+    OP_TS_NETSCAPE,
+    OP_TS_DATE,
+    OP_TS_TIME,
+    OP_FIELD
+  };
+
+  struct Op
+  {
+    OpType type;
+    int len;                    // literal length
+    const char *literal;        // points into m_printf_str
+    LogField *field;            // for OP_FIELD
+  };
+
+  LogAsciiPlan(LogFieldList * fieldlist, const char *printf_str);
+  ~LogAsciiPlan();
+
+  int format(char *read_from, char *write_to, int write_to_len,
+             long timestamp, long timestamp_usec, unsigned buffer_version);
+  bool valid() const
+  {
+    return m_valid;
+  }
+
+private:
+  void add_op(OpType type, const char *literal = NULL, int len = 0, LogField * field = NULL);
+  static OpType field_op(LogField * field);
+
+  char *m_printf_str;
+  Op *m_ops;
+  int m_n_ops;
+  int m_max_ops;
+  bool m_valid;
+
+  // -- member functions that are not allowed --
+  LogAsciiPlan();
+  LogAsciiPlan(const LogAsciiPlan & rhs);
+  LogAsciiPlan & operator=(const LogAsciiPlan & rhs);
+};
+
 class LogFile;
 
 /*-------------------------------------------------------------------------
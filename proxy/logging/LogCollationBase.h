@@ -37,6 +37,32 @@ protected:
     int msg_bytes;              // length of the following message
   };
 
+  // Capabilities.  A client appends its capability bits (a uint32_t)
+  // to the secret in the auth message, after the secret's terminating
+  // NUL; hosts that predate them compare the secret only and ignore the
+  // rest.  A host that understands them answers with a LOG_COLL_ACK_AUTH
+  // carrying the capabilities both sides share.
+  enum LogCollCapability
+  {
+    LOG_COLL_CAP_ACK = 1,       // host acks each buffer it receives
+    LOG_COLL_CAP_COLUMNAR = 2,  // host accepts columnar segments
+    LOG_COLL_CAP_ZLIB = 4       // ... with zlib compressed columns
+  };
+
+  // Messages from the host back to the client, each preceded by a
+  // NetMsgHeader.
+  enum LogCollAckType
+  {
+    LOG_COLL_ACK_AUTH = 1,      // value: shared capabilities
+    LOG_COLL_ACK_BUFFERS        // value: # of buffers received, in order
+  };
+
+  struct NetMsgAck
+  {
+    uint32_t type;              // LogCollAckType
+    uint32_t value;
+  };
+
   enum LogCollEvent
   {
     LOG_COLL_EVENT_NULL = LOG_COLLATION_EVENT_EVENTS_START,
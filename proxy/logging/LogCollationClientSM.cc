@@ -45,6 +45,7 @@
 #include "LogHost.h"
 #include "LogObject.h"
 #include "LogConfig.h"
+#include "LogColumnar.h"
 #include "Log.h"
 
 #include "LogCollationClientSM.h"
@@ -71,8 +72,10 @@ LogCollationClientSM::LogCollationClientSM(LogHost * log_host):
   m_pending_event(NULL),
   m_abort_vio(NULL),
   m_abort_buffer(NULL),
+  m_abort_reader(NULL),
   m_host_is_up(false),
-  m_buffer_send_list(NULL), m_buffer_in_iocore(NULL), m_flow(LOG_COLL_FLOW_ALLOW), m_log_host(log_host), m_id(ID++)
+  m_buffer_send_list(NULL), m_buffer_inflight_list(NULL), m_flow(LOG_COLL_FLOW_ALLOW),
+  m_host_caps(0), m_acks_to_skip(0), m_log_host(log_host), m_id(ID++)
 {
   Debug("log-coll", "[%d]client::constructor", m_id);
 
@@ -82,6 +85,8 @@ LogCollationClientSM::LogCollationClientSM(LogHost * log_host):
   // we can accept logs to send before we're fully initialized
   m_buffer_send_list = NEW(new LogBufferList());
   ink_assert(m_buffer_send_list != NULL);
+  m_buffer_inflight_list = NEW(new LogBufferList());
+  ink_assert(m_buffer_inflight_list != NULL);
 
   SET_HANDLER((LogCollationClientSMHandler) & LogCollationClientSM::client_handler);
   client_init(LOG_COLL_EVENT_SWITCH, NULL);
@@ -116,6 +121,12 @@ LogCollationClientSM::~LogCollationClientSM()
 int
 LogCollationClientSM::client_handler(int event, void *data)
 {
+  // acks from the host can arrive in any state
+  if (m_abort_vio != NULL && data == m_abort_vio &&
+      (event == VC_EVENT_READ_READY || event == VC_EVENT_READ_COMPLETE)) {
+    return client_read_acks(event);
+  }
+
   switch (m_client_state) {
   case LOG_COLL_CLIENT_AUTH:
     return client_auth(event, (VIO *) data);
@@ -235,14 +246,26 @@ LogCollationClientSM::client_auth(int event, VIO * vio)
       Debug("log-coll", "[%d]client::client_auth - SWITCH", m_id);
       m_client_state = LOG_COLL_CLIENT_AUTH;
 
+      // the secret, its NUL and then our capabilities (see
+      // LogCollationBase.h); older hosts only look at the secret
       NetMsgHeader nmh;
-      int bytes_to_send = (int) strlen(Log::config->collation_secret);
+      uint32_t caps = LOG_COLL_CAP_ACK;
+      int secret_bytes = (int) strlen(Log::config->collation_secret) + 1;
+      int bytes_to_send = secret_bytes + (int) sizeof(caps);
       nmh.msg_bytes = bytes_to_send;
 
+      if (Log::config->collation_compress) {
+        caps |= LOG_COLL_CAP_COLUMNAR;
+#if TS_HAS_LIBZ
+        caps |= LOG_COLL_CAP_ZLIB;
+#endif
+      }
+
       // memory copies, I know...  but it happens rarely!!!  ^_^
       ink_assert(m_auth_buffer != NULL);
       m_auth_buffer->write((char *) &nmh, sizeof(NetMsgHeader));
-      m_auth_buffer->write(Log::config->collation_secret, bytes_to_send);
+      m_auth_buffer->write(Log::config->collation_secret, secret_bytes);
+      m_auth_buffer->write((char *) &caps, sizeof(caps));
       bytes_to_send += sizeof(NetMsgHeader);
 
       Debug("log-coll", "[%d]client::client_auth - do_io_write(%d)", m_id, bytes_to_send);
@@ -349,6 +372,7 @@ LogCollationClientSM::client_done(int event, void *data)
       // do I need to delete this???
       m_host_vc->do_io_close(0);
       m_host_vc = 0;
+      m_abort_vio = NULL;
     }
 #ifndef TS_MICRO
     // flush unsent logs to orphan
@@ -376,11 +400,17 @@ LogCollationClientSM::client_done(int event, void *data)
       free_MIOBuffer(m_send_buffer);
     }
     if (m_abort_buffer) {
+      if (m_abort_reader) {
+        m_abort_buffer->dealloc_reader(m_abort_reader);
+      }
       free_MIOBuffer(m_abort_buffer);
     }
     if (m_buffer_send_list) {
       delete m_buffer_send_list;
     }
+    if (m_buffer_inflight_list) {
+      delete m_buffer_inflight_list;
+    }
 
     return EVENT_DONE;
 
@@ -425,9 +455,10 @@ LogCollationClientSM::client_fail(int event, void *data)
     if (m_host_vc) {
       m_host_vc->do_io_close(0);
       m_host_vc = 0;
+      m_abort_vio = NULL;
     }
-    // flush unsent logs to orphan
-    flush_to_orphan();
+    // hand unacked and unsent logs to the failover hosts, or orphan
+    flush_to_orphan(true);
 
     // call back in collation_retry_sec seconds
     ink_assert(m_pending_event == NULL);
@@ -510,6 +541,8 @@ LogCollationClientSM::client_init(int event, void *data)
     ink_assert(m_send_reader != NULL);
     m_abort_buffer = new_MIOBuffer();
     ink_assert(m_abort_buffer != NULL);
+    m_abort_reader = m_abort_buffer->alloc_reader();
+    ink_assert(m_abort_reader != NULL);
 
     // if we don't have an ip already, switch to client_dns
     if (! m_log_host->ip_addr().isValid()) {
@@ -580,9 +613,13 @@ LogCollationClientSM::client_open(int event, NetVConnection * net_vc)
     ink_assert(net_vc != NULL);
     m_host_vc = net_vc;
 
-    // setup a client reader just for detecting a host disconnnect
-    // (iocore should call back this function with and EOS/ERROR)
-    m_abort_vio = m_host_vc->do_io_read(this, 1, m_abort_buffer);
+    // setup a client reader for detecting a host disconnnect (iocore
+    // should call back this function with and EOS/ERROR), which also
+    // carries the host's acks, if it sends any
+    m_host_caps = 0;
+    m_acks_to_skip = 0;
+    m_abort_reader->consume(m_abort_reader->read_avail());
+    m_abort_vio = m_host_vc->do_io_read(this, INT64_MAX, m_abort_buffer);
 
     // change states
     return client_auth(LOG_COLL_EVENT_SWITCH, NULL);
@@ -625,14 +662,29 @@ LogCollationClientSM::client_send(int event, VIO * vio)
       Debug("log-coll", "[%d]client::client_send - SWITCH", m_id);
       m_client_state = LOG_COLL_CLIENT_SEND;
 
-      // get a buffer off our queue
+      // batch buffers off our queue into a single write, as many as the
+      // inflight window allows.  When the host acks, the window also
+      // holds the buffers written earlier that it has not acked yet.
       ink_assert(m_buffer_send_list != NULL);
-      ink_assert(m_buffer_in_iocore == NULL);
-      if ((m_buffer_in_iocore = m_buffer_send_list->get()) == NULL) {
+      ink_assert(m_buffer_inflight_list != NULL);
+      int window = max(Log::config->collation_max_inflight_buffers, 1);
+      int64_t bytes_to_send = 0;
+      LogBuffer *log_buffer;
+
+      while (m_buffer_inflight_list->get_size() < window && (log_buffer = m_buffer_send_list->get()) != NULL) {
+#if defined(LOG_BUFFER_TRACKING)
+        Debug("log-buftrak", "[%d]client::client_send - network write begin", log_buffer->header()->id);
+#endif // defined(LOG_BUFFER_TRACKING)
+        bytes_to_send += write_to_send_buffer(log_buffer);
+        m_buffer_inflight_list->add(log_buffer);
+      }
+
+      if (bytes_to_send == 0) {
         return client_idle(LOG_COLL_EVENT_SWITCH, NULL);
       }
-      Debug("log-coll", "[%d]client::client_send - send_list to m_buffer_in_iocore", m_id);
-      Debug("log-coll", "[%d]client::client_send - send_list_size(%d)", m_id, m_buffer_send_list->get_size());
+      Debug("log-coll", "[%d]client::client_send - send_list to inflight_list", m_id);
+      Debug("log-coll", "[%d]client::client_send - send_list_size(%d), inflight_list_size(%d)", m_id,
+            m_buffer_send_list->get_size(), m_buffer_inflight_list->get_size());
 
       // enable m_flow if we're out of work to do
       if (m_flow == LOG_COLL_FLOW_DENY && m_buffer_send_list->get_size() == 0) {
@@ -641,39 +693,9 @@ LogCollationClientSM::client_send(int event, VIO * vio)
              m_log_host->ip_addr().toString(ipb, sizeof ipb), m_log_host->port());
         m_flow = LOG_COLL_FLOW_ALLOW;
       }
-      // future work:
-      // Wrap the buffer in a io_buffer_block and send directly to
-      // do_io_write to save a memory copy.  But for now, just
-      // write the lame way.
-
-#if defined(LOG_BUFFER_TRACKING)
-      Debug("log-buftrak", "[%d]client::client_send - network write begin", m_buffer_in_iocore->header()->id);
-#endif // defined(LOG_BUFFER_TRACKING)
-
-      // prepare to send data
-      ink_assert(m_buffer_in_iocore != NULL);
-      LogBufferHeader *log_buffer_header = m_buffer_in_iocore->header();
-      ink_assert(log_buffer_header != NULL);
-      NetMsgHeader nmh;
-      int bytes_to_send = log_buffer_header->byte_count;
-      nmh.msg_bytes = bytes_to_send;
-      // TODO: We currently don't try to make the log buffers handle little vs big endian. TS-1156.
-      //m_buffer_in_iocore->convert_to_network_order();
-
-      RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_sent_to_network_stat,
-                     log_buffer_header->entry_count);
-
-      RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_sent_to_network_stat,
-                     log_buffer_header->byte_count);
-
-      // copy into m_send_buffer
-      ink_assert(m_send_buffer != NULL);
-      m_send_buffer->write((char *) &nmh, sizeof(NetMsgHeader));
-      m_send_buffer->write((char *) log_buffer_header, bytes_to_send);
-      bytes_to_send += sizeof(NetMsgHeader);
 
       // send m_send_buffer to iocore
-      Debug("log-coll", "[%d]client::client_send - do_io_write(%d)", m_id, bytes_to_send);
+      Debug("log-coll", "[%d]client::client_send - do_io_write(%" PRId64 ")", m_id, bytes_to_send);
       ink_assert(m_host_vc != NULL);
       m_host_vio = m_host_vc->do_io_write(this, bytes_to_send, m_send_reader);
       ink_assert(m_host_vio != NULL);
@@ -687,15 +709,21 @@ LogCollationClientSM::client_send(int event, VIO * vio)
   case VC_EVENT_WRITE_COMPLETE:
     Debug("log-coll", "[%d]client::client_send - WRITE_COMPLETE", m_id);
 
-    ink_assert(m_buffer_in_iocore != NULL);
+    // unless the host acks, we're done with the buffers, delete them.
+    // Should the host turn out to ack after all (its auth ack was still
+    // on the way), skip the acks for the buffers deleted here.
+    if (!(m_host_caps & LOG_COLL_CAP_ACK)) {
+      LogBuffer *log_buffer;
+
+      while ((log_buffer = m_buffer_inflight_list->get()) != NULL) {
 #if defined(LOG_BUFFER_TRACKING)
-    Debug("log-buftrak", "[%d]client::client_send - network write complete", m_buffer_in_iocore->header()->id);
+        Debug("log-buftrak", "[%d]client::client_send - network write complete", log_buffer->header()->id);
 #endif // defined(LOG_BUFFER_TRACKING)
-
-    // done with the buffer, delete it
-    Debug("log-coll", "[%d]client::client_send - m_buffer_in_iocore[%p] to delete_list", m_id, m_buffer_in_iocore);
-    LogBuffer::destroy(m_buffer_in_iocore);
-    m_buffer_in_iocore = NULL;
+        Debug("log-coll", "[%d]client::client_send - inflight buffer[%p] to delete_list", m_id, log_buffer);
+        LogBuffer::destroy(log_buffer);
+        m_acks_to_skip++;
+      }
+    }
 
     // switch back to client_send
     return client_send(LOG_COLL_EVENT_SWITCH, NULL);
@@ -729,33 +757,495 @@ LogCollationClientSM::client_send(int event, VIO * vio)
 //-------------------------------------------------------------------------
 //-------------------------------------------------------------------------
 
+//-------------------------------------------------------------------------
+// LogCollationClientSM::client_read_acks
+// next: client_fail || client_send || <unchanged>
+//-------------------------------------------------------------------------
+
+int
+LogCollationClientSM::client_read_acks(int event)
+{
+  ip_port_text_buffer ipb;
+  NOWARN_UNUSED(event);
+  Debug("log-coll", "[%d]client::client_read_acks", m_id);
+
+  NetMsgHeader nmh;
+  NetMsgAck ack;
+  LogBuffer *log_buffer;
+
+  while (m_abort_reader->read_avail() >= (int64_t) (sizeof(nmh) + sizeof(ack))) {
+    m_abort_reader->read((char *) &nmh, sizeof(nmh));
+    if (nmh.msg_bytes != (int) sizeof(ack)) {
+      Note("[log-coll] invalid message from host [%s:%u]",
+           m_log_host->ip_addr().toString(ipb, sizeof ipb), m_log_host->port());
+      return client_fail(LOG_COLL_EVENT_SWITCH, NULL);
+    }
+    m_abort_reader->read((char *) &ack, sizeof(ack));
+
+    switch (ack.type) {
+    case LOG_COLL_ACK_AUTH:
+      Debug("log-coll", "[%d]client::client_read_acks - host capabilities 0x%x", m_id, ack.value);
+      m_host_caps = ack.value;
+      break;
+
+    case LOG_COLL_ACK_BUFFERS:
+      Debug("log-coll", "[%d]client::client_read_acks - %u buffers acked", m_id, ack.value);
+      for (uint32_t i = 0; i < ack.value; i++) {
+        if (m_acks_to_skip > 0) {
+          m_acks_to_skip--;
+        } else if ((log_buffer = m_buffer_inflight_list->get()) != NULL) {
+          LogBuffer::destroy(log_buffer);
+        }
+      }
+      break;
+
+    default:
+      Note("[log-coll] invalid ack type %u from host [%s:%u]", ack.type,
+           m_log_host->ip_addr().toString(ipb, sizeof ipb), m_log_host->port());
+      return client_fail(LOG_COLL_EVENT_SWITCH, NULL);
+    }
+  }
+  m_abort_vio->reenable();
+
+  // acks open up the inflight window
+  if (m_client_state == LOG_COLL_CLIENT_IDLE && m_buffer_send_list->get_size() > 0) {
+    return client_send(LOG_COLL_EVENT_SWITCH, NULL);
+  }
+  return EVENT_CONT;
+}
+
+//-------------------------------------------------------------------------
+// LogCollationClientSM::write_to_send_buffer
+//
+// Queue log_buffer on m_send_buffer, behind its NetMsgHeader, and return
+// the number of bytes queued.  The buffer goes out by reference, so it
+// must not be deleted before the write completes (or the host acks it).
+// Hosts that accept columnar segments get the re-encoded buffer instead,
+// which m_send_buffer frees once written.
+//-------------------------------------------------------------------------
+
+int64_t
+LogCollationClientSM::write_to_send_buffer(LogBuffer * log_buffer)
+{
+  LogBufferHeader *log_buffer_header = log_buffer->header();
+  ink_assert(log_buffer_header != NULL);
+  LogObject *owner = log_buffer->get_owner();
+  IOBufferData *data = NULL;
+  int bytes_to_send = log_buffer_header->byte_count;
+
+  if ((m_host_caps & LOG_COLL_CAP_COLUMNAR) && owner && owner->m_format && !owner->m_format->is_aggregate()) {
+    char *segment = NULL;
+    int segment_len = LogColumnar::encode(log_buffer_header, &owner->m_format->m_field_list,
+                                          (m_host_caps & LOG_COLL_CAP_ZLIB) != 0, &segment);
+
+    if (segment_len > 0) {
+      data = new_xmalloc_IOBufferData(segment, segment_len);
+      bytes_to_send = segment_len;
+    }
+  }
+  if (data == NULL) {
+    data = new_constant_IOBufferData(log_buffer_header, bytes_to_send);
+  }
+  // TODO: We currently don't try to make the log buffers handle little vs big endian. TS-1156.
+  //log_buffer->convert_to_network_order();
+
+  RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_sent_to_network_stat,
+                 log_buffer_header->entry_count);
+
+  RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_sent_to_network_stat,
+                 bytes_to_send);
+
+  NetMsgHeader nmh;
+  nmh.msg_bytes = bytes_to_send;
+  ink_assert(m_send_buffer != NULL);
+  m_send_buffer->write((char *) &nmh, sizeof(NetMsgHeader));
+
+  IOBufferBlock *block = new_IOBufferBlock();
+  block->set(data);
+  block->fill(bytes_to_send);
+  m_send_buffer->append_block(block);
+
+  return bytes_to_send + sizeof(NetMsgHeader);
+}
+
 #ifndef TS_MICRO
 //-------------------------------------------------------------------------
 // LogCollationClientSM::flush_to_orphan
+//
+// With failover, a host that went away has its buffers retransmitted to
+// the next host of its failover chain that takes them, as LogHostList
+// does for new buffers; only the ones no host takes go to orphan.
 //-------------------------------------------------------------------------
 void
-LogCollationClientSM::flush_to_orphan()
+LogCollationClientSM::flush_to_orphan(bool failover)
 {
   Debug("log-coll", "[%d]client::flush_to_orphan", m_id);
 
-  // if in middle of a write, flush buffer_in_iocore to orphan
-  if (m_buffer_in_iocore != NULL) {
-    Debug("log-coll", "[%d]client::flush_to_orphan - m_buffer_in_iocore to oprhan", m_id);
+  // drop what is left of the last write, it refers to the buffers below
+  if (m_send_reader != NULL) {
+    m_send_reader->consume(m_send_reader->read_avail());
+  }
+  // flush buffers being written, or not yet acked, to orphan.  The host
+  // may have received some of them before the connection went away.
+  LogBuffer *log_buffer;
+  ink_assert(m_buffer_inflight_list != NULL);
+  while ((log_buffer = m_buffer_inflight_list->get()) != NULL) {
+    Debug("log-coll", "[%d]client::flush_to_orphan - inflight_list to orphan", m_id);
     // TODO: We currently don't try to make the log buffers handle little vs big endian. TS-1156.
-    // m_buffer_in_iocore->convert_to_host_order();
-    m_log_host->orphan_write_and_try_delete(m_buffer_in_iocore);
-    m_buffer_in_iocore = NULL;
+    // log_buffer->convert_to_host_order();
+    orphan_write_and_try_delete(log_buffer, failover);
   }
   // flush buffers in send_list to orphan
-  LogBuffer *log_buffer;
   ink_assert(m_buffer_send_list != NULL);
   while ((log_buffer = m_buffer_send_list->get()) != NULL) {
     Debug("log-coll", "[%d]client::flush_to_orphan - send_list to orphan", m_id);
-    m_log_host->orphan_write_and_try_delete(log_buffer);
+    orphan_write_and_try_delete(log_buffer, failover);
   }
 
   // Now send_list is empty, let's update m_flow to ALOW status
   Debug("log-coll", "[%d]client::client_send - m_flow = ALLOW", m_id);
   m_flow = LOG_COLL_FLOW_ALLOW;
 }
+
+//-------------------------------------------------------------------------
+// LogCollationClientSM::orphan_write_and_try_delete
+//-------------------------------------------------------------------------
+void
+LogCollationClientSM::orphan_write_and_try_delete(LogBuffer * log_buffer, bool failover)
+{
+  if (failover) {
+    for (LogHost *lh = m_log_host->failover_link.next; lh; lh = lh->failover_link.next) {
+      // the failover host takes a reference of its own, or drops it
+      ink_atomic_increment(&log_buffer->m_references, 1);
+      if (lh->preproc_and_try_delete(log_buffer) == 0) {
+        Debug("log-coll", "[%d]client::orphan_write_and_try_delete - retransmit to %s:%u", m_id, lh->name(), lh->port());
+        LogBuffer::destroy(log_buffer);
+        return;
+      }
+    }
+  }
+  m_log_host->orphan_write_and_try_delete(log_buffer);
+}
 #endif // TS_MICRO
+
+#if TS_HAS_TESTS
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+//-------------------------------------------------------------------------
+// A collation host on a loopback socket: it answers the auth message
+// with LOG_COLL_CAP_ACK, notes the low_timestamp the test stamps on each
+// buffer it receives, and acks them when told to.
+//-------------------------------------------------------------------------
+
+#define COLL_TEST_MAX_BUFFERS           16
+
+struct LogCollationTestHost: public LogCollationBase
+{
+  int listen_fd;
+  int fd;
+  in_port_t port;
+  bool authed;
+  bool auto_ack;
+  bool error;
+  int received;
+  uint32_t seq[COLL_TEST_MAX_BUFFERS];
+  int len;
+  char buf[65536];
+
+  LogCollationTestHost()
+    : listen_fd(-1), fd(-1), port(0), authed(false), auto_ack(true), error(false), received(0), len(0)
+  { }
+
+  ~LogCollationTestHost()
+  {
+    disconnect();
+    if (listen_fd >= 0)
+      ::close(listen_fd);
+  }
+
+  bool listen()
+  {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((listen_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+        bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || ::listen(listen_fd, 4) < 0 ||
+        getsockname(listen_fd, (struct sockaddr *) &addr, &addr_len) < 0)
+      return false;
+    fcntl(listen_fd, F_SETFL, O_NONBLOCK);
+    port = ntohs(addr.sin_port);
+    return true;
+  }
+
+  void ack(uint32_t type, uint32_t value)
+  {
+    NetMsgHeader nmh;
+    NetMsgAck a;
+    char msg[sizeof(nmh) + sizeof(a)];
+
+    nmh.msg_bytes = sizeof(a);
+    a.type = type;
+    a.value = value;
+    memcpy(msg, &nmh, sizeof(nmh));
+    memcpy(msg + sizeof(nmh), &a, sizeof(a));
+    if (write(fd, msg, sizeof(msg)) != (ssize_t) sizeof(msg))
+      error = true;
+  }
+
+  void ack_buffers(uint32_t n)
+  {
+    ack(LOG_COLL_ACK_BUFFERS, n);
+  }
+
+  // accept, read and answer whatever the client sent so far
+  void poll()
+  {
+    if (fd < 0) {
+      if ((fd = accept(listen_fd, NULL, NULL)) < 0)
+        return;
+      fcntl(fd, F_SETFL, O_NONBLOCK);
+    }
+
+    ssize_t n;
+    while (len < (int) sizeof(buf) && (n = read(fd, buf + len, sizeof(buf) - len)) > 0)
+      len += n;
+
+    NetMsgHeader nmh;
+    while (len >= (int) sizeof(nmh)) {
+      memcpy(&nmh, buf, sizeof(nmh));
+      if (len < (int) sizeof(nmh) + nmh.msg_bytes)
+        break;
+
+      char *msg = buf + sizeof(nmh);
+      if (!authed) {
+        uint32_t caps = 0;
+        int secret_bytes = (int) strnlen(msg, nmh.msg_bytes) + 1;
+
+        if (secret_bytes + (int) sizeof(caps) <= nmh.msg_bytes)
+          memcpy(&caps, msg + secret_bytes, sizeof(caps));
+        if (strcmp(msg, Log::config->collation_secret) != 0 || !(caps & LOG_COLL_CAP_ACK))
+          error = true;
+        ack(LOG_COLL_ACK_AUTH, LOG_COLL_CAP_ACK);
+        authed = true;
+      } else {
+        LogBufferHeader header;
+
+        memcpy(&header, msg, sizeof(header));
+        if (received < COLL_TEST_MAX_BUFFERS)
+          seq[received] = header.low_timestamp;
+        received++;
+        if (auto_ack)
+          ack(LOG_COLL_ACK_BUFFERS, 1);
+      }
+      len -= sizeof(nmh) + nmh.msg_bytes;
+      memmove(buf, buf + sizeof(nmh) + nmh.msg_bytes, len);
+    }
+  }
+
+  void disconnect()
+  {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+};
+
+//-------------------------------------------------------------------------
+// Drives a client against two such hosts, the second one the failover of
+// the first, with an inflight window of two buffers:
+//  - the window stalls the client on unacked buffers
+//  - each ack lets exactly one more buffer out
+//  - when the host fails, the unacked and unsent buffers are retransmitted
+//    to the failover host, in order
+//-------------------------------------------------------------------------
+
+#define COLL_TEST_WINDOW                2
+#define COLL_TEST_BUFFERS               5
+
+struct LogCollationRegressionContinuation: public Continuation
+{
+  enum State
+  {
+    TEST_AUTH,
+    TEST_SETTLE,
+    TEST_STALL,
+    TEST_ACK,
+    TEST_FAILOVER
+  };
+
+  RegressionTest *test;
+  int *status;
+  State state;
+  int ticks;
+  LogFormat *format;
+  LogObject *object;
+  LogHost *host;
+  LogHost *failover;
+  LogCollationTestHost primary_host;
+  LogCollationTestHost failover_host;
+  int saved_window;
+  int saved_retry_sec;
+  int saved_compress;
+
+  void send(uint32_t seq)
+  {
+    LogBuffer *lb = NEW(new LogBuffer(object, Log::config->log_buffer_size));
+
+    lb->header()->entry_count = 1;
+    lb->header()->low_timestamp = seq;
+    ink_atomic_increment(&lb->m_references, 1);
+    host->preproc_and_try_delete(lb);
+  }
+
+  void next(State s)
+  {
+    state = s;
+    ticks = 0;
+  }
+
+  int done(Event *e, bool passed, const char *msg)
+  {
+    if (!passed) {
+      rprintf(test, "%s (primary received %d, failover received %d)\n", msg, primary_host.received,
+              failover_host.received);
+    }
+    e->cancel();
+
+    host->failover_link.next = NULL;
+    delete host;
+    delete failover;
+    delete object;
+    delete format;
+    Log::config->collation_max_inflight_buffers = saved_window;
+    Log::config->collation_retry_sec = saved_retry_sec;
+    Log::config->collation_compress = saved_compress;
+
+    *status = passed ? REGRESSION_TEST_PASSED : REGRESSION_TEST_FAILED;
+    delete this;
+    return EVENT_DONE;
+  }
+
+  int mainEvent(int event, Event *e)
+  {
+    NOWARN_UNUSED(event);
+    primary_host.poll();
+    failover_host.poll();
+    if (primary_host.error || failover_host.error)
+      return done(e, false, "protocol error");
+    ++ticks;
+
+    switch (state) {
+    case TEST_AUTH:
+      // the first buffer opened the connection; with it acked, the
+      // client knows the host acks
+      if (primary_host.received < 1) {
+        if (ticks > 500)
+          return done(e, false, "the client did not connect");
+        return EVENT_CONT;
+      }
+      next(TEST_SETTLE);
+      return EVENT_CONT;
+
+    case TEST_SETTLE:
+      if (ticks < 5)
+        return EVENT_CONT;
+      primary_host.auto_ack = false;
+      for (int i = 1; i <= COLL_TEST_BUFFERS; i++)
+        send(i);
+      next(TEST_STALL);
+      return EVENT_CONT;
+
+    case TEST_STALL:
+      if (ticks < 20)
+        return EVENT_CONT;
+      if (primary_host.received != 1 + COLL_TEST_WINDOW)
+        return done(e, false, "the inflight window did not hold the client back");
+      primary_host.ack_buffers(1);
+      next(TEST_ACK);
+      return EVENT_CONT;
+
+    case TEST_ACK:
+      if (ticks < 20)
+        return EVENT_CONT;
+      if (primary_host.received != 2 + COLL_TEST_WINDOW)
+        return done(e, false, "one ack did not let exactly one buffer out");
+      // buffers 2 and 3 are unacked, 4 and 5 not sent yet
+      primary_host.disconnect();
+      next(TEST_FAILOVER);
+      return EVENT_CONT;
+
+    case TEST_FAILOVER:
+      if (failover_host.received < COLL_TEST_BUFFERS - 1) {
+        if (ticks > 500)
+          return done(e, false, "the failover host did not get the buffers");
+        return EVENT_CONT;
+      }
+      if (ticks < 20)
+        return EVENT_CONT;
+      if (failover_host.received != COLL_TEST_BUFFERS - 1)
+        return done(e, false, "the failover host got buffers twice");
+      for (int i = 0; i < COLL_TEST_BUFFERS - 1; i++) {
+        if (failover_host.seq[i] != (uint32_t) i + 2)
+          return done(e, false, "the failover host got the buffers out of order");
+      }
+      return done(e, true, NULL);
+    }
+    return EVENT_CONT;
+  }
+
+  LogCollationRegressionContinuation(RegressionTest *t, int *astatus)
+    : Continuation(new_ProxyMutex()), test(t), status(astatus), state(TEST_AUTH), ticks(0),
+      format(NULL), object(NULL), host(NULL), failover(NULL)
+  {
+    SET_HANDLER(&LogCollationRegressionContinuation::mainEvent);
+  }
+};
+
+REGRESSION_TEST(LogCollation_ack_window) (RegressionTest * t, int atype, int *pstatus) {
+  NOWARN_UNUSED(atype);
+
+  if (!Log::config || !Log::config->collation_secret) {
+    rprintf(t, "logging is not configured\n");
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  LogCollationRegressionContinuation *c = NEW(new LogCollationRegressionContinuation(t, pstatus));
+  char localhost[] = "127.0.0.1";
+  char object_name[] = "regression_collation.log";
+
+  if (!c->primary_host.listen() || !c->failover_host.listen()) {
+    rprintf(t, "cannot listen on the loopback interface\n");
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    delete c;
+    return;
+  }
+
+  // no reconnect to the failed host while the test runs, plain buffers
+  c->saved_window = Log::config->collation_max_inflight_buffers;
+  c->saved_retry_sec = Log::config->collation_retry_sec;
+  c->saved_compress = Log::config->collation_compress;
+  Log::config->collation_max_inflight_buffers = COLL_TEST_WINDOW;
+  Log::config->collation_retry_sec = 3600;
+  Log::config->collation_compress = 0;
+
+  c->format = NEW(new LogFormat(TEXT_LOG));
+  c->object = NEW(new LogObject(c->format, Log::config->logfile_dir, object_name, ASCII_LOG, NULL,
+                                LogConfig::NO_ROLLING, 1));
+  c->host = NEW(new LogHost(object_name, c->object->get_signature()));
+  c->host->set_ipstr_port(localhost, c->primary_host.port);
+  c->failover = NEW(new LogHost(object_name, c->object->get_signature()));
+  c->failover->set_ipstr_port(localhost, c->failover_host.port);
+  c->host->failover_link.next = c->failover;
+
+  // buffer 0 brings the connection up
+  c->send(0);
+  eventProcessor.schedule_every(c, HRTIME_MSECONDS(10));
+}
+#endif
@@ -92,8 +92,13 @@ private:
   int client_send(int event, VIO * vio);
   ClientState m_client_state;
 
+  // host acks, read on the abort vio
+  int client_read_acks(int event);
+
   // support functions
-  void flush_to_orphan();
+  int64_t write_to_send_buffer(LogBuffer * log_buffer);
+  void flush_to_orphan(bool failover = false);
+  void orphan_write_and_try_delete(LogBuffer * log_buffer, bool failover);
 
   // iocore stuff (two buffers to avoid races)
   NetVConnection *m_host_vc;
@@ -108,12 +113,15 @@ private:
   // to detect server closes (there's got to be a better way to do this)
   VIO *m_abort_vio;
   MIOBuffer *m_abort_buffer;
+  IOBufferReader *m_abort_reader;
   bool m_host_is_up;
 
   // send stuff
   LogBufferList *m_buffer_send_list;
-  LogBuffer *m_buffer_in_iocore;
+  LogBufferList *m_buffer_inflight_list;        // written, not yet acked
   ClientFlowControl m_flow;
+  uint32_t m_host_caps;         // LogCollCapability bits shared with host
+  uint32_t m_acks_to_skip;      // acks for buffers freed before m_host_caps
 
   // back pointer to LogHost container
   LogHost *m_log_host;
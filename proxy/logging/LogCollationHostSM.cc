@@ -45,6 +45,7 @@
 #include "LogHost.h"
 #include "LogObject.h"
 #include "LogConfig.h"
+#include "LogColumnar.h"
 #include "Log.h"
 
 #include "LogCollationHostSM.h"
@@ -67,7 +68,9 @@ m_client_vio(NULL),
 m_client_buffer(NULL),
 m_client_reader(NULL),
 m_pending_event(NULL),
-m_read_buffer(NULL), m_read_bytes_wanted(0), m_read_bytes_received(0), m_client_ip(0), m_client_port(0), m_id(ID++)
+m_read_buffer(NULL), m_read_bytes_wanted(0), m_read_bytes_received(0),
+m_ack_buffer(NULL), m_ack_reader(NULL), m_ack_vio(NULL), m_client_caps(0),
+m_client_ip(0), m_client_port(0), m_id(ID++)
 {
 
   Debug("log-coll", "[%d]host::constructor", m_id);
@@ -103,6 +106,10 @@ int
 LogCollationHostSM::host_handler(int event, void *data)
 {
 
+  if (m_ack_vio != NULL && data == m_ack_vio) {
+    return ack_event(event);
+  }
+
   switch (m_host_state) {
   case LOG_COLL_HOST_AUTH:
     return host_auth(event, data);
@@ -127,6 +134,10 @@ int
 LogCollationHostSM::read_handler(int event, void *data)
 {
 
+  if (m_ack_vio != NULL && data == m_ack_vio) {
+    return ack_event(event);
+  }
+
   switch (m_read_state) {
   case LOG_COLL_READ_BODY:
     return read_body(event, (VIO *) data);
@@ -172,10 +183,30 @@ LogCollationHostSM::host_auth(int event, void *data)
       ink_assert(m_read_buffer != NULL);
       int diff = strncmp(m_read_buffer, Log::config->collation_secret,
                          m_read_bytes_received);
+
+      // newer clients follow the secret's NUL with their capabilities
+      uint32_t caps = 0;
+      size_t secret_bytes = strnlen(m_read_buffer, m_read_bytes_received) + 1;
+      if (secret_bytes + sizeof(caps) <= (size_t) m_read_bytes_received) {
+        memcpy(&caps, m_read_buffer + secret_bytes, sizeof(caps));
+      }
       delete[]m_read_buffer;
       m_read_buffer = 0;
       if (!diff) {
         Debug("log-coll", "[%d]host::host_auth - authenticated!", m_id);
+        if (caps & LOG_COLL_CAP_ACK) {
+          m_client_caps = caps & (LOG_COLL_CAP_ACK | LOG_COLL_CAP_COLUMNAR);
+#if TS_HAS_LIBZ
+          m_client_caps |= caps & LOG_COLL_CAP_ZLIB;
+#endif
+          m_ack_buffer = new_MIOBuffer();
+          ink_assert(m_ack_buffer != NULL);
+          m_ack_reader = m_ack_buffer->alloc_reader();
+          ink_assert(m_ack_reader != NULL);
+          m_ack_vio = m_client_vc->do_io_write(this, INT64_MAX, m_ack_reader);
+          ink_assert(m_ack_vio != NULL);
+          send_ack(LOG_COLL_ACK_AUTH, m_client_caps);
+        }
         return host_recv(LOG_COLL_EVENT_SWITCH, NULL);
       } else {
         Debug("log-coll", "[%d]host::host_auth - authenticated failed!", m_id);
@@ -217,6 +248,7 @@ LogCollationHostSM::host_done(int event, void *data)
     Debug("log-coll", "[%d]host::host_done - disconnecting!", m_id);
     m_client_vc->do_io_close();
     m_client_vc = 0;
+    m_ack_vio = NULL;
     Note("[log-coll] client disconnected [%d.%d.%d.%d:%d]",
          ((unsigned char *) (&m_client_ip))[0],
          ((unsigned char *) (&m_client_ip))[1],
@@ -229,6 +261,12 @@ LogCollationHostSM::host_done(int event, void *data)
     }
     free_MIOBuffer(m_client_buffer);
   }
+  if (m_ack_buffer) {
+    if (m_ack_reader) {
+      m_ack_buffer->dealloc_reader(m_ack_reader);
+    }
+    free_MIOBuffer(m_ack_buffer);
+  }
   // delete this state machine and return
   delete this;
   return EVENT_DONE;
@@ -306,10 +344,11 @@ LogCollationHostSM::host_recv(int event, void *data)
       // LogBuffer::convert_to_host_order(log_buffer_header);
 
       version = log_buffer_header->version;
-      if (version != LOG_SEGMENT_VERSION) {
+      if (version != LOG_SEGMENT_VERSION && version != LOG_SEGMENT_COLUMNAR_VERSION) {
         Note("[log-coll] invalid LogBuffer received; invalid version - "
              "buffer = %u, current = %u", version, LOG_SEGMENT_VERSION);
         delete[]m_read_buffer;
+        log_buffer_header = NULL;
 
       } else {
         log_object = Log::match_logobject(log_buffer_header);
@@ -320,6 +359,13 @@ LogCollationHostSM::host_recv(int event, void *data)
         log_format = log_object->m_format;
         Debug("log-coll", "[%d]host::host_recv - using format '%s'", m_id, log_format->name());
 
+        // columnar segments are expanded, unless they can go to disk as is
+        if (version == LOG_SEGMENT_COLUMNAR_VERSION) {
+          log_buffer_header = expand_columnar(log_buffer_header, log_object);
+        }
+      }
+
+      if (log_buffer_header != NULL) {
         // make a new LogBuffer (log_buffer_header plus subsequent
         // buffer already converted to host order) and add it to the
         // object's flush queue
@@ -330,15 +376,18 @@ LogCollationHostSM::host_recv(int event, void *data)
                        log_buffer_header->entry_count);
 
 	RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_received_from_network_stat,
-                       log_buffer_header->byte_count);
+                       m_read_bytes_received);
 
         int idx = log_object->add_to_flush_queue(log_buffer);
         Log::preproc_notify[idx].signal();
-      }
 
 #if defined(LOG_BUFFER_TRACKING)
-      Debug("log-buftrak", "[%d]host::host_recv - network read complete", log_buffer_header->id);
+        Debug("log-buftrak", "[%d]host::host_recv - network read complete", log_buffer_header->id);
 #endif // defined(LOG_BUFFER_TRACKING)
+      }
+
+      // the buffer is ours now, the client can let go of it
+      send_ack(LOG_COLL_ACK_BUFFERS, 1);
 
       // get ready for next read (memory may not be freed!!!)
       m_read_buffer = 0;
@@ -531,3 +580,98 @@ LogCollationHostSM::read_partial(VIO * vio)
 
   m_read_bytes_received += bytes_received_now;
 }
+
+//-------------------------------------------------------------------------
+//-------------------------------------------------------------------------
+//
+// acks
+//
+//-------------------------------------------------------------------------
+//-------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------
+// LogCollationHostSM::ack_event
+//-------------------------------------------------------------------------
+
+int
+LogCollationHostSM::ack_event(int event)
+{
+
+  switch (event) {
+
+  case VC_EVENT_WRITE_READY:
+    Debug("log-coll", "[%d]host::ack_event - WRITE_READY", m_id);
+    return EVENT_CONT;
+
+  default:
+    // the read side sees the disconnect as well, just stop acking
+    Debug("log-coll", "[%d]host::ack_event - %d", m_id, event);
+    m_client_vc->do_io_write(NULL, 0, NULL);
+    m_ack_vio = NULL;
+    return EVENT_CONT;
+
+  }
+
+}
+
+//-------------------------------------------------------------------------
+// LogCollationHostSM::send_ack
+//-------------------------------------------------------------------------
+
+void
+LogCollationHostSM::send_ack(uint32_t type, uint32_t value)
+{
+  if (m_ack_vio == NULL) {
+    return;
+  }
+
+  NetMsgHeader nmh;
+  NetMsgAck ack;
+
+  nmh.msg_bytes = sizeof(NetMsgAck);
+  ack.type = type;
+  ack.value = value;
+
+  ink_assert(m_ack_buffer != NULL);
+  m_ack_buffer->write((char *) &nmh, sizeof(NetMsgHeader));
+  m_ack_buffer->write((char *) &ack, sizeof(NetMsgAck));
+  m_ack_vio->reenable();
+}
+
+//-------------------------------------------------------------------------
+//-------------------------------------------------------------------------
+//
+// support functions
+//
+//-------------------------------------------------------------------------
+//-------------------------------------------------------------------------
+
+//-------------------------------------------------------------------------
+// LogCollationHostSM::expand_columnar
+//
+// A columnar segment headed for a binary log that is written columnar
+// anyway is kept as is; LogFile writes the segments it cannot re-encode
+// unchanged, so it goes to disk without being decoded.  For any other
+// LogObject the segment is expanded back into a row buffer.  Takes over
+// header; returns NULL if the segment is malformed.
+//-------------------------------------------------------------------------
+
+LogBufferHeader *
+LogCollationHostSM::expand_columnar(LogBufferHeader * header, LogObject * log_object)
+{
+  if (Log::config->columnar_binary && log_object->m_logFile &&
+      log_object->m_logFile->get_format() == BINARY_LOG) {
+    return header;
+  }
+
+  int row_bytes = LogColumnar::decoded_size(header);
+  char *row = (row_bytes > 0) ? new char[row_bytes] : NULL;
+
+  if (row == NULL || LogColumnar::decode(header, row, row_bytes) != row_bytes) {
+    Note("[log-coll] invalid columnar LogBuffer received; discarding");
+    delete[]row;
+    row = NULL;
+  }
+  delete[](char *) header;
+  return (LogBufferHeader *) row;
+}
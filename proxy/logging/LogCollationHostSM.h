@@ -36,6 +36,7 @@
 //-------------------------------------------------------------------------
 
 struct LogBufferHeader;
+class LogObject;
 
 //-------------------------------------------------------------------------
 // LogCollationHostSM
@@ -89,6 +90,13 @@ private:
   // helper for read states
   void read_partial(VIO * vio);
 
+  // acks back to the client
+  int ack_event(int event);
+  void send_ack(uint32_t type, uint32_t value);
+
+  // support functions
+  LogBufferHeader *expand_columnar(LogBufferHeader * header, LogObject * log_object);
+
   // iocore stuff
   NetVConnection *m_client_vc;
   VIO *m_client_vio;
@@ -102,6 +110,12 @@ private:
   int64_t m_read_bytes_wanted;
   int64_t m_read_bytes_received;
 
+  // ack stuff, for clients that ask for acks
+  MIOBuffer *m_ack_buffer;
+  IOBufferReader *m_ack_reader;
+  VIO *m_ack_vio;
+  uint32_t m_client_caps;       // LogCollCapability bits shared with client
+
   // client info
   int m_client_ip;
   int m_client_port;
@@ -0,0 +1,980 @@
+/** @file
+
+  Columnar encoding of binary log segments
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+  @section description
+  This file implements LogColumnar, which converts binary LogBuffers to
+  and from the columnar segment format described in LogColumnar.h.
+ */
+
+
+#include "libts.h"
+
+#if TS_HAS_LIBZ
+#include <zlib.h>
+#endif
+
+#include "Error.h"
+#include "LogField.h"
+#include "LogAccess.h"
+#include "LogBuffer.h"
+#include "LogColumnar.h"
+
+#define LOG_COLUMN_MAX_WIDTH 2
+
+/*-------------------------------------------------------------------------
+  Helpers: a growable byte buffer for building columns, and the varint
+  and zigzag encodings used inside them.
+  -------------------------------------------------------------------------*/
+
+struct LogColumnWriter
+{
+  char *buf;
+  uint32_t len;
+  uint32_t size;
+};
+
+static void
+column_reserve(LogColumnWriter * w, uint32_t n)
+{
+  if (w->len + n > w->size) {
+    uint32_t size = w->size ? w->size : 256;
+    while (w->len + n > size)
+      size *= 2;
+    w->buf = (char *)ats_realloc(w->buf, size);
+    w->size = size;
+  }
+}
+
+static inline void
+column_put_varint(LogColumnWriter * w, uint64_t v)
+{
+  column_reserve(w, 10);
+  while (v >= 0x80) {
+    w->buf[w->len++] = (char) (v | 0x80);
+    v >>= 7;
+  }
+  w->buf[w->len++] = (char) v;
+}
+
+static inline void
+column_put_bytes(LogColumnWriter * w, const char *p, uint32_t n)
+{
+  column_reserve(w, n);
+  memcpy(w->buf + w->len, p, n);
+  w->len += n;
+}
+
+static inline bool
+column_get_varint(const char **p, const char *end, uint64_t * v)
+{
+  uint64_t val = 0;
+
+  for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+    uint8_t b = (uint8_t) * (*p)++;
+    val |= (uint64_t) (b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      *v = val;
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline uint64_t
+zigzag_encode(int64_t v)
+{
+  return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+static inline int64_t
+zigzag_decode(uint64_t v)
+{
+  return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+/*-------------------------------------------------------------------------
+  Field classification
+
+  The column type of a field follows from its unmarshal routine, which is
+  what determines how the field was laid out in the buffer.  Fields we
+  don't know the layout of make the buffer unencodable.
+  -------------------------------------------------------------------------*/
+
+static bool
+column_type_for_field(LogField * field, LogColumnType * type, int *width)
+{
+  if (field->aggregate() != LogField::NO_AGGREGATE)
+    return false;
+
+  *width = 1;
+  if (field->map() != NULL) {
+    *type = LOG_COLUMN_INT;
+    return true;
+  }
+
+  LogField::UnmarshalFunc func = field->unmarshal_func();
+
+  if (func == (LogField::UnmarshalFunc)LogAccess::unmarshal_str) {
+    *type = LOG_COLUMN_STR;
+  } else if (func == &LogAccess::unmarshal_ip_to_str || func == &LogAccess::unmarshal_ip_to_hex) {
+    *type = LOG_COLUMN_IP;
+  } else if (func == (LogField::UnmarshalFunc)LogAccess::unmarshal_http_text) {
+    *type = LOG_COLUMN_HTTP_TEXT;
+  } else if (func == &LogAccess::unmarshal_record) {
+    *type = LOG_COLUMN_RECORD;
+  } else if (func == &LogAccess::unmarshal_http_version) {
+    *type = LOG_COLUMN_INT;
+    *width = 2;                 // major, minor
+  } else if (func == &LogAccess::unmarshal_int_to_str || func == &LogAccess::unmarshal_int_to_str_hex ||
+             func == &LogAccess::unmarshal_ttmsf || func == &LogAccess::unmarshal_http_status) {
+    *type = LOG_COLUMN_INT;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Size of a marshaled string at p, including the NUL and padding, or
+// -1 if it is not terminated before end.
+static inline int
+marshaled_str_len(const char *p, const char *end)
+{
+  const char *nul = (const char *)memchr(p, 0, end - p);
+
+  if (nul == NULL)
+    return -1;
+  return LogAccess::round_strlen((int)(nul - p) + 1);
+}
+
+// Size of the value of the given column type at p, or -1.
+static int
+marshaled_len(LogColumnType type, int width, const char *p, const char *end)
+{
+  int len, len2;
+
+  switch (type) {
+  case LOG_COLUMN_INT:
+    len = width * INK_MIN_ALIGN;
+    break;
+  case LOG_COLUMN_STR:
+    len = marshaled_str_len(p, end);
+    break;
+  case LOG_COLUMN_IP:
+    {
+      if (end - p < (int)sizeof(LogFieldIp))
+        return -1;
+      const LogFieldIp *ip = reinterpret_cast<const LogFieldIp *>(p);
+      len = sizeof(LogFieldIp);
+      if (AF_INET == ip->_family)
+        len = sizeof(LogFieldIp4);
+      else if (AF_INET6 == ip->_family)
+        len = sizeof(LogFieldIp6);
+      len = INK_ALIGN_DEFAULT(len);
+    }
+    break;
+  case LOG_COLUMN_HTTP_TEXT:
+    // method, url, then the two http version ints
+    if ((len = marshaled_str_len(p, end)) < 0 || (len2 = marshaled_str_len(p + len, end)) < 0)
+      return -1;
+    len += len2 + 2 * INK_MIN_ALIGN;
+    break;
+  case LOG_COLUMN_RECORD:
+    len = MARSHAL_RECORD_LENGTH;
+    break;
+  default:
+    return -1;
+  }
+
+  return (len >= 0 && len <= end - p) ? len : -1;
+}
+
+/*-------------------------------------------------------------------------
+  LogColumnDict
+
+  Encoder side dictionary: open addressing over (bytes, length), storing
+  pointers into the row buffer being encoded.
+  -------------------------------------------------------------------------*/
+
+struct LogColumnDictSlot
+{
+  const char *ptr;
+  uint32_t len;
+  uint32_t idx;
+};
+
+struct LogColumnDict
+{
+  LogColumnDictSlot *slots;
+  uint32_t mask;
+  uint32_t count;
+
+  void init(uint32_t entries)
+  {
+    uint32_t size = 16;
+    while (size < 2 * entries)
+      size <<= 1;
+    slots = (LogColumnDictSlot *)ats_calloc(size, sizeof(LogColumnDictSlot));
+    mask = size - 1;
+    count = 0;
+  }
+
+  void destroy()
+  {
+    ats_free(slots);
+    slots = NULL;
+  }
+
+  // Return the index of p, adding it (and setting *added) if it is new.
+  uint32_t lookup_or_add(const char *p, uint32_t len, bool *added)
+  {
+    uint32_t hash = 2166136261U;
+
+    for (uint32_t i = 0; i < len; i++) {
+      hash ^= (uint8_t) p[i];
+      hash *= 16777619U;
+    }
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+      LogColumnDictSlot *s = &slots[i];
+      if (s->ptr == NULL) {
+        s->ptr = p;
+        s->len = len;
+        s->idx = count;
+        *added = true;
+        return count++;
+      }
+      if (s->len == len && memcmp(s->ptr, p, len) == 0) {
+        *added = false;
+        return s->idx;
+      }
+    }
+  }
+};
+
+/*-------------------------------------------------------------------------
+  column_assemble
+
+  Lay the header region, the column directory and the (optionally
+  compressed) columns down into one segment.  Gives up if the result is
+  not smaller than the row buffer, which also guarantees that readers
+  sized for row buffers can hold any columnar segment.
+  -------------------------------------------------------------------------*/
+
+static int
+column_assemble(LogBufferHeader * header, LogColumnHeader * col, LogColumnWriter * w, int n_columns,
+                bool compress, char **segment)
+{
+  char **payload = (char **)ats_calloc(n_columns, sizeof(char *));
+  uint32_t total = header->data_offset + sizeof(LogColumnDirectory) + n_columns * sizeof(LogColumnHeader);
+  int ret = -1;
+  int i;
+
+  for (i = 0; i < n_columns; i++) {
+    col[i].compression = LOG_COLUMN_UNCOMPRESSED;
+    col[i].length = col[i].raw_length = w[i].len;
+    payload[i] = w[i].buf;
+
+#if TS_HAS_LIBZ
+    if (compress && w[i].len > 0) {
+      uLongf zlen = compressBound(w[i].len);
+      char *z = (char *)ats_malloc(zlen);
+
+      if (compress2((Bytef *) z, &zlen, (Bytef *) w[i].buf, w[i].len, Z_BEST_SPEED) == Z_OK && zlen < w[i].len) {
+        col[i].compression = LOG_COLUMN_ZLIB;
+        col[i].length = zlen;
+        payload[i] = z;
+      } else {
+        ats_free(z);
+      }
+    }
+#else
+    NOWARN_UNUSED(compress);
+#endif
+
+    total += col[i].length;
+  }
+
+  if (total < header->byte_count) {
+    char *seg = (char *)ats_malloc(total);
+    char *p = seg + header->data_offset;
+    LogBufferHeader *h = (LogBufferHeader *) seg;
+    LogColumnDirectory dir;
+
+    memcpy(seg, header, header->data_offset);
+    h->version = LOG_SEGMENT_COLUMNAR_VERSION;
+    h->byte_count = total;
+
+    dir.n_columns = n_columns;
+    dir.row_bytes = header->byte_count;
+    memcpy(p, &dir, sizeof(dir));
+    p += sizeof(dir);
+    memcpy(p, col, n_columns * sizeof(LogColumnHeader));
+    p += n_columns * sizeof(LogColumnHeader);
+    for (i = 0; i < n_columns; i++) {
+      if (col[i].length)
+        memcpy(p, payload[i], col[i].length);
+      p += col[i].length;
+    }
+    ink_assert(p == seg + total);
+
+    *segment = seg;
+    ret = (int) total;
+  }
+
+  for (i = 0; i < n_columns; i++) {
+    if (payload[i] != w[i].buf)
+      ats_free(payload[i]);
+  }
+  ats_free(payload);
+  return ret;
+}
+
+/*-------------------------------------------------------------------------
+  LogColumnar::encode
+  -------------------------------------------------------------------------*/
+
+int
+LogColumnar::encode(LogBufferHeader * header, LogFieldList * fieldlist, bool compress, char **segment)
+{
+  ink_assert(header != NULL && fieldlist != NULL && segment != NULL);
+
+  if (header->version != LOG_SEGMENT_VERSION || header->entry_count == 0 ||
+      header->format_type == TEXT_LOG || header->data_offset >= header->byte_count)
+    return -1;
+
+  int n_fields = fieldlist->count();
+  int n_columns = n_fields + 1;
+  LogColumnHeader *col = (LogColumnHeader *)ats_calloc(n_columns, sizeof(LogColumnHeader));
+  LogColumnWriter *w = (LogColumnWriter *)ats_calloc(n_columns, sizeof(LogColumnWriter));
+  LogColumnDict *dict = (LogColumnDict *)ats_calloc(n_columns, sizeof(LogColumnDict));
+  int64_t *prev = (int64_t *)ats_calloc(n_columns * LOG_COLUMN_MAX_WIDTH, sizeof(int64_t));
+  int ret = -1;
+  int i;
+
+  col[0].type = LOG_COLUMN_ENTRY;
+  i = 1;
+  for (LogField * f = fieldlist->first(); f; f = fieldlist->next(f), i++) {
+    LogColumnType type;
+    int width;
+
+    if (!column_type_for_field(f, &type, &width)) {
+      Debug("log-columnar", "field %s has no columnar encoding", f->symbol());
+      goto done;
+    }
+    col[i].type = type;
+    col[i].width = width;
+    if (type != LOG_COLUMN_INT)
+      dict[i].init(header->entry_count);
+  }
+
+  {
+    LogBufferIterator iter(header);
+    LogEntryHeader *entry;
+    const char *data_end = (char *) header + header->byte_count;
+
+    while ((entry = iter.next())) {
+      const char *p = (char *) entry + sizeof(LogEntryHeader);
+      const char *end = (char *) entry + entry->entry_len;
+
+      if (entry->entry_len < sizeof(LogEntryHeader) || end > data_end)
+        goto done;
+
+      for (i = 1; i < n_columns; i++) {
+        int len = marshaled_len((LogColumnType) col[i].type, col[i].width, p, end);
+
+        if (len < 0)
+          goto done;
+
+        if (col[i].type == LOG_COLUMN_INT) {
+          for (int j = 0; j < col[i].width; j++) {
+            int64_t val;
+            memcpy(&val, p + j * INK_MIN_ALIGN, sizeof(val));
+            column_put_varint(&w[i], zigzag_encode((int64_t) ((uint64_t) val - (uint64_t) prev[i * LOG_COLUMN_MAX_WIDTH + j])));
+            prev[i * LOG_COLUMN_MAX_WIDTH + j] = val;
+          }
+        } else {
+          bool added;
+          uint32_t idx = dict[i].lookup_or_add(p, len, &added);
+
+          column_put_varint(&w[i], idx);
+          if (added) {
+            column_put_varint(&w[i], len);
+            column_put_bytes(&w[i], p, len);
+          }
+        }
+        p += len;
+      }
+
+      column_put_varint(&w[0], zigzag_encode((int64_t) ((uint64_t) entry->timestamp - (uint64_t) prev[0])));
+      prev[0] = entry->timestamp;
+      column_put_varint(&w[0], (uint32_t) entry->timestamp_usec);
+      column_put_varint(&w[0], (uint64_t) (end - p));
+    }
+  }
+
+  ret = 0;
+
+done:
+  for (i = 0; i < n_columns; i++)
+    dict[i].destroy();
+  ats_free(dict);
+  ats_free(prev);
+
+  if (ret == 0) {
+    ret = column_assemble(header, col, w, n_columns, compress, segment);
+  }
+
+  for (i = 0; i < n_columns; i++)
+    ats_free(w[i].buf);
+  ats_free(w);
+  ats_free(col);
+  return ret;
+}
+
+/*-------------------------------------------------------------------------
+  LogColumnar::decode
+  -------------------------------------------------------------------------*/
+
+struct LogColumnReader
+{
+  const char *p;
+  const char *end;
+  char *inflated;               // owned copy if the column was compressed
+  const char **dict_ptr;
+  uint32_t *dict_len;
+  uint32_t dict_count;
+  int64_t prev[LOG_COLUMN_MAX_WIDTH];
+  bool skip;
+};
+
+// Write the empty value of a column type; returns the bytes written.
+static int
+column_placeholder(LogColumnType type, int width, char *out)
+{
+  int len;
+
+  switch (type) {
+  case LOG_COLUMN_INT:
+    len = width * INK_MIN_ALIGN;
+    memset(out, 0, len);
+    break;
+  case LOG_COLUMN_STR:
+    len = LogAccess::round_strlen(2);
+    memset(out, 0, len);
+    out[0] = '-';
+    break;
+  case LOG_COLUMN_IP:
+    // family 0: unmarshals as an invalid address
+    len = INK_ALIGN_DEFAULT(sizeof(LogFieldIp));
+    memset(out, 0, len);
+    break;
+  case LOG_COLUMN_HTTP_TEXT:
+    len = 2 * LogAccess::round_strlen(2) + 2 * INK_MIN_ALIGN;
+    memset(out, 0, len);
+    out[0] = '-';
+    out[LogAccess::round_strlen(2)] = '-';
+    break;
+  case LOG_COLUMN_RECORD:
+    len = MARSHAL_RECORD_LENGTH;
+    memset(out, 0, len);
+    out[0] = '-';
+    break;
+  default:
+    len = 0;
+    break;
+  }
+  return len;
+}
+
+int
+LogColumnar::decoded_size(LogBufferHeader * header)
+{
+  LogColumnDirectory dir;
+
+  if (!is_columnar(header) || header->data_offset > header->byte_count ||
+      header->byte_count - header->data_offset < sizeof(dir))
+    return -1;
+  memcpy(&dir, (char *)header + header->data_offset, sizeof(dir));
+  if (dir.row_bytes < header->data_offset || dir.row_bytes > INT_MAX)
+    return -1;
+  return (int)dir.row_bytes;
+}
+
+bool
+LogColumnar::first_timestamp(LogBufferHeader * header, int64_t * timestamp, int64_t * usec)
+{
+  LogColumnDirectory dir;
+  LogColumnHeader col;
+  const char *seg = (const char *)header;
+  const char *p;
+  char head[32];                // the first entry's three varints
+  const char *hp = head;
+  const char *hend;
+  uint64_t ts, us;
+
+  if (decoded_size(header) < 0 || header->entry_count == 0 ||
+      header->byte_count - header->data_offset < sizeof(dir) + sizeof(col))
+    return false;
+  p = seg + header->data_offset;
+  memcpy(&dir, p, sizeof(dir));
+  if (dir.n_columns == 0)
+    return false;
+  p += sizeof(dir);
+  memcpy(&col, p, sizeof(col));
+  if (col.type != LOG_COLUMN_ENTRY)
+    return false;
+  // the entry column is the first payload, right after the column headers
+  p += (uint64_t) dir.n_columns * sizeof(LogColumnHeader);
+  if (p > seg + header->byte_count || (uint32_t) (seg + header->byte_count - p) < col.length)
+    return false;
+
+  if (col.compression == LOG_COLUMN_UNCOMPRESSED) {
+    hp = p;
+    hend = p + col.length;
+  } else {
+#if TS_HAS_LIBZ
+    // only inflate as much as the first entry needs
+    z_stream zs;
+
+    memset(&zs, 0, sizeof(zs));
+    if (col.compression != LOG_COLUMN_ZLIB || inflateInit(&zs) != Z_OK)
+      return false;
+    zs.next_in = (Bytef *) p;
+    zs.avail_in = col.length;
+    zs.next_out = (Bytef *) head;
+    zs.avail_out = sizeof(head);
+    inflate(&zs, Z_SYNC_FLUSH);
+    hend = head + (sizeof(head) - zs.avail_out);
+    inflateEnd(&zs);
+#else
+    return false;
+#endif
+  }
+
+  if (!column_get_varint(&hp, hend, &ts) || !column_get_varint(&hp, hend, &us))
+    return false;
+  // the first delta is taken from 0
+  *timestamp = zigzag_decode(ts);
+  *usec = (int64_t) us;
+  return true;
+}
+
+// Largest placeholder column_placeholder() can produce.
+#define LOG_COLUMN_MAX_PLACEHOLDER (MARSHAL_RECORD_LENGTH + 4 * INK_MIN_ALIGN)
+
+int
+LogColumnar::decode(LogBufferHeader * header, char *buf, int buf_len, const bool *skip, int n_skip)
+{
+  ink_assert(header != NULL && buf != NULL);
+
+  if (!is_columnar(header))
+    return -1;
+
+  const char *seg = (const char *)header;
+  const char *seg_end = seg + header->byte_count;
+  const char *p = seg + header->data_offset;
+  LogColumnDirectory dir;
+
+  if (header->data_offset > header->byte_count || (uint32_t) buf_len < header->data_offset ||
+      seg_end - p < (int)sizeof(dir))
+    return -1;
+  memcpy(&dir, p, sizeof(dir));
+  p += sizeof(dir);
+  if (dir.n_columns == 0 || (uint64_t) (seg_end - p) < (uint64_t) dir.n_columns * sizeof(LogColumnHeader))
+    return -1;
+
+  int n_columns = dir.n_columns;
+  LogColumnHeader *col = (LogColumnHeader *)ats_malloc(n_columns * sizeof(LogColumnHeader));
+  LogColumnReader *r = (LogColumnReader *)ats_calloc(n_columns, sizeof(LogColumnReader));
+  int ret = -1;
+  int i;
+
+  memcpy(col, p, n_columns * sizeof(LogColumnHeader));
+  p += n_columns * sizeof(LogColumnHeader);
+
+  // Locate, inflate and set up each column we need.
+  for (i = 0; i < n_columns; i++) {
+    if ((uint32_t) (seg_end - p) < col[i].length)
+      goto done;
+    if (col[i].type == LOG_COLUMN_INT && (col[i].width < 1 || col[i].width > LOG_COLUMN_MAX_WIDTH))
+      goto done;
+    if ((i == 0) != (col[i].type == LOG_COLUMN_ENTRY))
+      goto done;
+
+    r[i].skip = (i > 0 && skip && i - 1 < n_skip && skip[i - 1]);
+    if (!r[i].skip) {
+      if (col[i].compression == LOG_COLUMN_UNCOMPRESSED) {
+        r[i].p = p;
+        r[i].end = p + col[i].length;
+      } else {
+#if TS_HAS_LIBZ
+        uLongf rlen = col[i].raw_length;
+        r[i].inflated = (char *)ats_malloc(rlen ? rlen : 1);
+        if (col[i].compression != LOG_COLUMN_ZLIB ||
+            uncompress((Bytef *) r[i].inflated, &rlen, (const Bytef *)p, col[i].length) != Z_OK ||
+            rlen != col[i].raw_length)
+          goto done;
+        r[i].p = r[i].inflated;
+        r[i].end = r[i].inflated + rlen;
+#else
+        Note("columnar log segment is compressed, but zlib support is not available");
+        goto done;
+#endif
+      }
+      if (col[i].type != LOG_COLUMN_ENTRY && col[i].type != LOG_COLUMN_INT) {
+        r[i].dict_ptr = (const char **)ats_malloc(header->entry_count * sizeof(char *));
+        r[i].dict_len = (uint32_t *)ats_malloc(header->entry_count * sizeof(uint32_t));
+      }
+    }
+    p += col[i].length;
+  }
+
+  {
+    char *out = buf + header->data_offset;
+    char *out_end = buf + buf_len;
+    int64_t timestamp = 0;
+
+    memcpy(buf, seg, header->data_offset);
+
+    for (uint32_t e = 0; e < header->entry_count; e++) {
+      uint64_t ts_delta, usec, pad;
+      LogEntryHeader *entry = (LogEntryHeader *) out;
+
+      if (!column_get_varint(&r[0].p, r[0].end, &ts_delta) ||
+          !column_get_varint(&r[0].p, r[0].end, &usec) || !column_get_varint(&r[0].p, r[0].end, &pad))
+        goto done;
+      if (out_end - out < (int)sizeof(LogEntryHeader))
+        goto done;
+      out += sizeof(LogEntryHeader);
+
+      for (i = 1; i < n_columns; i++) {
+        LogColumnReader *c = &r[i];
+
+        if (c->skip) {
+          if (out_end - out < LOG_COLUMN_MAX_PLACEHOLDER)
+            goto done;
+          out += column_placeholder((LogColumnType) col[i].type, col[i].width, out);
+        } else if (col[i].type == LOG_COLUMN_INT) {
+          for (int j = 0; j < col[i].width; j++) {
+            uint64_t v;
+            if (!column_get_varint(&c->p, c->end, &v) || out_end - out < INK_MIN_ALIGN)
+              goto done;
+            c->prev[j] = (int64_t) ((uint64_t) c->prev[j] + (uint64_t) zigzag_decode(v));
+            memset(out, 0, INK_MIN_ALIGN);
+            memcpy(out, &c->prev[j], sizeof(int64_t));
+            out += INK_MIN_ALIGN;
+          }
+        } else {
+          uint64_t idx, len;
+
+          if (!column_get_varint(&c->p, c->end, &idx))
+            goto done;
+          if (idx == c->dict_count) {
+            if (c->dict_count >= header->entry_count || !column_get_varint(&c->p, c->end, &len) ||
+                (uint64_t) (c->end - c->p) < len)
+              goto done;
+            c->dict_ptr[c->dict_count] = c->p;
+            c->dict_len[c->dict_count] = (uint32_t) len;
+            c->dict_count++;
+            c->p += len;
+          } else if (idx > c->dict_count) {
+            goto done;
+          }
+          len = c->dict_len[idx];
+          if ((uint64_t) (out_end - out) < len)
+            goto done;
+          memcpy(out, c->dict_ptr[idx], len);
+          out += len;
+        }
+      }
+
+      if ((uint64_t) (out_end - out) < pad)
+        goto done;
+      memset(out, 0, pad);
+      out += pad;
+
+      timestamp = (int64_t) ((uint64_t) timestamp + (uint64_t) zigzag_decode(ts_delta));
+      entry->timestamp = timestamp;
+      entry->timestamp_usec = (int32_t) usec;
+      entry->entry_len = (uint32_t) (out - (char *) entry);
+    }
+
+    LogBufferHeader *h = (LogBufferHeader *) buf;
+    h->version = LOG_SEGMENT_VERSION;
+    h->byte_count = (uint32_t) (out - buf);
+    ret = (int) h->byte_count;
+  }
+
+done:
+  for (i = 0; i < n_columns; i++) {
+    ats_free(r[i].inflated);
+    ats_free(r[i].dict_ptr);
+    ats_free(r[i].dict_len);
+  }
+  ats_free(r);
+  ats_free(col);
+  return ret;
+}
+
+#if TS_HAS_TESTS
+#include "Regression.h"
+#include "LogFormat.h"
+
+REGRESSION_TEST(LogColumnar_roundtrip) (RegressionTest * t, int atype, int *pstatus) {
+  NOWARN_UNUSED(atype);
+
+  static const int n_entries = 200;
+  static const char *urls[] = { "http://a.example.com/", "http://b.example.com/x", "/relative", "-" };
+  int64_t storage[4096];
+  char *buf = (char *)storage;
+  LogBufferHeader *header = (LogBufferHeader *) buf;
+  int64_t decoded_storage[4096];
+  char *decoded = (char *)decoded_storage;
+  char *segment = NULL;
+  int status = REGRESSION_TEST_PASSED;
+  int len;
+
+  LogFieldList fieldlist;
+  LogField port("client_host_port", "chp", LogField::sINT,
+                &LogAccess::marshal_client_host_port, &LogAccess::unmarshal_int_to_str);
+  LogField url("client_req_url", "cqu", LogField::STRING,
+               &LogAccess::marshal_client_req_url, (LogField::UnmarshalFunc)&LogAccess::unmarshal_str);
+  LogField ip("client_host_ip", "chi", LogField::IP,
+              &LogAccess::marshal_client_host_ip, &LogAccess::unmarshal_ip_to_str);
+  fieldlist.add(&port);
+  fieldlist.add(&url);
+  fieldlist.add(&ip);
+
+  // Lay down a row buffer by hand.
+  memset(buf, 0, sizeof(storage));
+  header->cookie = LOG_SEGMENT_COOKIE;
+  header->version = LOG_SEGMENT_VERSION;
+  header->format_type = CUSTOM_LOG;
+  header->data_offset = INK_ALIGN_DEFAULT(sizeof(LogBufferHeader));
+
+  char *p = buf + header->data_offset;
+  for (int e = 0; e < n_entries; e++) {
+    LogEntryHeader *entry = (LogEntryHeader *) p;
+    IpEndpoint addr;
+    const char *u = urls[e % 4];
+
+    entry->timestamp = 1350000000 + e / 3;
+    entry->timestamp_usec = e * 997;
+    p += sizeof(LogEntryHeader);
+    LogAccess::marshal_int(p, (e % 7) * 100 - 300);
+    p += INK_MIN_ALIGN;
+    LogAccess::marshal_str(p, u, LogAccess::strlen(u));
+    p += LogAccess::strlen(u);
+    if (e % 5)
+      ats_ip4_set(&addr, htonl(0x0a000000 | (e % 3)));
+    else
+      ats_ip_pton("2001:db8::1", &addr);
+    p += LogAccess::marshal_ip(p, &addr.sa);
+    entry->entry_len = p - (char *) entry;
+  }
+  header->entry_count = n_entries;
+  header->byte_count = p - buf;
+
+  for (int compress = 0; compress <= 1; compress++) {
+    len = LogColumnar::encode(header, &fieldlist, compress, &segment);
+    if (len <= 0 || len >= (int)header->byte_count) {
+      rprintf(t, "encode (compress=%d) failed: %d bytes for %u byte buffer\n", compress, len, header->byte_count);
+      *pstatus = REGRESSION_TEST_FAILED;
+      return;
+    }
+    rprintf(t, "%u byte buffer encoded to %d bytes (compress=%d)\n", header->byte_count, len, compress);
+
+    int64_t first_ts, first_usec;
+    if (!LogColumnar::first_timestamp((LogBufferHeader *) segment, &first_ts, &first_usec) ||
+        first_ts != 1350000000 || first_usec != 0) {
+      rprintf(t, "first_timestamp (compress=%d) does not match the first entry\n", compress);
+      status = REGRESSION_TEST_FAILED;
+    }
+
+    if (LogColumnar::decode((LogBufferHeader *) segment, decoded, sizeof(decoded_storage)) != (int)header->byte_count ||
+        memcmp(decoded, buf, header->byte_count) != 0) {
+      rprintf(t, "decode (compress=%d) does not reproduce the buffer\n", compress);
+      status = REGRESSION_TEST_FAILED;
+    }
+
+    // Skipping the url column: ints and IPs must survive, urls become "-".
+    bool skip[] = { false, true, false };
+    if (LogColumnar::decode((LogBufferHeader *) segment, decoded, sizeof(decoded_storage), skip, 3) <= 0) {
+      rprintf(t, "decode with skipped column failed\n");
+      status = REGRESSION_TEST_FAILED;
+    } else {
+      LogBufferIterator orig_iter(header);
+      LogBufferIterator skip_iter((LogBufferHeader *) decoded);
+      LogEntryHeader *a, *b;
+
+      while ((a = orig_iter.next()) && (b = skip_iter.next())) {
+        char *ra = (char *) a + sizeof(LogEntryHeader);
+        char *rb = (char *) b + sizeof(LogEntryHeader);
+
+        if (a->timestamp != b->timestamp || LogAccess::unmarshal_int(&ra) != LogAccess::unmarshal_int(&rb) ||
+            strcmp(rb, "-") != 0) {
+          rprintf(t, "skipped decode mismatch\n");
+          status = REGRESSION_TEST_FAILED;
+          break;
+        }
+      }
+    }
+    ats_free(segment);
+    segment = NULL;
+  }
+
+  *pstatus = status;
+}
+
+// traffic_logstats decodes squid segments without the fields it steps over
+// (see parse_skip_fields in logstats.cc); the url, method and hierarchy it
+// does read must survive that.
+REGRESSION_TEST(LogColumnar_squid_skip) (RegressionTest * t, int atype, int *pstatus) {
+  NOWARN_UNUSED(atype);
+
+  static const int n_entries = 50;
+  static const bool skip[] = {
+    true, false, true, false, false, false, false, false, true, false, true, false
+  };
+  static const char *skipped_symbols[] = { "cqtq", "chi", "caun", "pqsn" };
+  static const char *kept_symbols[] = { "cqhm", "cquc", "phr" };
+  int64_t storage[8192];
+  char *buf = (char *)storage;
+  LogBufferHeader *header = (LogBufferHeader *) buf;
+  int64_t decoded_storage[8192];
+  char *decoded = (char *)decoded_storage;
+  char *segment = NULL;
+  int status = REGRESSION_TEST_PASSED;
+  int len;
+
+  LogFormat squid(SQUID_LOG);
+  LogFieldList *fieldlist = &squid.m_field_list;
+  LogField *f;
+  int pos;
+
+  // The positions logstats skips have to be the fields it means to skip.
+  for (unsigned i = 0; i < sizeof(skipped_symbols) / sizeof(skipped_symbols[0]); i++) {
+    for (pos = 0, f = fieldlist->first(); f && strcmp(f->symbol(), skipped_symbols[i]); f = fieldlist->next(f))
+      pos++;
+    if (!f || pos >= (int)(sizeof(skip) / sizeof(skip[0])) || !skip[pos]) {
+      rprintf(t, "squid field %s is not skipped\n", skipped_symbols[i]);
+      status = REGRESSION_TEST_FAILED;
+    }
+  }
+  for (unsigned i = 0; i < sizeof(kept_symbols) / sizeof(kept_symbols[0]); i++) {
+    for (pos = 0, f = fieldlist->first(); f && strcmp(f->symbol(), kept_symbols[i]); f = fieldlist->next(f))
+      pos++;
+    if (!f || (pos < (int)(sizeof(skip) / sizeof(skip[0])) && skip[pos])) {
+      rprintf(t, "squid field %s is skipped\n", kept_symbols[i]);
+      status = REGRESSION_TEST_FAILED;
+    }
+  }
+
+  memset(buf, 0, sizeof(storage));
+  header->cookie = LOG_SEGMENT_COOKIE;
+  header->version = LOG_SEGMENT_VERSION;
+  header->format_type = SQUID_LOG;
+  header->data_offset = INK_ALIGN_DEFAULT(sizeof(LogBufferHeader));
+
+  char *p = buf + header->data_offset;
+  for (int e = 0; e < n_entries; e++) {
+    LogEntryHeader *entry = (LogEntryHeader *) p;
+    char url[64];
+    IpEndpoint addr;
+
+    entry->timestamp = 1350000000 + e;
+    entry->timestamp_usec = 0;
+    p += sizeof(LogEntryHeader);
+    snprintf(url, sizeof(url), "http://origin%d.example.com/%d", e % 5, e);
+    for (f = fieldlist->first(); f; f = fieldlist->next(f)) {
+      switch (f->type()) {
+      case LogField::STRING: {
+        const char *str = strcmp(f->symbol(), "cquc") == 0 ? url : f->symbol();
+        LogAccess::marshal_str(p, str, LogAccess::strlen(str));
+        p += LogAccess::strlen(str);
+        break;
+      }
+      case LogField::IP:
+        ats_ip4_set(&addr, htonl(0x0a000001 + e));
+        p += LogAccess::marshal_ip(p, &addr.sa);
+        break;
+      default:
+        LogAccess::marshal_int(p, e + 1);
+        p += INK_MIN_ALIGN;
+        break;
+      }
+    }
+    entry->entry_len = p - (char *) entry;
+  }
+  header->entry_count = n_entries;
+  header->byte_count = p - buf;
+
+  len = LogColumnar::encode(header, fieldlist, true, &segment);
+  if (len <= 0) {
+    rprintf(t, "encode failed for a %u byte squid buffer\n", header->byte_count);
+    *pstatus = REGRESSION_TEST_FAILED;
+    return;
+  }
+  if (LogColumnar::decode((LogBufferHeader *) segment, decoded, sizeof(decoded_storage), skip,
+                          sizeof(skip) / sizeof(skip[0])) <= 0) {
+    rprintf(t, "decode with the logstats skip list failed\n");
+    status = REGRESSION_TEST_FAILED;
+  } else {
+    LogBufferIterator orig_iter(header);
+    LogBufferIterator skip_iter((LogBufferHeader *) decoded);
+    LogEntryHeader *a, *b;
+
+    while ((a = orig_iter.next()) && (b = skip_iter.next()) && status == REGRESSION_TEST_PASSED) {
+      char *ra = (char *) a + sizeof(LogEntryHeader);
+      char *rb = (char *) b + sizeof(LogEntryHeader);
+      IpEndpoint ip;
+
+      for (pos = 0, f = fieldlist->first(); f; f = fieldlist->next(f), pos++) {
+        bool skipped = pos < (int)(sizeof(skip) / sizeof(skip[0])) && skip[pos];
+
+        switch (f->type()) {
+        case LogField::STRING:
+          if (skipped ? strcmp(rb, "-") != 0 : strcmp(ra, rb) != 0) {
+            rprintf(t, "field %s decoded as \"%s\", logged \"%s\"\n", f->symbol(), rb, ra);
+            status = REGRESSION_TEST_FAILED;
+          }
+          ra += LogAccess::strlen(ra);
+          rb += LogAccess::strlen(rb);
+          break;
+        case LogField::IP:
+          LogAccess::unmarshal_ip(&ra, &ip);
+          LogAccess::unmarshal_ip(&rb, &ip);
+          break;
+        default:
+          if (LogAccess::unmarshal_int(&ra) != LogAccess::unmarshal_int(&rb) && !skipped) {
+            rprintf(t, "field %s does not survive the skipped decode\n", f->symbol());
+            status = REGRESSION_TEST_FAILED;
+          }
+          break;
+        }
+      }
+    }
+  }
+  ats_free(segment);
+
+  *pstatus = status;
+}
+#endif /* TS_HAS_TESTS */
@@ -0,0 +1,132 @@
+/** @file
+
+  Columnar encoding of binary log segments
+
+  @section license License
+
+  Licensed to the Apache Software Foundation (ASF) under one
+  or more contributor license agreements.  See the NOTICE file
+  distributed with this work for additional information
+  regarding copyright ownership.  The ASF licenses this file
+  to you under the Apache License, Version 2.0 (the
+  "License"); you may not use this file except in compliance
+  with the License.  You may obtain a copy of the License at
+
+      http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+ */
+
+
+#if !defined (INK_NO_LOG)
+#ifndef LOG_COLUMNAR_H
+#define LOG_COLUMNAR_H
+
+#include "libts.h"
+#include "LogBuffer.h"
+
+class LogFieldList;
+
+/*-------------------------------------------------------------------------
+  Columnar log segments
+
+  A columnar segment starts with the same LogBufferHeader (and header
+  strings) as a row segment, with version LOG_SEGMENT_COLUMNAR_VERSION.
+  At data_offset, instead of the entries, there is a LogColumnDirectory
+  followed by one LogColumnHeader per column and then the column
+  payloads, in order:
+
+    column 0      the entry headers: zigzag varint timestamp deltas,
+                  varint usec, varint trailing padding
+    column 1..n   one column per field of the format's field list
+
+  Integer fields are stored as zigzag varint deltas from the previous
+  entry.  Everything else (strings, IPs, http text, records) is stored
+  dictionary encoded: a varint index per entry, where the index one past
+  the current dictionary size introduces a new value (varint length plus
+  the marshaled bytes).  Each column is optionally zlib compressed on its
+  own, so readers that do not need a column never inflate it.
+
+  Decoding rebuilds an ordinary LOG_SEGMENT_VERSION buffer, so readers can
+  keep using LogBufferIterator and the unmarshal routines.
+  -------------------------------------------------------------------------*/
+
+enum LogColumnType
+{
+  LOG_COLUMN_ENTRY = 0,
+  LOG_COLUMN_INT,
+  LOG_COLUMN_STR,
+  LOG_COLUMN_IP,
+  LOG_COLUMN_HTTP_TEXT,
+  LOG_COLUMN_RECORD
+};
+
+enum LogColumnCompression
+{
+  LOG_COLUMN_UNCOMPRESSED = 0,
+  LOG_COLUMN_ZLIB
+};
+
+struct LogColumnDirectory
+{
+  uint32_t n_columns;           // including the entry column
+  uint32_t row_bytes;           // byte_count of the row buffer encoded
+};
+
+struct LogColumnHeader
+{
+  uint16_t type;                // LogColumnType
+  uint16_t width;               // ints per entry, for LOG_COLUMN_INT
+  uint32_t compression;         // LogColumnCompression
+  uint32_t length;              // bytes stored in the segment
+  uint32_t raw_length;          // bytes after decompression
+};
+
+class LogColumnar
+{
+public:
+  /**
+    Encode the row buffer @a header, logged with @a fieldlist, as a
+    columnar segment.  On success returns the segment length and sets
+    @a segment to an ats_malloc'd copy.  Returns -1 if the buffer cannot
+    be encoded (unknown field layout, aggregate entries) or the result
+    would not be smaller than the row buffer; the caller should then
+    write the row buffer as is.
+  */
+  static int encode(LogBufferHeader * header, LogFieldList * fieldlist, bool compress, char **segment);
+
+  /**
+    Decode the columnar segment @a header into a row buffer in @a buf.
+    If @a skip is given, fields whose skip[i] is true (i being the field
+    position, for i < n_skip) are not decoded; they are filled with an
+    empty value of the same layout ("-", 0, or an unset IP).  Returns
+    the number of bytes written to @a buf, or -1 on a malformed segment
+    or if @a buf_len is too small.
+  */
+  static int decode(LogBufferHeader * header, char *buf, int buf_len, const bool *skip = NULL, int n_skip = 0);
+
+  /**
+    Size of the row buffer decode() will produce for @a header, or -1 if
+    @a header is not a well formed columnar segment.
+  */
+  static int decoded_size(LogBufferHeader * header);
+
+  /**
+    Timestamp of the first entry of the columnar segment @a header,
+    without decoding the segment.  Returns false if @a header is empty
+    or not a well formed columnar segment.
+  */
+  static bool first_timestamp(LogBufferHeader * header, int64_t * timestamp, int64_t * usec);
+
+  static bool is_columnar(LogBufferHeader * header)
+  {
+    return header->cookie == LOG_SEGMENT_COOKIE && header->version == LOG_SEGMENT_COLUMNAR_VERSION;
+  }
+};
+
+#endif
+#endif // INK_NO_LOG
@@ -104,6 +104,8 @@ LogConfig::setup_default_values()
 
   log_buffer_size = (int) (10 * LOG_KILOBYTE);
   max_secs_per_buffer = 5;
+  per_thread_buffers = 1;
+  columnar_binary = 0;
   max_space_mb_for_logs = 100;
   max_space_mb_for_orphan_logs = 25;
   max_space_mb_headroom = 10;
@@ -142,6 +144,8 @@ LogConfig::setup_default_values()
   collation_secret = ats_strdup("foobar");
   collation_retry_sec = 0;
   collation_max_send_buffers = 0;
+  collation_max_inflight_buffers = 0;
+  collation_compress = 0;
 
   rolling_enabled = NO_ROLLING;
   rolling_interval_sec = 86400; // 24 hours
@@ -213,6 +217,9 @@ LogConfig::read_configuration_variables()
     max_secs_per_buffer = val;
   }
 
+  per_thread_buffers = (int) REC_ConfigReadInteger("proxy.config.log.per_thread_buffers");
+  columnar_binary = (int) REC_ConfigReadInteger("proxy.config.log.columnar_binary");
+
   val = (int) REC_ConfigReadInteger("proxy.config.log.max_space_mb_for_logs");
   if (val > 0) {
     max_space_mb_for_logs = val;
@@ -462,6 +469,13 @@ LogConfig::read_configuration_variables()
     collation_max_send_buffers = val;
   }
 
+  val = (int) REC_ConfigReadInteger("proxy.config.log.collation_max_inflight_buffers");
+  if (val >= 0) {
+    collation_max_inflight_buffers = val;
+  }
+
+  collation_compress = (int) REC_ConfigReadInteger("proxy.config.log.collation_compress");
+
 
   // ROLLING
 
@@ -799,6 +813,8 @@ LogConfig::display(FILE * fd)
   fprintf(fd, "Config variables:\n");
   fprintf(fd, "   log_buffer_size = %d\n", log_buffer_size);
   fprintf(fd, "   max_secs_per_buffer = %d\n", max_secs_per_buffer);
+  fprintf(fd, "   per_thread_buffers = %d\n", per_thread_buffers);
+  fprintf(fd, "   columnar_binary = %d\n", columnar_binary);
   fprintf(fd, "   max_space_mb_for_logs = %d\n", max_space_mb_for_logs);
   fprintf(fd, "   max_space_mb_for_orphan_logs = %d\n", max_space_mb_for_orphan_logs);
   fprintf(fd, "   use_orphan_log_space_value = %d\n", use_orphan_log_space_value);
@@ -1258,6 +1274,8 @@ LogConfig::register_config_callbacks()
   // Note: variables that are not exposed in the UI are commented out
   //
   REC_RegisterConfigUpdateFunc("proxy.config.log.log_buffer_size", &LogConfig::reconfigure, NULL);
+  REC_RegisterConfigUpdateFunc("proxy.config.log.per_thread_buffers", &LogConfig::reconfigure, NULL);
+  REC_RegisterConfigUpdateFunc("proxy.config.log.columnar_binary", &LogConfig::reconfigure, NULL);
 //    REC_RegisterConfigUpdateFunc ("proxy.config.log.max_secs_per_buffer",
 //                            &LogConfig::reconfigure, NULL);
   REC_RegisterConfigUpdateFunc("proxy.config.log.max_space_mb_for_logs", &LogConfig::reconfigure, NULL);
@@ -1307,6 +1325,10 @@ LogConfig::register_config_callbacks()
 //    REC_RegisterConfigUpdateFunc ("proxy.config.log.collation_retry_sec",
 //                                  &LogConfig::reconfigure, NULL);
 //    REC_RegisterConfigUpdateFunc ("proxy.config.log.collation_max_send_buffers",
+//                                  &LogConfig::reconfigure, NULL);
+//    REC_RegisterConfigUpdateFunc ("proxy.config.log.collation_max_inflight_buffers",
+//                                  &LogConfig::reconfigure, NULL);
+//    REC_RegisterConfigUpdateFunc ("proxy.config.log.collation_compress",
 //                                  &LogConfig::reconfigure, NULL);
 
   // ROLLING
@@ -191,6 +191,8 @@ public:
 
   int log_buffer_size;
   int max_secs_per_buffer;
+  int per_thread_buffers;
+  int columnar_binary;
   int max_space_mb_for_logs;
   int max_space_mb_for_orphan_logs;
   int max_space_mb_headroom;
@@ -212,6 +214,8 @@ public:
   int collation_preproc_threads;
   int collation_retry_sec;
   int collation_max_send_buffers;
+  int collation_max_inflight_buffers;
+  int collation_compress;
   int rolling_enabled;
   int rolling_interval_sec;
   int rolling_offset_hr;
@@ -45,6 +45,7 @@
 #include "LogFilter.h"
 #include "LogFormat.h"
 #include "LogBuffer.h"
+#include "LogColumnar.h"
 #include "LogFile.h"
 #include "LogHost.h"
 #include "LogObject.h"
@@ -513,10 +514,40 @@ LogFile::preproc_and_try_delete(LogBuffer * lb)
     // don't change between buffers), it's not worth trying to separate
     // out the buffer-dependent data from the buffer-independent data.
     //
-    LogFlushData *flush_data = new LogFlushData(this, lb);
-
     ProxyMutex *mutex = this_thread()->mutex;
 
+    //
+    // With proxy.config.log.columnar_binary the buffer is re-encoded as a
+    // columnar segment (see LogColumnar.h); buffers that can't be encoded,
+    // or don't get smaller, are still written as is.
+    //
+    LogObject *owner = lb->get_owner();
+
+    if (Log::config->columnar_binary && owner && owner->m_format && !owner->m_format->is_aggregate()) {
+      char *segment = NULL;
+      int segment_len = LogColumnar::encode(buffer_header, &owner->m_format->m_field_list,
+                                            Log::config->columnar_binary > 1, &segment);
+
+      if (segment_len > 0) {
+        LogFlushData *flush_data = new LogFlushData(this, segment, segment_len);
+
+        RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_flush_to_disk_stat,
+                       buffer_header->entry_count);
+
+        RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_bytes_flush_to_disk_stat,
+                       segment_len);
+
+        ink_atomiclist_push(Log::flush_data_list, flush_data);
+
+        Log::flush_notify->signal();
+
+        ret = 0;
+        goto done;
+      }
+    }
+
+    LogFlushData *flush_data = new LogFlushData(this, lb);
+
     RecIncrRawStat(log_rsb, mutex->thread_holding, log_stat_num_flush_to_disk_stat,
                    lb->header()->entry_count);
 
@@ -60,11 +60,27 @@ LogBufferManager::preproc_buffers(LogBufferSink *sink) {
   }
 
   int prepared = 0;
-  while ((b = new_q.pop())) {
-    b->update_header_data();
-    sink->preproc_and_try_delete(b);
-    ink_atomic_increment(&_num_flush_buffers, -1);
-    prepared++;
+  int nbuffers = 0;
+  LogBuffer *batch[FLUSH_BATCH_SIZE];
+
+  // Buffers staged on different threads reach us in the order they filled
+  // up, not in the order of their entries, so each batch is put back into
+  // timestamp order before it goes to the sink.
+  while ((b = new_q.pop()) || nbuffers) {
+    if (b) {
+      b->update_header_data();
+      batch[nbuffers++] = b;
+      if (nbuffers < FLUSH_BATCH_SIZE && new_q.head)
+        continue;
+    }
+    if (nbuffers > 1)
+      qsort(batch, nbuffers, sizeof(LogBuffer *), LogBuffer::compare_first_timestamp);
+    for (int i = 0; i < nbuffers; i++) {
+      sink->preproc_and_try_delete(batch[i]);
+      ink_atomic_increment(&_num_flush_buffers, -1);
+      prepared++;
+    }
+    nbuffers = 0;
   }
 
   Debug("log-logbuffer", "prepared %d buffers", prepared);
@@ -96,6 +112,8 @@ LogObject::LogObject(LogFormat *format, const char *log_dir,
     ink_debug_assert (format != NULL);
     m_format = new LogFormat(*format);
     m_buffer_manager = new LogBufferManager[m_flush_threads];
+    m_thread_buffers = Log::config->per_thread_buffers ?
+      (LogBuffer **) ats_calloc(MAX_EVENT_THREADS, sizeof(LogBuffer *)) : NULL;
 
     if (file_format == BINARY_LOG) {
         m_flags |= BINARY;
@@ -148,6 +166,8 @@ LogObject::LogObject(LogObject& rhs)
 {
     m_format = new LogFormat(*(rhs.m_format));
     m_buffer_manager = new LogBufferManager[m_flush_threads];
+    m_thread_buffers = Log::config->per_thread_buffers ?
+      (LogBuffer **) ats_calloc(MAX_EVENT_THREADS, sizeof(LogBuffer *)) : NULL;
 
 #ifndef TS_MICRO
     if (rhs.m_logFile) {
@@ -189,6 +209,7 @@ LogObject::~LogObject()
     Debug("log-config", "LogObject refcount = %d, waiting for zero", m_ref_count);
   }
 
+  _flush_thread_buffers(0);
   preproc_buffers();
 
   // here we need to free LogHost if it is remote logging.
@@ -203,6 +224,7 @@ LogObject::~LogObject()
   delete m_format;
   delete[] m_buffer_manager;
   delete (LogBuffer*)FREELIST_POINTER(m_log_buffer);
+  ats_free((void *) m_thread_buffers);
 }
 
 //-----------------------------------------------------------------------------
@@ -463,11 +485,8 @@ LogObject::_checkout_write(size_t * write_offset, size_t bytes_needed) {
       if (FREELIST_POINTER(old_h) == FREELIST_POINTER(h)) {
         ink_atomic_increment(&buffer->m_references, FREELIST_VERSION(old_h) - 1);
 
-        int idx = m_buffer_manager_idx++ % m_flush_threads;
         Debug("log-logbuffer", "adding buffer %d to flush list after checkout", buffer->get_id());
-        m_buffer_manager[idx].add_to_flush_queue(buffer);
-        Log::preproc_notify[idx].signal();
-
+        _add_to_flush_queue_and_signal(buffer);
       }
       decremented = true;
       break;
@@ -512,6 +531,142 @@ LogObject::_checkout_write(size_t * write_offset, size_t bytes_needed) {
 }
 
 
+void
+LogObject::_add_to_flush_queue_and_signal(LogBuffer * buffer)
+{
+  int idx = add_to_flush_queue(buffer);
+  Log::preproc_notify[idx].signal();
+}
+
+/*-------------------------------------------------------------------------
+  Per-thread staging buffers
+
+  Each EThread writes into its own LogBuffer for this object, so the
+  checkout/checkin state of a buffer is never shared between threads.
+  When a staging buffer fills up or expires it is handed to the flush
+  queue whole, just like the shared buffer is.
+  -------------------------------------------------------------------------*/
+
+LogBuffer * volatile *
+LogObject::_thread_buffer_slot()
+{
+  EThread *t;
+
+  if (!m_thread_buffers || (t = this_ethread()) == NULL) {
+    return NULL;
+  }
+  // Only regular event threads have a stable index
+  if (t->tt != REGULAR || t->id < 0 || t->id >= MAX_EVENT_THREADS) {
+    return NULL;
+  }
+  return &m_thread_buffers[t->id];
+}
+
+LogBuffer *
+LogObject::_checkout_thread_write(LogBuffer * volatile *slot, size_t * write_offset, size_t bytes_needed)
+{
+  // take ownership of our staging buffer, if the flush side left it to us
+  LogBuffer *buffer = (LogBuffer *) ink_atomic_swap_ptr((vvoidp) slot, NULL);
+
+  for (;;) {
+    if (!buffer) {
+      buffer = NEW(new LogBuffer(this, Log::config->log_buffer_size));
+    }
+
+    switch (buffer->checkout_write(write_offset, bytes_needed)) {
+    case LogBuffer::LB_OK:
+      return buffer;
+
+    case LogBuffer::LB_FULL_ACTIVE_WRITERS:
+    case LogBuffer::LB_FULL_NO_WRITERS:
+      Debug("log-logbuffer", "adding staging buffer %d to flush list after checkout", buffer->get_id());
+      _add_to_flush_queue_and_signal(buffer);
+      buffer = NULL;
+      break;
+
+    case LogBuffer::LB_BUFFER_TOO_SMALL:
+      // the buffer is still empty, keep it for the next entry
+      _stage_thread_buffer(slot, buffer);
+      return NULL;
+
+    default:
+      // nobody else writes to a staging buffer, so there is no contention
+      ink_release_assert(!"unexpected LogBuffer checkout result for a staging buffer");
+    }
+  }
+}
+
+void
+LogObject::_checkin_thread_write(LogBuffer * volatile *slot, LogBuffer * buffer, size_t write_offset)
+{
+  buffer->checkin_write(write_offset);
+
+  if (LogUtils::timestamp() > buffer->expiration_time()) {
+    buffer->checkout_write(NULL, 0);    // mark it full
+    _add_to_flush_queue_and_signal(buffer);
+  } else {
+    _stage_thread_buffer(slot, buffer);
+  }
+}
+
+// Put a buffer back into its slot. The flush side may have returned an
+// unexpired buffer to the slot while we were writing to a newer one; that
+// older buffer is retired rather than overwritten.
+void
+LogObject::_stage_thread_buffer(LogBuffer * volatile *slot, LogBuffer * buffer)
+{
+  LogBuffer *old = (LogBuffer *) ink_atomic_swap_ptr((vvoidp) slot, buffer);
+
+  if (old) {
+    _retire_thread_buffer(old);
+  }
+}
+
+void
+LogObject::_retire_thread_buffer(LogBuffer * buffer)
+{
+  if (buffer->checkout_write(NULL, 0) == LogBuffer::LB_OK) {
+    // never written to
+    delete buffer;
+  } else {
+    Debug("log-logbuffer", "adding expired staging buffer %d to flush list", buffer->get_id());
+    _add_to_flush_queue_and_signal(buffer);
+  }
+}
+
+// Move the staging buffers that have expired by time_now (or all of them,
+// if time_now is 0) to the flush queue. A buffer which is currently being
+// written to is not in its slot and will be picked up the next time.
+//
+// The owning thread may retire a buffer the moment it leaves the slot, so
+// a buffer is only looked at after it has been swapped out; one that has
+// not expired yet is put back, unless the owner has staged a newer buffer
+// in the meantime.
+void
+LogObject::_flush_thread_buffers(long time_now)
+{
+  if (!m_thread_buffers) {
+    return;
+  }
+
+  for (int i = 0; i < eventProcessor.n_ethreads; i++) {
+    LogBuffer *b;
+
+    if (!m_thread_buffers[i]) {
+      continue;
+    }
+    if ((b = (LogBuffer *) ink_atomic_swap_ptr((vvoidp) &m_thread_buffers[i], NULL)) == NULL) {
+      continue;
+    }
+    if (time_now && time_now <= b->expiration_time() &&
+        ink_atomic_cas_ptr((pvvoidp) &m_thread_buffers[i], NULL, b)) {
+      continue;
+    }
+    _retire_thread_buffer(b);
+  }
+}
+
+
 int
 LogObject::log(LogAccess * lad, char *text_entry)
 {
@@ -584,8 +739,10 @@ LogObject::log(LogAccess * lad, char *text_entry)
     return Log::SKIP;
   }
 
-  // Now try to place this entry in the current LogBuffer.
-  buffer = _checkout_write(&offset, bytes_needed);
+  // Now try to place this entry in the current LogBuffer, preferably
+  // the one staged for this thread.
+  LogBuffer * volatile *slot = _thread_buffer_slot();
+  buffer = slot ? _checkout_thread_write(slot, &offset, bytes_needed) : _checkout_write(&offset, bytes_needed);
 
   if (!buffer) {
     Note("Skipping the current log entry for %s because its size (%zu) exceeds "
@@ -612,7 +769,11 @@ LogObject::log(LogAccess * lad, char *text_entry)
     ink_strlcpy(&(*buffer)[offset], text_entry, bytes_needed);
   }
 
-  buffer->checkin_write(offset);
+  if (slot) {
+    _checkin_thread_write(slot, buffer, offset);
+  } else {
+    buffer->checkin_write(offset);
+  }
 
   return Log::LOG_OK;
 }
@@ -777,8 +938,9 @@ LogObject::check_buffer_expiration(long time_now)
 {
   LogBuffer *b = (LogBuffer*)FREELIST_POINTER(m_log_buffer);
   if (b && time_now > b->expiration_time()) {
-    force_new_buffer();
+    _checkout_write(NULL, 0);
   }
+  _flush_thread_buffers(time_now);
 }
 
 
@@ -1345,3 +1507,104 @@ LogObjectManager::log(LogAccess * lad)
 
   return ret;
 }
+
+#if TS_HAS_TESTS
+#include "Regression.h"
+
+struct LogThreadBufferSink: public LogBufferSink
+{
+  volatile int entries;
+
+  LogThreadBufferSink(): entries(0) { }
+
+  int preproc_and_try_delete(LogBuffer * buffer)
+  {
+    ink_atomic_increment(&entries, buffer->header()->entry_count);
+    delete buffer;
+    return 0;
+  }
+};
+
+struct LogThreadBufferWriter: public Continuation
+{
+  LogObject *object;
+  int nentries;
+  volatile int *nlogged;
+  volatile int *ndone;
+
+  LogThreadBufferWriter(LogObject * o, int n, volatile int *logged, volatile int *done)
+    : Continuation(new_ProxyMutex()), object(o), nentries(n), nlogged(logged), ndone(done)
+  {
+    SET_HANDLER(&LogThreadBufferWriter::mainEvent);
+  }
+
+  int mainEvent(int /* event */, void * /* data */)
+  {
+    char entry[] = "thread buffer regression entry";
+
+    for (int i = 0; i < nentries; i++) {
+      if (object->log(NULL, entry) == Log::LOG_OK)
+        ink_atomic_increment(nlogged, 1);
+    }
+    ink_atomic_increment(ndone, 1);
+    delete this;
+    return EVENT_DONE;
+  }
+};
+
+#define LOG_THREAD_BUFFER_ENTRIES 20000
+
+// Writers on other threads fill their staging buffers while this thread
+// keeps taking them away, both before and after they expire. Every entry
+// that was logged must come out of the flush queue exactly once.
+REGRESSION_TEST(LogObject_thread_buffer_flush) (RegressionTest * t, int atype, int *pstatus) {
+  NOWARN_UNUSED(atype);
+
+  if (!Log::config || !Log::config->per_thread_buffers) {
+    rprintf(t, "per thread log buffers are not enabled\n");
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  EThread *self = this_ethread();
+  EThread *threads[MAX_EVENT_THREADS];
+  int nthreads = 0;
+
+  for (int i = 0; i < eventProcessor.n_threads_for_type[ET_CALL]; i++) {
+    if (eventProcessor.eventthread[ET_CALL][i] != self)
+      threads[nthreads++] = eventProcessor.eventthread[ET_CALL][i];
+  }
+  if (nthreads == 0) {
+    rprintf(t, "no event threads available\n");
+    *pstatus = REGRESSION_TEST_NOT_RUN;
+    return;
+  }
+
+  LogFormat format(TEXT_LOG);
+  LogObject *object = NEW(new LogObject(&format, Log::config->logfile_dir, "regression_thread_buffers.log",
+                                        ASCII_LOG, NULL, LogConfig::NO_ROLLING, 1));
+  LogThreadBufferSink sink;
+  volatile int nlogged = 0, ndone = 0;
+
+  for (int i = 0; i < nthreads; i++)
+    threads[i]->schedule_imm(NEW(new LogThreadBufferWriter(object, LOG_THREAD_BUFFER_ENTRIES, &nlogged, &ndone)));
+
+  for (int pass = 0; ndone < nthreads; pass++) {
+    if (pass & 1)
+      object->force_new_buffer();
+    else
+      object->check_buffer_expiration(LogUtils::timestamp());
+    object->preproc_buffers(0, &sink);
+  }
+
+  object->force_new_buffer();
+  for (int i = 0; i < 1000 && sink.entries < nlogged; i++) {
+    object->preproc_buffers(0, &sink);
+    usleep(1000);
+  }
+
+  rprintf(t, "%d threads logged %d entries, %d flushed\n", nthreads, nlogged, sink.entries);
+  *pstatus = (nlogged > 0 && sink.entries == nlogged) ? REGRESSION_TEST_PASSED : REGRESSION_TEST_FAILED;
+  delete object;
+}
+#endif /* TS_HAS_TESTS */
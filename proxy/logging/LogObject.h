@@ -54,6 +54,7 @@
 #define ASCII_PIPE_OBJECT_FILENAME_EXTENSION ".pipe"
 
 #define FLUSH_ARRAY_SIZE (512*4)
+#define FLUSH_BATCH_SIZE 64
 
 #define LOG_OBJECT_ARRAY_DELTA 8
 
@@ -124,14 +125,16 @@ public:
     return idx;
   }
 
-  size_t preproc_buffers(int idx = -1)
+  size_t preproc_buffers(int idx = -1, LogBufferSink *sink = NULL)
   {
     size_t nfb;
 
     if (idx == -1)
       idx = m_buffer_manager_idx++ % m_flush_threads;
 
-    if (m_logFile) {
+    if (sink) {
+      nfb = m_buffer_manager[idx].preproc_buffers(sink);
+    } else if (m_logFile) {
       nfb = m_buffer_manager[idx].preproc_buffers(m_logFile);
     } else {
       nfb = m_buffer_manager[idx].preproc_buffers(&m_host_list);
@@ -192,6 +195,7 @@ public:
 
   void force_new_buffer() {
     _checkout_write(NULL, 0);
+    _flush_thread_buffers(0);
   }
 
   bool operator==(LogObject & rhs);
@@ -233,6 +237,12 @@ private:
   unsigned m_buffer_manager_idx;
   LogBufferManager *m_buffer_manager;
 
+  // Per-EThread staging buffers, indexed by EThread::id. The owning thread
+  // takes the buffer out (swaps in NULL) for the duration of a write; the
+  // flush side may take it at any time it finds it there, and only puts an
+  // unexpired buffer back into an empty slot. NULL if staging is disabled.
+  LogBuffer * volatile *m_thread_buffers;
+
   void generate_filenames(const char *log_dir, const char *basename, LogFileFormat file_format);
   void _setup_rolling(int rolling_enabled, int rolling_interval_sec, int rolling_offset_hr, int rolling_size_mb);
 #ifndef TS_MICRO
@@ -241,6 +251,14 @@ private:
 
   LogBuffer *_checkout_write(size_t * write_offset, size_t write_size);
 
+  LogBuffer * volatile *_thread_buffer_slot();
+  LogBuffer *_checkout_thread_write(LogBuffer * volatile *slot, size_t * write_offset, size_t write_size);
+  void _checkin_thread_write(LogBuffer * volatile *slot, LogBuffer * buffer, size_t write_offset);
+  void _stage_thread_buffer(LogBuffer * volatile *slot, LogBuffer * buffer);
+  void _retire_thread_buffer(LogBuffer * buffer);
+  void _flush_thread_buffers(long time_now);
+  void _add_to_flush_queue_and_signal(LogBuffer * buffer);
+
 private:
   // -- member functions not allowed --
   LogObject();
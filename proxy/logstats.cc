@@ -33,6 +33,7 @@
 #include "LogStandalone.cc"
 
 #include "LogObject.h"
+#include "LogColumnar.h"
 #include "hdrs/HTTP.h"
 
 #include <math.h>
@@ -1176,6 +1177,15 @@ update_schemes(OriginStats * stat, int scheme, int size)
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// Fields (by LogField position in the squid format) that parse_log_buff()
+// steps over without looking at: the timestamp (cqtq, 0), client IP (chi, 2),
+// rfc931 user (caun, 8) and peer host (pqsn, 10). Note that crc/pssc and
+// phr/pqsn are two fields each.
+static const bool parse_skip_fields[] = {
+  true, false, true, false, false, false, false, false, true, false, true, false
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // Parse a log buffer
 int
@@ -1701,7 +1711,7 @@ process_file(int in_fd, off_t offset, unsigned max_age)
     }
 
     Debug("logstats", "LogBuffer version %d, current = %d", header->version, LOG_SEGMENT_VERSION);
-    if (header->version != LOG_SEGMENT_VERSION)
+    if (header->version != LOG_SEGMENT_VERSION && header->version != LOG_SEGMENT_COLUMNAR_VERSION)
       return 1;
 
     // read the rest of the header
@@ -1732,7 +1742,21 @@ process_file(int in_fd, off_t offset, unsigned max_age)
 
     // Possibly skip too old entries (the entire buffer is skipped)
     if (header->high_timestamp >= max_age) {
-      if (parse_log_buff(header, cl.summary != 0) != 0) {
+      LogBufferHeader *rows = header;
+
+      // Expand columnar segments, without decoding the fields that
+      // parse_log_buff() only steps over.
+      if (LogColumnar::is_columnar(header)) {
+        static char row_buffer[MAX_LOGBUFFER_SIZE];
+
+        if (LogColumnar::decode(header, row_buffer, sizeof(row_buffer), parse_skip_fields,
+                                sizeof(parse_skip_fields) / sizeof(parse_skip_fields[0])) < 0) {
+          Debug("logstats", "Failed to decode columnar log buffer.");
+          return 1;
+        }
+        rows = (LogBufferHeader *) row_buffer;
+      }
+      if (parse_log_buff(rows, cl.summary != 0) != 0) {
         Debug("logstats", "Failed to parse log buffer.");
         return 1;
       }